@@ -0,0 +1,33 @@
+// Times SeasonalModel::add_observation at a small and a large window. Once
+// the ring is full every update evicts one observation, so the cost per
+// update should not depend on the window size.
+//
+// Build with -DBUILD_BENCHMARKS=ON and run `bench_seasonal_model`.
+
+#include "learning/seasonal_model.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <initializer_list>
+
+namespace {
+constexpr int kUpdates = 200000;
+constexpr uint64_t kBaseTime = 1700000000000ULL;
+
+double ns_per_update(size_t min_samples) {
+  learning::SeasonalModel model(min_samples);
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kUpdates; ++i)
+    model.add_observation(10.0 + i % 7, kBaseTime + i * 1000ULL);
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration<double, std::nano>(elapsed).count() / kUpdates;
+}
+} // namespace
+
+int main() {
+  for (size_t min_samples : {100, 20000})
+    std::printf("SeasonalModel::add_observation  window %6zu  %8.1f ns\n",
+                min_samples * 2, ns_per_update(min_samples));
+  return 0;
+}
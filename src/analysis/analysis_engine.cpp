@@ -1,6 +1,7 @@
 #include "analysis_engine.hpp"
 #include "analysis/per_session_state.hpp"
 #include "analyzed_event.hpp"
+#include "core/compact_serialization.hpp"
 #include "core/config.hpp"
 #include "core/log_entry.hpp"
 #include "core/logger.hpp"
@@ -8,6 +9,7 @@
 #include "models/feature_manager.hpp"
 #include "prometheus_anomaly_detector.hpp"
 #include "utils/scoped_timer.hpp"
+#include "utils/stream_sketches.hpp"
 #include "utils/ua_parser.hpp"
 #include "utils/utils.hpp"
 
@@ -16,56 +18,77 @@
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
+#include <filesystem>
 #include <fstream>
+#include <optional>
+#include <stdexcept>
 #include <string>
 #include <string_view>
+#include <tuple>
+
+using analysis::RequestType;
+
+constexpr uint32_t SNAPSHOT_FORMAT_VERSION = 3;
+// Full snapshots end with the session offset, the IP index offset and the IP
+// count as fixed-width words
+constexpr size_t SNAPSHOT_FOOTER_BYTES = 24;
+
+// Pattern sets of AnalysisEngine::ua_markers_, as match_sets() bits
+enum UaMarkerSet : uint32_t {
+  UA_HEADLESS = 1u << 0,
+  UA_KNOWN_BAD = 1u << 1,
+  UA_DESKTOP = 1u << 2,
+  UA_MOBILE = 1u << 3,
+  UA_SUSPICIOUS = 1u << 4
+};
+
+Utils::AhoCorasick build_ua_markers(const Config::Tier1Config &cfg) {
+  return Utils::AhoCorasick::from_sets({cfg.headless_browser_substrings,
+                                        {"sqlmap", "Nmap"},
+                                        {"Windows", "Macintosh", "Linux"},
+                                        {"iPhone", "Android"},
+                                        cfg.suspicious_ua_substrings});
+}
 
-enum class RequestType { HTML, ASSET, OTHER };
-
-constexpr uint32_t STATE_FILE_VERSION = 1;
-
-RequestType get_request_type(const std::string &raw_path,
-                             const Config::Tier1Config &cfg) {
-
-  std::string path = raw_path;
-  size_t query_pos = path.find('?');
-  if (query_pos != std::string::npos)
-    path = path.substr(0, query_pos);
-
-  size_t fragment_pos = path.find('#');
-  if (fragment_pos != std::string::npos)
-    path = path.substr(0, fragment_pos);
-
-  for (const auto &exact : cfg.html_exact_paths) {
-    if (path == exact)
-      return RequestType::HTML;
-  }
-
-  for (const auto &prefix : cfg.asset_path_prefixes) {
-    if (path.rfind(prefix, 0) == 0)
-      return RequestType::ASSET;
+// Seeds the verdict cache keys with every setting classify_user_agent reads
+uint64_t ua_verdict_seed(const Config::Tier1Config &cfg) {
+  std::string settings = std::to_string(cfg.min_chrome_version) + '/' +
+                         std::to_string(cfg.min_firefox_version);
+  for (const auto &headless_str : cfg.headless_browser_substrings) {
+    settings += '\0';
+    settings += headless_str;
   }
-
-  size_t last_dot = path.rfind('.');
-  if (last_dot != std::string::npos) {
-    std::string suffix = path.substr(last_dot);
-
-    for (const auto &s : cfg.html_path_suffixes) {
-      if (suffix == s)
-        return RequestType::HTML;
-    }
-
-    for (const auto &s : cfg.asset_path_suffixes) {
-      if (suffix == s)
-        return RequestType::ASSET;
-    }
+  settings += '\1';
+  for (const auto &suspicious_str : cfg.suspicious_ua_substrings) {
+    settings += '\0';
+    settings += suspicious_str;
   }
+  return Utils::sketch_hash(settings);
+}
 
-  return RequestType::OTHER;
+std::shared_ptr<analysis::UaVerdictCache>
+make_ua_verdict_cache(const Config::Tier1Config &cfg) {
+  if (cfg.ua_verdict_cache_size == 0)
+    return nullptr;
+  return std::make_shared<analysis::UaVerdictCache>(cfg.ua_verdict_cache_size);
 }
 
-AnalysisEngine::AnalysisEngine(const Config::AppConfig &cfg)
-    : app_config(cfg), feature_manager_(), last_cleanup_timestamp_(0) {
+AnalysisEngine::AnalysisEngine(
+    const Config::AppConfig &cfg,
+    std::shared_ptr<const analysis::RequestClassifier> request_classifier)
+    : app_config(cfg), ua_markers_(build_ua_markers(cfg.tier1)),
+      ua_verdicts_(make_ua_verdict_cache(cfg.tier1)),
+      ua_verdict_seed_(ua_verdict_seed(cfg.tier1)),
+      request_classifier_(
+          request_classifier
+              ? request_classifier
+              : std::make_shared<const analysis::RequestClassifier>(
+                    cfg.tier1)),
+      owns_request_classifier_(!request_classifier),
+      path_stats_(std::make_shared<analysis::SharedPathStats>()),
+      traffic_sketches_(std::make_shared<analysis::TrafficSketchSet>(
+          1, cfg.tier1.sliding_window_duration_seconds * 1000)),
+      feature_manager_(), last_cleanup_timestamp_(0) {
   LOG(LogLevel::INFO, LogComponent::ANALYSIS_LIFECYCLE,
       "AnalysisEngine created.");
 
@@ -81,6 +104,10 @@ AnalysisEngine::AnalysisEngine(const Config::AppConfig &cfg)
   // - memory::threading::CircularBuffer for high-performance circular buffers
   // These primitives can be used to optimize hot paths and reduce contention
 
+  if (app_config.tier1.subnet_rollup_enabled)
+    subnet_rollup_ = std::make_shared<analysis::SubnetRollup>(
+        app_config.tier1.sliding_window_duration_seconds * 1000);
+
   if (app_config.ml_data_collection_enabled) {
     data_collector_ = std::make_unique<ModelDataCollector>(
         app_config.ml_data_collection_path);
@@ -95,7 +122,26 @@ AnalysisEngine::~AnalysisEngine() {}
 PerIpState &
 AnalysisEngine::get_or_create_ip_state(const std::string &ip,
                                        uint64_t current_timestamp_ms) {
+  if (track_dirty_)
+    dirty_ips_.insert(ip);
   auto it = ip_activity_trackers.find(ip);
+  if (it == ip_activity_trackers.end() && cold_ip_store_) {
+    if (auto rehydrated = rehydrate_ip_state(ip, current_timestamp_ms)) {
+      LOG(LogLevel::DEBUG, LogComponent::ANALYSIS_LIFECYCLE,
+          "Rehydrated PerIpState for IP: " << ip << " from the cold tier");
+      return ip_activity_trackers.emplace(ip, std::move(*rehydrated))
+          .first->second;
+    }
+  }
+  if (it == ip_activity_trackers.end() && lazy_ips_) {
+    if (auto restored = lazy_ips_->take(ip)) {
+      LOG(LogLevel::TRACE, LogComponent::ANALYSIS_LIFECYCLE,
+          "Loaded restored PerIpState for IP: " << ip << " on first access");
+      restored->last_seen_timestamp_ms = current_timestamp_ms;
+      return ip_activity_trackers.emplace(ip, std::move(*restored))
+          .first->second;
+    }
+  }
   if (it == ip_activity_trackers.end()) {
     LOG(LogLevel::DEBUG, LogComponent::ANALYSIS_LIFECYCLE,
         "Creating new PerIpState for IP: " << ip);
@@ -117,25 +163,6 @@ AnalysisEngine::get_or_create_ip_state(const std::string &ip,
   }
 }
 
-PerPathState &
-AnalysisEngine::get_or_create_path_state(const std::string &path,
-                                         uint64_t current_timestamp_ms) {
-  auto it = path_activity_trackers.find(path);
-  if (it == path_activity_trackers.end()) {
-    LOG(LogLevel::DEBUG, LogComponent::ANALYSIS_LIFECYCLE,
-        "Creating new PerPathState for Path: " << path);
-    auto [inserted_it, success] = path_activity_trackers.emplace(
-        path, PerPathState(current_timestamp_ms));
-    return inserted_it->second;
-  } else {
-    LOG(LogLevel::TRACE, LogComponent::ANALYSIS_LIFECYCLE,
-        "Found existing PerPathState for Path: "
-            << path << ". Updating last_seen timestamp.");
-    it->second.last_seen_timestamp_ms = current_timestamp_ms;
-    return it->second;
-  }
-}
-
 std::string AnalysisEngine::build_session_key(const LogEntry &raw_log) const {
   std::string session_key;
 
@@ -152,65 +179,105 @@ std::string AnalysisEngine::build_session_key(const LogEntry &raw_log) const {
   return session_key;
 }
 
-void perform_advanced_ua_analysis(const std::string &ua,
-                                  const Config::Tier1Config &cfg,
-                                  PerIpState &ip_state, AnalyzedEvent &event,
-                                  uint64_t ts, uint64_t max_ts) {
-  LOG(LogLevel::TRACE, LogComponent::ANALYSIS_LIFECYCLE,
-      "Performing advanced UA analysis.");
-  if (!cfg.check_user_agent_anomalies) {
-    LOG(LogLevel::TRACE, LogComponent::ANALYSIS_LIFECYCLE,
-        "UA analysis is disabled in config, skipping.");
-    return;
-  }
+// Steps 2-4 of the UA checks depend only on the UA string and the config
+analysis::UaVerdict classify_user_agent(std::string_view ua,
+                                        const Config::Tier1Config &cfg,
+                                        const Utils::AhoCorasick &ua_markers) {
+  analysis::UaVerdict verdict;
 
-  // 1. Missing UA
-  if (ua.empty() || ua == "-") {
-    LOG(LogLevel::TRACE, LogComponent::ANALYSIS_LIFECYCLE, "UA is missing.");
-    event.is_ua_missing = true;
-    return;
+  // 2. Headless/Known Bad Bot detection, along with the platform markers
+  // of step 4, in a single pass over the UA
+  const uint32_t markers = ua_markers.match_sets(ua);
+  if (markers & UA_HEADLESS) {
+    LOG(LogLevel::TRACE, LogComponent::ANALYSIS_LIFECYCLE,
+        "Found headless browser string in UA.");
+    verdict.flags |= analysis::UaVerdict::HEADLESS;
   }
-
-  // 2. Headless/Known Bad Bot detection
-  for (const auto &headless_str : cfg.headless_browser_substrings)
-    if (ua.find(headless_str) != std::string::npos) {
-      LOG(LogLevel::TRACE, LogComponent::ANALYSIS_LIFECYCLE,
-          "Found headless browser string '" << headless_str << "' in UA.");
-      event.is_ua_headless = true;
-      break;
-    }
-  if (ua.find("sqlmap") != std::string::npos ||
-      ua.find("Nmap") != std::string::npos) {
+  if (markers & UA_KNOWN_BAD) {
     LOG(LogLevel::TRACE, LogComponent::ANALYSIS_LIFECYCLE,
         "Found known bad bot string in UA.");
-    event.is_ua_known_bad = true;
+    verdict.flags |= analysis::UaVerdict::KNOWN_BAD;
   }
+  if (markers & UA_SUSPICIOUS)
+    verdict.flags |= analysis::UaVerdict::SUSPICIOUS;
 
   // 3. Version Check
   if (auto ver = UAParser::get_major_version(ua, "Chrome/");
       ver && *ver < cfg.min_chrome_version) {
     LOG(LogLevel::TRACE, LogComponent::ANALYSIS_LIFECYCLE,
         "Detected outdated Chrome version: " << *ver);
-    event.is_ua_outdated = true;
-    event.detected_browser_version = "Chrome/" + std::to_string(*ver);
+    verdict.flags |=
+        analysis::UaVerdict::OUTDATED | analysis::UaVerdict::CHROME;
+    verdict.browser_major = static_cast<uint16_t>(std::clamp(*ver, 0, 65535));
   } else if (auto ver = UAParser::get_major_version(ua, "Firefox/");
              ver && *ver < cfg.min_firefox_version) {
     LOG(LogLevel::TRACE, LogComponent::ANALYSIS_LIFECYCLE,
         "Detected outdated Firefox version: " << *ver);
-    event.is_ua_outdated = true;
-    event.detected_browser_version = "Firefox/" + std::to_string(*ver);
+    verdict.flags |=
+        analysis::UaVerdict::OUTDATED | analysis::UaVerdict::FIREFOX;
+    verdict.browser_major = static_cast<uint16_t>(std::clamp(*ver, 0, 65535));
   }
 
   // 4. Platform Inconsistency
-  bool has_desktop = ua.find("Windows") != std::string::npos ||
-                     ua.find("Macintosh") != std::string::npos ||
-                     ua.find("Linux") != std::string::npos;
-  bool has_mobile = ua.find("iPhone") != std::string::npos ||
-                    ua.find("Android") != std::string::npos;
+  bool has_desktop = markers & UA_DESKTOP;
+  bool has_mobile = markers & UA_MOBILE;
   if (has_desktop && has_mobile) {
     LOG(LogLevel::TRACE, LogComponent::ANALYSIS_LIFECYCLE,
         "Detected inconsistent UA platform (both mobile and desktop).");
-    event.is_ua_inconsistent = true;
+    verdict.flags |= analysis::UaVerdict::INCONSISTENT;
+  }
+  return verdict;
+}
+
+void perform_advanced_ua_analysis(std::string_view ua,
+                                  const Config::Tier1Config &cfg,
+                                  const Utils::AhoCorasick &ua_markers,
+                                  analysis::UaVerdictCache *verdict_cache,
+                                  uint64_t verdict_seed, PerIpState &ip_state,
+                                  AnalyzedEvent &event, uint64_t ts,
+                                  uint64_t max_ts) {
+  LOG(LogLevel::TRACE, LogComponent::ANALYSIS_LIFECYCLE,
+      "Performing advanced UA analysis.");
+  // The suspicious UA rule reads its flag from the same scan, so the UA is
+  // classified whenever that rule has patterns to look for
+  if (!cfg.check_user_agent_anomalies &&
+      cfg.suspicious_ua_substrings.empty()) {
+    LOG(LogLevel::TRACE, LogComponent::ANALYSIS_LIFECYCLE,
+        "UA analysis is disabled in config, skipping.");
+    return;
+  }
+
+  // 1. Missing UA
+  if (ua.empty() || ua == "-") {
+    LOG(LogLevel::TRACE, LogComponent::ANALYSIS_LIFECYCLE, "UA is missing.");
+    event.is_ua_missing = cfg.check_user_agent_anomalies;
+    return;
+  }
+
+  // 2-4. Cached per distinct UA
+  std::optional<analysis::UaVerdict> cached;
+  uint64_t key = 0;
+  if (verdict_cache) {
+    key = analysis::UaVerdictCache::key_for(ua, verdict_seed);
+    cached = verdict_cache->find(key);
+  }
+  analysis::UaVerdict verdict =
+      cached ? *cached : classify_user_agent(ua, cfg, ua_markers);
+  if (verdict_cache && !cached)
+    verdict_cache->insert(key, verdict);
+
+  event.found_suspicious_ua_str =
+      verdict.has(analysis::UaVerdict::SUSPICIOUS);
+  if (!cfg.check_user_agent_anomalies)
+    return;
+  event.is_ua_headless = verdict.has(analysis::UaVerdict::HEADLESS);
+  event.is_ua_known_bad = verdict.has(analysis::UaVerdict::KNOWN_BAD);
+  event.is_ua_inconsistent = verdict.has(analysis::UaVerdict::INCONSISTENT);
+  if (verdict.has(analysis::UaVerdict::OUTDATED)) {
+    event.is_ua_outdated = true;
+    event.detected_browser_version =
+        (verdict.has(analysis::UaVerdict::CHROME) ? "Chrome/" : "Firefox/") +
+        std::to_string(verdict.browser_major);
   }
 
   // 5. UA changed and cycling check
@@ -242,7 +309,7 @@ void perform_advanced_ua_analysis(const std::string &ua,
   if (!found_in_window) {
     LOG(LogLevel::TRACE, LogComponent::ANALYSIS_WINDOW,
         "Adding new unique UA to window: " << ua);
-    ip_state.recent_unique_ua_window.add_event(ts, ua);
+    ip_state.recent_unique_ua_window.add_event(ts, std::string(ua));
   }
   if (ip_state.recent_unique_ua_window.get_event_count() >
       static_cast<size_t>(cfg.max_unique_uas_per_ip_in_window)) {
@@ -256,34 +323,22 @@ void perform_advanced_ua_analysis(const std::string &ua,
 bool AnalysisEngine::save_state(const std::string &path) const {
   LOG(LogLevel::TRACE, LogComponent::STATE_PERSIST,
       "Entering save_state to path: " << path);
+  core::BinarySerializer out;
+  encode_snapshot(out);
+
   std::string temp_path = path + ".tmp";
   Utils::create_directory_for_file(path);
-  std::ofstream out(temp_path, std::ios::binary);
-  if (!out) {
-    LOG(LogLevel::ERROR, LogComponent::STATE_PERSIST,
-        "AnalysisEngine: Could not open temporary state file for writing: "
-            << temp_path);
-    return false;
-  }
-
-  // Write header
-  out.write(reinterpret_cast<const char *>(&app_config.state_file_magic),
-            sizeof(app_config.state_file_magic));
-  out.write(reinterpret_cast<const char *>(&STATE_FILE_VERSION),
-            sizeof(STATE_FILE_VERSION));
-
-  // Write IP trackers
-  size_t ip_map_size = ip_activity_trackers.size();
-  LOG(LogLevel::DEBUG, LogComponent::STATE_PERSIST,
-      "Saving " << ip_map_size << " IP states.");
-  out.write(reinterpret_cast<const char *>(&ip_map_size), sizeof(ip_map_size));
-  for (const auto &pair : ip_activity_trackers) {
-    Utils::save_string(out, pair.first);
-    pair.second.save(out);
+  {
+    std::ofstream file(temp_path, std::ios::binary);
+    if (!file) {
+      LOG(LogLevel::ERROR, LogComponent::STATE_PERSIST,
+          "AnalysisEngine: Could not open temporary state file for writing: "
+              << temp_path);
+      return false;
+    }
+    file.write(reinterpret_cast<const char *>(out.data().data()), out.size());
   }
 
-  out.close();
-
   if (std::rename(temp_path.c_str(), path.c_str()) != 0) {
     LOG(LogLevel::ERROR, LogComponent::STATE_PERSIST,
         "AnalysisEngine: Could not rename temporary state file to final path: "
@@ -300,55 +355,329 @@ bool AnalysisEngine::save_state(const std::string &path) const {
 bool AnalysisEngine::load_state(const std::string &path) {
   LOG(LogLevel::TRACE, LogComponent::STATE_PERSIST,
       "Entering load_state from path: " << path);
-  std::ifstream in(path, std::ios::binary);
-  if (!in) {
+  if (!std::filesystem::exists(path)) {
     LOG(LogLevel::INFO, LogComponent::STATE_PERSIST,
         "AnalysisEngine: No state file found at: " << path
                                                    << ". Starting fresh.");
     return false;
   }
+  return restore_snapshot_file(path);
+}
+
+std::vector<uint8_t> AnalysisEngine::capture_snapshot() {
+  core::BinarySerializer out;
+  encode_snapshot(out);
+  track_dirty_ = true;
+  dirty_ips_.clear();
+  dirty_sessions_.clear();
+  return out.data();
+}
+
+void AnalysisEngine::encode_snapshot(core::BinarySerializer &out) const {
+  out.write_uint32(app_config.state_file_magic);
+  out.write_uint32(SNAPSHOT_FORMAT_VERSION);
+  out.write_varint64(max_timestamp_seen_);
+
+  // Cold and not-yet-loaded restored entries are already in
+  // PerIpState::serialize form and are copied through as-is
+  const size_t ip_count = ip_activity_trackers.size() +
+                          get_cold_ip_state_count() +
+                          (lazy_ips_ ? lazy_ips_->pending() : 0);
+  std::vector<std::pair<uint64_t, uint64_t>> index;
+  index.reserve(ip_count);
+  auto write_ip = [&](const std::string &ip, const uint8_t *data,
+                      size_t size) {
+    index.emplace_back(analysis::LazyIpSnapshot::key_hash(ip), out.size());
+    out.write_string_raw(ip);
+    out.write_blob(data, size);
+  };
+
+  out.write_varint64(ip_count);
+  core::BinarySerializer ip_out;
+  for (const auto &[ip, state] : ip_activity_trackers) {
+    ip_out.clear();
+    state.serialize(ip_out);
+    write_ip(ip, ip_out.data().data(), ip_out.size());
+  }
+  if (cold_ip_store_)
+    cold_ip_store_->for_each(write_ip);
+  if (lazy_ips_)
+    lazy_ips_->for_each_pending(write_ip);
+
+  const uint64_t sessions_offset = out.size();
+  out.write_varint64(session_trackers.size());
+  for (const auto &[key, session] : session_trackers) {
+    out.write_string_raw(key);
+    session.serialize(out);
+  }
+
+  // Lets restore_snapshot_file() find any IP without decoding the others
+  const uint64_t index_offset = out.size();
+  std::sort(index.begin(), index.end());
+  for (const auto &[hash, offset] : index) {
+    out.write_uint64(hash);
+    out.write_uint64(offset);
+  }
+  out.write_uint64(sessions_offset);
+  out.write_uint64(index_offset);
+  out.write_uint64(index.size());
+}
+
+bool AnalysisEngine::restore_snapshot(const uint8_t *data, size_t size) {
+  const uint64_t window_duration_ms =
+      app_config.tier1.sliding_window_duration_seconds * 1000;
+  try {
+    core::BinaryDeserializer in(data, size);
+    uint64_t max_ts = 0;
+    if (!read_snapshot_header(in, max_ts))
+      return false;
+
+    std::unordered_map<std::string, PerIpState> ips;
+    std::unordered_map<std::string, PerSessionState> sessions;
+    uint64_t ip_count = in.read_varint64();
+    ips.reserve(ip_count);
+    for (uint64_t i = 0; i < ip_count; ++i) {
+      std::string ip = in.read_string_raw();
+      auto [blob, blob_size] = in.read_blob();
+      PerIpState state(0, window_duration_ms, window_duration_ms);
+      core::BinaryDeserializer ip_in(blob, blob_size);
+      state.deserialize(ip_in);
+      ips.insert_or_assign(std::move(ip), std::move(state));
+    }
+    read_snapshot_sessions(in, sessions);
+
+    // Only swap in once the whole snapshot decoded cleanly
+    ip_activity_trackers = std::move(ips);
+    session_trackers = std::move(sessions);
+    lazy_ips_.reset();
+    if (cold_ip_store_)
+      cold_ip_store_->clear();
+    max_timestamp_seen_ = max_ts;
+    dirty_ips_.clear();
+    dirty_sessions_.clear();
+  } catch (const std::exception &e) {
+    LOG(LogLevel::ERROR, LogComponent::STATE_PERSIST,
+        "Snapshot is truncated or corrupt: " << e.what());
+    return false;
+  }
+
+  refresh_state_memory_estimate();
+  LOG(LogLevel::INFO, LogComponent::STATE_PERSIST,
+      "Restored " << ip_activity_trackers.size() << " IP and "
+                  << session_trackers.size() << " session states.");
+  return true;
+}
 
-  // Read and validate header
-  uint32_t magic = 0, version = 0;
-  in.read(reinterpret_cast<char *>(&magic), sizeof(magic));
-  in.read(reinterpret_cast<char *>(&version), sizeof(version));
+bool AnalysisEngine::restore_snapshot_file(const std::string &path) {
+  auto file = std::make_shared<core::MappedFile>(path);
+  if (!file->is_open() || file->size() < SNAPSHOT_FOOTER_BYTES)
+    return false;
 
-  if (magic != app_config.state_file_magic || version != STATE_FILE_VERSION) {
+  const uint64_t window_duration_ms =
+      app_config.tier1.sliding_window_duration_seconds * 1000;
+  try {
+    core::BinaryDeserializer in(file->data(), file->size());
+    uint64_t max_ts = 0;
+    if (!read_snapshot_header(in, max_ts))
+      return false;
+
+    core::BinaryDeserializer footer(
+        file->data() + file->size() - SNAPSHOT_FOOTER_BYTES,
+        SNAPSHOT_FOOTER_BYTES);
+    const uint64_t sessions_offset = footer.read_uint64();
+    const uint64_t index_offset = footer.read_uint64();
+    const uint64_t ip_count = footer.read_uint64();
+    if (sessions_offset > index_offset ||
+        index_offset > file->size() - SNAPSHOT_FOOTER_BYTES)
+      throw std::runtime_error("snapshot footer is out of bounds");
+
+    // Sessions are short-lived and few, so they are decoded up front
+    std::unordered_map<std::string, PerSessionState> sessions;
+    core::BinaryDeserializer session_in(file->data() + sessions_offset,
+                                        index_offset - sessions_offset);
+    read_snapshot_sessions(session_in, sessions);
+
+    auto lazy = std::make_unique<analysis::LazyIpSnapshot>(
+        file, static_cast<size_t>(index_offset),
+        static_cast<size_t>(ip_count),
+        [window_duration_ms](const uint8_t *blob, size_t blob_size) {
+          PerIpState state(0, window_duration_ms, window_duration_ms);
+          core::BinaryDeserializer ip_in(blob, blob_size);
+          state.deserialize(ip_in);
+          return state;
+        });
+
+    ip_activity_trackers.clear();
+    session_trackers = std::move(sessions);
+    if (cold_ip_store_)
+      cold_ip_store_->clear();
+    max_timestamp_seen_ = max_ts;
+    dirty_ips_.clear();
+    dirty_sessions_.clear();
+    lazy_ips_ = std::move(lazy);
+    lazy_ips_->start_warming();
+  } catch (const std::exception &e) {
+    LOG(LogLevel::ERROR, LogComponent::STATE_PERSIST,
+        "Snapshot " << path << " is truncated or corrupt: " << e.what());
+    return false;
+  }
+
+  refresh_state_memory_estimate();
+  LOG(LogLevel::INFO, LogComponent::STATE_PERSIST,
+      "Mapped " << lazy_ips_->pending() << " IP states from " << path
+                << " for lazy loading, restored " << session_trackers.size()
+                << " session states.");
+  return true;
+}
+
+bool AnalysisEngine::read_snapshot_header(core::BinaryDeserializer &in,
+                                          uint64_t &max_ts) const {
+  uint32_t magic = in.read_uint32();
+  uint32_t version = in.read_uint32();
+  if (magic != app_config.state_file_magic ||
+      version != SNAPSHOT_FORMAT_VERSION) {
     LOG(LogLevel::WARN, LogComponent::STATE_PERSIST,
-        "Warning: State file is incompatible or corrupt. Starting fresh. File "
-        "magic/version: "
-            << magic << "/" << version);
+        "Snapshot is incompatible (magic/version " << magic << "/" << version
+                                                   << "). Starting fresh.");
     return false;
   }
+  max_ts = in.read_varint64();
+  return true;
+}
 
-  // Read IP trackers
-  size_t ip_map_size = 0;
-  in.read(reinterpret_cast<char *>(&ip_map_size), sizeof(ip_map_size));
-  LOG(LogLevel::DEBUG, LogComponent::STATE_PERSIST,
-      "Loading " << ip_map_size << " IP states.");
-  ip_activity_trackers.clear();
-  for (size_t i = 0; i < ip_map_size; ++i) {
-    std::string ip = Utils::load_string(in);
-    PerIpState state;
-    state.load(in);
-    ip_activity_trackers.emplace(ip, std::move(state));
-  }
-
-  // Read Path trackers
-  size_t path_map_size = 0;
-  in.read(reinterpret_cast<char *>(&path_map_size), sizeof(path_map_size));
-  LOG(LogLevel::DEBUG, LogComponent::STATE_PERSIST,
-      "Loading " << path_map_size << " Path states.");
-  path_activity_trackers.clear();
-  for (size_t i = 0; i < path_map_size; ++i) {
-    std::string path_str = Utils::load_string(in);
-    PerPathState state;
-    state.load(in);
-    path_activity_trackers.emplace(path_str, std::move(state));
+void AnalysisEngine::read_snapshot_sessions(
+    core::BinaryDeserializer &in,
+    std::unordered_map<std::string, PerSessionState> &sessions) const {
+  const uint64_t window_duration_ms =
+      app_config.tier1.sliding_window_duration_seconds * 1000;
+  uint64_t session_count = in.read_varint64();
+  sessions.reserve(session_count);
+  for (uint64_t i = 0; i < session_count; ++i) {
+    std::string key = in.read_string_raw();
+    PerSessionState session(0, window_duration_ms);
+    session.deserialize(in);
+    sessions.insert_or_assign(std::move(key), std::move(session));
   }
+}
 
-  LOG(LogLevel::INFO, LogComponent::STATE_PERSIST,
-      "AnalysisEngine state successfully loaded from " << path);
+void AnalysisEngine::adopt_warmed_ip_states() {
+  for (auto &[ip, state] : lazy_ips_->drain_warmed())
+    ip_activity_trackers.emplace(std::move(ip), std::move(state));
+  if (lazy_ips_->pending() == 0) {
+    LOG(LogLevel::INFO, LogComponent::STATE_PERSIST,
+        "All restored IP states are loaded, releasing the snapshot mapping.");
+    lazy_ips_.reset();
+  }
+}
+
+std::vector<uint8_t> AnalysisEngine::capture_delta() {
+  core::BinarySerializer out;
+  out.write_uint32(app_config.state_file_magic);
+  out.write_uint32(SNAPSHOT_FORMAT_VERSION);
+  out.write_varint64(max_timestamp_seen_);
+
+  // Each entry is the key, a presence flag and, if present, the full state.
+  // An IP may have been demoted since it was marked, so the cold tier is
+  // checked before recording a removal.
+  out.write_varint64(dirty_ips_.size());
+  core::BinarySerializer ip_out;
+  for (const auto &ip : dirty_ips_) {
+    out.write_string_raw(ip);
+    auto it = ip_activity_trackers.find(ip);
+    if (it != ip_activity_trackers.end()) {
+      ip_out.clear();
+      it->second.serialize(ip_out);
+      out.write_bool(true);
+      out.write_blob(ip_out.data().data(), ip_out.size());
+    } else if (!cold_ip_store_ ||
+               !cold_ip_store_->visit(ip, [&out](const uint8_t *data,
+                                                 size_t size) {
+                 out.write_bool(true);
+                 out.write_blob(data, size);
+               })) {
+      out.write_bool(false);
+    }
+  }
+
+  out.write_varint64(dirty_sessions_.size());
+  for (const auto &key : dirty_sessions_) {
+    out.write_string_raw(key);
+    auto it = session_trackers.find(key);
+    out.write_bool(it != session_trackers.end());
+    if (it != session_trackers.end())
+      it->second.serialize(out);
+  }
+
+  track_dirty_ = true;
+  dirty_ips_.clear();
+  dirty_sessions_.clear();
+  return out.data();
+}
+
+bool AnalysisEngine::apply_delta(const uint8_t *data, size_t size) {
+  const uint64_t window_duration_ms =
+      app_config.tier1.sliding_window_duration_seconds * 1000;
+  std::vector<std::pair<std::string, std::optional<PerIpState>>> ips;
+  std::vector<std::pair<std::string, std::optional<PerSessionState>>> sessions;
+  uint64_t max_ts = 0;
+  try {
+    core::BinaryDeserializer in(data, size);
+    if (in.read_uint32() != app_config.state_file_magic ||
+        in.read_uint32() != SNAPSHOT_FORMAT_VERSION) {
+      LOG(LogLevel::WARN, LogComponent::STATE_PERSIST,
+          "Snapshot delta is incompatible, ignoring it.");
+      return false;
+    }
+    max_ts = in.read_varint64();
+
+    uint64_t ip_count = in.read_varint64();
+    for (uint64_t i = 0; i < ip_count; ++i) {
+      std::string ip = in.read_string_raw();
+      std::optional<PerIpState> state;
+      if (in.read_bool()) {
+        auto [blob, blob_size] = in.read_blob();
+        state.emplace(0, window_duration_ms, window_duration_ms);
+        core::BinaryDeserializer ip_in(blob, blob_size);
+        state->deserialize(ip_in);
+      }
+      ips.emplace_back(std::move(ip), std::move(state));
+    }
+
+    uint64_t session_count = in.read_varint64();
+    for (uint64_t i = 0; i < session_count; ++i) {
+      std::string key = in.read_string_raw();
+      std::optional<PerSessionState> session;
+      if (in.read_bool()) {
+        session.emplace(0, window_duration_ms);
+        session->deserialize(in);
+      }
+      sessions.emplace_back(std::move(key), std::move(session));
+    }
+  } catch (const std::exception &e) {
+    LOG(LogLevel::ERROR, LogComponent::STATE_PERSIST,
+        "Snapshot delta is truncated or corrupt: " << e.what());
+    return false;
+  }
+
+  // Only applied once the whole record decoded cleanly
+  for (auto &[ip, state] : ips) {
+    if (cold_ip_store_)
+      cold_ip_store_->take(ip);
+    if (lazy_ips_)
+      lazy_ips_->drop(ip);
+    if (state)
+      ip_activity_trackers.insert_or_assign(std::move(ip), std::move(*state));
+    else
+      ip_activity_trackers.erase(ip);
+  }
+  for (auto &[key, session] : sessions) {
+    if (session)
+      session_trackers.insert_or_assign(std::move(key), std::move(*session));
+    else
+      session_trackers.erase(key);
+  }
+  max_timestamp_seen_ = std::max(max_timestamp_seen_, max_ts);
+  refresh_state_memory_estimate();
   return true;
 }
 
@@ -595,9 +924,30 @@ void AnalysisEngine::export_state_metrics() {
   metrics_exporter_->set_gauge(
       "ad_analysis_ip_states_total",
       static_cast<double>(state_metrics.total_ip_states));
+  if (subnet_rollup_) {
+    for (const auto &[label, ipv6, wide] :
+         {std::tuple{"v4_24", false, false}, std::tuple{"v4_16", false, true},
+          std::tuple{"v6_64", true, false}, std::tuple{"v6_48", true, true}})
+      metrics_exporter_->set_gauge(
+          "ad_analysis_subnet_rollups_total",
+          static_cast<double>(subnet_rollup_->tracked_subnet_count(ipv6, wide)),
+          {{"level", label}});
+  }
+  if (cold_ip_store_) {
+    metrics_exporter_->set_gauge(
+        "ad_analysis_cold_ip_states_total",
+        static_cast<double>(cold_ip_store_->entry_count()));
+    metrics_exporter_->set_gauge(
+        "ad_analysis_cold_state_file_bytes",
+        static_cast<double>(cold_ip_store_->file_bytes()));
+  }
   metrics_exporter_->set_gauge(
       "ad_analysis_path_states_total",
       static_cast<double>(state_metrics.total_path_states));
+  metrics_exporter_->set_gauge("ad_analysis_distinct_ips_estimate",
+                               traffic_sketches_->distinct_ips());
+  metrics_exporter_->set_gauge("ad_analysis_distinct_paths_estimate",
+                               traffic_sketches_->distinct_paths());
   metrics_exporter_->set_gauge(
       "ad_analysis_session_states_total",
       static_cast<double>(state_metrics.total_session_states));
@@ -686,10 +1036,7 @@ void AnalysisEngine::export_state_metrics() {
   total_memory_footprint += ip_states_memory;
 
   // Calculate and export memory footprint for path states
-  size_t path_states_memory = 0;
-  for (const auto &[path, state] : path_activity_trackers) {
-    path_states_memory += state.calculate_memory_footprint();
-  }
+  size_t path_states_memory = path_stats_->memory_footprint();
   metrics_exporter_->set_gauge("ad_analysis_path_states_memory_bytes_total",
                                static_cast<double>(path_states_memory));
   total_memory_footprint += path_states_memory;
@@ -715,6 +1062,7 @@ void AnalysisEngine::run_pruning(uint64_t current_timestamp_ms) {
   if (ttl_ms == 0 || !app_config.state_pruning_enabled) {
     LOG(LogLevel::DEBUG, LogComponent::STATE_PRUNE,
         "State pruning is disabled or TTL is 0, skipping.");
+    refresh_state_memory_estimate();
     return;
   }
 
@@ -723,28 +1071,63 @@ void AnalysisEngine::run_pruning(uint64_t current_timestamp_ms) {
     export_state_metrics();
   }
 
+  // With the cold tier enabled, IPs idle past the hot threshold are demoted
+  // instead of kept in RAM; only those past the TTL are dropped outright
+  const uint64_t hot_idle_ms =
+      static_cast<uint64_t>(
+          app_config.memory_management.hot_state_idle_seconds) *
+      1000;
   size_t ips_before = ip_activity_trackers.size();
+  size_t ips_demoted = 0;
   for (auto it = ip_activity_trackers.begin();
        it != ip_activity_trackers.end();) {
-    if ((current_timestamp_ms - it->second.last_seen_timestamp_ms) > ttl_ms)
+    const uint64_t last_seen = it->second.last_seen_timestamp_ms;
+    const uint64_t idle_ms =
+        current_timestamp_ms > last_seen ? current_timestamp_ms - last_seen : 0;
+    if (idle_ms > ttl_ms) {
+      if (track_dirty_)
+        dirty_ips_.insert(it->first);
       it = ip_activity_trackers.erase(it);
-    else
+    } else if (cold_ip_store_ && idle_ms > hot_idle_ms) {
+      if (demote_ip_state(it->first, it->second))
+        ++ips_demoted;
+      else if (track_dirty_)
+        dirty_ips_.insert(it->first);
+      it = ip_activity_trackers.erase(it);
+    } else {
       ++it;
+    }
   }
   LOG(LogLevel::DEBUG, LogComponent::STATE_PRUNE,
-      "Pruned " << (ips_before - ip_activity_trackers.size()) << " IP states.");
+      "Pruned " << (ips_before - ip_activity_trackers.size() - ips_demoted)
+                << " IP states, demoted " << ips_demoted
+                << " to the cold tier.");
+
+  if (cold_ip_store_) {
+    const uint64_t cutoff_ms =
+        current_timestamp_ms > ttl_ms ? current_timestamp_ms - ttl_ms : 0;
+    // Expiries are not marked dirty: a copy restored from an older delta is
+    // past the TTL too and is dropped again by the next pass
+    size_t expired = cold_ip_store_->expire_older_than(cutoff_ms);
+    size_t reclaimed = 0;
+    if (cold_ip_store_->file_bytes() - cold_ip_store_->live_bytes() >
+        cold_ip_store_->file_bytes() / 2)
+      reclaimed = cold_ip_store_->compact();
+    LOG(LogLevel::DEBUG, LogComponent::STATE_PRUNE,
+        "Expired " << expired << " cold IP states, reclaimed " << reclaimed
+                   << " bytes of spill file.");
+    if (ips_demoted > 0 && metrics_exporter_)
+      metrics_exporter_->increment_counter("ad_analysis_state_spills_total",
+                                           {{"reason", "idle"}},
+                                           static_cast<double>(ips_demoted));
+  }
 
-  size_t paths_before = path_activity_trackers.size();
-  for (auto it = path_activity_trackers.begin();
-       it != path_activity_trackers.end();) {
-    if ((current_timestamp_ms - it->second.last_seen_timestamp_ms) > ttl_ms)
-      it = path_activity_trackers.erase(it);
-    else
-      ++it;
+  if (owns_path_stats_) {
+    size_t paths_pruned =
+        path_stats_->prune_idle(current_timestamp_ms, ttl_ms);
+    LOG(LogLevel::DEBUG, LogComponent::STATE_PRUNE,
+        "Pruned " << paths_pruned << " Path states.");
   }
-  LOG(LogLevel::DEBUG, LogComponent::STATE_PRUNE,
-      "Pruned " << (paths_before - path_activity_trackers.size())
-                << " Path states.");
 
   if (app_config.tier1.session_tracking_enabled) {
     size_t sessions_before = session_trackers.size();
@@ -753,30 +1136,84 @@ void AnalysisEngine::run_pruning(uint64_t current_timestamp_ms) {
     if (session_ttl_ms > 0)
       for (auto it = session_trackers.begin(); it != session_trackers.end();) {
         if ((current_timestamp_ms - it->second.last_seen_timestamp_ms) >
-            session_ttl_ms)
+            session_ttl_ms) {
+          if (track_dirty_)
+            dirty_sessions_.insert(it->first);
           it = session_trackers.erase(it);
-        else
+        } else {
           ++it;
+        }
       }
     LOG(LogLevel::DEBUG, LogComponent::STATE_PRUNE,
         "Pruned " << (sessions_before - session_trackers.size())
                   << " Session states.");
   }
 
+  if (subnet_rollup_) {
+    size_t subnets_pruned = subnet_rollup_->prune(current_timestamp_ms);
+    LOG(LogLevel::DEBUG, LogComponent::STATE_PRUNE,
+        "Pruned " << subnets_pruned << " idle subnet rollups.");
+  }
+
+  refresh_state_memory_estimate();
   LOG(LogLevel::INFO, LogComponent::STATE_PRUNE, "State pruning completed.");
 }
 
+void AnalysisEngine::refresh_state_memory_estimate() {
+  size_t state_bytes = 0;
+  for (const auto &[ip, state] : ip_activity_trackers)
+    state_bytes += state.calculate_memory_footprint();
+  // Path stats are shared across workers and not spillable, so they are not
+  // part of this engine's footprint
+  for (const auto &[key, state] : session_trackers)
+    state_bytes += state.calculate_memory_footprint();
+  if (cold_ip_store_)
+    state_bytes += cold_ip_store_->index_memory_bytes();
+  state_memory_estimate_.store(state_bytes, std::memory_order_relaxed);
+}
+
 void AnalysisEngine::reset_in_memory_state() {
   ip_activity_trackers.clear();
-  path_activity_trackers.clear();
+  lazy_ips_.reset();
+  if (cold_ip_store_)
+    cold_ip_store_->clear();
+  if (owns_path_stats_)
+    path_stats_->clear();
+  traffic_sketches_->clear();
   session_trackers.clear();
   max_timestamp_seen_ = 0;
+  track_dirty_ = false;
+  dirty_ips_.clear();
+  dirty_sessions_.clear();
   LOG(LogLevel::WARN, LogComponent::STATE_PERSIST,
       "AnalysisEngine: In-memory state has been reset.");
 }
 
 void AnalysisEngine::reconfigure(const Config::AppConfig &new_config) {
+  const bool window_changed = new_config.tier1.sliding_window_duration_seconds !=
+                              app_config.tier1.sliding_window_duration_seconds;
+  const size_t old_ua_cache_size = app_config.tier1.ua_verdict_cache_size;
   app_config = new_config;
+  ua_markers_ = build_ua_markers(app_config.tier1);
+  ua_verdict_seed_ = ua_verdict_seed(app_config.tier1);
+  if (owns_request_classifier_)
+    request_classifier_ =
+        std::make_shared<const analysis::RequestClassifier>(app_config.tier1);
+  if (app_config.tier1.ua_verdict_cache_size != old_ua_cache_size)
+    ua_verdicts_ = make_ua_verdict_cache(app_config.tier1);
+
+  if (!app_config.tier1.subnet_rollup_enabled) {
+    subnet_rollup_.reset();
+  } else if (!subnet_rollup_) {
+    subnet_rollup_ = std::make_shared<analysis::SubnetRollup>(
+        app_config.tier1.sliding_window_duration_seconds * 1000);
+  } else if (window_changed) {
+    subnet_rollup_->reconfigure(
+        app_config.tier1.sliding_window_duration_seconds * 1000);
+  }
+  if (window_changed)
+    traffic_sketches_->reconfigure(
+        app_config.tier1.sliding_window_duration_seconds * 1000);
 
   uint64_t window_duration_ms =
       app_config.tier1.sliding_window_duration_seconds * 1000;
@@ -800,12 +1237,44 @@ namespace {
 std::shared_ptr<analysis::PrometheusAnomalyDetector> tier4_detector;
 }
 
+void AnalysisEngine::set_path_stats(
+    std::shared_ptr<analysis::SharedPathStats> stats) {
+  path_stats_ = std::move(stats);
+  owns_path_stats_ = false;
+}
+
+void AnalysisEngine::set_request_classifier(
+    std::shared_ptr<const analysis::RequestClassifier> classifier) {
+  request_classifier_ = std::move(classifier);
+  owns_request_classifier_ = false;
+}
+
+void AnalysisEngine::set_ua_verdict_cache(
+    std::shared_ptr<analysis::UaVerdictCache> cache) {
+  ua_verdicts_ = std::move(cache);
+}
+
+void AnalysisEngine::set_traffic_sketches(
+    std::shared_ptr<analysis::TrafficSketchSet> sketches, size_t shard) {
+  traffic_sketches_ = std::move(sketches);
+  traffic_sketch_shard_ = shard;
+}
+
+void AnalysisEngine::set_subnet_rollup(
+    std::shared_ptr<analysis::SubnetRollup> rollup) {
+  subnet_rollup_ = std::move(rollup);
+}
+
 void AnalysisEngine::set_tier4_anomaly_detector(
     std::shared_ptr<analysis::PrometheusAnomalyDetector> detector) {
   tier4_detector = std::move(detector);
 }
 
 AnalyzedEvent AnalysisEngine::process_and_analyze(const LogEntry &raw_log) {
+  return process_and_analyze(LogEntry(raw_log));
+}
+
+AnalyzedEvent AnalysisEngine::process_and_analyze(LogEntry &&log_entry) {
   static Histogram *processing_timer =
       MetricsManager::instance().register_histogram(
           "ad_analysis_engine_process_duration_seconds",
@@ -821,6 +1290,10 @@ AnalyzedEvent AnalysisEngine::process_and_analyze(const LogEntry &raw_log) {
   std::map<std::string, std::string> component_labels;
   component_labels["component"] = "analysis_engine";
 
+  // The event owns the log from here on; everything below reads it in place
+  AnalyzedEvent event(std::move(log_entry));
+  const LogEntry &raw_log = event.raw_log;
+
   LOG(LogLevel::TRACE, LogComponent::ANALYSIS_LIFECYCLE,
       "Entering process_and_analyze for IP: " << raw_log.ip_address << " Path: "
                                               << raw_log.request_path);
@@ -856,8 +1329,6 @@ AnalyzedEvent AnalysisEngine::process_and_analyze(const LogEntry &raw_log) {
                 "Latency of advanced User-Agent analysis.")
           : nullptr;
 
-  AnalyzedEvent event(raw_log);
-
   if (!raw_log.parsed_timestamp_ms) {
     LOG(LogLevel::WARN, LogComponent::ANALYSIS_LIFECYCLE,
         "Skipping analysis for log line " << raw_log.original_line_number
@@ -870,9 +1341,15 @@ AnalyzedEvent AnalysisEngine::process_and_analyze(const LogEntry &raw_log) {
     max_timestamp_seen_ = current_event_ts;
   }
 
+  // Pressure callbacks only flag the request; spill here, between events,
+  // so no state reference is held while entries leave the hot map
+  if (pending_spill_level_.load(std::memory_order_relaxed) != 0)
+    apply_pending_cold_spill();
+  if (lazy_ips_)
+    adopt_warmed_ip_states();
+
   // --- Instrument State Lookup ---
   PerIpState *current_ip_state_ptr;
-  PerPathState *current_path_state_ptr;
 
   {
     std::optional<ScopedTimer> t =
@@ -880,12 +1357,9 @@ AnalyzedEvent AnalysisEngine::process_and_analyze(const LogEntry &raw_log) {
                            : std::nullopt;
     current_ip_state_ptr = &get_or_create_ip_state(
         std::string(raw_log.ip_address), current_event_ts);
-    current_path_state_ptr =
-        &get_or_create_path_state(raw_log.request_path, current_event_ts);
   }
 
   PerIpState &current_ip_state = *current_ip_state_ptr;
-  PerPathState &current_path_state = *current_path_state_ptr;
 
   // --- "New Seen" Tracking Logic ---
   if (current_ip_state.ip_first_seen_timestamp_ms == 0) {
@@ -925,10 +1399,12 @@ AnalyzedEvent AnalysisEngine::process_and_analyze(const LogEntry &raw_log) {
       current_ip_state.request_timestamps_window.get_event_count();
 
   // Update IP's failed login window if applicable
+  bool is_failed_login = false;
   if (raw_log.http_status_code) {
     int status = *raw_log.http_status_code;
     const auto &codes = app_config.tier1.failed_login_status_codes;
     if (std::find(codes.begin(), codes.end(), status) != codes.end()) {
+      is_failed_login = true;
       LOG(LogLevel::TRACE, LogComponent::ANALYSIS_WINDOW,
           "Detected failed login status "
               << status << ". Updating failed_login_timestamps_window for IP: "
@@ -943,8 +1419,17 @@ AnalyzedEvent AnalysisEngine::process_and_analyze(const LogEntry &raw_log) {
   event.current_ip_failed_login_count_in_window =
       current_ip_state.failed_login_timestamps_window.get_event_count();
 
+  // Subnet rollups are bucketed counters shared by all workers, so a /24 is
+  // seen as a whole even though its IPs hash to different shards
+  if (subnet_rollup_) {
+    auto rollup = subnet_rollup_->record(raw_log.ip_address, current_event_ts,
+                                         is_failed_login);
+    event.subnet_narrow_activity = rollup.narrow;
+    event.subnet_wide_activity = rollup.wide;
+  }
+
   // HTML/Asset request tracking
-  RequestType type = get_request_type(raw_log.request_path, app_config.tier1);
+  RequestType type = request_classifier_->classify(raw_log.request_path);
   if (type == RequestType::HTML) {
     LOG(LogLevel::TRACE, LogComponent::ANALYSIS_WINDOW,
         "Request identified as HTML. Updating html_request_timestamps.");
@@ -998,6 +1483,8 @@ AnalyzedEvent AnalysisEngine::process_and_analyze(const LogEntry &raw_log) {
 
       // Update the session state with the current event's data
       PerSessionState &session = it->second;
+      if (track_dirty_)
+        dirty_sessions_.insert(it->first);
       session.last_seen_timestamp_ms = current_event_ts;
       session.request_count++;
       LOG(LogLevel::TRACE, LogComponent::ANALYSIS_SESSION,
@@ -1013,6 +1500,7 @@ AnalyzedEvent AnalysisEngine::process_and_analyze(const LogEntry &raw_log) {
 
       session.http_method_counts[std::string(raw_log.request_method)]++;
       session.request_timestamps_window.add_event(current_event_ts, 1);
+      session.request_timestamps_window.prune_old_events(current_event_ts);
 
       if (raw_log.request_time_s)
         session.request_time_tracker.update(*raw_log.request_time_s);
@@ -1030,8 +1518,8 @@ AnalyzedEvent AnalysisEngine::process_and_analyze(const LogEntry &raw_log) {
           session.failed_login_attempts++;
       }
 
-      // Populate AnalyzedEvent
-      event.raw_session_state = it->second;
+      // Populate AnalyzedEvent with a handle, not a copy, of the session
+      event.raw_session_state = &it->second;
       event.derived_session_features =
           SessionFeatureExtractor::extract(it->second);
     }
@@ -1043,11 +1531,6 @@ AnalyzedEvent AnalysisEngine::process_and_analyze(const LogEntry &raw_log) {
         "Updating request_time_tracker for IP "
             << raw_log.ip_address << " with value " << *raw_log.request_time_s);
     current_ip_state.request_time_tracker.update(*raw_log.request_time_s);
-    LOG(LogLevel::TRACE, LogComponent::ANALYSIS_STATS,
-        "Updating request_time_tracker for Path " << raw_log.request_path
-                                                  << " with value "
-                                                  << *raw_log.request_time_s);
-    current_path_state.request_time_tracker.update(*raw_log.request_time_s);
   }
 
   if (raw_log.bytes_sent) {
@@ -1056,11 +1539,6 @@ AnalyzedEvent AnalysisEngine::process_and_analyze(const LogEntry &raw_log) {
             << raw_log.ip_address << " with value " << *raw_log.bytes_sent);
     current_ip_state.bytes_sent_tracker.update(
         static_cast<double>(*raw_log.bytes_sent));
-    LOG(LogLevel::TRACE, LogComponent::ANALYSIS_STATS,
-        "Updating bytes_sent_tracker for Path "
-            << raw_log.request_path << " with value " << *raw_log.bytes_sent);
-    current_path_state.bytes_sent_tracker.update(
-        static_cast<double>(*raw_log.bytes_sent));
   }
 
   bool is_error =
@@ -1070,14 +1548,20 @@ AnalyzedEvent AnalysisEngine::process_and_analyze(const LogEntry &raw_log) {
       "Updating error_rate_tracker for IP "
           << raw_log.ip_address << " with value " << (is_error ? 1.0 : 0.0));
   current_ip_state.error_rate_tracker.update(is_error ? 1.0 : 0.0);
+
+  // Path trackers are global; work on the copy returned by the shared store
   LOG(LogLevel::TRACE, LogComponent::ANALYSIS_STATS,
-      "Updating error_rate_tracker for Path "
-          << raw_log.request_path << " with value " << (is_error ? 1.0 : 0.0));
-  current_path_state.error_rate_tracker.update(is_error ? 1.0 : 0.0);
-  LOG(LogLevel::TRACE, LogComponent::ANALYSIS_STATS,
-      "Updating request_volume_tracker for Path " << raw_log.request_path
-                                                  << " with value 1.0");
-  current_path_state.request_volume_tracker.update(1.0);
+      "Updating shared path trackers for Path " << raw_log.request_path);
+  analysis::SharedPathStats::Sample path_sample;
+  path_sample.request_time_s = raw_log.request_time_s;
+  if (raw_log.bytes_sent)
+    path_sample.bytes_sent = static_cast<double>(*raw_log.bytes_sent);
+  path_sample.is_error = is_error;
+  const PerPathState current_path_state = path_stats_->record(
+      raw_log.request_path, current_event_ts, path_sample);
+
+  traffic_sketches_->record(traffic_sketch_shard_, raw_log.ip_address,
+                            raw_log.request_path, current_event_ts, is_error);
 
   double current_requests_in_gen_window = static_cast<double>(
       current_ip_state.request_timestamps_window.get_event_count());
@@ -1272,9 +1756,10 @@ AnalyzedEvent AnalysisEngine::process_and_analyze(const LogEntry &raw_log) {
     std::optional<ScopedTimer> t =
         ua_analysis_timer ? std::optional<ScopedTimer>(*ua_analysis_timer)
                           : std::nullopt;
-    perform_advanced_ua_analysis(std::string(raw_log.user_agent),
-                                 app_config.tier1, current_ip_state, event,
-                                 current_event_ts, max_timestamp_seen_);
+    perform_advanced_ua_analysis(
+        raw_log.user_agent, app_config.tier1, ua_markers_, ua_verdicts_.get(),
+        ua_verdict_seed_, current_ip_state, event, current_event_ts,
+        max_timestamp_seen_);
   }
 
   // --- Tier 4: Prometheus anomaly detection ---
@@ -1340,123 +1825,481 @@ AnalyzedEvent AnalysisEngine::process_and_analyze(const LogEntry &raw_log) {
   return event;
 }
 
-void PerPathState::save(std::ofstream &out) const {
-  request_time_tracker.save(out);
-  bytes_sent_tracker.save(out);
-  error_rate_tracker.save(out);
-  request_volume_tracker.save(out);
-  out.write(reinterpret_cast<const char *>(&last_seen_timestamp_ms),
-            sizeof(last_seen_timestamp_ms));
+namespace {
+// Field tags of the persisted state records (see core::TaggedRecordWriter).
+// Append new tags; never renumber or reuse one.
+namespace ip_field {
+enum : uint32_t {
+  LAST_SEEN = 1,
+  FIRST_SEEN_AGE = 2,
+  STRINGS = 3,
+  REQUEST_WINDOW = 4,
+  FAILED_LOGIN_WINDOW = 5,
+  HTML_WINDOW = 6,
+  ASSET_WINDOW = 7,
+  UA_WINDOW = 8,
+  PATHS_SEEN = 9,
+  LAST_USER_AGENT = 10,
+  HISTORICAL_USER_AGENTS = 11,
+  REQUEST_TIME = 12,
+  BYTES_SENT = 13,
+  ERROR_RATE = 14,
+  REQUESTS_IN_WINDOW = 15,
+};
+} // namespace ip_field
+
+namespace path_field {
+enum : uint32_t {
+  LAST_SEEN = 1,
+  REQUEST_TIME = 2,
+  BYTES_SENT = 3,
+  ERROR_RATE = 4,
+  REQUEST_VOLUME = 5,
+};
+} // namespace path_field
+
+namespace session_field {
+enum : uint32_t {
+  START = 1,
+  LAST_SEEN_AGE = 2,
+  REQUEST_COUNT = 3,
+  STRINGS = 4,
+  REQUEST_HISTORY = 5,
+  UNIQUE_PATHS = 6,
+  UNIQUE_USER_AGENTS = 7,
+  HTTP_METHODS = 8,
+  FAILED_LOGINS = 9,
+  ERRORS_4XX = 10,
+  ERRORS_5XX = 11,
+  REQUEST_TIME = 12,
+  BYTES_SENT = 13,
+  REQUEST_WINDOW = 14,
+};
+} // namespace session_field
+
+using core::varint::zigzag_decode;
+using core::varint::zigzag_encode;
+using Bytes = std::pair<const uint8_t *, size_t>;
+
+// Window timestamps are stored as zigzag deltas from the previous one,
+// starting at the owner's last_seen, so most take one or two bytes. String
+// values go through the serializer's dictionary.
+template <typename ValueType>
+void encode_window(core::BinarySerializer &out,
+                   const SlidingWindow<ValueType> &window, uint64_t base) {
+  const auto &data = window.get_raw_window_data();
+  out.write_varint32(static_cast<uint32_t>(data.size()));
+  uint64_t prev = base;
+  for (const auto &[ts, value] : data) {
+    out.write_varint64(zigzag_encode(static_cast<int64_t>(ts - prev)));
+    prev = ts;
+    if constexpr (std::is_same_v<ValueType, std::string>)
+      out.write_string(value);
+    else // 0 marks "value is the timestamp itself", the common case
+      out.write_varint64(value == ts ? 0 : value + 1);
+  }
 }
 
-void PerPathState::load(std::ifstream &in) {
-  request_time_tracker.load(in);
-  bytes_sent_tracker.load(in);
-  error_rate_tracker.load(in);
-  request_volume_tracker.load(in);
-  in.read(reinterpret_cast<char *>(&last_seen_timestamp_ms),
-          sizeof(last_seen_timestamp_ms));
+template <typename ValueType>
+void decode_window(core::BinaryDeserializer &in,
+                   SlidingWindow<ValueType> &window, uint64_t base) {
+  uint32_t size = in.read_varint32();
+  uint64_t prev = base;
+  for (uint32_t i = 0; i < size; ++i) {
+    prev += static_cast<uint64_t>(zigzag_decode(in.read_varint64()));
+    if constexpr (std::is_same_v<ValueType, std::string>) {
+      window.add_event(prev, in.read_string());
+    } else {
+      uint64_t encoded = in.read_varint64();
+      window.add_event(prev, encoded == 0 ? prev : encoded - 1);
+    }
+  }
 }
 
-void PerIpState::save(std::ofstream &out) const {
-  // Tier 1 Windows
-  request_timestamps_window.save(out);
-  failed_login_timestamps_window.save(out);
-  html_request_timestamps.save(out);
-  asset_request_timestamps.save(out);
-  recent_unique_ua_window.save(out);
+template <typename ValueType>
+void write_window(core::TaggedRecordWriter &record, uint32_t tag,
+                  const SlidingWindow<ValueType> &window, uint64_t base,
+                  core::StringDictionary *dict = nullptr) {
+  if (window.get_raw_window_data().empty())
+    return;
+  core::BinarySerializer out(dict);
+  encode_window(out, window, base);
+  record.write_bytes(tag, out);
+}
 
-  // Timestamps and simple members
-  out.write(reinterpret_cast<const char *>(&last_seen_timestamp_ms),
-            sizeof(last_seen_timestamp_ms));
-  out.write(reinterpret_cast<const char *>(&ip_first_seen_timestamp_ms),
-            sizeof(ip_first_seen_timestamp_ms));
+template <typename ValueType>
+void read_window(Bytes bytes, SlidingWindow<ValueType> &window, uint64_t base,
+                 core::StringDictionary *dict = nullptr) {
+  core::BinaryDeserializer in(bytes.first, bytes.second, dict);
+  decode_window(in, window, base);
+}
 
-  // Unordered sets need special handling
-  size_t paths_seen_size = paths_seen_by_ip.size();
-  out.write(reinterpret_cast<const char *>(&paths_seen_size),
-            sizeof(paths_seen_size));
-  for (const auto &path : paths_seen_by_ip) {
-    Utils::save_string(out, path);
-  }
+// Empty trackers are left out and come back as default-constructed
+void write_tracker(core::TaggedRecordWriter &record, uint32_t tag,
+                   const StatsTracker &tracker) {
+  if (tracker.get_count() == 0)
+    return;
+  core::BinarySerializer out;
+  out.write_varint64(static_cast<uint64_t>(tracker.get_count()));
+  out.write_double(tracker.get_mean());
+  out.write_double(tracker.get_m2());
+  record.write_bytes(tag, out);
+}
 
-  Utils::save_string(out, last_known_user_agent);
+void read_tracker(Bytes bytes, StatsTracker &tracker) {
+  core::BinaryDeserializer in(bytes.first, bytes.second);
+  int64_t count = static_cast<int64_t>(in.read_varint64());
+  double mean = in.read_double();
+  double m2 = in.read_double();
+  tracker.restore(count, mean, m2);
+}
+
+template <typename Set>
+void write_string_set(core::TaggedRecordWriter &record, uint32_t tag,
+                      const Set &set, core::StringDictionary *dict = nullptr) {
+  if (set.empty())
+    return;
+  core::BinarySerializer out(dict);
+  out.write_varint32(static_cast<uint32_t>(set.size()));
+  for (const auto &value : set)
+    out.write_string(value);
+  record.write_bytes(tag, out);
+}
 
-  // Tier 2 Historical Trackers
-  request_time_tracker.save(out);
-  bytes_sent_tracker.save(out);
-  error_rate_tracker.save(out);
-  requests_in_window_count_tracker.save(out);
+template <typename Set>
+void read_string_set(Bytes bytes, Set &set,
+                     core::StringDictionary *dict = nullptr) {
+  core::BinaryDeserializer in(bytes.first, bytes.second, dict);
+  set.clear();
+  uint32_t size = in.read_varint32();
+  set.reserve(size);
+  for (uint32_t i = 0; i < size; ++i)
+    set.insert(in.read_string());
 }
 
-void PerIpState::load(std::ifstream &in) {
-  // Tier 1 Windows
-  request_timestamps_window.load(in);
-  failed_login_timestamps_window.load(in);
-  html_request_timestamps.load(in);
-  asset_request_timestamps.load(in);
-  recent_unique_ua_window.load(in);
+// Strings repeated within one record (user agents, session paths) are
+// written once to a record-local dictionary and referenced by id
+void write_dictionary(core::TaggedRecordWriter &record, uint32_t tag,
+                      const core::StringDictionary &dict) {
+  if (dict.size() == 0)
+    return;
+  std::vector<uint8_t> buffer(dict.serialized_size());
+  dict.serialize(buffer.data(), buffer.size());
+  record.write_bytes(tag, buffer.data(), buffer.size());
+}
 
-  // Timestamps and simple members
-  in.read(reinterpret_cast<char *>(&last_seen_timestamp_ms),
-          sizeof(last_seen_timestamp_ms));
-  in.read(reinterpret_cast<char *>(&ip_first_seen_timestamp_ms),
-          sizeof(ip_first_seen_timestamp_ms));
+void read_dictionary(Bytes bytes, core::StringDictionary &dict) {
+  dict.deserialize(bytes.first, bytes.second);
+}
+} // namespace
+
+void PerIpState::serialize(core::BinarySerializer &out) const {
+  using namespace ip_field;
+  core::StringDictionary dict;
+  core::TaggedRecordWriter record;
+  const uint64_t base = last_seen_timestamp_ms;
+  record.write_varint(LAST_SEEN, last_seen_timestamp_ms);
+  record.write_signed(FIRST_SEEN_AGE, static_cast<int64_t>(
+                                          base - ip_first_seen_timestamp_ms));
+
+  write_window(record, REQUEST_WINDOW, request_timestamps_window, base);
+  write_window(record, FAILED_LOGIN_WINDOW, failed_login_timestamps_window,
+               base);
+  write_window(record, HTML_WINDOW, html_request_timestamps, base);
+  write_window(record, ASSET_WINDOW, asset_request_timestamps, base);
+  write_window(record, UA_WINDOW, recent_unique_ua_window, base, &dict);
+
+  write_string_set(record, PATHS_SEEN, paths_seen_by_ip);
+  if (!last_known_user_agent.empty())
+    record.write_varint(LAST_USER_AGENT, dict.add_string(last_known_user_agent));
+  write_string_set(record, HISTORICAL_USER_AGENTS, historical_user_agents,
+                   &dict);
+
+  write_tracker(record, REQUEST_TIME, request_time_tracker);
+  write_tracker(record, BYTES_SENT, bytes_sent_tracker);
+  write_tracker(record, ERROR_RATE, error_rate_tracker);
+  write_tracker(record, REQUESTS_IN_WINDOW, requests_in_window_count_tracker);
+
+  write_dictionary(record, STRINGS, dict);
+  record.finish(out);
+}
 
-  // Unordered sets
-  size_t paths_seen_size = 0;
-  in.read(reinterpret_cast<char *>(&paths_seen_size), sizeof(paths_seen_size));
-  paths_seen_by_ip.clear();
-  for (size_t i = 0; i < paths_seen_size; ++i) {
-    paths_seen_by_ip.insert(Utils::load_string(in));
+void PerIpState::deserialize(core::BinaryDeserializer &in) {
+  using namespace ip_field;
+  core::TaggedRecordReader record(in);
+  // Windows are relative to last_seen and strings to the dictionary, so
+  // those fields are decoded once the whole record has been read
+  core::StringDictionary dict;
+  int64_t first_seen_age = 0;
+  std::optional<uint64_t> last_user_agent;
+  std::vector<std::pair<uint32_t, Bytes>> deferred;
+
+  while (record.next()) {
+    switch (record.tag()) {
+    case LAST_SEEN:
+      last_seen_timestamp_ms = record.read_varint();
+      break;
+    case FIRST_SEEN_AGE:
+      first_seen_age = record.read_signed();
+      break;
+    case STRINGS:
+      read_dictionary(record.read_bytes(), dict);
+      break;
+    case LAST_USER_AGENT:
+      last_user_agent = record.read_varint();
+      break;
+    case REQUEST_WINDOW:
+    case FAILED_LOGIN_WINDOW:
+    case HTML_WINDOW:
+    case ASSET_WINDOW:
+    case UA_WINDOW:
+    case PATHS_SEEN:
+    case HISTORICAL_USER_AGENTS:
+    case REQUEST_TIME:
+    case BYTES_SENT:
+    case ERROR_RATE:
+    case REQUESTS_IN_WINDOW:
+      deferred.emplace_back(record.tag(), record.read_bytes());
+      break;
+    default:
+      break; // written by a newer version
+    }
   }
 
-  last_known_user_agent = Utils::load_string(in);
+  const uint64_t base = last_seen_timestamp_ms;
+  ip_first_seen_timestamp_ms = base - static_cast<uint64_t>(first_seen_age);
+  if (last_user_agent)
+    last_known_user_agent =
+        dict.get_string(static_cast<uint32_t>(*last_user_agent));
+  for (const auto &[tag, bytes] : deferred) {
+    switch (tag) {
+    case REQUEST_WINDOW:
+      read_window(bytes, request_timestamps_window, base);
+      break;
+    case FAILED_LOGIN_WINDOW:
+      read_window(bytes, failed_login_timestamps_window, base);
+      break;
+    case HTML_WINDOW:
+      read_window(bytes, html_request_timestamps, base);
+      break;
+    case ASSET_WINDOW:
+      read_window(bytes, asset_request_timestamps, base);
+      break;
+    case UA_WINDOW:
+      read_window(bytes, recent_unique_ua_window, base, &dict);
+      break;
+    case PATHS_SEEN:
+      read_string_set(bytes, paths_seen_by_ip);
+      break;
+    case HISTORICAL_USER_AGENTS:
+      read_string_set(bytes, historical_user_agents, &dict);
+      break;
+    case REQUEST_TIME:
+      read_tracker(bytes, request_time_tracker);
+      break;
+    case BYTES_SENT:
+      read_tracker(bytes, bytes_sent_tracker);
+      break;
+    case ERROR_RATE:
+      read_tracker(bytes, error_rate_tracker);
+      break;
+    case REQUESTS_IN_WINDOW:
+      read_tracker(bytes, requests_in_window_count_tracker);
+      break;
+    }
+  }
+}
 
-  // Tier 2 Historical Trackers
-  request_time_tracker.load(in);
-  bytes_sent_tracker.load(in);
-  error_rate_tracker.load(in);
-  requests_in_window_count_tracker.load(in);
+void PerPathState::serialize(core::BinarySerializer &out) const {
+  using namespace path_field;
+  core::TaggedRecordWriter record;
+  record.write_varint(LAST_SEEN, last_seen_timestamp_ms);
+  write_tracker(record, REQUEST_TIME, request_time_tracker);
+  write_tracker(record, BYTES_SENT, bytes_sent_tracker);
+  write_tracker(record, ERROR_RATE, error_rate_tracker);
+  write_tracker(record, REQUEST_VOLUME, request_volume_tracker);
+  record.finish(out);
 }
 
-std::vector<TopIpInfo>
-AnalysisEngine::get_top_n_by_metric(size_t n, const std::string &metric_name) {
-  std::vector<TopIpInfo> all_ips;
-  {
-    // Must lock to safely read from the map
-    // This is a simplified example. In a real high-throughput system,
-    // you might copy the data or use more advanced concurrent structures.
-    // For now, a lock is sufficient and safe.
-    // NOTE: This lock can introduce latency on the main processing thread if
-    // held for long.
-    all_ips.reserve(ip_activity_trackers.size());
-    for (const auto &[ip, state] : ip_activity_trackers) {
-      double value = 0.0;
-      if (metric_name == "request_rate") {
-        value = state.request_timestamps_window.get_event_count();
-      } else if (metric_name == "error_rate") {
-        value = state.error_rate_tracker.get_mean();
-      }
-      // More metrics can be added here
+void PerPathState::deserialize(core::BinaryDeserializer &in) {
+  using namespace path_field;
+  core::TaggedRecordReader record(in);
+  while (record.next()) {
+    switch (record.tag()) {
+    case LAST_SEEN:
+      last_seen_timestamp_ms = record.read_varint();
+      break;
+    case REQUEST_TIME:
+      read_tracker(record.read_bytes(), request_time_tracker);
+      break;
+    case BYTES_SENT:
+      read_tracker(record.read_bytes(), bytes_sent_tracker);
+      break;
+    case ERROR_RATE:
+      read_tracker(record.read_bytes(), error_rate_tracker);
+      break;
+    case REQUEST_VOLUME:
+      read_tracker(record.read_bytes(), request_volume_tracker);
+      break;
+    default:
+      break;
+    }
+  }
+}
 
-      all_ips.push_back({ip, value, metric_name});
+void PerSessionState::serialize(core::BinarySerializer &out) const {
+  using namespace session_field;
+  core::StringDictionary dict;
+  core::TaggedRecordWriter record;
+  const uint64_t start = session_start_timestamp_ms;
+  record.write_varint(START, start);
+  record.write_signed(LAST_SEEN_AGE,
+                      static_cast<int64_t>(last_seen_timestamp_ms - start));
+  record.write_varint(REQUEST_COUNT, request_count);
+
+  if (!request_history.empty()) {
+    core::BinarySerializer history(&dict);
+    history.write_varint32(static_cast<uint32_t>(request_history.size()));
+    uint64_t prev = start;
+    for (const auto &[ts, path] : request_history) {
+      history.write_varint64(zigzag_encode(static_cast<int64_t>(ts - prev)));
+      prev = ts;
+      history.write_string(path);
     }
+    record.write_bytes(REQUEST_HISTORY, history);
   }
+  write_string_set(record, UNIQUE_PATHS, unique_paths_visited, &dict);
+  write_string_set(record, UNIQUE_USER_AGENTS, unique_user_agents);
 
-  std::vector<TopIpInfo> top_n;
-  top_n.reserve(n);
+  if (!http_method_counts.empty()) {
+    core::BinarySerializer methods;
+    methods.write_varint32(static_cast<uint32_t>(http_method_counts.size()));
+    for (const auto &[method, count] : http_method_counts) {
+      methods.write_string_raw(method);
+      methods.write_varint32(static_cast<uint32_t>(count));
+    }
+    record.write_bytes(HTTP_METHODS, methods);
+  }
+
+  if (failed_login_attempts)
+    record.write_varint(FAILED_LOGINS, failed_login_attempts);
+  if (error_4xx_count)
+    record.write_varint(ERRORS_4XX, error_4xx_count);
+  if (error_5xx_count)
+    record.write_varint(ERRORS_5XX, error_5xx_count);
+  write_tracker(record, REQUEST_TIME, request_time_tracker);
+  write_tracker(record, BYTES_SENT, bytes_sent_tracker);
+  write_window(record, REQUEST_WINDOW, request_timestamps_window,
+               last_seen_timestamp_ms);
+
+  write_dictionary(record, STRINGS, dict);
+  record.finish(out);
+}
 
-  // Sort all IPs and take the top n
-  std::sort(all_ips.begin(), all_ips.end(),
-            [](const TopIpInfo &a, const TopIpInfo &b) {
-              return a.value > b.value; // Sort descending
-            });
+void PerSessionState::deserialize(core::BinaryDeserializer &in) {
+  using namespace session_field;
+  core::TaggedRecordReader record(in);
+  core::StringDictionary dict;
+  int64_t last_seen_age = 0;
+  std::vector<std::pair<uint32_t, Bytes>> deferred;
+
+  while (record.next()) {
+    switch (record.tag()) {
+    case START:
+      session_start_timestamp_ms = record.read_varint();
+      break;
+    case LAST_SEEN_AGE:
+      last_seen_age = record.read_signed();
+      break;
+    case REQUEST_COUNT:
+      request_count = record.read_varint();
+      break;
+    case STRINGS:
+      read_dictionary(record.read_bytes(), dict);
+      break;
+    case FAILED_LOGINS:
+      failed_login_attempts = static_cast<uint32_t>(record.read_varint());
+      break;
+    case ERRORS_4XX:
+      error_4xx_count = static_cast<uint32_t>(record.read_varint());
+      break;
+    case ERRORS_5XX:
+      error_5xx_count = static_cast<uint32_t>(record.read_varint());
+      break;
+    case REQUEST_HISTORY:
+    case UNIQUE_PATHS:
+    case UNIQUE_USER_AGENTS:
+    case HTTP_METHODS:
+    case REQUEST_TIME:
+    case BYTES_SENT:
+    case REQUEST_WINDOW:
+      deferred.emplace_back(record.tag(), record.read_bytes());
+      break;
+    default:
+      break;
+    }
+  }
 
-  // Take only the top n elements
-  size_t limit = std::min(n, all_ips.size());
-  top_n.assign(all_ips.begin(), all_ips.begin() + limit);
+  const uint64_t start = session_start_timestamp_ms;
+  last_seen_timestamp_ms = start + static_cast<uint64_t>(last_seen_age);
+  for (const auto &[tag, bytes] : deferred) {
+    switch (tag) {
+    case REQUEST_HISTORY: {
+      core::BinaryDeserializer history(bytes.first, bytes.second, &dict);
+      request_history.clear();
+      uint32_t size = history.read_varint32();
+      uint64_t prev = start;
+      for (uint32_t i = 0; i < size; ++i) {
+        prev += static_cast<uint64_t>(zigzag_decode(history.read_varint64()));
+        request_history.emplace_back(prev, history.read_string());
+      }
+      break;
+    }
+    case UNIQUE_PATHS:
+      read_string_set(bytes, unique_paths_visited, &dict);
+      break;
+    case UNIQUE_USER_AGENTS:
+      read_string_set(bytes, unique_user_agents);
+      break;
+    case HTTP_METHODS: {
+      core::BinaryDeserializer methods(bytes.first, bytes.second);
+      http_method_counts.clear();
+      uint32_t size = methods.read_varint32();
+      for (uint32_t i = 0; i < size; ++i) {
+        std::string method = methods.read_string_raw();
+        http_method_counts[method] = static_cast<int>(methods.read_varint32());
+      }
+      break;
+    }
+    case REQUEST_TIME:
+      read_tracker(bytes, request_time_tracker);
+      break;
+    case BYTES_SENT:
+      read_tracker(bytes, bytes_sent_tracker);
+      break;
+    case REQUEST_WINDOW:
+      read_window(bytes, request_timestamps_window, last_seen_timestamp_ms);
+      break;
+    }
+  }
+}
 
+std::vector<TopIpInfo>
+AnalysisEngine::get_top_n_by_metric(size_t n, const std::string &metric_name) {
+  // Served from the per-worker sketches rather than by scanning this
+  // engine's IP map, which only ever held one worker's share of the traffic
+  auto metric = metric_name == "error_count"
+                    ? analysis::TrafficSketchSet::IpMetric::ERRORS
+                    : analysis::TrafficSketchSet::IpMetric::REQUESTS;
+  std::vector<TopIpInfo> top_n;
+  if (metric_name != "request_rate" && metric_name != "error_count")
+    return top_n;
+
+  auto talkers = traffic_sketches_->top_ips(metric, n);
+  top_n.reserve(talkers.size());
+  for (auto &talker : talkers)
+    top_n.push_back({std::move(talker.key), static_cast<double>(talker.count),
+                     metric_name, talker.distinct});
   return top_n;
 }
 
@@ -1482,7 +2325,7 @@ EngineStateMetrics AnalysisEngine::get_internal_state_metrics() const {
         state.get_historical_user_agents_count();
   }
 
-  metrics.total_path_states = path_activity_trackers.size();
+  metrics.total_path_states = path_stats_->size();
 
   metrics.total_session_states = session_trackers.size();
   for (const auto &[key, state] : session_trackers) {
@@ -1609,6 +2452,33 @@ void AnalysisEngine::set_metrics_exporter(
     metrics_exporter_->register_gauge("ad_analysis_session_states_total",
                                       "Total number of session states");
 
+    metrics_exporter_->register_gauge(
+        "ad_analysis_distinct_ips_estimate",
+        "Estimated distinct client IPs in the current window, all workers");
+    metrics_exporter_->register_gauge(
+        "ad_analysis_distinct_paths_estimate",
+        "Estimated distinct request paths in the current window, all workers");
+
+    metrics_exporter_->register_gauge(
+        "ad_analysis_subnet_rollups_total",
+        "Number of subnets with live rollup counters", {"level"});
+
+    metrics_exporter_->register_gauge(
+        "ad_analysis_cold_ip_states_total",
+        "Number of IP states spilled to the cold tier");
+
+    metrics_exporter_->register_gauge(
+        "ad_analysis_cold_state_file_bytes",
+        "Bytes used in the cold tier spill file");
+
+    metrics_exporter_->register_counter(
+        "ad_analysis_state_spills_total",
+        "IP states moved from RAM to the cold tier", {"reason"});
+
+    metrics_exporter_->register_counter(
+        "ad_analysis_state_rehydrations_total",
+        "IP states reloaded from the cold tier on a new request");
+
     // Register memory metrics
     metrics_exporter_->register_gauge("ad_analysis_ip_state_memory_bytes",
                                       "Memory usage in bytes for an IP state",
@@ -1899,13 +2769,14 @@ void AnalysisEngine::evict_inactive_states(uint64_t current_timestamp_ms) {
 
   size_t ttl_ms = app_config.memory_management.state_object_ttl_seconds * 1000;
   size_t initial_ip_count = ip_activity_trackers.size();
-  size_t initial_path_count = path_activity_trackers.size();
   size_t initial_session_count = session_trackers.size();
 
   // Evict inactive IP states
   auto ip_it = ip_activity_trackers.begin();
   while (ip_it != ip_activity_trackers.end()) {
     if (current_timestamp_ms > ip_it->second.last_seen_timestamp_ms + ttl_ms) {
+      if (track_dirty_)
+        dirty_ips_.insert(ip_it->first);
       ip_it = ip_activity_trackers.erase(ip_it);
     } else {
       ++ip_it;
@@ -1913,21 +2784,17 @@ void AnalysisEngine::evict_inactive_states(uint64_t current_timestamp_ms) {
   }
 
   // Evict inactive path states
-  auto path_it = path_activity_trackers.begin();
-  while (path_it != path_activity_trackers.end()) {
-    if (current_timestamp_ms >
-        path_it->second.last_seen_timestamp_ms + ttl_ms) {
-      path_it = path_activity_trackers.erase(path_it);
-    } else {
-      ++path_it;
-    }
-  }
+  size_t evicted_path =
+      owns_path_stats_ ? path_stats_->prune_idle(current_timestamp_ms, ttl_ms)
+                       : 0;
 
   // Evict inactive session states
   auto session_it = session_trackers.begin();
   while (session_it != session_trackers.end()) {
     if (current_timestamp_ms >
         session_it->second.last_seen_timestamp_ms + ttl_ms) {
+      if (track_dirty_)
+        dirty_sessions_.insert(session_it->first);
       session_it = session_trackers.erase(session_it);
     } else {
       ++session_it;
@@ -1935,7 +2802,6 @@ void AnalysisEngine::evict_inactive_states(uint64_t current_timestamp_ms) {
   }
 
   size_t evicted_ip = initial_ip_count - ip_activity_trackers.size();
-  size_t evicted_path = initial_path_count - path_activity_trackers.size();
   size_t evicted_session = initial_session_count - session_trackers.size();
 
   if (evicted_ip > 0 || evicted_path > 0 || evicted_session > 0) {
@@ -1954,4 +2820,140 @@ void AnalysisEngine::evict_inactive_states(uint64_t current_timestamp_ms) {
     metrics_exporter_->set_gauge("ad_analysis_evicted_states_total",
                                  evicted_session, {{"type", "session"}});
   }
-}
\ No newline at end of file
+}
+
+// =============================================================================
+// Cold State Tier
+// =============================================================================
+
+bool AnalysisEngine::enable_cold_state_tier(
+    const std::string &spill_file_path) {
+  const size_t max_file_bytes =
+      app_config.memory_management.cold_state_max_file_mb * 1024 * 1024;
+  auto store =
+      std::make_unique<memory::ColdStateStore>(spill_file_path, max_file_bytes);
+  if (!store->is_open()) {
+    LOG(LogLevel::ERROR, LogComponent::ANALYSIS_LIFECYCLE,
+        "Cold state tier disabled: could not map " << spill_file_path);
+    return false;
+  }
+
+  cold_ip_store_ = std::move(store);
+  LOG(LogLevel::INFO, LogComponent::ANALYSIS_LIFECYCLE,
+      "Cold state tier enabled with spill file " << spill_file_path);
+  return true;
+}
+
+void AnalysisEngine::request_cold_spill(size_t pressure_level) {
+  pending_spill_level_.store(pressure_level, std::memory_order_relaxed);
+}
+
+size_t AnalysisEngine::get_memory_usage() const {
+  return state_memory_estimate_.load(std::memory_order_relaxed);
+}
+
+void AnalysisEngine::on_memory_pressure(size_t pressure_level) {
+  request_cold_spill(pressure_level);
+}
+
+size_t AnalysisEngine::get_cold_ip_state_count() const {
+  return cold_ip_store_ ? cold_ip_store_->entry_count() : 0;
+}
+
+void AnalysisEngine::apply_pending_cold_spill() {
+  // Share of the hot tier to spill, indexed by pressure level (1=low ..
+  // 4=critical)
+  static constexpr double kSpillFraction[] = {0.0, 0.1, 0.25, 0.5, 0.75};
+
+  size_t level = pending_spill_level_.exchange(0, std::memory_order_relaxed);
+  if (level == 0 || !cold_ip_store_)
+    return;
+
+  level = std::min<size_t>(level, 4);
+  size_t target = static_cast<size_t>(
+      static_cast<double>(ip_activity_trackers.size()) *
+      kSpillFraction[level]);
+  size_t spilled = spill_ip_states_to_cold(target);
+  LOG(LogLevel::INFO, LogComponent::STATE_PRUNE,
+      "Memory pressure level " << level << ": spilled " << spilled
+                               << " IP states to the cold tier ("
+                               << ip_activity_trackers.size()
+                               << " remain hot).");
+}
+
+size_t AnalysisEngine::spill_ip_states_to_cold(size_t count) {
+  if (!cold_ip_store_ || count == 0 || ip_activity_trackers.empty())
+    return 0;
+  count = std::min(count, ip_activity_trackers.size());
+
+  // last_seen is refreshed on every request, so the smallest values are the
+  // least recently used entries without keeping an LRU list on the hot path
+  using IpIterator = decltype(ip_activity_trackers)::iterator;
+  std::vector<std::pair<uint64_t, IpIterator>> candidates;
+  candidates.reserve(ip_activity_trackers.size());
+  for (auto it = ip_activity_trackers.begin(); it != ip_activity_trackers.end();
+       ++it)
+    candidates.emplace_back(it->second.last_seen_timestamp_ms, it);
+  std::nth_element(
+      candidates.begin(), candidates.begin() + (count - 1), candidates.end(),
+      [](const auto &a, const auto &b) { return a.first < b.first; });
+
+  size_t spilled = 0;
+  for (size_t i = 0; i < count; ++i) {
+    IpIterator it = candidates[i].second;
+    // Under pressure the entry leaves RAM either way; if the spill file is
+    // full it is dropped as before the cold tier existed
+    if (demote_ip_state(it->first, it->second))
+      ++spilled;
+    else if (track_dirty_)
+      dirty_ips_.insert(it->first);
+    ip_activity_trackers.erase(it);
+  }
+
+  if (metrics_exporter_ && spilled > 0)
+    metrics_exporter_->increment_counter("ad_analysis_state_spills_total",
+                                         {{"reason", "pressure"}},
+                                         static_cast<double>(spilled));
+  return spilled;
+}
+
+bool AnalysisEngine::demote_ip_state(const std::string &ip,
+                                     PerIpState &state) {
+  // Expired window entries would be discarded on rehydration anyway
+  state.request_timestamps_window.prune_old_events(max_timestamp_seen_);
+  state.failed_login_timestamps_window.prune_old_events(max_timestamp_seen_);
+  state.html_request_timestamps.prune_old_events(max_timestamp_seen_);
+  state.asset_request_timestamps.prune_old_events(max_timestamp_seen_);
+  state.recent_unique_ua_window.prune_old_events(max_timestamp_seen_);
+
+  core::BinarySerializer out;
+  state.serialize(out);
+  return cold_ip_store_->put(ip, out.data(), state.last_seen_timestamp_ms);
+}
+
+std::optional<PerIpState>
+AnalysisEngine::rehydrate_ip_state(const std::string &ip,
+                                   uint64_t current_timestamp_ms) {
+  auto blob = cold_ip_store_->take(ip);
+  if (!blob)
+    return std::nullopt;
+
+  const uint64_t window_duration_ms =
+      app_config.tier1.sliding_window_duration_seconds * 1000;
+  PerIpState state(current_timestamp_ms, window_duration_ms,
+                   window_duration_ms);
+  try {
+    core::BinaryDeserializer in(blob->data(), blob->size());
+    state.deserialize(in);
+  } catch (const std::exception &e) {
+    LOG(LogLevel::WARN, LogComponent::STATE_PRUNE,
+        "Discarding unreadable cold state for IP " << ip << ": " << e.what());
+    return std::nullopt;
+  }
+  state.last_seen_timestamp_ms = current_timestamp_ms;
+
+  if (metrics_exporter_)
+    metrics_exporter_->increment_counter(
+        "ad_analysis_state_rehydrations_total");
+  return state;
+}
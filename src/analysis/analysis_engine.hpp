@@ -3,21 +3,32 @@
 
 #include "analysis/per_session_state.hpp"
 #include "analyzed_event.hpp"
+#include "core/cold_state_store.hpp"
 #include "core/config.hpp"
 #include "core/log_entry.hpp"
 #include "core/memory_manager.hpp"
 #include "core/prometheus_metrics_exporter.hpp"
 #include "models/feature_manager.hpp"
 #include "models/model_data_collector.hpp"
+#include "lazy_ip_snapshot.hpp"
 #include "per_ip_state.hpp"
 #include "per_path_state.hpp"
+#include "shared_path_stats.hpp"
 #include "prometheus_anomaly_detector.hpp"
+#include "request_classifier.hpp"
+#include "subnet_rollup.hpp"
+#include "traffic_sketches.hpp"
+#include "ua_verdict_cache.hpp"
 #include "utils/advanced_threading.hpp" // Advanced threading optimizations
+#include "utils/aho_corasick.hpp"
 
+#include <atomic>
 #include <cstdint>
 #include <memory>
+#include <optional>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 
 // Forward declarations
 namespace memory {
@@ -28,6 +39,7 @@ struct TopIpInfo {
   std::string ip;
   double value;
   std::string metric;
+  double unique_paths = 0.0; // estimate
 };
 
 struct EngineStateMetrics {
@@ -50,16 +62,49 @@ struct EngineStateMetrics {
   size_t total_session_unique_user_agents = 0;
 };
 
-class AnalysisEngine {
+class AnalysisEngine : public memory::IMemoryManaged {
 public:
-  AnalysisEngine(const Config::AppConfig &cfg);
+  // Engines given a request classifier share it instead of building one
+  AnalysisEngine(const Config::AppConfig &cfg,
+                 std::shared_ptr<const analysis::RequestClassifier>
+                     request_classifier = nullptr);
   ~AnalysisEngine();
 
+  // The returned event borrows session state from this engine; see
+  // AnalyzedEvent::raw_session_state. The rvalue overload avoids copying the
+  // raw log line into the event.
   AnalyzedEvent process_and_analyze(const LogEntry &raw_log);
+  AnalyzedEvent process_and_analyze(LogEntry &&log_entry);
 
+  // Single-file form of capture_snapshot()/restore_snapshot_file(), written
+  // atomically through a temporary file
   bool save_state(const std::string &path) const;
   bool load_state(const std::string &path);
 
+  // Encodes this worker's IP (hot and cold) and session state into one
+  // buffer. Must run on the worker thread, between events; the file I/O is
+  // left to the caller so ingestion only pauses for the encode. Starts dirty
+  // tracking for the following capture_delta().
+  std::vector<uint8_t> capture_snapshot();
+  bool restore_snapshot(const uint8_t *data, size_t size);
+
+  // Maps a full snapshot file instead of decoding it: sessions are restored
+  // right away, each IP on first access, and a background thread warms the
+  // rest. Returns in time independent of the number of IPs.
+  bool restore_snapshot_file(const std::string &path);
+  size_t get_unloaded_ip_state_count() const {
+    return lazy_ips_ ? lazy_ips_->pending() : 0;
+  }
+
+  // Encodes only the IPs and sessions touched or removed since the previous
+  // capture. Applied in order on top of the matching full snapshot, the
+  // deltas reproduce the state at the last capture.
+  std::vector<uint8_t> capture_delta();
+  bool apply_delta(const uint8_t *data, size_t size);
+  size_t get_dirty_state_count() const {
+    return dirty_ips_.size() + dirty_sessions_.size();
+  }
+
   void run_pruning(uint64_t current_timestamp_ms);
   uint64_t get_max_timestamp_seen() const;
 
@@ -67,9 +112,11 @@ public:
   void reset_in_memory_state();
 
   size_t get_ip_state_count() const { return ip_activity_trackers.size(); }
-  size_t get_path_state_count() const { return path_activity_trackers.size(); }
+  size_t get_path_state_count() const { return path_stats_->size(); }
   size_t get_session_state_count() const { return session_trackers.size(); }
 
+  // Top IPs across all workers from the heavy-hitter sketches. Supported
+  // metrics are "request_rate" and "error_count".
   std::vector<TopIpInfo> get_top_n_by_metric(size_t n,
                                              const std::string &metric_name);
   EngineStateMetrics get_internal_state_metrics() const;
@@ -81,6 +128,27 @@ public:
   void trigger_memory_cleanup();
   void evict_inactive_states(uint64_t current_timestamp_ms);
 
+  // Cold tier for IP state. Idle or pressure-evicted states are spilled to an
+  // mmap-backed file and rehydrated on the IP's next request.
+  bool enable_cold_state_tier(const std::string &spill_file_path);
+  // Safe to call from any thread; the spill runs on the owning worker before
+  // its next event.
+  void request_cold_spill(size_t pressure_level);
+  size_t spill_ip_states_to_cold(size_t count);
+  size_t get_cold_ip_state_count() const;
+
+  // IMemoryManaged interface. These run on the MemoryManager's threads, so
+  // they only read the footprint estimate refreshed by run_pruning and queue
+  // spills for the worker.
+  size_t get_memory_usage() const override;
+  size_t compact() override { return 0; }
+  void on_memory_pressure(size_t pressure_level) override;
+  bool can_evict() const override { return cold_ip_store_ != nullptr; }
+  std::string get_component_name() const override {
+    return "analysis_engine";
+  }
+  int get_priority() const override { return 1; }
+
   // Backpressure mechanism
   bool should_throttle_ingestion() const;
   size_t get_recommended_batch_size() const;
@@ -95,15 +163,64 @@ public:
   void set_tier4_anomaly_detector(
       std::shared_ptr<analysis::PrometheusAnomalyDetector> detector);
 
+  // Subnet rollups must be shared by every worker to see a whole subnet; the
+  // engine creates its own when enabled, main replaces it with a shared one.
+  void set_subnet_rollup(std::shared_ptr<analysis::SubnetRollup> rollup);
+  std::shared_ptr<analysis::SubnetRollup> get_subnet_rollup() const {
+    return subnet_rollup_;
+  }
+
+  // Path baselines are likewise global; every engine starts with its own
+  // store and main points all workers at the first engine's. Only the
+  // engine that created the store clears and prunes it; attached engines
+  // just record into it.
+  void set_path_stats(std::shared_ptr<analysis::SharedPathStats> stats);
+  std::shared_ptr<analysis::SharedPathStats> get_path_stats() const {
+    return path_stats_;
+  }
+
+  // UA verdicts are cached across workers the same way
+  void set_ua_verdict_cache(std::shared_ptr<analysis::UaVerdictCache> cache);
+  std::shared_ptr<analysis::UaVerdictCache> get_ua_verdict_cache() const {
+    return ua_verdicts_;
+  }
+
+  // The path classifier is read-only, so one built per configuration serves
+  // every worker. Only an engine that built its own rebuilds it on
+  // reconfigure; main hands that one to the others.
+  void set_request_classifier(
+      std::shared_ptr<const analysis::RequestClassifier> classifier);
+  std::shared_ptr<const analysis::RequestClassifier>
+  get_request_classifier() const {
+    return request_classifier_;
+  }
+
+  // Top-N sketches have one shard per worker; this engine writes to `shard`
+  void set_traffic_sketches(std::shared_ptr<analysis::TrafficSketchSet> sketches,
+                            size_t shard);
+  std::shared_ptr<analysis::TrafficSketchSet> get_traffic_sketches() const {
+    return traffic_sketches_;
+  }
+
 private:
   Config::AppConfig app_config;
+  // Headless, known-bad, desktop and mobile UA markers in one automaton
+  Utils::AhoCorasick ua_markers_;
+  std::shared_ptr<analysis::UaVerdictCache> ua_verdicts_;
+  uint64_t ua_verdict_seed_;
+  std::shared_ptr<const analysis::RequestClassifier> request_classifier_;
+  bool owns_request_classifier_;
   std::unordered_map<std::string, PerIpState> ip_activity_trackers;
-  std::unordered_map<std::string, PerPathState> path_activity_trackers;
   std::unordered_map<std::string, PerSessionState> session_trackers;
 
   std::unique_ptr<ModelDataCollector> data_collector_;
   std::shared_ptr<prometheus::PrometheusMetricsExporter> metrics_exporter_;
   std::shared_ptr<memory::MemoryManager> memory_manager_;
+  std::shared_ptr<analysis::SubnetRollup> subnet_rollup_;
+  std::shared_ptr<analysis::SharedPathStats> path_stats_;
+  bool owns_path_stats_ = true;
+  std::shared_ptr<analysis::TrafficSketchSet> traffic_sketches_;
+  size_t traffic_sketch_shard_ = 0;
 
   FeatureManager feature_manager_;
   uint64_t max_timestamp_seen_ = 0;
@@ -113,12 +230,36 @@ private:
   uint64_t last_cleanup_timestamp_ = 0;
   size_t memory_pressure_threshold_ = 0; // Will be set from config
 
+  // Keys changed since the last capture. A dirty key that is gone from both
+  // tiers at capture time is encoded as a removal.
+  bool track_dirty_ = false;
+  std::unordered_set<std::string> dirty_ips_;
+  std::unordered_set<std::string> dirty_sessions_;
+
+  // Restored IPs still in the mapped snapshot
+  std::unique_ptr<analysis::LazyIpSnapshot> lazy_ips_;
+
+  std::unique_ptr<memory::ColdStateStore> cold_ip_store_;
+  std::atomic<size_t> pending_spill_level_{0};
+  std::atomic<size_t> state_memory_estimate_{0};
+
+  void apply_pending_cold_spill();
+  void adopt_warmed_ip_states();
+  void encode_snapshot(core::BinarySerializer &out) const;
+  bool read_snapshot_header(core::BinaryDeserializer &in,
+                            uint64_t &max_ts) const;
+  void read_snapshot_sessions(
+      core::BinaryDeserializer &in,
+      std::unordered_map<std::string, PerSessionState> &sessions) const;
+  void refresh_state_memory_estimate();
+  bool demote_ip_state(const std::string &ip, PerIpState &state);
+  std::optional<PerIpState> rehydrate_ip_state(const std::string &ip,
+                                               uint64_t current_timestamp_ms);
+
   std::string build_session_key(const LogEntry &raw_log) const;
 
   PerIpState &get_or_create_ip_state(const std::string &ip,
                                      uint64_t current_timestamp_ms);
-  PerPathState &get_or_create_path_state(const std::string &path,
-                                         uint64_t current_timestamp_ms);
 };
 
 #endif // ANALYSIS_ENGINE_HPP
\ No newline at end of file
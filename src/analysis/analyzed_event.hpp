@@ -4,11 +4,14 @@
 #include "analysis/per_session_state.hpp"
 #include "analysis/prometheus_anomaly_detector.hpp"
 #include "analysis/session_features.hpp"
+#include "analysis/subnet_rollup.hpp"
 #include "core/log_entry.hpp"
 
 #include <cstddef>
 #include <cstdint>
+#include <memory>
 #include <optional>
+#include <utility>
 #include <vector>
 
 struct AnalyzedEvent {
@@ -22,6 +25,11 @@ struct AnalyzedEvent {
   std::optional<size_t> current_ip_request_count_in_window;
   std::optional<size_t> current_ip_failed_login_count_in_window;
 
+  // Window totals for the enclosing subnets (/24 + /16 for IPv4, /64 + /48
+  // for IPv6), aggregated across all workers
+  std::optional<analysis::SubnetActivity> subnet_narrow_activity;
+  std::optional<analysis::SubnetActivity> subnet_wide_activity;
+
   // Historical stats for IP request time
   std::optional<double> ip_hist_req_time_mean;
   std::optional<double> ip_hist_req_time_stddev;
@@ -97,7 +105,11 @@ struct AnalyzedEvent {
   // Session context
   // ------------------
 
-  std::optional<PerSessionState> raw_session_state;
+  // Read-only handle into the owning AnalysisEngine's session map. It is only
+  // valid until the next process_and_analyze call on that engine, so anything
+  // that outlives the event (alerts) must use session_snapshot instead.
+  const PerSessionState *raw_session_state = nullptr;
+  std::optional<SessionSnapshot> session_snapshot;
   std::optional<SessionFeatures> derived_session_features;
 
   // ----------------------
@@ -119,6 +131,27 @@ struct AnalyzedEvent {
         found_suspicious_ua_str(false), ip_html_requests_in_window(0),
         ip_asset_requests_in_window(0) {}
 
+  // Takes ownership of the log line without copying it
+  AnalyzedEvent(LogEntry &&log)
+      : raw_log(std::move(log)), is_first_request_from_ip(false),
+        is_path_new_for_ip(false), is_ua_missing(false),
+        is_ua_changed_for_ip(false), is_ua_known_bad(false),
+        is_ua_outdated(false), is_ua_headless(false), is_ua_inconsistent(false),
+        is_ua_cycling(false), found_suspicious_path_str(false),
+        found_suspicious_ua_str(false), ip_html_requests_in_window(0),
+        ip_asset_requests_in_window(0) {}
+
+  // Builds the owned, self-contained copy attached to alerts. The session
+  // handle is replaced by a SessionSnapshot so the copy stays valid after the
+  // engine mutates or evicts the session.
+  std::shared_ptr<const AnalyzedEvent> materialize() const {
+    auto owned = std::make_shared<AnalyzedEvent>(*this);
+    if (raw_session_state && !owned->session_snapshot)
+      owned->session_snapshot.emplace(*raw_session_state);
+    owned->raw_session_state = nullptr;
+    return owned;
+  }
+
   // ----------------------
   // Prometheus Tier 4 anomalies
   // ----------------------
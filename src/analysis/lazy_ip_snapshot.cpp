@@ -0,0 +1,198 @@
+#include "lazy_ip_snapshot.hpp"
+#include "core/compact_serialization.hpp"
+#include "core/logger.hpp"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+
+namespace analysis {
+
+namespace {
+// Entries decoded by the warmer are handed over in batches of this size
+constexpr size_t WARM_BATCH = 256;
+} // namespace
+
+LazyIpSnapshot::LazyIpSnapshot(std::shared_ptr<const core::MappedFile> file,
+                               size_t index_offset, size_t entry_count,
+                               Decoder decode)
+    : file_(std::move(file)), index_offset_(index_offset),
+      entry_count_(entry_count), decode_(std::move(decode)),
+      states_(new std::atomic<uint8_t>[entry_count]) {
+  if (!file_ || index_offset_ > file_->size() ||
+      entry_count_ > (file_->size() - index_offset_) / INDEX_ENTRY_BYTES)
+    throw std::runtime_error("snapshot index is out of bounds");
+  for (size_t i = 0; i < entry_count_; ++i)
+    states_[i].store(UNTOUCHED, std::memory_order_relaxed);
+}
+
+LazyIpSnapshot::~LazyIpSnapshot() { stop_warming(); }
+
+uint64_t LazyIpSnapshot::key_hash(std::string_view key) {
+  // FNV-1a with a final avalanche so that sorted hashes spread evenly
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (unsigned char c : key) {
+    hash ^= c;
+    hash *= 0x100000001b3ULL;
+  }
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+uint64_t LazyIpSnapshot::index_word(size_t entry, size_t word) const {
+  const uint8_t *p =
+      file_->data() + index_offset_ + entry * INDEX_ENTRY_BYTES + word * 8;
+  uint64_t value = 0;
+  for (size_t i = 0; i < 8; ++i)
+    value |= static_cast<uint64_t>(p[i]) << (8 * i);
+  return value;
+}
+
+bool LazyIpSnapshot::read_entry(size_t entry, std::string &ip,
+                                const uint8_t *&blob, size_t &size) const {
+  uint64_t offset = index_word(entry, 1);
+  if (offset >= index_offset_)
+    return false;
+  try {
+    core::BinaryDeserializer in(file_->data() + offset,
+                                index_offset_ - static_cast<size_t>(offset));
+    ip = in.read_string_raw();
+    std::tie(blob, size) = in.read_blob();
+    return true;
+  } catch (const std::exception &) {
+    return false;
+  }
+}
+
+std::optional<size_t> LazyIpSnapshot::find(const std::string &ip) const {
+  const uint64_t hash = key_hash(ip);
+  size_t lo = 0, hi = entry_count_;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (index_word(mid, 0) < hash)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  std::string key;
+  const uint8_t *blob = nullptr;
+  size_t size = 0;
+  for (size_t i = lo; i < entry_count_ && index_word(i, 0) == hash; ++i)
+    if (read_entry(i, key, blob, size) && key == ip)
+      return i;
+  return std::nullopt;
+}
+
+std::optional<PerIpState> LazyIpSnapshot::take(const std::string &ip) {
+  auto entry = find(ip);
+  if (!entry || states_[*entry].exchange(TAKEN) == TAKEN)
+    return std::nullopt;
+  ++taken_;
+
+  // Even if the warmer already decoded it, its copy is dropped in
+  // drain_warmed() and the entry is decoded again here
+  std::string key;
+  const uint8_t *blob = nullptr;
+  size_t size = 0;
+  if (!read_entry(*entry, key, blob, size))
+    return std::nullopt;
+  try {
+    return decode_(blob, size);
+  } catch (const std::exception &e) {
+    LOG(LogLevel::WARN, LogComponent::STATE_PERSIST,
+        "Discarding unreadable restored state for IP " << ip << ": "
+                                                       << e.what());
+    return std::nullopt;
+  }
+}
+
+void LazyIpSnapshot::drop(const std::string &ip) {
+  auto entry = find(ip);
+  if (entry && states_[*entry].exchange(TAKEN) != TAKEN)
+    ++taken_;
+}
+
+std::vector<std::pair<std::string, PerIpState>> LazyIpSnapshot::drain_warmed() {
+  std::vector<Warmed> batch;
+  {
+    std::unique_lock<std::mutex> lock(warmed_mutex_, std::try_to_lock);
+    if (!lock.owns_lock() || warmed_.empty())
+      return {};
+    batch.swap(warmed_);
+  }
+
+  std::vector<std::pair<std::string, PerIpState>> adopted;
+  adopted.reserve(batch.size());
+  for (auto &item : batch) {
+    // Only the worker moves entries to TAKEN, so this cannot race
+    if (states_[item.entry].load(std::memory_order_acquire) != WARMED)
+      continue;
+    states_[item.entry].store(TAKEN, std::memory_order_release);
+    ++taken_;
+    if (item.state)
+      adopted.emplace_back(std::move(item.ip), std::move(*item.state));
+  }
+  return adopted;
+}
+
+void LazyIpSnapshot::start_warming() {
+  if (!warmer_.joinable() && entry_count_ > 0)
+    warmer_ = std::thread(&LazyIpSnapshot::warm_loop, this);
+}
+
+void LazyIpSnapshot::stop_warming() {
+  stop_warming_.store(true);
+  if (warmer_.joinable())
+    warmer_.join();
+}
+
+void LazyIpSnapshot::warm_loop() {
+  // Walk the entries in file order so the reads are sequential
+  std::vector<size_t> order(entry_count_);
+  std::iota(order.begin(), order.end(), size_t{0});
+  std::sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+    return index_word(a, 1) < index_word(b, 1);
+  });
+
+  std::vector<Warmed> batch;
+  std::string ip;
+  const uint8_t *blob = nullptr;
+  size_t size = 0;
+  auto publish = [&]() {
+    std::lock_guard<std::mutex> lock(warmed_mutex_);
+    for (auto &item : batch)
+      warmed_.push_back(std::move(item));
+    batch.clear();
+  };
+
+  for (size_t entry : order) {
+    if (stop_warming_.load(std::memory_order_relaxed))
+      return;
+    uint8_t expected = UNTOUCHED;
+    if (!states_[entry].compare_exchange_strong(expected, WARMED))
+      continue;
+    if (!read_entry(entry, ip, blob, size)) {
+      batch.push_back(Warmed{entry, std::string(), std::nullopt});
+      continue;
+    }
+    std::optional<PerIpState> state;
+    try {
+      state = decode_(blob, size);
+    } catch (const std::exception &e) {
+      LOG(LogLevel::WARN, LogComponent::STATE_PERSIST,
+          "Discarding unreadable restored state for IP " << ip << ": "
+                                                         << e.what());
+    }
+    batch.push_back(Warmed{entry, ip, std::move(state)});
+    if (batch.size() >= WARM_BATCH)
+      publish();
+  }
+  publish();
+  LOG(LogLevel::DEBUG, LogComponent::STATE_PERSIST,
+      "Finished warming " << entry_count_ << " restored IP states from "
+                          << file_->path());
+}
+
+} // namespace analysis
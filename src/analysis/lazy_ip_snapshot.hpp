@@ -0,0 +1,103 @@
+#ifndef LAZY_IP_SNAPSHOT_HPP
+#define LAZY_IP_SNAPSHOT_HPP
+
+#include "core/mapped_file.hpp"
+#include "per_ip_state.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace analysis {
+
+// IP section of a full snapshot, left in the mapped file and decoded on
+// demand.
+//
+// The snapshot ends with an index of (key hash, entry offset) pairs sorted by
+// hash, so a lookup is a binary search over the mapping and touches only the
+// pages it needs. The owning worker take()s entries as IPs show up; a warmer
+// thread decodes the rest in file order and hands them back through
+// drain_warmed(), which the worker calls between events. Every entry is
+// handed to the worker exactly once, by whichever path gets there first.
+class LazyIpSnapshot {
+public:
+  using Decoder = std::function<PerIpState(const uint8_t *, size_t)>;
+
+  static constexpr size_t INDEX_ENTRY_BYTES = 16;
+
+  // Throws std::runtime_error if the index does not fit in the file
+  LazyIpSnapshot(std::shared_ptr<const core::MappedFile> file,
+                 size_t index_offset, size_t entry_count, Decoder decode);
+  ~LazyIpSnapshot();
+
+  LazyIpSnapshot(const LazyIpSnapshot &) = delete;
+  LazyIpSnapshot &operator=(const LazyIpSnapshot &) = delete;
+
+  // Stable across processes and builds, unlike std::hash
+  static uint64_t key_hash(std::string_view key);
+
+  // Worker thread only. Decodes ip if it has not been handed out yet.
+  std::optional<PerIpState> take(const std::string &ip);
+  // Worker thread only. Marks ip as superseded without decoding it.
+  void drop(const std::string &ip);
+  // Worker thread only. Entries the warmer decoded that are still wanted.
+  std::vector<std::pair<std::string, PerIpState>> drain_warmed();
+
+  void start_warming();
+  void stop_warming();
+
+  // Entries not yet handed to the worker
+  size_t pending() const { return entry_count_ - taken_; }
+
+  // Worker thread only. Visits (ip, payload, size) of every pending entry.
+  template <typename Fn> void for_each_pending(Fn &&fn) const {
+    std::string ip;
+    const uint8_t *blob = nullptr;
+    size_t size = 0;
+    for (size_t i = 0; i < entry_count_; ++i)
+      if (states_[i].load(std::memory_order_acquire) != TAKEN &&
+          read_entry(i, ip, blob, size))
+        fn(ip, blob, size);
+  }
+
+private:
+  enum EntryState : uint8_t { UNTOUCHED = 0, WARMED = 1, TAKEN = 2 };
+
+  // state is empty if the entry failed to decode
+  struct Warmed {
+    size_t entry;
+    std::string ip;
+    std::optional<PerIpState> state;
+  };
+
+  std::optional<size_t> find(const std::string &ip) const;
+  uint64_t index_word(size_t entry, size_t word) const;
+  bool read_entry(size_t entry, std::string &ip, const uint8_t *&blob,
+                  size_t &size) const;
+  void warm_loop();
+
+  std::shared_ptr<const core::MappedFile> file_;
+  size_t index_offset_;
+  size_t entry_count_;
+  Decoder decode_;
+  std::unique_ptr<std::atomic<uint8_t>[]> states_;
+  size_t taken_ = 0;
+
+  std::mutex warmed_mutex_;
+  std::vector<Warmed> warmed_;
+  std::atomic<bool> stop_warming_{false};
+  std::thread warmer_;
+};
+
+} // namespace analysis
+
+#endif // LAZY_IP_SNAPSHOT_HPP
@@ -5,10 +5,14 @@
 #include "utils/stats_tracker.hpp"
 
 #include <cstdint>
-#include <fstream>
 #include <string>
 #include <unordered_set>
 
+namespace core {
+class BinarySerializer;
+class BinaryDeserializer;
+} // namespace core
+
 struct PerIpState {
   int default_elements_limit = 200;
   int default_duration_ms = 60000; // 60 seconds
@@ -110,8 +114,12 @@ struct PerIpState {
         recent_unique_ua_window(default_duration_ms, default_elements_limit),
         last_seen_timestamp_ms(0) {}
 
-  void save(std::ofstream &out) const;
-  void load(std::ifstream &in);
+  // Tagged, checksummed record used by snapshots and the cold state tier.
+  // Unknown tags are skipped, so fields can be added without a format bump.
+  // Window durations are not encoded; construct with the current config
+  // first.
+  void serialize(core::BinarySerializer &out) const;
+  void deserialize(core::BinaryDeserializer &in);
 };
 
 #endif // PER_IP_STATE_HPP
\ No newline at end of file
@@ -4,7 +4,11 @@
 #include "utils/stats_tracker.hpp"
 
 #include <cstdint>
-#include <fstream>
+
+namespace core {
+class BinarySerializer;
+class BinaryDeserializer;
+} // namespace core
 
 struct PerPathState {
   StatsTracker request_time_tracker;
@@ -31,8 +35,8 @@ struct PerPathState {
 
   PerPathState() : last_seen_timestamp_ms(0) {}
 
-  void save(std::ofstream &out) const;
-  void load(std::ifstream &in);
+  void serialize(core::BinarySerializer &out) const;
+  void deserialize(core::BinaryDeserializer &in);
 };
 
 #endif // PER_PATH_STATE_HPP
\ No newline at end of file
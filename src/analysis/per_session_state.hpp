@@ -10,6 +10,11 @@
 #include <string>
 #include <unordered_set>
 
+namespace core {
+class BinarySerializer;
+class BinaryDeserializer;
+} // namespace core
+
 struct PerSessionState {
   int default_elements_limit = 200;
   int default_duration_ms = 60000; // 60 seconds
@@ -92,6 +97,37 @@ struct PerSessionState {
       : session_start_timestamp_ms(timestamp_ms),
         last_seen_timestamp_ms(timestamp_ms),
         request_timestamps_window(window_duration_ms, default_elements_limit) {}
+
+  // Compact encoding used by state snapshots. As with PerIpState, construct
+  // with the current window duration before deserializing.
+  void serialize(core::BinarySerializer &out) const;
+  void deserialize(core::BinaryDeserializer &in);
+};
+
+// Fixed-size copy of the session counters. Attached to alerts instead of the
+// live PerSessionState, which keeps changing after the event is analyzed.
+struct SessionSnapshot {
+  uint64_t session_start_timestamp_ms = 0;
+  uint64_t last_seen_timestamp_ms = 0;
+  uint64_t request_count = 0;
+  size_t unique_paths_count = 0;
+  size_t unique_user_agents_count = 0;
+  size_t requests_in_window = 0;
+  uint32_t failed_login_attempts = 0;
+  uint32_t error_4xx_count = 0;
+  uint32_t error_5xx_count = 0;
+
+  SessionSnapshot() = default;
+  explicit SessionSnapshot(const PerSessionState &session)
+      : session_start_timestamp_ms(session.session_start_timestamp_ms),
+        last_seen_timestamp_ms(session.last_seen_timestamp_ms),
+        request_count(session.request_count),
+        unique_paths_count(session.get_unique_paths_count()),
+        unique_user_agents_count(session.get_unique_user_agents_count()),
+        requests_in_window(session.get_request_timestamps_count()),
+        failed_login_attempts(session.failed_login_attempts),
+        error_4xx_count(session.error_4xx_count),
+        error_5xx_count(session.error_5xx_count) {}
 };
 
 #endif // PER_SESSION_STATE_HPP
\ No newline at end of file
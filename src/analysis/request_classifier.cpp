@@ -0,0 +1,277 @@
+#include "request_classifier.hpp"
+#include "core/config.hpp"
+
+#include <algorithm>
+#include <unordered_set>
+#include <utility>
+
+namespace analysis {
+
+namespace {
+
+uint64_t length_bit(size_t length) {
+  return uint64_t{1} << (length < 63 ? length : 63);
+}
+
+uint64_t seeded_hash(std::string_view key, uint64_t seed) {
+  uint64_t h = 0xcbf29ce484222325ULL ^ (seed * 0x9e3779b97f4a7c15ULL);
+  for (unsigned char ch : key) {
+    h ^= ch;
+    h *= 0x100000001b3ULL;
+  }
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  return h ^ (h >> 33);
+}
+
+// A key's bucket comes from the high half of its hash, its first slot from
+// the low bits and its odd probe step from a remix, so over a power-of-two
+// table each displacement moves it to a different slot
+size_t bucket_of(uint64_t hash, size_t bucket_count) {
+  return static_cast<size_t>(((hash >> 32) * bucket_count) >> 32);
+}
+
+size_t displaced_slot(uint64_t hash, uint32_t displacement, size_t mask) {
+  const uint64_t step = ((hash * 0x9e3779b97f4a7c15ULL) >> 32) | 1;
+  return static_cast<size_t>(hash + displacement * step) & mask;
+}
+
+} // namespace
+
+RequestClassifier::RequestClassifier(const Config::Tier1Config &cfg) {
+  std::vector<std::pair<std::string, RequestType>> exact;
+  for (const auto &path : cfg.html_exact_paths)
+    exact.emplace_back(path, RequestType::HTML);
+  exact_paths_.build(std::move(exact));
+
+  // HTML suffixes first, so they win when a suffix is in both lists
+  std::vector<std::pair<std::string, RequestType>> suffixes;
+  for (const auto &suffix : cfg.html_path_suffixes)
+    suffixes.emplace_back(suffix, RequestType::HTML);
+  for (const auto &suffix : cfg.asset_path_suffixes)
+    suffixes.emplace_back(suffix, RequestType::ASSET);
+  suffixes_.build(std::move(suffixes));
+
+  asset_prefixes_.build(cfg.asset_path_prefixes);
+}
+
+std::string_view
+RequestClassifier::strip_query(std::string_view request_path) {
+  for (size_t i = 0; i < request_path.size(); ++i)
+    if (request_path[i] == '?' || request_path[i] == '#')
+      return request_path.substr(0, i);
+  return request_path;
+}
+
+RequestType RequestClassifier::classify(std::string_view request_path) const {
+  std::string_view path = strip_query(request_path);
+
+  if (exact_paths_.find(path) == RequestType::HTML)
+    return RequestType::HTML;
+  if (asset_prefixes_.matches(path))
+    return RequestType::ASSET;
+
+  size_t last_dot = path.rfind('.');
+  if (last_dot != std::string_view::npos)
+    return suffixes_.find(path.substr(last_dot));
+  return RequestType::OTHER;
+}
+
+size_t RequestClassifier::memory_footprint() const {
+  return sizeof(*this) + exact_paths_.memory_footprint() +
+         suffixes_.memory_footprint() + asset_prefixes_.memory_footprint();
+}
+
+void RequestClassifier::PerfectHashTable::build(
+    std::vector<std::pair<std::string, RequestType>> entries) {
+  keys_.clear();
+  values_.clear();
+  occupied_.clear();
+  displacements_.clear();
+  key_lengths_ = 0;
+  seed_ = 0;
+  mask_ = 0;
+
+  // The first occurrence of a key wins
+  std::vector<size_t> first_occurrences;
+  {
+    std::unordered_set<std::string_view> seen;
+    for (size_t i = 0; i < entries.size(); ++i)
+      if (seen.insert(entries[i].first).second)
+        first_occurrences.push_back(i);
+  }
+  std::vector<std::pair<std::string, RequestType>> unique;
+  unique.reserve(first_occurrences.size());
+  for (size_t i : first_occurrences)
+    unique.push_back(std::move(entries[i]));
+  if (unique.empty())
+    return;
+  for (const auto &entry : unique)
+    key_lengths_ |= length_bit(entry.first.size());
+
+  const size_t n = unique.size();
+  size_t size = 2;
+  while (size < n + n / 2)
+    size <<= 1;
+  const size_t bucket_count = (n + 3) / 4;
+
+  std::vector<uint64_t> hashes(n);
+  std::vector<size_t> bucket_start(bucket_count + 1);
+  std::vector<size_t> members(n);
+  std::vector<size_t> order(bucket_count);
+  std::vector<uint8_t> occupied;
+  std::vector<uint32_t> displacements;
+  std::vector<size_t> slots;
+
+  for (uint64_t seed = 0;; ++seed) {
+    // Keys grouped by bucket with a counting sort
+    std::fill(bucket_start.begin(), bucket_start.end(), 0);
+    for (size_t i = 0; i < n; ++i) {
+      hashes[i] = seeded_hash(unique[i].first, seed);
+      ++bucket_start[bucket_of(hashes[i], bucket_count) + 1];
+    }
+    size_t largest = 0;
+    for (size_t b = 0; b < bucket_count; ++b) {
+      largest = std::max(largest, bucket_start[b + 1]);
+      bucket_start[b + 1] += bucket_start[b];
+    }
+    std::vector<size_t> fill(bucket_start.begin(), bucket_start.end() - 1);
+    for (size_t i = 0; i < n; ++i)
+      members[fill[bucket_of(hashes[i], bucket_count)]++] = i;
+
+    // Largest buckets first, while the table is emptiest
+    std::vector<size_t> by_size(largest + 2);
+    for (size_t b = 0; b < bucket_count; ++b)
+      ++by_size[largest - (bucket_start[b + 1] - bucket_start[b]) + 1];
+    for (size_t k = 1; k < by_size.size(); ++k)
+      by_size[k] += by_size[k - 1];
+    for (size_t b = 0; b < bucket_count; ++b)
+      order[by_size[largest - (bucket_start[b + 1] - bucket_start[b])]++] = b;
+
+    occupied.assign(size, 0);
+    displacements.assign(bucket_count, 0);
+    bool placed_all = true;
+    for (size_t b : order) {
+      bool placed = false;
+      // Every displacement below size sends a key to a different slot, so
+      // running out means keys that can never be separated: reseed
+      for (uint32_t d = 0; d < size && !placed; ++d) {
+        slots.clear();
+        placed = true;
+        for (size_t m = bucket_start[b]; m < bucket_start[b + 1]; ++m) {
+          size_t slot = displaced_slot(hashes[members[m]], d, size - 1);
+          if (occupied[slot]) {
+            placed = false;
+            break;
+          }
+          occupied[slot] = 1;
+          slots.push_back(slot);
+        }
+        if (!placed)
+          for (size_t slot : slots)
+            occupied[slot] = 0;
+        else
+          displacements[b] = d;
+      }
+      if (!placed) {
+        placed_all = false;
+        break;
+      }
+    }
+    if (!placed_all)
+      continue;
+
+    keys_.assign(size, std::string());
+    values_.assign(size, RequestType::OTHER);
+    for (size_t i = 0; i < n; ++i) {
+      size_t slot = displaced_slot(
+          hashes[i], displacements[bucket_of(hashes[i], bucket_count)],
+          size - 1);
+      keys_[slot] = std::move(unique[i].first);
+      values_[slot] = unique[i].second;
+    }
+    occupied_ = std::move(occupied);
+    displacements_ = std::move(displacements);
+    seed_ = seed;
+    mask_ = size - 1;
+    return;
+  }
+}
+
+size_t
+RequestClassifier::PerfectHashTable::slot_for(std::string_view key) const {
+  uint64_t hash = seeded_hash(key, seed_);
+  return displaced_slot(
+      hash, displacements_[bucket_of(hash, displacements_.size())], mask_);
+}
+
+RequestType
+RequestClassifier::PerfectHashTable::find(std::string_view key) const {
+  if (!(key_lengths_ & length_bit(key.size())))
+    return RequestType::OTHER;
+  size_t slot = slot_for(key);
+  if (occupied_[slot] && keys_[slot] == key)
+    return values_[slot];
+  return RequestType::OTHER;
+}
+
+size_t RequestClassifier::PerfectHashTable::memory_footprint() const {
+  size_t usage = keys_.capacity() * sizeof(std::string) +
+                 values_.capacity() * sizeof(RequestType) +
+                 occupied_.capacity() +
+                 displacements_.capacity() * sizeof(uint32_t);
+  for (const auto &key : keys_)
+    usage += key.capacity();
+  return usage;
+}
+
+void RequestClassifier::PrefixTrie::build(
+    const std::vector<std::string> &prefixes) {
+  byte_class_.fill(0);
+  std::array<bool, 256> seen{};
+  for (const auto &prefix : prefixes)
+    for (unsigned char ch : prefix)
+      seen[ch] = true;
+  class_count_ = 1;
+  for (int ch = 0; ch < 256; ++ch)
+    if (seen[ch])
+      byte_class_[ch] = static_cast<uint16_t>(class_count_++);
+
+  transitions_.assign(class_count_, kDead);
+  terminal_.assign(1, 0);
+  for (const auto &prefix : prefixes) {
+    int32_t state = 0;
+    for (unsigned char ch : prefix) {
+      size_t edge = state * class_count_ + byte_class_[ch];
+      if (transitions_[edge] == kDead) {
+        transitions_[edge] = static_cast<int32_t>(terminal_.size());
+        terminal_.push_back(0);
+        transitions_.resize(transitions_.size() + class_count_, kDead);
+      }
+      state = transitions_[edge];
+    }
+    terminal_[state] = 1;
+  }
+}
+
+bool RequestClassifier::PrefixTrie::matches(std::string_view path) const {
+  if (terminal_.empty())
+    return false;
+  if (terminal_[0])
+    return true;
+  int32_t state = 0;
+  for (unsigned char ch : path) {
+    state = transitions_[state * class_count_ + byte_class_[ch]];
+    if (state == kDead)
+      return false;
+    if (terminal_[state])
+      return true;
+  }
+  return false;
+}
+
+size_t RequestClassifier::PrefixTrie::memory_footprint() const {
+  return transitions_.capacity() * sizeof(int32_t) + terminal_.capacity();
+}
+
+} // namespace analysis
@@ -0,0 +1,89 @@
+#ifndef REQUEST_CLASSIFIER_HPP
+#define REQUEST_CLASSIFIER_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Config {
+struct Tier1Config;
+} // namespace Config
+
+namespace analysis {
+
+enum class RequestType { HTML, ASSET, OTHER };
+
+// The html/asset path lists of the Tier 1 config, compiled once per
+// (re)configuration and shared read-only by every worker. Exact paths and
+// suffixes go into collision-free hash tables and asset prefixes into a
+// dense trie, so classifying a path is a prefix walk plus at most two probes
+// and never allocates.
+//
+// Rules apply in the order the original linear scans did: exact HTML path,
+// asset prefix, HTML suffix, asset suffix.
+class RequestClassifier {
+public:
+  RequestClassifier() = default;
+  explicit RequestClassifier(const Config::Tier1Config &cfg);
+
+  RequestType classify(std::string_view request_path) const;
+
+  // request_path without its query string and fragment
+  static std::string_view strip_query(std::string_view request_path);
+
+  size_t memory_footprint() const;
+
+private:
+  // Hash-and-displace (CHD) table: keys are split into buckets of about four,
+  // and each bucket is given a displacement that sends all of its keys to
+  // free slots. Building takes expected linear time, with the table at most
+  // two thirds full. A lookup is one hash, one displacement and one compare,
+  // and is skipped entirely when no key has the probe's length.
+  class PerfectHashTable {
+  public:
+    void build(std::vector<std::pair<std::string, RequestType>> entries);
+    RequestType find(std::string_view key) const;
+    size_t memory_footprint() const;
+
+  private:
+    size_t slot_for(std::string_view key) const;
+
+    std::vector<std::string> keys_;
+    std::vector<RequestType> values_;
+    std::vector<uint8_t> occupied_;
+    std::vector<uint32_t> displacements_;
+    // Bit n set if some key has length n, or length >= 63 for bit 63
+    uint64_t key_lengths_ = 0;
+    uint64_t seed_ = 0;
+    size_t mask_ = 0;
+  };
+
+  // Anchored trie over the asset prefixes, with rows of a dense transition
+  // table indexed by compressed byte class
+  class PrefixTrie {
+  public:
+    void build(const std::vector<std::string> &prefixes);
+    // True if some prefix is a prefix of path
+    bool matches(std::string_view path) const;
+    size_t memory_footprint() const;
+
+  private:
+    static constexpr int32_t kDead = -1;
+
+    std::array<uint16_t, 256> byte_class_{};
+    uint32_t class_count_ = 1;
+    std::vector<int32_t> transitions_;
+    std::vector<uint8_t> terminal_;
+  };
+
+  PerfectHashTable exact_paths_;
+  PerfectHashTable suffixes_;
+  PrefixTrie asset_prefixes_;
+};
+
+} // namespace analysis
+
+#endif // REQUEST_CLASSIFIER_HPP
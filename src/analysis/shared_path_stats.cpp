@@ -0,0 +1,108 @@
+#include "shared_path_stats.hpp"
+#include "core/compact_serialization.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+
+namespace analysis {
+
+SharedPathStats::Shard &SharedPathStats::shard_for(const std::string &path) {
+  return shards_[std::hash<std::string>{}(path) % kShardCount];
+}
+
+PerPathState SharedPathStats::record(const std::string &path,
+                                     uint64_t timestamp_ms,
+                                     const Sample &sample) {
+  Shard &shard = shard_for(path);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+
+  auto it = shard.paths.find(path);
+  if (it == shard.paths.end())
+    it = shard.paths.emplace(path, PerPathState(timestamp_ms)).first;
+
+  PerPathState &state = it->second;
+  state.last_seen_timestamp_ms =
+      std::max(state.last_seen_timestamp_ms, timestamp_ms);
+  if (sample.request_time_s)
+    state.request_time_tracker.update(*sample.request_time_s);
+  if (sample.bytes_sent)
+    state.bytes_sent_tracker.update(*sample.bytes_sent);
+  state.error_rate_tracker.update(sample.is_error ? 1.0 : 0.0);
+  state.request_volume_tracker.update(1.0);
+  return state;
+}
+
+void SharedPathStats::insert(const std::string &path, PerPathState state) {
+  Shard &shard = shard_for(path);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  shard.paths.insert_or_assign(path, std::move(state));
+}
+
+size_t SharedPathStats::prune_idle(uint64_t now_ms, uint64_t ttl_ms) {
+  size_t pruned = 0;
+  for (auto &shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    for (auto it = shard.paths.begin(); it != shard.paths.end();) {
+      if (now_ms > it->second.last_seen_timestamp_ms + ttl_ms) {
+        it = shard.paths.erase(it);
+        ++pruned;
+      } else {
+        ++it;
+      }
+    }
+  }
+  return pruned;
+}
+
+void SharedPathStats::serialize(core::BinarySerializer &out) const {
+  out.write_varint32(static_cast<uint32_t>(kShardCount));
+  for (const auto &shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    out.write_varint32(static_cast<uint32_t>(shard.paths.size()));
+    for (const auto &[path, state] : shard.paths) {
+      out.write_string_raw(path);
+      state.serialize(out);
+    }
+  }
+}
+
+void SharedPathStats::deserialize(core::BinaryDeserializer &in) {
+  // Entries are rehashed on insert, so a different shard count is fine
+  uint32_t groups = in.read_varint32();
+  for (uint32_t g = 0; g < groups; ++g) {
+    uint32_t count = in.read_varint32();
+    for (uint32_t i = 0; i < count; ++i) {
+      std::string path = in.read_string_raw();
+      PerPathState state;
+      state.deserialize(in);
+      insert(path, std::move(state));
+    }
+  }
+}
+
+void SharedPathStats::clear() {
+  for (auto &shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.paths.clear();
+  }
+}
+
+size_t SharedPathStats::size() const {
+  size_t total = 0;
+  for (const auto &shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    total += shard.paths.size();
+  }
+  return total;
+}
+
+size_t SharedPathStats::memory_footprint() const {
+  size_t total = 0;
+  for_each([&total](const std::string &path, const PerPathState &state) {
+    total += path.capacity() + state.calculate_memory_footprint();
+  });
+  return total;
+}
+
+} // namespace analysis
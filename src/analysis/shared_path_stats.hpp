@@ -0,0 +1,80 @@
+#ifndef SHARED_PATH_STATS_HPP
+#define SHARED_PATH_STATS_HPP
+
+#include "per_path_state.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+namespace core {
+class BinarySerializer;
+class BinaryDeserializer;
+} // namespace core
+
+namespace analysis {
+
+// Path-level Tier 2 baselines shared by all workers.
+//
+// Events are sharded by IP, so a per-worker path map would only ever see 1/N
+// of a path's traffic and keep N copies of it. Here every worker folds its
+// samples into one lock-striped table and scores against the global baseline.
+// The critical section is a handful of Welford updates plus a copy of the
+// result.
+class SharedPathStats {
+public:
+  struct Sample {
+    std::optional<double> request_time_s;
+    std::optional<double> bytes_sent;
+    bool is_error = false;
+  };
+
+  // Folds one request into the path's trackers and returns a copy of the
+  // updated state, taken under the same lock
+  PerPathState record(const std::string &path, uint64_t timestamp_ms,
+                      const Sample &sample);
+
+  // Replaces the state for path, used when restoring persisted state
+  void insert(const std::string &path, PerPathState state);
+
+  // Drops paths not seen within ttl_ms of now_ms. Returns the number dropped.
+  size_t prune_idle(uint64_t now_ms, uint64_t ttl_ms);
+
+  // Snapshot encoding. Shards are locked one at a time, so concurrent
+  // updates may land on either side of the snapshot.
+  void serialize(core::BinarySerializer &out) const;
+  void deserialize(core::BinaryDeserializer &in);
+
+  void clear();
+  size_t size() const;
+  size_t memory_footprint() const;
+
+  // Visits every path as (path, state) with its shard locked
+  template <typename Fn> void for_each(Fn &&fn) const {
+    for (const auto &shard : shards_) {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      for (const auto &[path, state] : shard.paths)
+        fn(path, state);
+    }
+  }
+
+private:
+  static constexpr size_t kShardCount = 64;
+
+  struct Shard {
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, PerPathState> paths;
+  };
+
+  Shard &shard_for(const std::string &path);
+
+  std::array<Shard, kShardCount> shards_;
+};
+
+} // namespace analysis
+
+#endif // SHARED_PATH_STATS_HPP
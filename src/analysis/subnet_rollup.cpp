@@ -0,0 +1,225 @@
+#include "subnet_rollup.hpp"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cmath>
+#include <cstring>
+
+namespace analysis {
+
+namespace {
+
+struct ParsedAddress {
+  bool ipv6 = false;
+  uint32_t v4 = 0; // host byte order
+  uint64_t hi = 0; // first 64 bits of an IPv6 address
+  uint64_t lo = 0;
+};
+
+uint64_t mix64(uint64_t x) {
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ULL;
+  x ^= x >> 33;
+  return x;
+}
+
+uint64_t load_be64(const unsigned char *p) {
+  uint64_t v = 0;
+  for (int i = 0; i < 8; ++i)
+    v = (v << 8) | p[i];
+  return v;
+}
+
+std::optional<ParsedAddress> parse_address(std::string_view ip) {
+  char buf[INET6_ADDRSTRLEN];
+  if (ip.empty() || ip.size() >= sizeof(buf))
+    return std::nullopt;
+  std::memcpy(buf, ip.data(), ip.size());
+  buf[ip.size()] = '\0';
+
+  ParsedAddress out;
+  in_addr v4{};
+  if (inet_pton(AF_INET, buf, &v4) == 1) {
+    out.v4 = ntohl(v4.s_addr);
+    return out;
+  }
+
+  in6_addr v6{};
+  if (inet_pton(AF_INET6, buf, &v6) != 1)
+    return std::nullopt;
+
+  const unsigned char *bytes = v6.s6_addr;
+  static const unsigned char kV4MappedPrefix[12] = {0, 0, 0, 0, 0,    0,
+                                                    0, 0, 0, 0, 0xff, 0xff};
+  if (std::memcmp(bytes, kV4MappedPrefix, sizeof(kV4MappedPrefix)) == 0) {
+    out.v4 = (uint32_t(bytes[12]) << 24) | (uint32_t(bytes[13]) << 16) |
+             (uint32_t(bytes[14]) << 8) | uint32_t(bytes[15]);
+    return out;
+  }
+
+  out.ipv6 = true;
+  out.hi = load_be64(bytes);
+  out.lo = load_be64(bytes + 8);
+  return out;
+}
+
+uint32_t estimate_distinct(const std::array<uint64_t, 4> &hosts, bool exact) {
+  int ones = 0;
+  for (uint64_t word : hosts)
+    ones += __builtin_popcountll(word);
+  if (exact)
+    return static_cast<uint32_t>(ones);
+
+  // Linear counting over the 256-bit bitmap
+  constexpr double m = 256.0;
+  const double zeros = m - ones;
+  if (zeros <= 0.0)
+    return static_cast<uint32_t>(m * std::log(m));
+  return static_cast<uint32_t>(std::lround(m * std::log(m / zeros)));
+}
+
+} // namespace
+
+const uint8_t SubnetRollup::kPrefixLengths[LEVEL_COUNT] = {24, 16, 64, 48};
+
+SubnetRollup::SubnetRollup(uint64_t window_ms)
+    : bucket_ms_(std::max<uint64_t>(1, window_ms / kBucketsPerWindow)) {}
+
+SubnetRollup::Result SubnetRollup::record(std::string_view ip,
+                                          uint64_t timestamp_ms,
+                                          bool failed_login) {
+  Result result;
+  auto addr = parse_address(ip);
+  if (!addr)
+    return result;
+
+  const uint64_t epoch = timestamp_ms / bucket_ms_.load();
+  if (!addr->ipv6) {
+    const uint32_t v4 = addr->v4;
+    result.narrow = update(V4_NARROW, v4 >> 8, static_cast<uint8_t>(v4),
+                           epoch, failed_login);
+    result.wide = update(V4_WIDE, v4 >> 16, static_cast<uint8_t>(mix64(v4)),
+                         epoch, failed_login);
+  } else {
+    const uint8_t host_bit = static_cast<uint8_t>(mix64(addr->hi ^ addr->lo));
+    result.narrow = update(V6_NARROW, addr->hi, host_bit, epoch, failed_login);
+    result.wide =
+        update(V6_WIDE, addr->hi >> 16,
+               static_cast<uint8_t>(mix64(addr->hi & 0xFFFF) ^ host_bit),
+               epoch, failed_login);
+  }
+  return result;
+}
+
+SubnetActivity SubnetRollup::update(Level level, uint64_t prefix,
+                                    uint8_t host_bit, uint64_t epoch,
+                                    bool failed_login) {
+  Shard &shard = tables_[level][mix64(prefix) % kShardCount];
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  Counter &counter = shard.counters[prefix];
+
+  // Events older than the ring span have no bucket left; they only read totals
+  if (epoch + kBucketsPerWindow > counter.last_epoch) {
+    Bucket &bucket = counter.buckets[epoch % kBucketsPerWindow];
+    if (bucket.epoch != epoch) {
+      bucket = Bucket{};
+      bucket.epoch = epoch;
+    }
+    ++bucket.requests;
+    if (failed_login)
+      ++bucket.failed_logins;
+    bucket.hosts[host_bit >> 6] |= uint64_t{1} << (host_bit & 63);
+    counter.last_epoch = std::max(counter.last_epoch, epoch);
+  }
+
+  SubnetActivity activity;
+  activity.prefix_length = kPrefixLengths[level];
+  std::array<uint64_t, 4> hosts{};
+  for (const Bucket &bucket : counter.buckets) {
+    if (bucket.epoch + kBucketsPerWindow <= counter.last_epoch)
+      continue;
+    activity.requests += bucket.requests;
+    activity.failed_logins += bucket.failed_logins;
+    for (size_t i = 0; i < hosts.size(); ++i)
+      hosts[i] |= bucket.hosts[i];
+  }
+  activity.distinct_ips = estimate_distinct(hosts, level == V4_NARROW);
+  return activity;
+}
+
+size_t SubnetRollup::prune(uint64_t now_ms) {
+  const uint64_t now_epoch = now_ms / bucket_ms_.load();
+  size_t pruned = 0;
+  for (auto &table : tables_) {
+    for (auto &shard : table) {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      for (auto it = shard.counters.begin(); it != shard.counters.end();) {
+        if (it->second.last_epoch + kBucketsPerWindow <= now_epoch) {
+          it = shard.counters.erase(it);
+          ++pruned;
+        } else {
+          ++it;
+        }
+      }
+    }
+  }
+  return pruned;
+}
+
+void SubnetRollup::reconfigure(uint64_t window_ms) {
+  for (auto &table : tables_) {
+    for (auto &shard : table) {
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      shard.counters.clear();
+    }
+  }
+  bucket_ms_.store(std::max<uint64_t>(1, window_ms / kBucketsPerWindow));
+}
+
+size_t SubnetRollup::tracked_subnet_count(bool ipv6, bool wide) const {
+  const Level level = ipv6 ? (wide ? V6_WIDE : V6_NARROW)
+                           : (wide ? V4_WIDE : V4_NARROW);
+  size_t total = 0;
+  for (const auto &shard : tables_[level]) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    total += shard.counters.size();
+  }
+  return total;
+}
+
+std::string SubnetRollup::format_prefix(std::string_view ip,
+                                        uint8_t prefix_length) {
+  auto addr = parse_address(ip);
+  if (!addr)
+    return std::string(ip);
+
+  char buf[INET6_ADDRSTRLEN] = {};
+  if (!addr->ipv6) {
+    const uint32_t mask =
+        prefix_length == 0
+            ? 0
+            : 0xFFFFFFFFu << (32 - std::min<uint8_t>(prefix_length, 32));
+    in_addr masked{};
+    masked.s_addr = htonl(addr->v4 & mask);
+    inet_ntop(AF_INET, &masked, buf, sizeof(buf));
+  } else {
+    in6_addr masked{};
+    for (int i = 0; i < 16; ++i) {
+      const int bits_before = i * 8;
+      const uint64_t word = i < 8 ? addr->hi : addr->lo;
+      const unsigned char byte =
+          static_cast<unsigned char>(word >> (8 * (7 - (i % 8))));
+      if (bits_before + 8 <= prefix_length)
+        masked.s6_addr[i] = byte;
+      else if (bits_before < prefix_length)
+        masked.s6_addr[i] = byte & static_cast<unsigned char>(
+                                       0xFF << (8 - (prefix_length % 8)));
+    }
+    inet_ntop(AF_INET6, &masked, buf, sizeof(buf));
+  }
+  return std::string(buf) + "/" + std::to_string(prefix_length);
+}
+
+} // namespace analysis
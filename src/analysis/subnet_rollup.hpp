@@ -0,0 +1,90 @@
+#ifndef SUBNET_ROLLUP_HPP
+#define SUBNET_ROLLUP_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace analysis {
+
+// Window totals for one enclosing subnet of the current request
+struct SubnetActivity {
+  uint8_t prefix_length = 0;
+  uint32_t requests = 0;
+  uint32_t failed_logins = 0;
+  // Exact for IPv4 /24, a linear-counting estimate for wider prefixes
+  uint32_t distinct_ips = 0;
+};
+
+// Incremental per-subnet request counters shared by all workers.
+//
+// Each request bumps one counter at the narrow level (/24 for IPv4, /64 for
+// IPv6) and one at the wide level (/16 or /48). Counters are rings of time
+// buckets covering the sliding window, so both updates and window totals are
+// O(1) regardless of how many IPs the subnet contains. Tables are sharded by
+// prefix with one mutex per shard.
+class SubnetRollup {
+public:
+  static constexpr size_t kBucketsPerWindow = 6;
+
+  struct Result {
+    std::optional<SubnetActivity> narrow;
+    std::optional<SubnetActivity> wide;
+  };
+
+  explicit SubnetRollup(uint64_t window_ms);
+
+  // Records one request and returns the updated window totals for the
+  // enclosing subnets. Unparseable addresses yield an empty result.
+  Result record(std::string_view ip, uint64_t timestamp_ms, bool failed_login);
+
+  // Drops subnets with no traffic inside the window ending at now_ms
+  size_t prune(uint64_t now_ms);
+
+  // Changes the window length; existing counters are discarded
+  void reconfigure(uint64_t window_ms);
+
+  size_t tracked_subnet_count(bool ipv6, bool wide) const;
+
+  // "203.0.113.0/24" style label for the subnet of ip at prefix_length
+  static std::string format_prefix(std::string_view ip, uint8_t prefix_length);
+
+private:
+  enum Level : size_t { V4_NARROW, V4_WIDE, V6_NARROW, V6_WIDE, LEVEL_COUNT };
+  static constexpr size_t kShardCount = 64;
+
+  struct Bucket {
+    uint64_t epoch = 0;
+    uint32_t requests = 0;
+    uint32_t failed_logins = 0;
+    std::array<uint64_t, 4> hosts{}; // 256-bit host presence bitmap
+  };
+
+  struct Counter {
+    std::array<Bucket, kBucketsPerWindow> buckets{};
+    uint64_t last_epoch = 0;
+  };
+
+  struct Shard {
+    mutable std::mutex mutex;
+    std::unordered_map<uint64_t, Counter> counters;
+  };
+
+  SubnetActivity update(Level level, uint64_t prefix, uint8_t host_bit,
+                        uint64_t epoch, bool failed_login);
+
+  static const uint8_t kPrefixLengths[LEVEL_COUNT];
+
+  std::array<std::array<Shard, kShardCount>, LEVEL_COUNT> tables_;
+  std::atomic<uint64_t> bucket_ms_;
+};
+
+} // namespace analysis
+
+#endif // SUBNET_ROLLUP_HPP
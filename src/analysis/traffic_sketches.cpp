@@ -0,0 +1,147 @@
+#include "traffic_sketches.hpp"
+
+#include <algorithm>
+#include <unordered_map>
+
+namespace analysis {
+
+namespace {
+
+uint64_t generation_length(uint64_t window_ms) {
+  return std::max<uint64_t>(1, window_ms / 2);
+}
+
+} // namespace
+
+TrafficSketchSet::Generation::Generation()
+    : ip_requests(kHeavyHitterCapacity,
+                  Utils::HyperLogLog(kCompanionPrecision)),
+      ip_errors(kHeavyHitterCapacity, Utils::HyperLogLog(kCompanionPrecision)),
+      path_requests(kHeavyHitterCapacity,
+                    Utils::HyperLogLog(kCompanionPrecision)),
+      ips(kGlobalPrecision), paths(kGlobalPrecision) {}
+
+void TrafficSketchSet::Generation::clear() {
+  ip_requests.clear();
+  ip_errors.clear();
+  path_requests.clear();
+  ips.clear();
+  paths.clear();
+}
+
+TrafficSketchSet::TrafficSketchSet(size_t shard_count, uint64_t window_ms)
+    : generation_ms_(generation_length(window_ms)) {
+  shards_.reserve(std::max<size_t>(1, shard_count));
+  for (size_t i = 0; i < std::max<size_t>(1, shard_count); ++i)
+    shards_.push_back(std::make_unique<Shard>());
+}
+
+void TrafficSketchSet::record(size_t shard_index, std::string_view ip,
+                              std::string_view path, uint64_t timestamp_ms,
+                              bool is_error) {
+  Shard &shard = *shards_[shard_index % shards_.size()];
+  const uint64_t epoch = timestamp_ms / generation_ms_.load();
+  const uint64_t ip_hash = Utils::sketch_hash(ip);
+  const uint64_t path_hash = Utils::sketch_hash(path);
+
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  if (epoch > shard.epoch) {
+    if (epoch == shard.epoch + 1)
+      std::swap(shard.previous, shard.current);
+    else
+      shard.previous.clear();
+    shard.current.clear();
+    shard.epoch = epoch;
+  }
+
+  Generation &gen = shard.current;
+  gen.ip_requests.offer(ip).add_hash(path_hash);
+  if (is_error)
+    gen.ip_errors.offer(ip).add_hash(path_hash);
+  gen.path_requests.offer(path).add_hash(ip_hash);
+  gen.ips.add_hash(ip_hash);
+  gen.paths.add_hash(path_hash);
+}
+
+std::vector<TopTalker>
+TrafficSketchSet::merge_top(KeyedSketch Generation::*sketch, size_t n) const {
+  struct Merged {
+    uint64_t count = 0;
+    uint64_t error = 0;
+    Utils::HyperLogLog distinct{kCompanionPrecision};
+  };
+  std::unordered_map<std::string, Merged> merged;
+
+  // IPs live in exactly one shard, paths in many; summing per key handles
+  // both as well as keys present in both generations
+  for (const auto &shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    for (const Generation *gen : {&shard->current, &shard->previous}) {
+      for (const auto &entry : (gen->*sketch).entries()) {
+        Merged &m = merged[entry.key];
+        m.count += entry.count;
+        m.error += entry.error;
+        m.distinct.merge(entry.payload);
+      }
+    }
+  }
+
+  std::vector<TopTalker> out;
+  out.reserve(merged.size());
+  for (auto &[key, m] : merged)
+    out.push_back(TopTalker{key, m.count, m.error, m.distinct.estimate()});
+
+  n = std::min(n, out.size());
+  std::partial_sort(out.begin(), out.begin() + n, out.end(),
+                    [](const TopTalker &a, const TopTalker &b) {
+                      return a.count > b.count;
+                    });
+  out.resize(n);
+  return out;
+}
+
+double TrafficSketchSet::merge_distinct(
+    Utils::HyperLogLog Generation::*sketch) const {
+  Utils::HyperLogLog merged(kGlobalPrecision);
+  for (const auto &shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    merged.merge(shard->current.*sketch);
+    merged.merge(shard->previous.*sketch);
+  }
+  return merged.estimate();
+}
+
+std::vector<TopTalker> TrafficSketchSet::top_ips(IpMetric metric,
+                                                 size_t n) const {
+  return merge_top(metric == IpMetric::ERRORS ? &Generation::ip_errors
+                                              : &Generation::ip_requests,
+                   n);
+}
+
+std::vector<TopTalker> TrafficSketchSet::top_paths(size_t n) const {
+  return merge_top(&Generation::path_requests, n);
+}
+
+double TrafficSketchSet::distinct_ips() const {
+  return merge_distinct(&Generation::ips);
+}
+
+double TrafficSketchSet::distinct_paths() const {
+  return merge_distinct(&Generation::paths);
+}
+
+void TrafficSketchSet::reconfigure(uint64_t window_ms) {
+  clear();
+  generation_ms_.store(generation_length(window_ms));
+}
+
+void TrafficSketchSet::clear() {
+  for (auto &shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    shard->current.clear();
+    shard->previous.clear();
+    shard->epoch = 0;
+  }
+}
+
+} // namespace analysis
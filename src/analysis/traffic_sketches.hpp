@@ -0,0 +1,87 @@
+#ifndef TRAFFIC_SKETCHES_HPP
+#define TRAFFIC_SKETCHES_HPP
+
+#include "utils/stream_sketches.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace analysis {
+
+struct TopTalker {
+  std::string key;
+  uint64_t count = 0;
+  // Upper bound on how much count overestimates the true value
+  uint64_t error = 0;
+  // Unique paths for an IP, unique IPs for a path
+  double distinct = 0.0;
+};
+
+// Heavy-hitter and distinct-count sketches for the dashboard's top-N views.
+//
+// Each worker writes only to its own shard, so updates never contend; queries
+// lock each shard briefly and merge. Every shard keeps two tumbling
+// generations of half a window each, and queries combine both, so results
+// cover between half and one full analysis window.
+class TrafficSketchSet {
+public:
+  enum class IpMetric { REQUESTS, ERRORS };
+
+  static constexpr size_t kHeavyHitterCapacity = 256;
+  static constexpr uint8_t kCompanionPrecision = 7;
+  static constexpr uint8_t kGlobalPrecision = 12;
+
+  TrafficSketchSet(size_t shard_count, uint64_t window_ms);
+
+  void record(size_t shard, std::string_view ip, std::string_view path,
+              uint64_t timestamp_ms, bool is_error);
+
+  std::vector<TopTalker> top_ips(IpMetric metric, size_t n) const;
+  std::vector<TopTalker> top_paths(size_t n) const;
+  double distinct_ips() const;
+  double distinct_paths() const;
+
+  // Changes the window length; existing sketches are discarded
+  void reconfigure(uint64_t window_ms);
+  void clear();
+
+  size_t shard_count() const { return shards_.size(); }
+
+private:
+  using KeyedSketch = Utils::SpaceSaving<Utils::HyperLogLog>;
+
+  struct Generation {
+    Generation();
+    void clear();
+
+    KeyedSketch ip_requests;
+    KeyedSketch ip_errors;
+    KeyedSketch path_requests;
+    Utils::HyperLogLog ips;
+    Utils::HyperLogLog paths;
+  };
+
+  struct Shard {
+    mutable std::mutex mutex;
+    uint64_t epoch = 0;
+    Generation current;
+    Generation previous;
+  };
+
+  std::vector<TopTalker> merge_top(KeyedSketch Generation::*sketch,
+                                   size_t n) const;
+  double merge_distinct(Utils::HyperLogLog Generation::*sketch) const;
+
+  std::vector<std::unique_ptr<Shard>> shards_;
+  std::atomic<uint64_t> generation_ms_;
+};
+
+} // namespace analysis
+
+#endif // TRAFFIC_SKETCHES_HPP
@@ -0,0 +1,64 @@
+#include "ua_verdict_cache.hpp"
+#include "utils/stream_sketches.hpp"
+
+namespace analysis {
+
+namespace {
+
+constexpr unsigned kVerdictBits = 24;
+constexpr uint64_t kVerdictMask = (uint64_t{1} << kVerdictBits) - 1;
+
+// The high bits of the key, which the slot index does not use for any
+// capacity below 2^24. Never 0, so a filled slot is never empty.
+uint64_t tag_of(uint64_t key) {
+  uint64_t tag = key & ~kVerdictMask;
+  return tag ? tag : uint64_t{1} << kVerdictBits;
+}
+
+uint64_t pack(UaVerdict verdict) {
+  return static_cast<uint64_t>(verdict.flags) |
+         static_cast<uint64_t>(verdict.browser_major) << 8;
+}
+
+UaVerdict unpack(uint64_t packed) {
+  UaVerdict verdict;
+  verdict.flags = static_cast<uint8_t>(packed);
+  verdict.browser_major = static_cast<uint16_t>(packed >> 8);
+  return verdict;
+}
+
+} // namespace
+
+UaVerdictCache::UaVerdictCache(size_t capacity) {
+  size_t rounded = 1;
+  while (rounded < capacity)
+    rounded <<= 1;
+  slots_ = std::make_unique<Slot[]>(rounded);
+  mask_ = rounded - 1;
+}
+
+uint64_t UaVerdictCache::key_for(std::string_view ua, uint64_t config_seed) {
+  return Utils::sketch_hash(ua) ^ config_seed;
+}
+
+std::optional<UaVerdict> UaVerdictCache::find(uint64_t key) const {
+  uint64_t word = slots_[key & mask_].load(std::memory_order_relaxed);
+  if ((word & ~kVerdictMask) != tag_of(key))
+    return std::nullopt;
+  return unpack(word & kVerdictMask);
+}
+
+void UaVerdictCache::insert(uint64_t key, UaVerdict verdict) {
+  Slot &slot = slots_[key & mask_];
+  const uint64_t word = tag_of(key) | pack(verdict);
+  // Skip the store when the slot already holds it, so hot UAs do not keep
+  // bouncing the cache line between workers
+  if (slot.load(std::memory_order_relaxed) != word)
+    slot.store(word, std::memory_order_relaxed);
+}
+
+size_t UaVerdictCache::memory_footprint() const {
+  return sizeof(*this) + capacity() * sizeof(Slot);
+}
+
+} // namespace analysis
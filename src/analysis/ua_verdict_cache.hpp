@@ -0,0 +1,66 @@
+#ifndef UA_VERDICT_CACHE_HPP
+#define UA_VERDICT_CACHE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string_view>
+
+namespace analysis {
+
+// What the Tier 1 UA checks concluded about one User-Agent string, before
+// any per-IP state is considered
+struct UaVerdict {
+  enum Flag : uint8_t {
+    HEADLESS = 1 << 0,
+    KNOWN_BAD = 1 << 1,
+    OUTDATED = 1 << 2,
+    INCONSISTENT = 1 << 3,
+    // Which browser browser_major refers to
+    CHROME = 1 << 4,
+    FIREFOX = 1 << 5,
+    // Contains one of the suspicious_ua_substrings
+    SUSPICIOUS = 1 << 6
+  };
+
+  uint8_t flags = 0;
+  uint16_t browser_major = 0;
+
+  bool has(Flag flag) const { return flags & flag; }
+};
+
+// Fixed-size, direct-mapped map from UA fingerprint to verdict, shared by all
+// workers. UA strings repeat heavily, so most events skip the classifier.
+//
+// Each slot is one atomic word packing the verdict with a tag taken from the
+// high bits of the key, so a reader gets a tag and verdict written together
+// by one insert and never the verdict of another UA. Readers and writers
+// never block; concurrent writers to a slot just leave the last verdict.
+// Keys mix in a seed derived from the UA settings: after a config reload old
+// verdicts stop matching and are overwritten as new ones arrive.
+class UaVerdictCache {
+public:
+  // Capacity is rounded up to a power of two
+  explicit UaVerdictCache(size_t capacity);
+
+  static uint64_t key_for(std::string_view ua, uint64_t config_seed);
+
+  std::optional<UaVerdict> find(uint64_t key) const;
+  void insert(uint64_t key, UaVerdict verdict);
+
+  size_t capacity() const { return mask_ + 1; }
+  size_t memory_footprint() const;
+
+private:
+  // Tag in the high 40 bits, verdict in the low 24; 0 while empty
+  using Slot = std::atomic<uint64_t>;
+
+  std::unique_ptr<Slot[]> slots_;
+  size_t mask_;
+};
+
+} // namespace analysis
+
+#endif // UA_VERDICT_CACHE_HPP
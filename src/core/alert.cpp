@@ -53,6 +53,19 @@ std::string alert_tier_to_raw_string(AlertTier tier) {
   }
 }
 
+std::string incident_state_to_string(IncidentState state) {
+  switch (state) {
+  case IncidentState::OPENED:
+    return "OPENED";
+  case IncidentState::UPDATED:
+    return "UPDATED";
+  case IncidentState::CLOSED:
+    return "CLOSED";
+  default:
+    return "UNKNOWN_STATE";
+  }
+}
+
 Alert::Alert(std::shared_ptr<const AnalyzedEvent> event,
              std::string_view reason, AlertTier tier, AlertAction action,
              std::string_view action_str, double score, std::string_view key_id)
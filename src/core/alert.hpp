@@ -6,6 +6,7 @@
 #include <cstdint>
 #include <memory>
 #include <string>
+#include <vector>
 
 // Enum class for type-safe alert items
 enum class AlertTier {
@@ -28,6 +29,24 @@ std::string alert_action_to_string(AlertAction action);
 std::string alert_tier_to_string_representation(AlertTier tier);
 std::string alert_tier_to_raw_string(AlertTier tier);
 
+enum class IncidentState { OPENED, UPDATED, CLOSED };
+
+std::string incident_state_to_string(IncidentState state);
+
+// Rolling view of the alerts one rule raised for one source, attached to the
+// notifications IncidentAggregator emits in their place
+struct IncidentSummary {
+  uint64_t incident_id = 0;
+  IncidentState state = IncidentState::OPENED;
+  // Event time of the first and latest alert merged into the incident
+  uint64_t first_seen_ms = 0;
+  uint64_t last_seen_ms = 0;
+  uint64_t alert_count = 0;
+  double max_score = 0.0;
+  // Events of the first alerts, kept for forensics
+  std::vector<std::shared_ptr<const AnalyzedEvent>> sample_events;
+};
+
 struct Alert {
   std::shared_ptr<const AnalyzedEvent> event_context;
   uint64_t event_timestamp_ms;
@@ -43,6 +62,12 @@ struct Alert {
   uint64_t associated_log_line;
   std::string raw_log_trigger_sample;
   std::string ml_feature_contribution;
+  // Identity of the rule that raised the alert, for throttling; 0 when the
+  // reason is the only identity
+  uint64_t rule_id = 0;
+  // Set on incident notifications; the rest of the alert is the incident's
+  // highest scoring one
+  std::shared_ptr<const IncidentSummary> incident;
 
   Alert(std::shared_ptr<const AnalyzedEvent> event, std::string_view reason,
         AlertTier tier, AlertAction action, std::string_view action_str,
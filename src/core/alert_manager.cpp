@@ -6,6 +6,8 @@
 #include "io/alert_dispatch/syslog_dispatcher.hpp"
 #include "prometheus_metrics_exporter.hpp"
 
+#include <algorithm>
+#include <chrono>
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
@@ -14,6 +16,18 @@
 #include <memory>
 #include <optional>
 #include <string>
+#include <vector>
+
+namespace {
+
+uint64_t steady_now_ms() {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+}
+
+} // namespace
 
 AlertManager::AlertManager() : output_alerts_to_stdout(true) {
   std::cout << "AlertManager created" << std::endl;
@@ -34,8 +48,15 @@ void AlertManager::initialize(const Config::AppConfig &app_config) {
 
 void AlertManager::reconfigure(const Config::AppConfig &new_config) {
   output_alerts_to_stdout = new_config.alerts_to_stdout;
-  throttle_duration_ms_ = new_config.alert_throttle_duration_seconds * 1000;
-  alert_throttle_max_intervening_alerts_ = new_config.alert_throttle_max_alerts;
+  throttle_.configure(new_config.alert_throttle_duration_seconds * 1000,
+                      new_config.alert_throttle_max_alerts,
+                      new_config.alert_throttle_max_entries);
+  incidents_.configure(new_config.incident_idle_timeout_seconds * 1000,
+                       new_config.incident_sample_events,
+                       new_config.incident_max_open);
+  incident_flush_interval_ms_ =
+      std::max<uint64_t>(1, new_config.incident_flush_interval_seconds) * 1000;
+  incidents_enabled_ = new_config.incidents_enabled;
 
   dispatchers_.clear();
   const auto &alert_cfg = new_config.alerting;
@@ -66,79 +87,59 @@ void AlertManager::reconfigure(const Config::AppConfig &new_config) {
 void AlertManager::record_alert(const Alert &new_alert) {
   alerts_processed_++;
 
-  if (throttle_duration_ms_ > 0) {
-    std::string throttle_key =
-        new_alert.source_ip + ":" + new_alert.alert_reason;
-    auto it = recent_alert_timestamps_.find(throttle_key);
-
-    if (it != recent_alert_timestamps_.end()) {
-      auto &throttle_info = it->second;
-      uint64_t last_alert_time = throttle_info.first;
-      size_t last_alert_global_count = throttle_info.second;
-
-      size_t intervening_alerts =
-          total_alerts_recorded_ - last_alert_global_count;
-
-      bool is_in_time_window = new_alert.event_timestamp_ms <
-                               (last_alert_time + throttle_duration_ms_);
-      bool has_exceeded_intervening_limit =
-          (alert_throttle_max_intervening_alerts_ > 0) &&
-          (intervening_alerts >= alert_throttle_max_intervening_alerts_);
-
-      if (is_in_time_window && !has_exceeded_intervening_limit) {
-        // Track throttled alerts
-        alerts_throttled_++;
-
-        // Update metrics
-        if (metrics_exporter_) {
-          // Track throttled alerts with reason
-          std::string throttle_reason = is_in_time_window ? "time_window" : "intervening_limit";
-          metrics_exporter_->increment_counter("ad_alerts_throttled_total", 
-                                              {{"reason", throttle_reason}});
-
-          // Track suppressed alerts by tier
-          std::string tier_str;
-          switch (new_alert.detection_tier) {
-          case AlertTier::TIER1_HEURISTIC:
-            tier_str = "tier1";
-            break;
-          case AlertTier::TIER2_STATISTICAL:
-            tier_str = "tier2";
-            break;
-          case AlertTier::TIER3_ML:
-            tier_str = "tier3";
-            break;
-          default:
-            tier_str = "unknown";
-          }
-          
-          metrics_exporter_->increment_counter("ad_alerts_suppressed_total", 
-                                              {{"reason", throttle_reason}, 
-                                               {"tier", tier_str}});
-
-          // Update throttling ratio
-          double throttle_ratio =
-              static_cast<double>(alerts_throttled_.load()) /
-              static_cast<double>(alerts_processed_.load());
-          metrics_exporter_->set_gauge("ad_alert_throttling_ratio",
-                                       throttle_ratio);
-                                       
-          // Update suppression ratio by tier
-          // We need to calculate this based on tier-specific counts
-          // For now, we'll use the overall ratio as an approximation
-          metrics_exporter_->set_gauge("ad_alert_suppression_ratio_by_tier",
-                                      throttle_ratio,
-                                      {{"tier", tier_str}});
-        }
-
-        return; // Suppress the alert
+  uint64_t rule_id = new_alert.rule_id != 0
+                         ? new_alert.rule_id
+                         : AlertThrottle::name_id(new_alert.alert_reason);
+  const uint64_t key = AlertThrottle::key(new_alert.source_ip, rule_id);
+  // Repeats are what incidents count, so they are never throttled away.
+  // Alerts the aggregator has no room for are throttled and sent as usual.
+  const bool coalesce = incidents_enabled_.load() &&
+                        incidents_.record(key, new_alert, steady_now_ms());
+  if (!coalesce && throttle_.throttle(key, new_alert.event_timestamp_ms)) {
+    // Track throttled alerts
+    alerts_throttled_++;
+
+    // Update metrics
+    if (metrics_exporter_) {
+      // Only alerts inside the time window are throttled
+      std::string throttle_reason = "time_window";
+      metrics_exporter_->increment_counter("ad_alerts_throttled_total",
+                                           {{"reason", throttle_reason}});
+
+      // Track suppressed alerts by tier
+      std::string tier_str;
+      switch (new_alert.detection_tier) {
+      case AlertTier::TIER1_HEURISTIC:
+        tier_str = "tier1";
+        break;
+      case AlertTier::TIER2_STATISTICAL:
+        tier_str = "tier2";
+        break;
+      case AlertTier::TIER3_ML:
+        tier_str = "tier3";
+        break;
+      default:
+        tier_str = "unknown";
       }
+
+      metrics_exporter_->increment_counter(
+          "ad_alerts_suppressed_total",
+          {{"reason", throttle_reason}, {"tier", tier_str}});
+
+      // Update throttling ratio
+      double throttle_ratio = static_cast<double>(alerts_throttled_.load()) /
+                              static_cast<double>(alerts_processed_.load());
+      metrics_exporter_->set_gauge("ad_alert_throttling_ratio",
+                                   throttle_ratio);
+
+      // Update suppression ratio by tier
+      // We need to calculate this based on tier-specific counts
+      // For now, we'll use the overall ratio as an approximation
+      metrics_exporter_->set_gauge("ad_alert_suppression_ratio_by_tier",
+                                   throttle_ratio, {{"tier", tier_str}});
     }
 
-    // If we are here, the alert will be recorded
-    total_alerts_recorded_++;
-    recent_alert_timestamps_[throttle_key] = {new_alert.event_timestamp_ms,
-                                              total_alerts_recorded_};
+    return; // Suppress the alert
   }
 
   {
@@ -196,6 +197,10 @@ void AlertManager::record_alert(const Alert &new_alert) {
         "ad_alerts_total", {{"tier", tier_str}, {"action", action_str}});
   }
 
+  // Dispatched as incident notifications by the dispatcher thread
+  if (coalesce)
+    return;
+
   alert_queue_.push(new_alert);
 
   // Update queue size metric
@@ -253,6 +258,17 @@ AlertManager::format_alert_to_human_readable(const Alert &alert_data) const {
   formatted_alert += "  Source IP: " + alert_data.source_ip + "\n";
   formatted_alert += "  Reason:    " + alert_data.alert_reason + "\n";
 
+  if (alert_data.incident) {
+    const IncidentSummary &incident = *alert_data.incident;
+    formatted_alert += "  Incident:  #" + std::to_string(incident.incident_id) +
+                       " " + incident_state_to_string(incident.state) + ", " +
+                       std::to_string(incident.alert_count) + " alerts over " +
+                       std::to_string((incident.last_seen_ms -
+                                       incident.first_seen_ms) /
+                                      1000) +
+                       "s\n";
+  }
+
   if (!alert_data.offending_key_identifier.empty() &&
       alert_data.offending_key_identifier != alert_data.source_ip)
     formatted_alert +=
@@ -284,112 +300,146 @@ AlertManager::format_alert_to_human_readable(const Alert &alert_data) const {
 }
 
 void AlertManager::dispatcher_loop() {
+  auto next_flush = std::chrono::steady_clock::now();
   while (!shutdown_flag_) {
-    std::optional<Alert> alert_opt = alert_queue_.wait_and_pop();
+    auto now = std::chrono::steady_clock::now();
+    if (now >= next_flush) {
+      dispatch_incidents(false);
+      next_flush =
+          now + std::chrono::milliseconds(incident_flush_interval_ms_.load());
+    }
+
+    // Wakes up for the next incident flush even if no alert arrives
+    std::optional<Alert> alert_opt = alert_queue_.wait_and_pop_for(
+        std::chrono::duration_cast<std::chrono::milliseconds>(next_flush -
+                                                              now));
 
     if (!alert_opt) {
-      if (shutdown_flag_)
+      if (shutdown_flag_ || alert_queue_.is_shutdown())
         break;
       continue;
     }
 
-    const Alert &alert_to_dispatch = *alert_opt;
+    dispatch_alert(*alert_opt);
 
-    if (output_alerts_to_stdout)
-      std::cout << format_alert_to_human_readable(alert_to_dispatch)
-                << std::endl;
+    // Update queue size metric after processing
+    if (metrics_exporter_) {
+      metrics_exporter_->set_gauge("ad_alert_queue_size",
+                                   static_cast<double>(alert_queue_.size()));
+    }
+  }
 
-    for (const auto &dispatcher : dispatchers_) {
-      if (dispatcher) {
-        std::string dispatcher_type = dispatcher->get_dispatcher_type();
+  // No incident is left without its CLOSED notification
+  dispatch_incidents(true);
+}
 
-        // Track dispatch attempt
-        if (metrics_exporter_) {
-          metrics_exporter_->increment_counter(
-              "ad_alert_dispatch_attempts_total",
-              {{"dispatcher_type", dispatcher_type}});
-        }
+void AlertManager::dispatch_incidents(bool close_all) {
+  std::vector<Alert> notifications =
+      close_all ? incidents_.close_all() : incidents_.flush(steady_now_ms());
 
-        // Get tier string for metrics
-        std::string tier_str;
-        switch (alert_to_dispatch.detection_tier) {
-        case AlertTier::TIER1_HEURISTIC:
-          tier_str = "tier1";
-          break;
-        case AlertTier::TIER2_STATISTICAL:
-          tier_str = "tier2";
-          break;
-        case AlertTier::TIER3_ML:
-          tier_str = "tier3";
-          break;
-        default:
-          tier_str = "unknown";
-        }
+  for (const Alert &notification : notifications) {
+    if (metrics_exporter_)
+      metrics_exporter_->increment_counter(
+          "ad_incident_notifications_total",
+          {{"state", incident_state_to_string(notification.incident->state)}});
+    dispatch_alert(notification);
+  }
 
-        // Measure dispatch latency
-        auto start_time = std::chrono::high_resolution_clock::now();
-        bool success = dispatcher->dispatch(alert_to_dispatch);
-        auto end_time = std::chrono::high_resolution_clock::now();
-        
-        // Calculate latency in seconds
-        double latency_seconds = std::chrono::duration<double>(end_time - start_time).count();
-
-        // Track dispatch success/failure
-        if (metrics_exporter_) {
-          if (success) {
-            metrics_exporter_->increment_counter(
-                "ad_alert_dispatch_success_total",
-                {{"dispatcher_type", dispatcher_type}, {"tier", tier_str}});
-            dispatcher_success_counts_[dispatcher_type]++;
-            
-            // Track dispatch latency on success
-            metrics_exporter_->observe_histogram(
-                "ad_alert_dispatch_latency_seconds",
-                latency_seconds,
-                {{"dispatcher_type", dispatcher_type}});
-          } else {
-            // Determine error type based on dispatcher type
-            std::string error_type = "unknown";
-            if (dispatcher_type == "http") {
-              error_type = "network_error"; // Default error type for HTTP
-            } else if (dispatcher_type == "file") {
-              error_type = "file_write_error"; // Default error type for file
-            } else if (dispatcher_type == "syslog") {
-              error_type = "syslog_error"; // Default error type for syslog
-            }
-            
-            metrics_exporter_->increment_counter(
-                "ad_alert_dispatch_failure_total",
-                {{"dispatcher_type", dispatcher_type}, {"error_type", error_type}});
-            dispatcher_failure_counts_[dispatcher_type]++;
-          }
+  if (metrics_exporter_)
+    metrics_exporter_->set_gauge("ad_open_incidents",
+                                 static_cast<double>(incidents_.open_count()));
+}
 
-          // Calculate and update success rate
-          size_t success_count =
-              dispatcher_success_counts_[dispatcher_type].load();
-          size_t failure_count =
-              dispatcher_failure_counts_[dispatcher_type].load();
-          size_t total_count = success_count + failure_count;
-
-          double success_rate = (total_count > 0)
-                                    ? static_cast<double>(success_count) /
-                                          static_cast<double>(total_count)
-                                    : 1.0;
-
-          metrics_exporter_->set_gauge("ad_alert_dispatch_success_rate",
-                                       success_rate,
-                                       {{"dispatcher_type", dispatcher_type}});
-        }
+void AlertManager::dispatch_alert(const Alert &alert_to_dispatch) {
+  if (output_alerts_to_stdout)
+    std::cout << format_alert_to_human_readable(alert_to_dispatch)
+              << std::endl;
+
+  for (const auto &dispatcher : dispatchers_) {
+    if (dispatcher) {
+      std::string dispatcher_type = dispatcher->get_dispatcher_type();
+
+      // Track dispatch attempt
+      if (metrics_exporter_) {
+        metrics_exporter_->increment_counter(
+            "ad_alert_dispatch_attempts_total",
+            {{"dispatcher_type", dispatcher_type}});
       }
-    }
 
-    // Update queue size metric after processing
-    if (metrics_exporter_) {
-      metrics_exporter_->set_gauge("ad_alert_queue_size",
-                                   static_cast<double>(alert_queue_.size()));
+      // Get tier string for metrics
+      std::string tier_str;
+      switch (alert_to_dispatch.detection_tier) {
+      case AlertTier::TIER1_HEURISTIC:
+        tier_str = "tier1";
+        break;
+      case AlertTier::TIER2_STATISTICAL:
+        tier_str = "tier2";
+        break;
+      case AlertTier::TIER3_ML:
+        tier_str = "tier3";
+        break;
+      default:
+        tier_str = "unknown";
+      }
+
+      // Measure dispatch latency
+      auto start_time = std::chrono::high_resolution_clock::now();
+      bool success = dispatcher->dispatch(alert_to_dispatch);
+      auto end_time = std::chrono::high_resolution_clock::now();
+      
+      // Calculate latency in seconds
+      double latency_seconds = std::chrono::duration<double>(end_time - start_time).count();
+
+      // Track dispatch success/failure
+      if (metrics_exporter_) {
+        if (success) {
+          metrics_exporter_->increment_counter(
+              "ad_alert_dispatch_success_total",
+              {{"dispatcher_type", dispatcher_type}, {"tier", tier_str}});
+          dispatcher_success_counts_[dispatcher_type]++;
+          
+          // Track dispatch latency on success
+          metrics_exporter_->observe_histogram(
+              "ad_alert_dispatch_latency_seconds",
+              latency_seconds,
+              {{"dispatcher_type", dispatcher_type}});
+        } else {
+          // Determine error type based on dispatcher type
+          std::string error_type = "unknown";
+          if (dispatcher_type == "http") {
+            error_type = "network_error"; // Default error type for HTTP
+          } else if (dispatcher_type == "file") {
+            error_type = "file_write_error"; // Default error type for file
+          } else if (dispatcher_type == "syslog") {
+            error_type = "syslog_error"; // Default error type for syslog
+          }
+          
+          metrics_exporter_->increment_counter(
+              "ad_alert_dispatch_failure_total",
+              {{"dispatcher_type", dispatcher_type}, {"error_type", error_type}});
+          dispatcher_failure_counts_[dispatcher_type]++;
+        }
+
+        // Calculate and update success rate
+        size_t success_count =
+            dispatcher_success_counts_[dispatcher_type].load();
+        size_t failure_count =
+            dispatcher_failure_counts_[dispatcher_type].load();
+        size_t total_count = success_count + failure_count;
+
+        double success_rate = (total_count > 0)
+                                  ? static_cast<double>(success_count) /
+                                        static_cast<double>(total_count)
+                                  : 1.0;
+
+        metrics_exporter_->set_gauge("ad_alert_dispatch_success_rate",
+                                     success_rate,
+                                     {{"dispatcher_type", dispatcher_type}});
+      }
     }
   }
 }
+
 void AlertManager::set_metrics_exporter(
     std::shared_ptr<prometheus::PrometheusMetricsExporter> exporter) {
   metrics_exporter_ = exporter;
@@ -458,4 +508,12 @@ void AlertManager::register_alert_manager_metrics() {
 
   metrics_exporter_->register_gauge(
       "ad_recent_alerts_count", "Number of alerts in the recent alerts cache");
+
+  // Register incident aggregation metrics
+  metrics_exporter_->register_counter(
+      "ad_incident_notifications_total",
+      "Total number of incident notifications dispatched", {"state"});
+
+  metrics_exporter_->register_gauge("ad_open_incidents",
+                                    "Number of incidents currently open");
 }
\ No newline at end of file
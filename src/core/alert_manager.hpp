@@ -1,7 +1,9 @@
 #ifndef ALERT_MANAGER_HPP
 #define ALERT_MANAGER_HPP
 
+#include "alert_throttle.hpp"
 #include "config.hpp"
+#include "incident_aggregator.hpp"
 #include "io/alert_dispatch/base_dispatcher.hpp"
 #include "utils/thread_safe_queue.hpp"
 
@@ -40,6 +42,9 @@ public:
 
 private:
   void dispatcher_loop();
+  void dispatch_alert(const Alert &alert_to_dispatch);
+  // Dispatches the due incident notifications, or closes every incident
+  void dispatch_incidents(bool close_all);
   std::string format_alert_to_human_readable(const Alert &alert_data) const;
   void register_alert_manager_metrics();
 
@@ -51,14 +56,16 @@ private:
   std::atomic<bool> shutdown_flag_{false};
 
   bool output_alerts_to_stdout;
-  uint64_t throttle_duration_ms_ = 0;
-  size_t alert_throttle_max_intervening_alerts_ = 0;
-  size_t total_alerts_recorded_ = 0;
   std::atomic<size_t> alerts_throttled_{0};
   std::atomic<size_t> alerts_processed_{0};
 
-  std::unordered_map<std::string, std::pair<uint64_t, size_t>>
-      recent_alert_timestamps_;
+  // Keyed by (source IP, rule); shared by every worker's RuleEngine
+  AlertThrottle throttle_;
+
+  // Replaces the throttle and per-alert dispatch while enabled
+  IncidentAggregator incidents_;
+  std::atomic<bool> incidents_enabled_{false};
+  std::atomic<uint64_t> incident_flush_interval_ms_{10000};
 
   // Metrics tracking
   std::unordered_map<std::string, std::atomic<size_t>>
@@ -0,0 +1,123 @@
+#include "alert_throttle.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <vector>
+
+namespace {
+
+uint64_t mix(uint64_t hash) {
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ULL;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+uint64_t fnv1a(std::string_view value) {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (unsigned char c : value) {
+    hash ^= c;
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+} // namespace
+
+void AlertThrottle::configure(uint64_t duration_ms, size_t max_intervening,
+                              size_t max_entries) {
+  duration_ms_.store(duration_ms, std::memory_order_relaxed);
+  max_intervening_.store(max_intervening, std::memory_order_relaxed);
+  shard_capacity_.store(std::max<size_t>(1, max_entries / kShardCount),
+                        std::memory_order_relaxed);
+}
+
+uint64_t AlertThrottle::key(std::string_view source, uint64_t rule_id) {
+  return mix(fnv1a(source) ^ (rule_id * 0x9e3779b97f4a7c15ULL));
+}
+
+uint64_t AlertThrottle::name_id(std::string_view name) {
+  return mix(fnv1a(name));
+}
+
+bool AlertThrottle::throttle(uint64_t key, uint64_t timestamp_ms) {
+  const uint64_t duration_ms = duration_ms_.load(std::memory_order_relaxed);
+  if (duration_ms == 0)
+    return false;
+  const size_t max_intervening =
+      max_intervening_.load(std::memory_order_relaxed);
+
+  Shard &shard = shards_[key >> (64 - kShardBits)];
+  std::lock_guard<std::mutex> lock(shard.mutex);
+
+  auto it = shard.entries.find(key);
+  if (it != shard.entries.end()) {
+    const Entry &entry = it->second;
+    uint64_t intervening =
+        recorded_.load(std::memory_order_relaxed) - entry.recorded_at;
+    bool in_time_window = timestamp_ms < entry.last_ms + duration_ms;
+    bool exceeded_intervening_limit =
+        max_intervening > 0 && intervening >= max_intervening;
+    if (in_time_window && !exceeded_intervening_limit)
+      return true;
+  } else {
+    const size_t capacity = shard_capacity_.load(std::memory_order_relaxed);
+    if (shard.entries.size() >= capacity)
+      make_room(shard, timestamp_ms, duration_ms, capacity);
+  }
+
+  uint64_t recorded = recorded_.fetch_add(1, std::memory_order_relaxed) + 1;
+  shard.entries[key] = {timestamp_ms, recorded};
+  return false;
+}
+
+void AlertThrottle::make_room(Shard &shard, uint64_t now_ms,
+                              uint64_t duration_ms, size_t capacity) {
+  // Entries outside their window or past the intervening limit can no
+  // longer suppress anything, so dropping them changes no decision
+  const uint64_t recorded = recorded_.load(std::memory_order_relaxed);
+  const size_t max_intervening =
+      max_intervening_.load(std::memory_order_relaxed);
+  for (auto it = shard.entries.begin(); it != shard.entries.end();) {
+    const Entry &entry = it->second;
+    bool expired = now_ms >= entry.last_ms + duration_ms ||
+                   (max_intervening > 0 &&
+                    recorded - entry.recorded_at >= max_intervening);
+    it = expired ? shard.entries.erase(it) : std::next(it);
+  }
+  const size_t target = capacity - std::max<size_t>(1, capacity / 4);
+  if (shard.entries.size() <= target)
+    return;
+
+  // Still close to the memory cap with live entries: forget the oldest
+  // until the shard is back to three quarters, so a full scan is paid at
+  // most once per capacity / 4 insertions
+  std::vector<uint64_t> times;
+  times.reserve(shard.entries.size());
+  for (const auto &[key, entry] : shard.entries)
+    times.push_back(entry.last_ms);
+  auto cutoff = times.begin() + (shard.entries.size() - target - 1);
+  std::nth_element(times.begin(), cutoff, times.end());
+  const uint64_t newest_dropped = *cutoff;
+  for (auto it = shard.entries.begin(); it != shard.entries.end();)
+    it = it->second.last_ms <= newest_dropped ? shard.entries.erase(it)
+                                              : std::next(it);
+}
+
+size_t AlertThrottle::size() const {
+  size_t total = 0;
+  for (const Shard &shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    total += shard.entries.size();
+  }
+  return total;
+}
+
+void AlertThrottle::clear() {
+  for (Shard &shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.entries.clear();
+  }
+}
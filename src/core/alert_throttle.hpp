@@ -0,0 +1,70 @@
+#ifndef ALERT_THROTTLE_HPP
+#define ALERT_THROTTLE_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+
+// Remembers the last recorded alert per (source, rule) so repeats can be
+// suppressed. An alert is throttled if one with the same key was recorded
+// less than duration_ms earlier (by event time), unless at least
+// max_intervening other alerts have been recorded since; 0 disables the
+// intervening limit.
+//
+// Keys are 64-bit hashes spread over independently locked shards, so
+// workers raising alerts for different sources rarely contend. Entries
+// that can no longer throttle anything are dropped when their shard fills
+// up, and a shard never holds more than its share of max_entries: if it is
+// still nearly full of live entries, the oldest are evicted until it is
+// back to three quarters.
+class AlertThrottle {
+public:
+  AlertThrottle() = default;
+
+  void configure(uint64_t duration_ms, size_t max_intervening,
+                 size_t max_entries);
+
+  // Key of the alerts raised by rule_id for source
+  static uint64_t key(std::string_view source, uint64_t rule_id);
+  // Identity of a rule known by name, or only by its alert reason
+  static uint64_t name_id(std::string_view name);
+
+  // Returns true if the alert should be suppressed; otherwise records it
+  // and returns false. Always false while duration_ms is 0.
+  bool throttle(uint64_t key, uint64_t timestamp_ms);
+
+  size_t size() const;
+  void clear();
+
+private:
+  static constexpr size_t kShardBits = 6;
+  static constexpr size_t kShardCount = size_t{1} << kShardBits;
+
+  struct Entry {
+    uint64_t last_ms;
+    // Value of recorded_ when the entry was last recorded
+    uint64_t recorded_at;
+  };
+
+  struct alignas(64) Shard {
+    mutable std::mutex mutex;
+    std::unordered_map<uint64_t, Entry> entries;
+  };
+
+  // Makes room for one entry in a full shard
+  void make_room(Shard &shard, uint64_t now_ms, uint64_t duration_ms,
+                 size_t capacity);
+
+  std::atomic<uint64_t> duration_ms_{0};
+  std::atomic<size_t> max_intervening_{0};
+  std::atomic<size_t> shard_capacity_{1};
+  // Alerts that passed the throttle, across all shards
+  std::atomic<uint64_t> recorded_{0};
+  std::array<Shard, kShardCount> shards_;
+};
+
+#endif // ALERT_THROTTLE_HPP
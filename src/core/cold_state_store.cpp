@@ -0,0 +1,172 @@
+#include "cold_state_store.hpp"
+#include "core/logger.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <utility>
+
+namespace memory {
+
+ColdStateStore::ColdStateStore(std::string file_path, size_t max_file_bytes,
+                               size_t initial_capacity_bytes)
+    : file_path_(std::move(file_path)), max_file_bytes_(max_file_bytes) {
+  fd_ = ::open(file_path_.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+  if (fd_ < 0) {
+    LOG(LogLevel::ERROR, LogComponent::STATE_PRUNE,
+        "Failed to open cold state file " << file_path_ << ": "
+                                          << std::strerror(errno));
+    return;
+  }
+  remap(std::min(initial_capacity_bytes, max_file_bytes_));
+}
+
+ColdStateStore::~ColdStateStore() {
+  unmap();
+  if (fd_ >= 0) {
+    ::close(fd_);
+    ::unlink(file_path_.c_str());
+  }
+}
+
+void ColdStateStore::unmap() {
+  if (base_) {
+    ::munmap(base_, capacity_);
+    base_ = nullptr;
+  }
+}
+
+bool ColdStateStore::remap(size_t new_capacity) {
+  // Map the grown file before dropping the old mapping so that a failure
+  // leaves the existing entries readable
+  if (new_capacity == 0 ||
+      ::ftruncate(fd_, static_cast<off_t>(new_capacity)) != 0)
+    return false;
+
+  void *addr = ::mmap(nullptr, new_capacity, PROT_READ | PROT_WRITE,
+                      MAP_SHARED, fd_, 0);
+  if (addr == MAP_FAILED) {
+    LOG(LogLevel::ERROR, LogComponent::STATE_PRUNE,
+        "Failed to map cold state file " << file_path_ << ": "
+                                         << std::strerror(errno));
+    return false;
+  }
+  unmap();
+  base_ = static_cast<uint8_t *>(addr);
+  capacity_ = new_capacity;
+  return true;
+}
+
+bool ColdStateStore::ensure_capacity(size_t needed_bytes) {
+  if (write_offset_ + needed_bytes <= capacity_)
+    return true;
+
+  // Reclaim dead space first if at least half the file is garbage
+  if (write_offset_ - live_bytes_ >= write_offset_ / 2)
+    compact();
+  if (write_offset_ + needed_bytes <= capacity_)
+    return true;
+
+  size_t required = write_offset_ + needed_bytes;
+  if (required > max_file_bytes_)
+    return false;
+
+  size_t new_capacity = std::max(capacity_ * 2, required);
+  new_capacity = std::min(new_capacity, max_file_bytes_);
+  return remap(new_capacity);
+}
+
+bool ColdStateStore::put(const std::string &key,
+                         const std::vector<uint8_t> &blob,
+                         uint64_t last_seen_ms) {
+  if (!is_open() || blob.size() > UINT32_MAX)
+    return false;
+
+  auto existing = index_.find(key);
+  if (existing != index_.end()) {
+    live_bytes_ -= existing->second.length;
+    index_.erase(existing);
+  }
+
+  if (!ensure_capacity(blob.size()))
+    return false;
+
+  std::memcpy(base_ + write_offset_, blob.data(), blob.size());
+  index_.emplace(key, Slot{write_offset_, static_cast<uint32_t>(blob.size()),
+                           last_seen_ms});
+  write_offset_ += blob.size();
+  live_bytes_ += blob.size();
+  return true;
+}
+
+std::optional<std::vector<uint8_t>>
+ColdStateStore::take(const std::string &key) {
+  auto it = index_.find(key);
+  if (it == index_.end())
+    return std::nullopt;
+
+  const Slot &slot = it->second;
+  std::vector<uint8_t> blob(base_ + slot.offset,
+                            base_ + slot.offset + slot.length);
+  live_bytes_ -= slot.length;
+  index_.erase(it);
+  return blob;
+}
+
+size_t ColdStateStore::expire_older_than(uint64_t cutoff_ms) {
+  size_t dropped = 0;
+  for (auto it = index_.begin(); it != index_.end();) {
+    if (it->second.last_seen_ms < cutoff_ms) {
+      live_bytes_ -= it->second.length;
+      it = index_.erase(it);
+      ++dropped;
+    } else {
+      ++it;
+    }
+  }
+  return dropped;
+}
+
+size_t ColdStateStore::compact() {
+  if (!is_open() || live_bytes_ == write_offset_)
+    return 0;
+
+  std::vector<Slot *> live;
+  live.reserve(index_.size());
+  for (auto &[key, slot] : index_)
+    live.push_back(&slot);
+  std::sort(live.begin(), live.end(), [](const Slot *a, const Slot *b) {
+    return a->offset < b->offset;
+  });
+
+  // Records only ever move towards the start, so a forward pass is safe
+  size_t cursor = 0;
+  for (Slot *slot : live) {
+    if (slot->offset != cursor)
+      std::memmove(base_ + cursor, base_ + slot->offset, slot->length);
+    slot->offset = cursor;
+    cursor += slot->length;
+  }
+
+  size_t reclaimed = write_offset_ - cursor;
+  write_offset_ = cursor;
+  return reclaimed;
+}
+
+void ColdStateStore::clear() {
+  index_.clear();
+  write_offset_ = 0;
+  live_bytes_ = 0;
+}
+
+size_t ColdStateStore::index_memory_bytes() const {
+  size_t total = index_.bucket_count() * sizeof(void *);
+  for (const auto &[key, slot] : index_)
+    total += sizeof(key) + key.capacity() + sizeof(slot);
+  return total;
+}
+
+} // namespace memory
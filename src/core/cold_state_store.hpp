@@ -0,0 +1,96 @@
+#ifndef COLD_STATE_STORE_HPP
+#define COLD_STATE_STORE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace memory {
+
+// Append-only, mmap-backed spill file for serialized state objects.
+//
+// Only the key index lives in RAM; payloads live in the mapped file and are
+// paged in by the kernel when an entry is rehydrated. The file is scratch
+// space for the current process and is truncated on open, it is not a
+// persistence format. Not thread-safe: each owner (one AnalysisEngine per
+// worker) keeps its own store.
+class ColdStateStore {
+public:
+  ColdStateStore(std::string file_path, size_t max_file_bytes,
+                 size_t initial_capacity_bytes = 16 * 1024 * 1024);
+  ~ColdStateStore();
+
+  ColdStateStore(const ColdStateStore &) = delete;
+  ColdStateStore &operator=(const ColdStateStore &) = delete;
+
+  bool is_open() const { return base_ != nullptr; }
+
+  // Stores (or replaces) the blob for key. Fails when the file would grow
+  // past max_file_bytes even after compaction.
+  bool put(const std::string &key, const std::vector<uint8_t> &blob,
+           uint64_t last_seen_ms);
+
+  // Removes the entry and returns its payload, if present.
+  std::optional<std::vector<uint8_t>> take(const std::string &key);
+
+  bool contains(const std::string &key) const {
+    return index_.find(key) != index_.end();
+  }
+
+  // Calls fn(payload pointer, payload size) for key without removing it.
+  // Returns false if the key is not stored.
+  template <typename Fn> bool visit(const std::string &key, Fn &&fn) const {
+    auto it = index_.find(key);
+    if (it == index_.end())
+      return false;
+    fn(base_ + it->second.offset, static_cast<size_t>(it->second.length));
+    return true;
+  }
+
+  // Drops entries last seen before cutoff_ms. Returns the number dropped.
+  size_t expire_older_than(uint64_t cutoff_ms);
+
+  // Slides live records down over dead space. Returns bytes reclaimed.
+  size_t compact();
+
+  void clear();
+
+  // Visits every live entry as (key, payload pointer, payload size). The
+  // pointers are only valid until the next mutating call.
+  template <typename Fn> void for_each(Fn &&fn) const {
+    for (const auto &[key, slot] : index_)
+      fn(key, base_ + slot.offset, static_cast<size_t>(slot.length));
+  }
+
+  size_t entry_count() const { return index_.size(); }
+  size_t live_bytes() const { return live_bytes_; }
+  size_t file_bytes() const { return write_offset_; }
+  size_t index_memory_bytes() const;
+
+private:
+  struct Slot {
+    uint64_t offset;
+    uint32_t length;
+    uint64_t last_seen_ms;
+  };
+
+  bool remap(size_t new_capacity);
+  bool ensure_capacity(size_t needed_bytes);
+  void unmap();
+
+  std::string file_path_;
+  size_t max_file_bytes_;
+  int fd_ = -1;
+  uint8_t *base_ = nullptr;
+  size_t capacity_ = 0;
+  size_t write_offset_ = 0;
+  size_t live_bytes_ = 0;
+  std::unordered_map<std::string, Slot> index_;
+};
+
+} // namespace memory
+
+#endif // COLD_STATE_STORE_HPP
@@ -1,4 +1,6 @@
 #include "compact_serialization.hpp"
+
+#include <array>
 #include <cassert>
 #include <cstring>
 #include <stdexcept>
@@ -69,6 +71,23 @@ size_t encoded_size_uint32(uint32_t value) {
 
 } // namespace varint
 
+uint32_t crc32(const uint8_t *data, size_t size) {
+  static const auto table = [] {
+    std::array<uint32_t, 256> t{};
+    for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; ++k)
+        c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+      t[i] = c;
+    }
+    return t;
+  }();
+  uint32_t crc = 0xFFFFFFFFu;
+  for (size_t i = 0; i < size; ++i)
+    crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+  return crc ^ 0xFFFFFFFFu;
+}
+
 // StringDictionary implementation
 StringDictionary::StringDictionary() : next_id_(0) {}
 
@@ -431,6 +450,11 @@ void BinarySerializer::write_string_raw(const std::string &str) {
   write_raw_bytes(str.data(), str.size());
 }
 
+void BinarySerializer::write_blob(const uint8_t *data, size_t size) {
+  write_varint64(size);
+  write_raw_bytes(data, size);
+}
+
 void BinarySerializer::write_timestamp(
     std::chrono::steady_clock::time_point timestamp) {
   auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
@@ -565,6 +589,14 @@ std::string BinaryDeserializer::read_string() {
   }
 }
 
+std::pair<const uint8_t *, size_t> BinaryDeserializer::read_blob() {
+  uint64_t blob_size = read_varint64();
+  check_bounds(blob_size);
+  const uint8_t *blob = data_ + position_;
+  position_ += blob_size;
+  return {blob, static_cast<size_t>(blob_size)};
+}
+
 std::string BinaryDeserializer::read_string_raw() {
   uint32_t str_size = read_varint32();
   check_bounds(str_size);
@@ -651,6 +683,108 @@ void BinaryDeserializer::check_bounds(size_t bytes_needed) {
 }
 
 // Utility functions
+// TaggedRecordWriter implementation
+void TaggedRecordWriter::write_key(uint32_t tag, WireType type) {
+  body_.write_varint64((static_cast<uint64_t>(tag) << 3) |
+                       static_cast<uint8_t>(type));
+}
+
+void TaggedRecordWriter::write_varint(uint32_t tag, uint64_t value) {
+  write_key(tag, WireType::VARINT);
+  body_.write_varint64(value);
+}
+
+void TaggedRecordWriter::write_signed(uint32_t tag, int64_t value) {
+  write_varint(tag, varint::zigzag_encode(value));
+}
+
+void TaggedRecordWriter::write_double(uint32_t tag, double value) {
+  write_key(tag, WireType::FIXED64);
+  body_.write_double(value);
+}
+
+void TaggedRecordWriter::write_string(uint32_t tag, const std::string &value) {
+  write_bytes(tag, reinterpret_cast<const uint8_t *>(value.data()),
+              value.size());
+}
+
+void TaggedRecordWriter::write_bytes(uint32_t tag, const uint8_t *data,
+                                     size_t size) {
+  write_key(tag, WireType::BYTES);
+  body_.write_blob(data, size);
+}
+
+void TaggedRecordWriter::finish(BinarySerializer &out) {
+  out.write_blob(body_.data().data(), body_.size());
+  out.write_uint32(crc32(body_.data().data(), body_.size()));
+  body_.clear();
+}
+
+// TaggedRecordReader implementation
+TaggedRecordReader::TaggedRecordReader(BinaryDeserializer &in) {
+  auto [body, size] = in.read_blob();
+  if (in.read_uint32() != crc32(body, size))
+    throw std::runtime_error("Record checksum mismatch");
+  body_ = std::make_unique<BinaryDeserializer>(body, size);
+}
+
+bool TaggedRecordReader::next() {
+  if (!consumed_) {
+    switch (type_) {
+    case WireType::VARINT:
+      body_->read_varint64();
+      break;
+    case WireType::FIXED64:
+      body_->read_uint64();
+      break;
+    case WireType::BYTES:
+      body_->read_blob();
+      break;
+    }
+  }
+  if (!body_->has_more())
+    return false;
+
+  uint64_t key = body_->read_varint64();
+  if ((key & 7) > static_cast<uint8_t>(WireType::BYTES))
+    throw std::runtime_error("Unknown wire type in record");
+  tag_ = static_cast<uint32_t>(key >> 3);
+  type_ = static_cast<WireType>(key & 7);
+  consumed_ = false;
+  return true;
+}
+
+void TaggedRecordReader::expect(WireType type) {
+  if (consumed_ || type_ != type)
+    throw std::runtime_error("Record field " + std::to_string(tag_) +
+                             " has an unexpected wire type");
+  consumed_ = true;
+}
+
+uint64_t TaggedRecordReader::read_varint() {
+  expect(WireType::VARINT);
+  return body_->read_varint64();
+}
+
+int64_t TaggedRecordReader::read_signed() {
+  return varint::zigzag_decode(read_varint());
+}
+
+double TaggedRecordReader::read_double() {
+  expect(WireType::FIXED64);
+  return body_->read_double();
+}
+
+std::string TaggedRecordReader::read_string() {
+  auto [data, size] = read_bytes();
+  return std::string(reinterpret_cast<const char *>(data), size);
+}
+
+std::pair<const uint8_t *, size_t> TaggedRecordReader::read_bytes() {
+  expect(WireType::BYTES);
+  return body_->read_blob();
+}
+
 namespace serialization_utils {
 
 double compression_ratio(size_t original_size, size_t compressed_size) {
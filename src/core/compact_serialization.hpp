@@ -8,6 +8,7 @@
 #include <string>
 #include <type_traits>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace core {
@@ -44,8 +45,21 @@ std::pair<uint32_t, size_t> decode_uint32(const uint8_t *buffer,
 // Calculate encoded size without actually encoding
 size_t encoded_size_uint64(uint64_t value);
 size_t encoded_size_uint32(uint32_t value);
+
+// Maps signed values to unsigned so small magnitudes of either sign stay
+// short as varints
+inline uint64_t zigzag_encode(int64_t value) {
+  return (static_cast<uint64_t>(value) << 1) ^
+         static_cast<uint64_t>(value >> 63);
+}
+inline int64_t zigzag_decode(uint64_t value) {
+  return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
 } // namespace varint
 
+// CRC-32 (IEEE 802.3), as used by zlib
+uint32_t crc32(const uint8_t *data, size_t size);
+
 /**
  * String dictionary for compression of repeated strings
  */
@@ -228,6 +242,9 @@ public:
   void write_string(const std::string &str);
   void write_string_raw(const std::string &str); // No dictionary compression
 
+  // Length-prefixed opaque bytes, e.g. an already-serialized nested object
+  void write_blob(const uint8_t *data, size_t size);
+
   // Collections
   template <typename T> void write_vector(const std::vector<T> &vec) {
     write_varint32(static_cast<uint32_t>(vec.size()));
@@ -295,7 +312,7 @@ private:
     } else if constexpr (std::is_same_v<T, std::string>) {
       write_string(value);
     } else {
-      static_assert(false, "Unsupported type for serialization");
+      static_assert(sizeof(T) == 0, "Unsupported type for serialization");
     }
   }
 };
@@ -323,6 +340,9 @@ public:
   std::string read_string();
   std::string read_string_raw();
 
+  // View of a blob written by write_blob; valid while the input buffer is
+  std::pair<const uint8_t *, size_t> read_blob();
+
   // Collections
   template <typename T> std::vector<T> read_vector() {
     uint32_t size = read_varint32();
@@ -394,11 +414,68 @@ private:
     } else if constexpr (std::is_same_v<T, std::string>) {
       return read_string();
     } else {
-      static_assert(false, "Unsupported type for deserialization");
+      static_assert(sizeof(T) == 0, "Unsupported type for deserialization");
     }
   }
 };
 
+/**
+ * Tagged, checksummed record for persisted state
+ *
+ * A record is a varint body length, the body and a CRC-32 of the body. The
+ * body is a sequence of fields, each a varint key (tag << 3 | wire type)
+ * followed by its payload, so readers skip tags they do not know and writers
+ * can add fields without bumping a file version. Absent fields keep their
+ * defaults. A tag must never be reused for a different meaning.
+ */
+enum class WireType : uint8_t { VARINT = 0, FIXED64 = 1, BYTES = 2 };
+
+class TaggedRecordWriter {
+public:
+  void write_varint(uint32_t tag, uint64_t value);
+  void write_signed(uint32_t tag, int64_t value);
+  void write_double(uint32_t tag, double value);
+  void write_string(uint32_t tag, const std::string &value);
+  void write_bytes(uint32_t tag, const uint8_t *data, size_t size);
+  void write_bytes(uint32_t tag, const BinarySerializer &nested) {
+    write_bytes(tag, nested.data().data(), nested.size());
+  }
+
+  // Appends the framed record to out and resets the writer
+  void finish(BinarySerializer &out);
+
+private:
+  void write_key(uint32_t tag, WireType type);
+
+  BinarySerializer body_;
+};
+
+class TaggedRecordReader {
+public:
+  // Consumes one record from in. Throws std::runtime_error if it is
+  // truncated or its checksum does not match.
+  explicit TaggedRecordReader(BinaryDeserializer &in);
+
+  // Moves to the next field, skipping the current one if it was not read.
+  // Returns false at the end of the record.
+  bool next();
+  uint32_t tag() const { return tag_; }
+
+  uint64_t read_varint();
+  int64_t read_signed();
+  double read_double();
+  std::string read_string();
+  std::pair<const uint8_t *, size_t> read_bytes();
+
+private:
+  void expect(WireType type);
+
+  std::unique_ptr<BinaryDeserializer> body_;
+  uint32_t tag_ = 0;
+  WireType type_ = WireType::VARINT;
+  bool consumed_ = true;
+};
+
 /**
  * Helper interface for serializable objects
  */
@@ -134,6 +134,38 @@ bool validate_dynamic_learning_config(const DynamicLearningConfig &config,
     valid = false;
   }
 
+  if (config.percentile_relative_accuracy < 0.0001 ||
+      config.percentile_relative_accuracy > 0.1) {
+    errors.push_back("Dynamic learning percentile relative accuracy must be "
+                     "between 0.0001 and 0.1");
+    valid = false;
+  }
+
+  if (config.update_threads < 1 || config.update_threads > 64) {
+    errors.push_back(
+        "Dynamic learning update threads must be between 1 and 64");
+    valid = false;
+  }
+
+  if (config.update_flush_interval_ms < 10 ||
+      config.update_flush_interval_ms > 10000) {
+    errors.push_back("Dynamic learning update flush interval must be between "
+                     "10 and 10000 ms");
+    valid = false;
+  }
+
+  if (config.max_pending_updates_per_worker < 1024) {
+    errors.push_back("Dynamic learning max pending updates per worker must be "
+                     "at least 1024");
+    valid = false;
+  }
+
+  if (config.baseline_cleanup_interval_seconds < 1) {
+    errors.push_back("Dynamic learning baseline cleanup interval must be at "
+                     "least 1 second");
+    valid = false;
+  }
+
   if (config.baseline_update_interval_seconds < 60 ||
       config.baseline_update_interval_seconds > 86400) {
     errors.push_back("Dynamic learning baseline update interval must be "
@@ -283,6 +315,27 @@ bool validate_memory_management_config(const MemoryManagementConfig &config,
     valid = false;
   }
 
+  if (config.enable_cold_state_tier) {
+    if (config.hot_state_idle_seconds < 60 ||
+        config.hot_state_idle_seconds > 86400) {
+      errors.push_back("Memory management hot state idle time must be between "
+                       "60 and 86400 seconds");
+      valid = false;
+    }
+
+    if (config.cold_state_max_file_mb < 16) {
+      errors.push_back(
+          "Memory management cold state file limit must be at least 16 MB");
+      valid = false;
+    }
+
+    if (config.cold_state_directory.empty()) {
+      errors.push_back("Memory management cold state directory is required "
+                       "when the cold state tier is enabled");
+      valid = false;
+    }
+  }
+
   return valid;
 }
 
@@ -657,6 +710,14 @@ bool parse_config_into(const std::string &filepath, AppConfig &config) {
           config.state_save_interval_events =
               Utils::string_to_number<uint64_t>(value).value_or(
                   config.state_save_interval_events);
+        else if (key == Keys::STATE_SAVE_INTERVAL_SECONDS)
+          config.state_save_interval_seconds =
+              Utils::string_to_number<uint64_t>(value).value_or(
+                  config.state_save_interval_seconds);
+        else if (key == Keys::STATE_COMPACTION_INTERVAL)
+          config.state_compaction_interval =
+              Utils::string_to_number<uint64_t>(value).value_or(
+                  config.state_compaction_interval);
         else if (key == Keys::STATE_PRUNING_ENABLED)
           config.state_pruning_enabled = string_to_bool(value);
         else if (key == Keys::STATE_TTL_SECONDS)
@@ -685,10 +746,36 @@ bool parse_config_into(const std::string &filepath, AppConfig &config) {
           config.alert_throttle_max_alerts =
               Utils::string_to_number<uint64_t>(value).value_or(
                   config.alert_throttle_max_alerts);
+        else if (key == Keys::ALERT_THROTTLE_MAX_ENTRIES)
+          config.alert_throttle_max_entries =
+              Utils::string_to_number<uint64_t>(value).value_or(
+                  config.alert_throttle_max_entries);
+        else if (key == Keys::INCIDENTS_ENABLED)
+          config.incidents_enabled = string_to_bool(value);
+        else if (key == Keys::INCIDENT_FLUSH_INTERVAL_SECONDS)
+          config.incident_flush_interval_seconds =
+              Utils::string_to_number<uint64_t>(value).value_or(
+                  config.incident_flush_interval_seconds);
+        else if (key == Keys::INCIDENT_IDLE_TIMEOUT_SECONDS)
+          config.incident_idle_timeout_seconds =
+              Utils::string_to_number<uint64_t>(value).value_or(
+                  config.incident_idle_timeout_seconds);
+        else if (key == Keys::INCIDENT_SAMPLE_EVENTS)
+          config.incident_sample_events =
+              Utils::string_to_number<uint64_t>(value).value_or(
+                  config.incident_sample_events);
+        else if (key == Keys::INCIDENT_MAX_OPEN)
+          config.incident_max_open =
+              Utils::string_to_number<uint64_t>(value).value_or(
+                  config.incident_max_open);
         else if (key == Keys::ML_DATA_COLLECTION_ENABLED)
           config.ml_data_collection_enabled = string_to_bool(value);
         else if (key == Keys::ML_DATA_COLLECTION_PATH)
           config.ml_data_collection_path = value;
+        else if (key == Keys::RULE_BATCH_SIZE)
+          config.rule_batch_size =
+              Utils::string_to_number<size_t>(value).value_or(
+                  config.rule_batch_size);
         else
           config.custom_settings[key] = value;
 
@@ -737,6 +824,10 @@ bool parse_config_into(const std::string &filepath, AppConfig &config) {
           config.tier1.max_unique_uas_per_ip_in_window =
               Utils::string_to_number<size_t>(value).value_or(
                   config.tier1.max_unique_uas_per_ip_in_window);
+        else if (key == Keys::T1_UA_VERDICT_CACHE_SIZE)
+          config.tier1.ua_verdict_cache_size =
+              Utils::string_to_number<size_t>(value).value_or(
+                  config.tier1.ua_verdict_cache_size);
         else if (key == Keys::T1_HTML_PATH_SUFFIXES) {
           std::vector<std::string> suffixes = Utils::split_string(value, ',');
           if (!suffixes.empty())
@@ -842,6 +933,24 @@ bool parse_config_into(const std::string &filepath, AppConfig &config) {
           config.tier1.score_sensitive_path_new_ip =
               Utils::string_to_number<double>(value).value_or(
                   config.tier1.score_sensitive_path_new_ip);
+        else if (key == Keys::T1_SUBNET_ROLLUP_ENABLED)
+          config.tier1.subnet_rollup_enabled = string_to_bool(value);
+        else if (key == Keys::T1_MAX_REQUESTS_PER_SUBNET_NARROW)
+          config.tier1.max_requests_per_subnet_narrow_in_window =
+              Utils::string_to_number<size_t>(value).value_or(
+                  config.tier1.max_requests_per_subnet_narrow_in_window);
+        else if (key == Keys::T1_MAX_REQUESTS_PER_SUBNET_WIDE)
+          config.tier1.max_requests_per_subnet_wide_in_window =
+              Utils::string_to_number<size_t>(value).value_or(
+                  config.tier1.max_requests_per_subnet_wide_in_window);
+        else if (key == Keys::T1_MAX_FAILED_LOGINS_PER_SUBNET)
+          config.tier1.max_failed_logins_per_subnet =
+              Utils::string_to_number<size_t>(value).value_or(
+                  config.tier1.max_failed_logins_per_subnet);
+        else if (key == Keys::T1_MIN_DISTINCT_IPS_FOR_SUBNET_ALERT)
+          config.tier1.min_distinct_ips_for_subnet_alert =
+              Utils::string_to_number<size_t>(value).value_or(
+                  config.tier1.min_distinct_ips_for_subnet_alert);
 
         // Tier 2 settings
       } else if (current_section == "Tier2") {
@@ -1006,6 +1115,32 @@ bool parse_config_into(const std::string &filepath, AppConfig &config) {
           config.dynamic_learning.threshold_change_max_percent =
               Utils::string_to_number<double>(value).value_or(
                   config.dynamic_learning.threshold_change_max_percent);
+        else if (key == Keys::DL_BASELINE_STATE_FILE)
+          config.dynamic_learning.baseline_state_file = value;
+        else if (key == Keys::DL_PERCENTILE_RELATIVE_ACCURACY)
+          config.dynamic_learning.percentile_relative_accuracy =
+              Utils::string_to_number<double>(value).value_or(
+                  config.dynamic_learning.percentile_relative_accuracy);
+        else if (key == Keys::DL_UPDATE_THREADS)
+          config.dynamic_learning.update_threads =
+              Utils::string_to_number<uint32_t>(value).value_or(
+                  config.dynamic_learning.update_threads);
+        else if (key == Keys::DL_UPDATE_FLUSH_INTERVAL_MS)
+          config.dynamic_learning.update_flush_interval_ms =
+              Utils::string_to_number<uint32_t>(value).value_or(
+                  config.dynamic_learning.update_flush_interval_ms);
+        else if (key == Keys::DL_MAX_PENDING_UPDATES_PER_WORKER)
+          config.dynamic_learning.max_pending_updates_per_worker =
+              Utils::string_to_number<uint32_t>(value).value_or(
+                  config.dynamic_learning.max_pending_updates_per_worker);
+        else if (key == Keys::DL_BASELINE_TTL_HOURS)
+          config.dynamic_learning.baseline_ttl_hours =
+              Utils::string_to_number<uint32_t>(value).value_or(
+                  config.dynamic_learning.baseline_ttl_hours);
+        else if (key == Keys::DL_BASELINE_CLEANUP_INTERVAL_SECONDS)
+          config.dynamic_learning.baseline_cleanup_interval_seconds =
+              Utils::string_to_number<uint32_t>(value).value_or(
+                  config.dynamic_learning.baseline_cleanup_interval_seconds);
 
         // Tier4 Settings
       } else if (current_section == "Tier4") {
@@ -1068,6 +1203,19 @@ bool parse_config_into(const std::string &filepath, AppConfig &config) {
           config.memory_management.state_object_ttl_seconds =
               Utils::string_to_number<uint32_t>(value).value_or(
                   config.memory_management.state_object_ttl_seconds);
+        else if (key == Keys::MM_ENABLE_COLD_STATE_TIER)
+          config.memory_management.enable_cold_state_tier =
+              string_to_bool(value);
+        else if (key == Keys::MM_COLD_STATE_DIRECTORY)
+          config.memory_management.cold_state_directory = value;
+        else if (key == Keys::MM_HOT_STATE_IDLE_SECONDS)
+          config.memory_management.hot_state_idle_seconds =
+              Utils::string_to_number<uint32_t>(value).value_or(
+                  config.memory_management.hot_state_idle_seconds);
+        else if (key == Keys::MM_COLD_STATE_MAX_FILE_MB)
+          config.memory_management.cold_state_max_file_mb =
+              Utils::string_to_number<size_t>(value).value_or(
+                  config.memory_management.cold_state_max_file_mb);
       } else if (current_section == "PerformanceMonitoring") {
         if (key == "enabled")
           config.performance_monitoring.enabled = string_to_bool(value);
@@ -28,9 +28,20 @@ constexpr const char *ALERT_OUTPUT_PATH = "alert_output_path";
 constexpr const char *ALERT_THROTTLE_DURATION_SECONDS =
     "alert_throttle_duration_seconds";
 constexpr const char *ALERT_THROTTLE_MAX_ALERTS = "alert_throttle_max_alerts";
+constexpr const char *ALERT_THROTTLE_MAX_ENTRIES = "alert_throttle_max_entries";
+constexpr const char *INCIDENTS_ENABLED = "incidents_enabled";
+constexpr const char *INCIDENT_FLUSH_INTERVAL_SECONDS =
+    "incident_flush_interval_seconds";
+constexpr const char *INCIDENT_IDLE_TIMEOUT_SECONDS =
+    "incident_idle_timeout_seconds";
+constexpr const char *INCIDENT_SAMPLE_EVENTS = "incident_sample_events";
+constexpr const char *INCIDENT_MAX_OPEN = "incident_max_open";
 constexpr const char *STATE_PERSISTENCE_ENABLED = "state_persistence_enabled";
 constexpr const char *STATE_FILE_PATH = "state_file_path";
 constexpr const char *STATE_SAVE_INTERVAL_EVENTS = "state_save_interval_events";
+constexpr const char *STATE_SAVE_INTERVAL_SECONDS =
+    "state_save_interval_seconds";
+constexpr const char *STATE_COMPACTION_INTERVAL = "state_compaction_interval";
 constexpr const char *STATE_PRUNING_ENABLED = "state_pruning_enabled";
 constexpr const char *STATE_TTL_SECONDS = "state_ttl_seconds";
 constexpr const char *STATE_PRUNE_INTERVAL_EVENTS =
@@ -41,6 +52,7 @@ constexpr const char *LIVE_MONITORING_SLEEP_SECONDS =
 constexpr const char *STATE_FILE_MAGIC = "state_file_magic";
 constexpr const char *ML_DATA_COLLECTION_ENABLED = "ml_data_collection_enabled";
 constexpr const char *ML_DATA_COLLECTION_PATH = "ml_data_collection_path";
+constexpr const char *RULE_BATCH_SIZE = "rule_batch_size";
 
 // Tier1 Settings
 constexpr const char *T1_ENABLED = "enabled";
@@ -56,6 +68,7 @@ constexpr const char *T1_MIN_CHROME_VERSION = "min_chrome_version";
 constexpr const char *T1_MIN_FIREFOX_VERSION = "min_firefox_version";
 constexpr const char *T1_MAX_UNIQUE_UAS_PER_IP =
     "max_unique_uas_per_ip_in_window";
+constexpr const char *T1_UA_VERDICT_CACHE_SIZE = "ua_verdict_cache_size";
 constexpr const char *T1_HTML_PATH_SUFFIXES = "html_path_suffixes";
 constexpr const char *T1_HTML_EXACT_PATHS = "html_exact_paths";
 constexpr const char *T1_ASSET_PATH_PREFIXES = "asset_path_prefixes";
@@ -89,6 +102,15 @@ constexpr const char *T1_SCORE_UA_CYCLING = "score_ua_cycling";
 constexpr const char *T1_SCORE_SUSPICIOUS_PATH = "score_suspicious_path";
 constexpr const char *T1_SCORE_SENSITIVE_PATH_NEW_IP =
     "score_sensitive_path_new_ip";
+constexpr const char *T1_SUBNET_ROLLUP_ENABLED = "subnet_rollup_enabled";
+constexpr const char *T1_MAX_REQUESTS_PER_SUBNET_NARROW =
+    "max_requests_per_subnet_narrow_in_window";
+constexpr const char *T1_MAX_REQUESTS_PER_SUBNET_WIDE =
+    "max_requests_per_subnet_wide_in_window";
+constexpr const char *T1_MAX_FAILED_LOGINS_PER_SUBNET =
+    "max_failed_logins_per_subnet";
+constexpr const char *T1_MIN_DISTINCT_IPS_FOR_SUBNET_ALERT =
+    "min_distinct_ips_for_subnet_alert";
 
 // Tier2 Settings
 constexpr const char *T2_ENABLED = "enabled";
@@ -156,6 +178,16 @@ constexpr const char *DL_BASELINE_UPDATE_INTERVAL_SECONDS =
 constexpr const char *DL_ENABLE_MANUAL_OVERRIDES = "enable_manual_overrides";
 constexpr const char *DL_THRESHOLD_CHANGE_MAX_PERCENT =
     "threshold_change_max_percent";
+constexpr const char *DL_BASELINE_STATE_FILE = "baseline_state_file";
+constexpr const char *DL_PERCENTILE_RELATIVE_ACCURACY =
+    "percentile_relative_accuracy";
+constexpr const char *DL_UPDATE_THREADS = "update_threads";
+constexpr const char *DL_UPDATE_FLUSH_INTERVAL_MS = "update_flush_interval_ms";
+constexpr const char *DL_MAX_PENDING_UPDATES_PER_WORKER =
+    "max_pending_updates_per_worker";
+constexpr const char *DL_BASELINE_TTL_HOURS = "baseline_ttl_hours";
+constexpr const char *DL_BASELINE_CLEANUP_INTERVAL_SECONDS =
+    "baseline_cleanup_interval_seconds";
 
 // Tier4 Settings
 constexpr const char *T4_ENABLED = "enabled";
@@ -183,6 +215,10 @@ constexpr const char *MM_EVICTION_THRESHOLD_PERCENT =
     "eviction_threshold_percent";
 constexpr const char *MM_ENABLE_MEMORY_COMPACTION = "enable_memory_compaction";
 constexpr const char *MM_STATE_OBJECT_TTL_SECONDS = "state_object_ttl_seconds";
+constexpr const char *MM_ENABLE_COLD_STATE_TIER = "enable_cold_state_tier";
+constexpr const char *MM_COLD_STATE_DIRECTORY = "cold_state_directory";
+constexpr const char *MM_HOT_STATE_IDLE_SECONDS = "hot_state_idle_seconds";
+constexpr const char *MM_COLD_STATE_MAX_FILE_MB = "cold_state_max_file_mb";
 } // namespace Keys
 
 struct LoggingConfig {
@@ -202,6 +238,8 @@ struct Tier1Config {
   int min_chrome_version = 90;
   int min_firefox_version = 85;
   size_t max_unique_uas_per_ip_in_window = 3;
+  // Distinct UA strings whose verdicts are cached across workers; 0 disables
+  size_t ua_verdict_cache_size = 16384;
 
   std::vector<std::string> suspicious_path_substrings;
   std::vector<std::string> suspicious_ua_substrings;
@@ -231,6 +269,17 @@ struct Tier1Config {
   double score_ua_cycling = 85.0;
   double score_suspicious_path = 95.0;
   double score_sensitive_path_new_ip = 80.0;
+
+  // Subnet rollups: /24 + /16 for IPv4, /64 + /48 for IPv6. "Narrow" and
+  // "wide" refer to the first and second level respectively. Opt-in, since
+  // enabling them adds new alerts.
+  bool subnet_rollup_enabled = false;
+  size_t max_requests_per_subnet_narrow_in_window = 5000;
+  size_t max_requests_per_subnet_wide_in_window = 20000;
+  size_t max_failed_logins_per_subnet = 100;
+  // Subnet rules only fire when the traffic is spread over this many sources,
+  // so a single busy IP or NAT gateway stays with the per-IP rules
+  size_t min_distinct_ips_for_subnet_alert = 8;
 };
 
 struct Tier2Config {
@@ -322,6 +371,20 @@ struct DynamicLearningConfig {
   uint32_t min_samples_for_contextual_baseline = 1;
   // Contextual baseline EWMA alpha (1.0 = no smoothing, 0.1 = slow adapt)
   double contextual_statistics_alpha = 1.0;
+  // Relative error bound of baseline percentiles (0.01 = within 1%)
+  double percentile_relative_accuracy = 0.01;
+  // Baselines are saved here alongside each state snapshot when state
+  // persistence is enabled
+  std::string baseline_state_file = "data/learning_baselines.dat";
+  // Workers buffer baseline updates; these threads fold them in batches
+  uint32_t update_threads = 1;
+  uint32_t update_flush_interval_ms = 100;
+  // Updates beyond this many unfolded ones per worker are dropped
+  uint32_t max_pending_updates_per_worker = 65536;
+  // Baselines not updated for this long are dropped (0 keeps them forever),
+  // checked every cleanup interval of event time
+  uint32_t baseline_ttl_hours = 72;
+  uint32_t baseline_cleanup_interval_seconds = 300;
 };
 
 struct Tier4Config {
@@ -345,6 +408,13 @@ struct MemoryManagementConfig {
   double eviction_threshold_percent = 80.0;
   bool enable_memory_compaction = true;
   uint32_t state_object_ttl_seconds = 3600;
+
+  // Cold tier: idle IP states are spilled to an mmap-backed file per worker
+  // and rehydrated on their next request instead of being dropped
+  bool enable_cold_state_tier = false;
+  std::string cold_state_directory = "data/cold_state";
+  uint32_t hot_state_idle_seconds = 900;
+  size_t cold_state_max_file_mb = 2048;
 };
 
 struct PerformanceMonitoringConfig {
@@ -434,10 +504,22 @@ struct AppConfig {
   std::string alert_output_path = "alerts.json";
   uint64_t alert_throttle_duration_seconds = 300; // 5 minutes default
   uint64_t alert_throttle_max_alerts = 10;
+  // (IP, rule) pairs remembered by the throttle across all workers
+  uint64_t alert_throttle_max_entries = 100000;
+  // Coalesce alerts into per-(IP, rule) incidents instead of dispatching
+  // each one; only alerts with no room for an incident are throttled
+  bool incidents_enabled = false;
+  uint64_t incident_flush_interval_seconds = 10;
+  uint64_t incident_idle_timeout_seconds = 300;
+  uint64_t incident_sample_events = 5;
+  uint64_t incident_max_open = 10000;
 
   bool state_persistence_enabled = true;
   std::string state_file_path = "data/engine_state.dat";
   uint64_t state_save_interval_events = 50000;
+  uint64_t state_save_interval_seconds = 0;
+  // Delta checkpoints between two full ones
+  uint64_t state_compaction_interval = 20;
   bool state_pruning_enabled = true;
   uint64_t state_ttl_seconds = 604800; // 7 days
   uint64_t state_prune_interval_events = 100000;
@@ -446,6 +528,10 @@ struct AppConfig {
   uint64_t live_monitoring_sleep_seconds = 5;
   uint32_t state_file_magic = 0xADE57A7E;
 
+  // Events whose Tier 1/2 rules are evaluated together by a worker, at most
+  // 64; 0 or 1 evaluates every event on its own
+  size_t rule_batch_size = 64;
+
   Tier1Config tier1;
   Tier2Config tier2;
   Tier3Config tier3;
@@ -0,0 +1,134 @@
+#include "incident_aggregator.hpp"
+
+#include <algorithm>
+#include <utility>
+
+void IncidentAggregator::configure(uint64_t idle_timeout_ms,
+                                   size_t max_samples, size_t max_open) {
+  idle_timeout_ms_.store(idle_timeout_ms, std::memory_order_relaxed);
+  max_samples_.store(max_samples, std::memory_order_relaxed);
+  shard_capacity_.store(std::max<size_t>(1, max_open / kShardCount),
+                        std::memory_order_relaxed);
+}
+
+bool IncidentAggregator::record(uint64_t key, const Alert &alert,
+                                uint64_t now_ms) {
+  Shard &shard = shards_[key >> (64 - kShardBits)];
+  std::lock_guard<std::mutex> lock(shard.mutex);
+
+  auto it = shard.open.find(key);
+  if (it == shard.open.end()) {
+    const size_t capacity = shard_capacity_.load(std::memory_order_relaxed);
+    if (shard.open.size() >= capacity) {
+      if (shard.evicted.size() >= capacity)
+        return false;
+      // The scan is bounded by the shard's capacity, and is only paid by
+      // alerts that open an incident in a full shard
+      auto stalest = std::min_element(
+          shard.open.begin(), shard.open.end(),
+          [](const auto &a, const auto &b) {
+            return a.second.touched_ms < b.second.touched_ms;
+          });
+      // Its CLOSED notification carries the totals, not the events
+      stalest->second.samples = {};
+      shard.evicted.push_back(std::move(stalest->second));
+      shard.open.erase(stalest);
+    }
+    const uint64_t id = next_id_.fetch_add(1, std::memory_order_relaxed);
+    const uint64_t ts = alert.event_timestamp_ms;
+    it = shard.open.emplace(key, Incident{id, alert, ts, ts, 0, 0, now_ms, {}})
+             .first;
+  } else if (alert.normalized_score > it->second.peak.normalized_score) {
+    it->second.peak = alert;
+  }
+
+  Incident &incident = it->second;
+  ++incident.count;
+  incident.first_seen_ms =
+      std::min(incident.first_seen_ms, alert.event_timestamp_ms);
+  incident.last_seen_ms =
+      std::max(incident.last_seen_ms, alert.event_timestamp_ms);
+  incident.touched_ms = now_ms;
+  if (alert.event_context &&
+      incident.samples.size() < max_samples_.load(std::memory_order_relaxed))
+    incident.samples.push_back(alert.event_context);
+  return true;
+}
+
+std::vector<Alert> IncidentAggregator::flush(uint64_t now_ms) {
+  const uint64_t idle_timeout_ms =
+      idle_timeout_ms_.load(std::memory_order_relaxed);
+  std::vector<Alert> notifications;
+
+  for (Shard &shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    close_evicted(shard, notifications);
+
+    for (auto it = shard.open.begin(); it != shard.open.end();) {
+      Incident &incident = it->second;
+      // An incident is always announced before it can close
+      if (incident.notified_count == 0) {
+        notifications.push_back(notification(incident, IncidentState::OPENED));
+      } else if (now_ms >= incident.touched_ms + idle_timeout_ms) {
+        notifications.push_back(notification(incident, IncidentState::CLOSED));
+        it = shard.open.erase(it);
+        continue;
+      } else if (incident.count != incident.notified_count) {
+        notifications.push_back(
+            notification(incident, IncidentState::UPDATED));
+      }
+      incident.notified_count = incident.count;
+      ++it;
+    }
+  }
+  return notifications;
+}
+
+std::vector<Alert> IncidentAggregator::close_all() {
+  std::vector<Alert> notifications;
+  for (Shard &shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    close_evicted(shard, notifications);
+    for (const auto &[key, incident] : shard.open) {
+      if (incident.notified_count == 0)
+        notifications.push_back(notification(incident, IncidentState::OPENED));
+      notifications.push_back(notification(incident, IncidentState::CLOSED));
+    }
+    shard.open.clear();
+  }
+  return notifications;
+}
+
+size_t IncidentAggregator::open_count() const {
+  size_t total = 0;
+  for (const Shard &shard : shards_) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    total += shard.open.size();
+  }
+  return total;
+}
+
+void IncidentAggregator::close_evicted(Shard &shard,
+                                       std::vector<Alert> &notifications) {
+  // One notification each, even for incidents no flush announced, so a scan
+  // over many keys costs no more dispatches than it has keys
+  for (const Incident &incident : shard.evicted)
+    notifications.push_back(notification(incident, IncidentState::CLOSED));
+  shard.evicted.clear();
+}
+
+Alert IncidentAggregator::notification(const Incident &incident,
+                                       IncidentState state) {
+  auto summary = std::make_shared<IncidentSummary>();
+  summary->incident_id = incident.id;
+  summary->state = state;
+  summary->first_seen_ms = incident.first_seen_ms;
+  summary->last_seen_ms = incident.last_seen_ms;
+  summary->alert_count = incident.count;
+  summary->max_score = incident.peak.normalized_score;
+  summary->sample_events = incident.samples;
+
+  Alert alert = incident.peak;
+  alert.incident = std::move(summary);
+  return alert;
+}
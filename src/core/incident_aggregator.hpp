@@ -0,0 +1,90 @@
+#ifndef INCIDENT_AGGREGATOR_HPP
+#define INCIDENT_AGGREGATOR_HPP
+
+#include "alert.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Merges the alerts raised by one rule for one source into an open incident
+// that tracks first and last seen, count, the highest scoring alert and the
+// events of the first few alerts. Instead of every alert, flush() returns
+// one notification per incident that opened, grew or went idle since the
+// previous flush, so a flood of near-identical alerts costs a handful of
+// dispatches and a bounded number of retained events.
+//
+// Keys are AlertThrottle keys, spread over independently locked shards like
+// the throttle's. Idleness is measured with the caller's clock (now_ms),
+// separately from the event times reported in the summary, so replayed logs
+// still close their incidents. A shard never holds more than its share of
+// max_open incidents: the least recently updated one is closed early to
+// make room, keeping its peak alert and totals but not its samples, and is
+// reported with a single CLOSED at the next flush. At most as many closed
+// incidents wait in a shard as it keeps open; once both are full, record()
+// turns new keys away until the next flush.
+class IncidentAggregator {
+public:
+  IncidentAggregator() = default;
+
+  void configure(uint64_t idle_timeout_ms, size_t max_samples,
+                 size_t max_open);
+
+  // Merges alert into the open incident for key, opening one if needed.
+  // Returns false, leaving the alert to the caller, if key has no incident
+  // and its shard has no room for another before the next flush.
+  bool record(uint64_t key, const Alert &alert, uint64_t now_ms);
+
+  // Notifications due at now_ms: OPENED for incidents not announced yet,
+  // UPDATED for those that merged alerts since their last notification and
+  // CLOSED for those idle for idle_timeout_ms, which are then dropped
+  std::vector<Alert> flush(uint64_t now_ms);
+  // CLOSED notifications for every incident, leaving none open. Like
+  // flush(), an open incident that was never announced gets OPENED first.
+  std::vector<Alert> close_all();
+
+  size_t open_count() const;
+
+private:
+  static constexpr size_t kShardBits = 6;
+  static constexpr size_t kShardCount = size_t{1} << kShardBits;
+
+  struct Incident {
+    uint64_t id;
+    // Highest scoring alert so far; notifications are copies of it
+    Alert peak;
+    uint64_t first_seen_ms;
+    uint64_t last_seen_ms;
+    uint64_t count;
+    // Count at the last notification; 0 until the incident is announced
+    uint64_t notified_count;
+    // Caller's clock at the last merged alert
+    uint64_t touched_ms;
+    std::vector<std::shared_ptr<const AnalyzedEvent>> samples;
+  };
+
+  struct alignas(64) Shard {
+    mutable std::mutex mutex;
+    std::unordered_map<uint64_t, Incident> open;
+    // Closed early to make room, without samples, waiting for the next
+    // flush; never longer than the shard's capacity
+    std::vector<Incident> evicted;
+  };
+
+  // Notifications for the incidents closed early; the shard's mutex is held
+  static void close_evicted(Shard &shard, std::vector<Alert> &notifications);
+  static Alert notification(const Incident &incident, IncidentState state);
+
+  std::atomic<uint64_t> idle_timeout_ms_{0};
+  std::atomic<size_t> max_samples_{0};
+  std::atomic<size_t> shard_capacity_{1};
+  std::atomic<uint64_t> next_id_{1};
+  std::array<Shard, kShardCount> shards_;
+};
+
+#endif // INCIDENT_AGGREGATOR_HPP
@@ -12,6 +12,74 @@ LogEntry::LogEntry()
       // std::optional fields are default constructed to std::nullopt
       successfully_parsed_structure(false) {}
 
+LogEntry::LogEntry(const LogEntry &other)
+    : raw_log_line(other.raw_log_line), request_path(other.request_path) {
+  assign_fields_from(other, other.raw_log_line.data(),
+                     other.raw_log_line.size());
+}
+
+LogEntry::LogEntry(LogEntry &&other) noexcept {
+  // Capture the source buffer before moving: short lines live in the SSO
+  // buffer and change address on move, long lines keep their heap block.
+  const char *old_base = other.raw_log_line.data();
+  size_t old_size = other.raw_log_line.size();
+  raw_log_line = std::move(other.raw_log_line);
+  request_path = std::move(other.request_path);
+  assign_fields_from(other, old_base, old_size);
+}
+
+LogEntry &LogEntry::operator=(const LogEntry &other) {
+  if (this != &other) {
+    raw_log_line = other.raw_log_line;
+    request_path = other.request_path;
+    assign_fields_from(other, other.raw_log_line.data(),
+                       other.raw_log_line.size());
+  }
+  return *this;
+}
+
+LogEntry &LogEntry::operator=(LogEntry &&other) noexcept {
+  if (this != &other) {
+    const char *old_base = other.raw_log_line.data();
+    size_t old_size = other.raw_log_line.size();
+    raw_log_line = std::move(other.raw_log_line);
+    request_path = std::move(other.request_path);
+    assign_fields_from(other, old_base, old_size);
+  }
+  return *this;
+}
+
+void LogEntry::assign_fields_from(const LogEntry &other, const char *old_base,
+                                  size_t old_size) {
+  auto rebase = [&](std::string_view view) -> std::string_view {
+    if (view.data() != nullptr && view.data() >= old_base &&
+        view.data() + view.size() <= old_base + old_size)
+      return std::string_view(raw_log_line.data() + (view.data() - old_base),
+                              view.size());
+    return view;
+  };
+
+  original_line_number = other.original_line_number;
+  ip_address = rebase(other.ip_address);
+  timestamp_str = rebase(other.timestamp_str);
+  parsed_timestamp_ms = other.parsed_timestamp_ms;
+  request_method = rebase(other.request_method);
+  request_protocol = rebase(other.request_protocol);
+  http_status_code = other.http_status_code;
+  request_time_s = other.request_time_s;
+  upstream_response_time_s = other.upstream_response_time_s;
+  bytes_sent = other.bytes_sent;
+  remote_user = rebase(other.remote_user);
+  referer = rebase(other.referer);
+  user_agent = rebase(other.user_agent);
+  host = rebase(other.host);
+  country_code = rebase(other.country_code);
+  upstream_addr = rebase(other.upstream_addr);
+  x_request_id = rebase(other.x_request_id);
+  accept_encoding = rebase(other.accept_encoding);
+  successfully_parsed_structure = other.successfully_parsed_structure;
+}
+
 void LogEntry::parse_request_details(std::string_view full_request_field,
                                      std::string_view &out_method,
                                      std::string &out_path,
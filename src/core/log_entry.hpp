@@ -39,12 +39,25 @@ struct LogEntry {
   // Default constructor
   LogEntry();
 
+  // Copies and moves re-point the string_view fields at the destination's
+  // own raw_log_line, so a LogEntry never borrows from another instance.
+  LogEntry(const LogEntry &other);
+  LogEntry(LogEntry &&other) noexcept;
+  LogEntry &operator=(const LogEntry &other);
+  LogEntry &operator=(LogEntry &&other) noexcept;
+
   // Static function to create LogEntry from raw string
   static std::optional<LogEntry>
   parse_from_string(std::string &&log_line, uint64_t line_num,
                     bool verbose_warnings = true);
 
 private:
+  // Copies every field except raw_log_line and request_path, rebasing any
+  // view that pointed into [old_base, old_base + old_size) onto
+  // this->raw_log_line.
+  void assign_fields_from(const LogEntry &other, const char *old_base,
+                          size_t old_size);
+
   // Helper function to parse "request" field (into request_method,
   // request_path, request_protocol)
   static void parse_request_details(std::string_view full_request_field,
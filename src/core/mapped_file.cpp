@@ -0,0 +1,50 @@
+#include "mapped_file.hpp"
+#include "core/logger.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace core {
+
+MappedFile::MappedFile(const std::string &path) : path_(path) {
+  int fd = ::open(path_.c_str(), O_RDONLY);
+  if (fd < 0)
+    return;
+
+  struct stat st;
+  if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+    void *addr = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ,
+                        MAP_PRIVATE, fd, 0);
+    if (addr != MAP_FAILED) {
+      data_ = static_cast<const uint8_t *>(addr);
+      size_ = static_cast<size_t>(st.st_size);
+    } else {
+      LOG(LogLevel::ERROR, LogComponent::STATE_PERSIST,
+          "Failed to map " << path_ << ": " << std::strerror(errno));
+    }
+  }
+  // The mapping keeps its own reference to the file
+  ::close(fd);
+}
+
+MappedFile::~MappedFile() {
+  if (data_)
+    ::munmap(const_cast<uint8_t *>(data_), size_);
+}
+
+void MappedFile::prefetch(size_t offset, size_t length) const {
+  if (!data_ || offset >= size_)
+    return;
+  // madvise needs a page-aligned start
+  static const size_t page = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+  size_t start = offset - offset % page;
+  size_t end = std::min(size_, offset + length);
+  ::madvise(const_cast<uint8_t *>(data_) + start, end - start, MADV_WILLNEED);
+}
+
+} // namespace core
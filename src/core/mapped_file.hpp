@@ -0,0 +1,37 @@
+#ifndef MAPPED_FILE_HPP
+#define MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace core {
+
+// Read-only private mapping of a whole file. Pages are faulted in on first
+// touch, so opening is O(1) regardless of the file size. The mapping stays
+// valid if the file is unlinked afterwards.
+class MappedFile {
+public:
+  explicit MappedFile(const std::string &path);
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  bool is_open() const { return data_ != nullptr; }
+  const uint8_t *data() const { return data_; }
+  size_t size() const { return size_; }
+  const std::string &path() const { return path_; }
+
+  // Hints that [offset, offset + length) will be read soon
+  void prefetch(size_t offset, size_t length) const;
+
+private:
+  std::string path_;
+  const uint8_t *data_ = nullptr;
+  size_t size_ = 0;
+};
+
+} // namespace core
+
+#endif // MAPPED_FILE_HPP
@@ -10,6 +10,7 @@
 #include <regex>
 #include <sstream>
 #include <stdexcept>
+#include <utility>
 
 namespace prometheus {
 
@@ -260,6 +261,17 @@ bool PrometheusMetricsExporter::is_running() const {
   return server_running_.load();
 }
 
+void PrometheusMetricsExporter::add_collector(Collector collector) {
+  std::lock_guard<std::mutex> lock(collectors_mutex_);
+  collectors_.push_back(std::move(collector));
+}
+
+void PrometheusMetricsExporter::collect() {
+  std::lock_guard<std::mutex> lock(collectors_mutex_);
+  for (const auto &collector : collectors_)
+    collector(*this);
+}
+
 std::string PrometheusMetricsExporter::generate_metrics_output() const {
   std::ostringstream output;
 
@@ -459,6 +471,7 @@ void PrometheusMetricsExporter::setup_http_handlers() {
 void PrometheusMetricsExporter::handle_metrics_request(
     [[maybe_unused]] const httplib::Request &req, httplib::Response &res) {
   try {
+    collect();
     std::string metrics = generate_metrics_output();
     // Set proper Prometheus content-type header
     res.set_content(metrics, "text/plain; version=0.0.4; charset=utf-8");
@@ -549,17 +562,31 @@ void prometheus::PrometheusMetricsExporter::handle_state_request(
     auto top_active = analysis_engine_->get_top_n_by_metric(10, "request_rate");
     nlohmann::json j_top_active = nlohmann::json::array();
     for (const auto &info : top_active) {
-      j_top_active.push_back({{"ip", info.ip}, {"value", info.value}});
+      j_top_active.push_back({{"ip", info.ip},
+                              {"value", info.value},
+                              {"unique_paths", info.unique_paths}});
     }
     j_state["top_active_ips"] = j_top_active;
 
-    auto top_error = analysis_engine_->get_top_n_by_metric(10, "error_rate");
+    auto top_error = analysis_engine_->get_top_n_by_metric(10, "error_count");
     nlohmann::json j_top_error = nlohmann::json::array();
     for (const auto &info : top_error) {
       j_top_error.push_back({{"ip", info.ip}, {"value", info.value}});
     }
     j_state["top_error_ips"] = j_top_error;
 
+    if (auto sketches = analysis_engine_->get_traffic_sketches()) {
+      nlohmann::json j_top_paths = nlohmann::json::array();
+      for (const auto &talker : sketches->top_paths(10)) {
+        j_top_paths.push_back({{"path", talker.key},
+                               {"value", talker.count},
+                               {"unique_ips", talker.distinct}});
+      }
+      j_state["top_paths"] = j_top_paths;
+      j_state["distinct_ips"] = sketches->distinct_ips();
+      j_state["distinct_paths"] = sketches->distinct_paths();
+    }
+
     res.set_content(j_state.dump(2), "application/json");
     res.status = 200;
 
@@ -3,9 +3,11 @@
 
 #include <atomic>
 #include <chrono>
+#include <functional>
 #include <httplib.h>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <shared_mutex>
 #include <string>
 #include <thread>
@@ -85,6 +87,13 @@ public:
   // Metrics export
   std::string generate_metrics_output() const;
 
+  // Collectors fold state kept outside the exporter (e.g. per-worker
+  // counters) into its metrics. They run one at a time, on every scrape
+  // before the output is generated, or whenever collect() is called.
+  using Collector = std::function<void(PrometheusMetricsExporter &)>;
+  void add_collector(Collector collector);
+  void collect();
+
   // Set dependencies for API handlers
   void set_alert_manager(std::shared_ptr<AlertManager> alert_manager);
   void set_analysis_engine(std::shared_ptr<AnalysisEngine> analysis_engine);
@@ -148,6 +157,9 @@ private:
   std::unordered_map<std::string, std::unique_ptr<HistogramMetric>> histograms_;
   mutable std::shared_mutex metrics_mutex_;
 
+  std::vector<Collector> collectors_;
+  std::mutex collectors_mutex_;
+
   // HTTP server
   std::unique_ptr<httplib::Server> server_;
   std::unique_ptr<std::thread> server_thread_;
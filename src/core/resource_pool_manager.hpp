@@ -336,6 +336,8 @@ private:
     // Reset all optional values
     event.current_ip_request_count_in_window.reset();
     event.current_ip_failed_login_count_in_window.reset();
+    event.subnet_narrow_activity.reset();
+    event.subnet_wide_activity.reset();
     event.ip_hist_req_time_mean.reset();
     event.ip_hist_req_time_stddev.reset();
     event.ip_hist_req_time_samples.reset();
@@ -362,7 +364,8 @@ private:
     event.path_hist_error_rate_stddev.reset();
     event.path_error_event_zscore.reset();
     event.ip_assets_per_html_ratio.reset();
-    event.raw_session_state.reset();
+    event.raw_session_state = nullptr;
+    event.session_snapshot.reset();
     event.derived_session_features.reset();
 
     // Reset boolean flags
@@ -0,0 +1,496 @@
+#include "state_snapshotter.hpp"
+#include "core/compact_serialization.hpp"
+#include "core/logger.hpp"
+#include "utils/utils.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <utility>
+
+namespace core {
+
+namespace {
+constexpr uint32_t MANIFEST_VERSION = 2;
+constexpr size_t LOG_RECORD_HEADER_BYTES = 4;
+
+std::string base_name(const std::string &path) {
+  size_t slash = path.find_last_of('/');
+  return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+} // namespace
+
+StateSnapshotter::StateSnapshotter(std::string manifest_path,
+                                   size_t shard_count, uint32_t magic,
+                                   size_t compaction_interval,
+                                   size_t writer_threads)
+    : manifest_path_(std::move(manifest_path)),
+      shard_count_(std::max<size_t>(1, shard_count)), magic_(magic),
+      compaction_interval_(compaction_interval),
+      shard_busy_(shard_count_, false), chains_(shard_count_),
+      last_submitted_(shard_count_, 0), bases_on_disk_(shard_count_) {
+  Utils::create_directory_for_file(manifest_path_);
+
+  // Continue numbering after the snapshot on disk so its files are never
+  // overwritten before a newer manifest replaces it. The engines do not know
+  // what that snapshot holds, so the first checkpoint is always full.
+  if (auto manifest = load_manifest()) {
+    requested_generation_.store(manifest->generation);
+    committed_generation_.store(manifest->generation);
+    previous_run_files_ = manifest->shard_files;
+    for (const auto &log : manifest->shard_logs)
+      if (!log.empty())
+        previous_run_files_.push_back(log);
+  }
+
+  for (size_t i = 0; i < std::max<size_t>(1, writer_threads); ++i)
+    writers_.emplace_back(&StateSnapshotter::writer_loop, this);
+}
+
+StateSnapshotter::~StateSnapshotter() {
+  flush();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  jobs_cv_.notify_all();
+  for (auto &writer : writers_)
+    if (writer.joinable())
+      writer.join();
+}
+
+void StateSnapshotter::set_shared_state_encoder(SharedStateEncoder encoder) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  shared_encoder_ = std::move(encoder);
+}
+
+uint64_t StateSnapshotter::request_snapshot(bool full) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  uint64_t generation = requested_generation_.load() + 1;
+  full = full || compaction_due_ ||
+         (compaction_interval_ > 0 && deltas_since_full_ >= compaction_interval_);
+  if (full) {
+    last_full_generation_ = generation;
+    deltas_since_full_ = 0;
+    compaction_due_ = false;
+  } else {
+    ++deltas_since_full_;
+  }
+  // Published last so a worker that sees the generation also sees its kind
+  requested_generation_.store(generation, std::memory_order_release);
+  LOG(LogLevel::DEBUG, LogComponent::STATE_PERSIST,
+      "Requested " << (full ? "full" : "delta")
+                   << " state snapshot generation " << generation);
+  return generation;
+}
+
+bool StateSnapshotter::full_snapshot_due(size_t shard) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return shard >= shard_count_ ||
+         last_full_generation_ > last_submitted_[shard];
+}
+
+void StateSnapshotter::submit(size_t shard, uint64_t generation,
+                              uint64_t watermark_ms,
+                              std::vector<uint8_t> blob, bool full) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (shard < shard_count_)
+      last_submitted_[shard] = std::max(last_submitted_[shard], generation);
+    jobs_.push_back(
+        Job{shard, generation, watermark_ms, std::move(blob), full});
+  }
+  jobs_cv_.notify_one();
+}
+
+void StateSnapshotter::flush() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  idle_cv_.wait(lock, [this] { return jobs_.empty() && jobs_in_flight_ == 0; });
+}
+
+void StateSnapshotter::writer_loop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    auto next = jobs_.end();
+    jobs_cv_.wait(lock, [this, &next] {
+      next = std::find_if(jobs_.begin(), jobs_.end(), [this](const Job &job) {
+        return job.shard >= shard_count_ || !shard_busy_[job.shard];
+      });
+      return stopping_ || next != jobs_.end();
+    });
+    if (next == jobs_.end()) {
+      if (jobs_.empty())
+        return;
+      continue;
+    }
+
+    Job job = std::move(*next);
+    jobs_.erase(next);
+    ++jobs_in_flight_;
+    if (job.shard < shard_count_)
+      shard_busy_[job.shard] = true;
+
+    bool ok = write_job(job, lock);
+    if (ok)
+      on_shard_written(job, lock);
+
+    if (job.shard < shard_count_)
+      shard_busy_[job.shard] = false;
+    --jobs_in_flight_;
+    jobs_cv_.notify_all();
+    if (jobs_.empty() && jobs_in_flight_ == 0)
+      idle_cv_.notify_all();
+  }
+}
+
+// Drops the lock around the file I/O. The shard is marked busy, so its
+// chain cannot change underneath.
+bool StateSnapshotter::write_job(Job &job, std::unique_lock<std::mutex> &lock) {
+  if (job.shard >= shard_count_)
+    return false;
+  const ShardChain chain = chains_[job.shard];
+
+  if (job.full) {
+    lock.unlock();
+    bool ok = write_file(shard_file(job.generation, job.shard), job.blob.data(),
+                         job.blob.size());
+    std::remove(log_file(job.generation, job.shard).c_str());
+    lock.lock();
+    if (!ok)
+      return false;
+    chains_[job.shard] = ShardChain{job.generation, job.blob.size(), 0,
+                                    job.watermark_ms};
+    bases_on_disk_[job.shard].insert(job.generation);
+    return true;
+  }
+
+  if (chain.base_generation == 0) {
+    // No base in this process (e.g. state was just discarded): the delta
+    // has nothing to apply to, so ask for a full checkpoint instead
+    compaction_due_ = true;
+    return false;
+  }
+
+  lock.unlock();
+  bool ok = append_record(log_file(chain.base_generation, job.shard),
+                          chain.log_bytes, job.blob.data(), job.blob.size());
+  lock.lock();
+  if (!ok) {
+    // The log may be torn past log_bytes; the next append overwrites it, but
+    // this delta is gone, so the chain has to restart from a full base
+    compaction_due_ = true;
+    return false;
+  }
+  ShardChain &current = chains_[job.shard];
+  current.log_bytes += LOG_RECORD_HEADER_BYTES + job.blob.size();
+  current.watermark_ms = job.watermark_ms;
+  if (current.log_bytes > current.base_bytes)
+    compaction_due_ = true;
+  return true;
+}
+
+void StateSnapshotter::on_shard_written(const Job &job,
+                                        std::unique_lock<std::mutex> &lock) {
+  // A newer generation may have committed while this one was being written;
+  // the shard's chain still advanced and later generations pick it up
+  if (job.generation <= committed_generation())
+    return;
+
+  auto [it, inserted] = pending_.try_emplace(job.generation);
+  PendingGeneration &pending = it->second;
+  if (inserted) {
+    pending.written.assign(shard_count_, false);
+    pending.chains.assign(shard_count_, ShardChain{});
+    pending.remaining = shard_count_;
+  }
+  if (pending.written[job.shard])
+    return;
+  pending.written[job.shard] = true;
+  pending.chains[job.shard] = chains_[job.shard];
+  if (--pending.remaining != 0)
+    return;
+
+  // Shards write in submission order, so older generations still pending
+  // lost a shard's write and can never complete
+  PendingGeneration ready = std::move(pending);
+  for (auto old = pending_.begin();
+       old != pending_.end() && old->first <= job.generation;)
+    old = pending_.erase(old);
+  commit(job.generation, ready, lock);
+}
+
+// Runs on a writer thread with mutex_ held and returns with it held, but
+// drops it for the encode and all file I/O so submit() never waits on disk
+void StateSnapshotter::commit(uint64_t generation,
+                              const PendingGeneration &pending,
+                              std::unique_lock<std::mutex> &lock) {
+  SharedStateEncoder encoder = shared_encoder_;
+  lock.unlock();
+  std::unique_lock<std::mutex> commit_lock(commit_mutex_);
+  auto relock = [&] {
+    commit_lock.unlock();
+    lock.lock();
+  };
+  // A newer generation committed while this one waited for its turn
+  if (generation <= committed_generation())
+    return relock();
+
+  SnapshotManifest manifest;
+  manifest.generation = generation;
+  // Shards that have not seen any event yet do not hold the watermark back
+  for (const ShardChain &chain : pending.chains) {
+    manifest.shard_watermarks_ms.push_back(chain.watermark_ms);
+    if (chain.watermark_ms != 0 && (manifest.watermark_ms == 0 ||
+                                    chain.watermark_ms < manifest.watermark_ms))
+      manifest.watermark_ms = chain.watermark_ms;
+  }
+
+  if (encoder) {
+    std::vector<uint8_t> shared = encoder();
+    manifest.shared_file = shared_file(generation);
+    if (!write_file(manifest.shared_file, shared.data(), shared.size()))
+      return relock();
+  }
+
+  // Names are stored relative to the manifest so the directory can move
+  BinarySerializer out;
+  out.write_uint32(magic_);
+  out.write_uint32(MANIFEST_VERSION);
+  out.write_varint64(manifest.generation);
+  out.write_varint64(manifest.watermark_ms);
+  out.write_varint32(static_cast<uint32_t>(shard_count_));
+  for (size_t shard = 0; shard < shard_count_; ++shard) {
+    const ShardChain &chain = pending.chains[shard];
+    out.write_string_raw(base_name(shard_file(chain.base_generation, shard)));
+    out.write_string_raw(
+        chain.log_bytes > 0
+            ? base_name(log_file(chain.base_generation, shard))
+            : std::string());
+    out.write_varint64(chain.log_bytes);
+    out.write_varint64(chain.watermark_ms);
+  }
+  out.write_string_raw(base_name(manifest.shared_file));
+  if (!write_file(manifest_path_, out.data().data(), out.size()))
+    return relock();
+
+  const uint64_t previous = committed_generation_.exchange(generation);
+  uint64_t log_bytes = 0;
+  for (const ShardChain &chain : pending.chains)
+    log_bytes += chain.log_bytes;
+  LOG(LogLevel::INFO, LogComponent::STATE_PERSIST,
+      "Committed state snapshot generation "
+          << generation << " (" << shard_count_ << " shards, "
+          << log_bytes << " delta log bytes, watermark ms: "
+          << manifest.watermark_ms << ").");
+
+  std::vector<std::string> unreferenced;
+  lock.lock();
+  unreferenced = take_stale_files(pending.chains);
+  // Restored engines may still have these mapped, which unlinking allows
+  std::move(previous_run_files_.begin(), previous_run_files_.end(),
+            std::back_inserter(unreferenced));
+  previous_run_files_.clear();
+  lock.unlock();
+
+  if (previous != 0 && previous != generation)
+    unreferenced.push_back(shared_file(previous));
+  for (const auto &file : unreferenced)
+    std::remove(file.c_str());
+  relock();
+}
+
+std::vector<std::string> StateSnapshotter::take_stale_files(
+    const std::vector<ShardChain> &committed) {
+  // Bases older than the committed one are unreferenced. Newer ones belong
+  // to generations still in flight and stay.
+  std::vector<std::string> files;
+  for (size_t shard = 0; shard < shard_count_; ++shard) {
+    auto &bases = bases_on_disk_[shard];
+    for (auto it = bases.begin();
+         it != bases.end() && *it < committed[shard].base_generation;) {
+      files.push_back(shard_file(*it, shard));
+      files.push_back(log_file(*it, shard));
+      it = bases.erase(it);
+    }
+  }
+  return files;
+}
+
+std::optional<SnapshotManifest> StateSnapshotter::load_manifest() const {
+  auto bytes = read_file(manifest_path_);
+  if (!bytes)
+    return std::nullopt;
+
+  try {
+    BinaryDeserializer in(bytes->data(), bytes->size());
+    if (in.read_uint32() != magic_ || in.read_uint32() != MANIFEST_VERSION) {
+      LOG(LogLevel::WARN, LogComponent::STATE_PERSIST,
+          "Snapshot manifest " << manifest_path_ << " is incompatible.");
+      return std::nullopt;
+    }
+    SnapshotManifest manifest;
+    manifest.generation = in.read_varint64();
+    manifest.watermark_ms = in.read_varint64();
+    uint32_t shards = in.read_varint32();
+    for (uint32_t i = 0; i < shards; ++i) {
+      manifest.shard_files.push_back(absolute(in.read_string_raw()));
+      std::string log = in.read_string_raw();
+      manifest.shard_logs.push_back(log.empty() ? log : absolute(log));
+      manifest.shard_log_bytes.push_back(in.read_varint64());
+      manifest.shard_watermarks_ms.push_back(in.read_varint64());
+    }
+    std::string shared = in.read_string_raw();
+    if (!shared.empty())
+      manifest.shared_file = absolute(shared);
+    return manifest;
+  } catch (const std::exception &e) {
+    LOG(LogLevel::WARN, LogComponent::STATE_PERSIST,
+        "Snapshot manifest " << manifest_path_ << " is corrupt: " << e.what());
+    return std::nullopt;
+  }
+}
+
+void StateSnapshotter::discard() {
+  flush();
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (auto manifest = load_manifest()) {
+    for (size_t shard = 0; shard < manifest->shard_files.size(); ++shard) {
+      std::remove(manifest->shard_files[shard].c_str());
+      if (!manifest->shard_logs[shard].empty())
+        std::remove(manifest->shard_logs[shard].c_str());
+    }
+    if (!manifest->shared_file.empty())
+      std::remove(manifest->shared_file.c_str());
+  }
+  std::remove(manifest_path_.c_str());
+  for (size_t shard = 0; shard < shard_count_; ++shard) {
+    for (uint64_t base : bases_on_disk_[shard]) {
+      std::remove(shard_file(base, shard).c_str());
+      std::remove(log_file(base, shard).c_str());
+    }
+    bases_on_disk_[shard].clear();
+  }
+  chains_.assign(shard_count_, ShardChain{});
+  pending_.clear();
+  previous_run_files_.clear();
+  compaction_due_ = true;
+}
+
+std::string StateSnapshotter::shard_file(uint64_t generation,
+                                         size_t shard) const {
+  return manifest_path_ + ".g" + std::to_string(generation) + ".s" +
+         std::to_string(shard);
+}
+
+std::string StateSnapshotter::log_file(uint64_t generation,
+                                       size_t shard) const {
+  return shard_file(generation, shard) + ".log";
+}
+
+std::string StateSnapshotter::shared_file(uint64_t generation) const {
+  return manifest_path_ + ".g" + std::to_string(generation) + ".shared";
+}
+
+std::string StateSnapshotter::absolute(const std::string &file_name) const {
+  size_t slash = manifest_path_.find_last_of('/');
+  if (slash == std::string::npos)
+    return file_name;
+  return manifest_path_.substr(0, slash + 1) + file_name;
+}
+
+bool StateSnapshotter::write_file(const std::string &path, const uint8_t *data,
+                                  size_t size) {
+  std::string temp_path = path + ".tmp";
+  {
+    std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+    if (!out) {
+      LOG(LogLevel::ERROR, LogComponent::STATE_PERSIST,
+          "Could not open snapshot file for writing: " << temp_path);
+      return false;
+    }
+    out.write(reinterpret_cast<const char *>(data),
+              static_cast<std::streamsize>(size));
+    if (!out) {
+      LOG(LogLevel::ERROR, LogComponent::STATE_PERSIST,
+          "Failed writing snapshot file: " << temp_path);
+      std::remove(temp_path.c_str());
+      return false;
+    }
+  }
+  if (std::rename(temp_path.c_str(), path.c_str()) != 0) {
+    LOG(LogLevel::ERROR, LogComponent::STATE_PERSIST,
+        "Could not rename snapshot file to final path: " << path);
+    std::remove(temp_path.c_str());
+    return false;
+  }
+  return true;
+}
+
+// Records are a 4-byte little-endian length followed by the payload. The
+// record is written at offset rather than appended so that a torn tail left
+// by an earlier failure is overwritten.
+bool StateSnapshotter::append_record(const std::string &path, uint64_t offset,
+                                     const uint8_t *data, size_t size) {
+  std::fstream out(path, std::ios::binary | std::ios::in | std::ios::out);
+  if (!out.is_open())
+    out.open(path, std::ios::binary | std::ios::out | std::ios::trunc);
+  if (!out.is_open()) {
+    LOG(LogLevel::ERROR, LogComponent::STATE_PERSIST,
+        "Could not open snapshot log for writing: " << path);
+    return false;
+  }
+  uint8_t header[LOG_RECORD_HEADER_BYTES];
+  for (size_t i = 0; i < LOG_RECORD_HEADER_BYTES; ++i)
+    header[i] = static_cast<uint8_t>(size >> (8 * i));
+  out.seekp(static_cast<std::streamoff>(offset));
+  out.write(reinterpret_cast<const char *>(header), sizeof(header));
+  out.write(reinterpret_cast<const char *>(data),
+            static_cast<std::streamsize>(size));
+  out.flush();
+  if (!out) {
+    LOG(LogLevel::ERROR, LogComponent::STATE_PERSIST,
+        "Failed appending to snapshot log: " << path);
+    return false;
+  }
+  return true;
+}
+
+size_t StateSnapshotter::replay_log(
+    const std::string &path, uint64_t committed_bytes,
+    const std::function<bool(const uint8_t *, size_t)> &apply) {
+  if (committed_bytes == 0)
+    return 0;
+  auto bytes = read_file(path);
+  if (!bytes || bytes->size() < committed_bytes) {
+    LOG(LogLevel::WARN, LogComponent::STATE_PERSIST,
+        "Snapshot log " << path << " is missing or shorter than committed.");
+    return 0;
+  }
+
+  size_t applied = 0;
+  uint64_t offset = 0;
+  while (offset + LOG_RECORD_HEADER_BYTES <= committed_bytes) {
+    uint64_t size = 0;
+    for (size_t i = 0; i < LOG_RECORD_HEADER_BYTES; ++i)
+      size |= static_cast<uint64_t>((*bytes)[offset + i]) << (8 * i);
+    offset += LOG_RECORD_HEADER_BYTES;
+    if (offset + size > committed_bytes ||
+        !apply(bytes->data() + offset, static_cast<size_t>(size)))
+      break;
+    offset += size;
+    ++applied;
+  }
+  return applied;
+}
+
+std::optional<std::vector<uint8_t>>
+StateSnapshotter::read_file(const std::string &path) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in)
+    return std::nullopt;
+  return std::vector<uint8_t>(std::istreambuf_iterator<char>(in),
+                              std::istreambuf_iterator<char>());
+}
+
+} // namespace core
@@ -0,0 +1,175 @@
+#ifndef STATE_SNAPSHOTTER_HPP
+#define STATE_SNAPSHOTTER_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace core {
+
+// The manifest is the commit point of a snapshot. Per worker shard it names
+// a full base file plus an append-only delta log, of which only the first
+// shard_log_bytes are part of this snapshot; a torn tail past that point is
+// ignored.
+struct SnapshotManifest {
+  uint64_t generation = 0;
+  // Every shard has applied all events up to this timestamp
+  uint64_t watermark_ms = 0;
+  std::vector<std::string> shard_files;
+  std::vector<std::string> shard_logs;
+  std::vector<uint64_t> shard_log_bytes;
+  std::vector<uint64_t> shard_watermarks_ms;
+  std::string shared_file;
+};
+
+// Coordinates sharded background snapshots of the worker engines.
+//
+// request_snapshot() opens a new generation. Each worker notices it between
+// events, encodes its own state in memory and hands the buffer to submit(),
+// so ingestion only pauses for the encode. Most generations are deltas: only
+// the entities dirtied since the shard's previous checkpoint, appended to the
+// shard's log. Every compaction_interval deltas, or once a shard's log has
+// outgrown its base, the next generation is full and starts a new base and
+// an empty log, so checkpoint I/O follows churn rather than total state.
+//
+// Once all shards of a generation are on disk the shared state is written
+// and the manifest is atomically replaced. Files no longer referenced are
+// removed afterwards, so a crash at any point leaves the previous manifest
+// and everything it references intact.
+class StateSnapshotter {
+public:
+  using SharedStateEncoder = std::function<std::vector<uint8_t>()>;
+
+  StateSnapshotter(std::string manifest_path, size_t shard_count,
+                   uint32_t magic, size_t compaction_interval = 20,
+                   size_t writer_threads = 2);
+  ~StateSnapshotter();
+
+  StateSnapshotter(const StateSnapshotter &) = delete;
+  StateSnapshotter &operator=(const StateSnapshotter &) = delete;
+
+  // Encodes state owned by no single worker (e.g. shared path statistics)
+  void set_shared_state_encoder(SharedStateEncoder encoder);
+
+  // Opens a new generation. Pass full to force a compaction.
+  uint64_t request_snapshot(bool full = false);
+  uint64_t requested_generation() const {
+    return requested_generation_.load(std::memory_order_acquire);
+  }
+  uint64_t committed_generation() const {
+    return committed_generation_.load(std::memory_order_acquire);
+  }
+
+  // True when the shard's next submission must be a full base rather than
+  // a delta against the base and log it has already written
+  bool full_snapshot_due(size_t shard) const;
+
+  void submit(size_t shard, uint64_t generation, uint64_t watermark_ms,
+              std::vector<uint8_t> blob, bool full);
+
+  // Blocks until every submitted shard has been written and committed
+  void flush();
+
+  std::optional<SnapshotManifest> load_manifest() const;
+  static std::optional<std::vector<uint8_t>> read_file(const std::string &path);
+
+  // Calls apply for each record in the first committed_bytes of a delta log
+  // and stops at the first one it rejects. Returns the records applied.
+  static size_t
+  replay_log(const std::string &path, uint64_t committed_bytes,
+             const std::function<bool(const uint8_t *, size_t)> &apply);
+
+  // Removes the manifest and every file it references
+  void discard();
+
+  size_t shard_count() const { return shard_count_; }
+
+private:
+  struct Job {
+    size_t shard;
+    uint64_t generation;
+    uint64_t watermark_ms;
+    std::vector<uint8_t> blob;
+    bool full;
+  };
+
+  // Where a shard's checkpoint chain stands on disk
+  struct ShardChain {
+    uint64_t base_generation = 0;
+    uint64_t base_bytes = 0;
+    uint64_t log_bytes = 0;
+    uint64_t watermark_ms = 0;
+  };
+
+  struct PendingGeneration {
+    std::vector<bool> written;
+    std::vector<ShardChain> chains;
+    size_t remaining;
+  };
+
+  void writer_loop();
+  bool write_job(Job &job, std::unique_lock<std::mutex> &lock);
+  void on_shard_written(const Job &job, std::unique_lock<std::mutex> &lock);
+  void commit(uint64_t generation, const PendingGeneration &pending,
+              std::unique_lock<std::mutex> &lock);
+  std::vector<std::string>
+  take_stale_files(const std::vector<ShardChain> &committed);
+
+  std::string shard_file(uint64_t generation, size_t shard) const;
+  std::string log_file(uint64_t generation, size_t shard) const;
+  std::string shared_file(uint64_t generation) const;
+  std::string absolute(const std::string &file_name) const;
+
+  static bool write_file(const std::string &path, const uint8_t *data,
+                         size_t size);
+  static bool append_record(const std::string &path, uint64_t offset,
+                            const uint8_t *data, size_t size);
+
+  std::string manifest_path_;
+  size_t shard_count_;
+  uint32_t magic_;
+  size_t compaction_interval_;
+  SharedStateEncoder shared_encoder_;
+
+  std::atomic<uint64_t> requested_generation_{0};
+  std::atomic<uint64_t> committed_generation_{0};
+
+  mutable std::mutex mutex_;
+  // Held by commit() across the shared state encode and the file writes,
+  // without mutex_, so manifests are written in generation order while
+  // workers keep submitting
+  std::mutex commit_mutex_;
+  std::condition_variable jobs_cv_;
+  std::condition_variable idle_cv_;
+  std::deque<Job> jobs_;
+  size_t jobs_in_flight_ = 0;
+  std::map<uint64_t, PendingGeneration> pending_;
+  bool stopping_ = false;
+  std::vector<std::thread> writers_;
+
+  // Jobs of one shard are written in submission order, one at a time
+  std::vector<bool> shard_busy_;
+  std::vector<ShardChain> chains_;
+  std::vector<uint64_t> last_submitted_;
+  // Base generations per shard that are on disk and not yet removed
+  std::vector<std::set<uint64_t>> bases_on_disk_;
+  // Files of the manifest found at startup, removed by the first commit
+  std::vector<std::string> previous_run_files_;
+  uint64_t last_full_generation_ = 0;
+  size_t deltas_since_full_ = 0;
+  bool compaction_due_ = true;
+};
+
+} // namespace core
+
+#endif // STATE_SNAPSHOTTER_HPP
@@ -0,0 +1,79 @@
+#include "rule_counters.hpp"
+#include "core/prometheus_metrics_exporter.hpp"
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <utility>
+
+namespace detection {
+
+namespace {
+
+using Labels = std::map<std::string, std::string>;
+
+const std::array<Labels, kRuleGroupCount> &group_labels() {
+  static const std::array<Labels, kRuleGroupCount> labels = [] {
+    std::array<Labels, kRuleGroupCount> built;
+    for (size_t i = 0; i < kRuleGroupCount; ++i) {
+      auto group = static_cast<RuleGroup>(i);
+      built[i] = {{"tier", rule_group_tier(group)},
+                  {"rule", rule_group_name(group)}};
+    }
+    return built;
+  }();
+  return labels;
+}
+
+} // namespace
+
+void RuleCounterSet::add(std::shared_ptr<const RuleCounters> counters) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  counters_.push_back(std::move(counters));
+}
+
+bool RuleCounterSet::claim(
+    const prometheus::PrometheusMetricsExporter *exporter) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (std::find(exporters_.begin(), exporters_.end(), exporter) !=
+      exporters_.end())
+    return false;
+  exporters_.push_back(exporter);
+  return true;
+}
+
+void RuleCounterSet::publish(prometheus::PrometheusMetricsExporter &exporter) {
+  const auto &labels = group_labels();
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (size_t i = 0; i < kRuleGroupCount; ++i) {
+    const auto group = static_cast<RuleGroup>(i);
+    // Hits are read first, so a hit counted between the two loads never
+    // pushes the rate above the evaluations it belongs to
+    uint64_t hits = 0;
+    for (const auto &counters : counters_)
+      hits += counters->hits(group);
+    uint64_t evaluations = 0;
+    for (const auto &counters : counters_)
+      evaluations += counters->evaluations(group);
+    if (evaluations == 0)
+      continue;
+
+    if (evaluations > published_evaluations_[i])
+      exporter.increment_counter(
+          "ad_rule_evaluations_total", labels[i],
+          static_cast<double>(evaluations - published_evaluations_[i]));
+    if (hits > published_hits_[i])
+      exporter.increment_counter(
+          "ad_rule_hits_total", labels[i],
+          static_cast<double>(hits - published_hits_[i]));
+    published_evaluations_[i] = evaluations;
+    published_hits_[i] = hits;
+
+    exporter.set_gauge("ad_rule_hit_rate",
+                       static_cast<double>(hits) /
+                           static_cast<double>(evaluations),
+                       labels[i]);
+  }
+}
+
+} // namespace detection
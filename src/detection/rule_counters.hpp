@@ -0,0 +1,78 @@
+#ifndef RULE_COUNTERS_HPP
+#define RULE_COUNTERS_HPP
+
+#include "detection/rule_program.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace prometheus {
+class PrometheusMetricsExporter;
+} // namespace prometheus
+
+namespace detection {
+
+// Evaluation and hit counts of the built-in rule groups of one worker's
+// RuleEngine, indexed by RuleGroup. The worker is the only writer, so a
+// count is a relaxed load and store with no locked instruction, and each
+// instance fills cache lines of its own so workers never write to the same
+// line. The scrape thread folds the totals into Prometheus through the
+// RuleCounterSet the instance belongs to.
+class alignas(64) RuleCounters {
+public:
+  void add_evaluations(RuleGroup group, uint64_t count) {
+    bump(evaluations_[index(group)], count);
+  }
+  void add_hit(RuleGroup group) { bump(hits_[index(group)], 1); }
+
+  uint64_t evaluations(RuleGroup group) const {
+    return evaluations_[index(group)].load(std::memory_order_relaxed);
+  }
+  uint64_t hits(RuleGroup group) const {
+    return hits_[index(group)].load(std::memory_order_relaxed);
+  }
+
+private:
+  static size_t index(RuleGroup group) { return static_cast<size_t>(group); }
+  static void bump(std::atomic<uint64_t> &counter, uint64_t count) {
+    counter.store(counter.load(std::memory_order_relaxed) + count,
+                  std::memory_order_relaxed);
+  }
+
+  std::array<std::atomic<uint64_t>, kRuleGroupCount> evaluations_{};
+  std::array<std::atomic<uint64_t>, kRuleGroupCount> hits_{};
+};
+
+// The RuleCounters of every worker, published as one set of series. Each
+// scrape sums a group over all workers, so ad_rule_hit_rate is set once from
+// the process totals instead of by every worker in turn.
+class RuleCounterSet {
+public:
+  void add(std::shared_ptr<const RuleCounters> counters);
+
+  // True the first time it is called with exporter, so only one of the
+  // engines sharing the set registers its collector there
+  bool claim(const prometheus::PrometheusMetricsExporter *exporter);
+
+  // Adds what was counted since the last call to ad_rule_evaluations_total
+  // and ad_rule_hits_total, and sets ad_rule_hit_rate from the totals.
+  // Groups never evaluated are left out.
+  void publish(prometheus::PrometheusMetricsExporter &exporter);
+
+private:
+  std::mutex mutex_;
+  std::vector<std::shared_ptr<const RuleCounters>> counters_;
+  std::vector<const prometheus::PrometheusMetricsExporter *> exporters_;
+  // Totals already added to the exporter
+  std::array<uint64_t, kRuleGroupCount> published_evaluations_{};
+  std::array<uint64_t, kRuleGroupCount> published_hits_{};
+};
+
+} // namespace detection
+
+#endif // RULE_COUNTERS_HPP
@@ -2,15 +2,16 @@
 #include "analysis/analyzed_event.hpp"
 #include "core/alert.hpp"
 #include "core/alert_manager.hpp"
+#include "core/alert_throttle.hpp"
 #include "core/config.hpp"
 #include "core/log_entry.hpp"
 #include "core/logger.hpp"
 #include "core/metrics_manager.hpp"
 #include "core/prometheus_metrics_exporter.hpp"
+#include "detection/rule_counters.hpp"
 #include "io/threat_intel/intel_manager.hpp"
 #include "models/model_manager.hpp"
 #include "rules/scoring.hpp"
-#include "utils/aho_corasick.hpp"
 #include "utils/scoped_timer.hpp"
 #include "utils/sliding_window.hpp"
 #include "utils/utils.hpp"
@@ -20,52 +21,59 @@
 #include <cstdint>
 #include <cstdlib>
 #include <fstream>
+#include <iterator>
 #include <memory>
 #include <optional>
 #include <string>
 #include <sys/types.h>
+#include <vector>
+
+namespace {
+
+// Throttle identity of a compiled rule, so that the rules of one group (and
+// reasons carrying live counts) throttle per rule. Name hashes are spread
+// over all 64 bits and practically never land in this range.
+uint64_t compiled_rule_id(detection::RuleId id) {
+  return (uint64_t{1} << 32) | static_cast<uint64_t>(id);
+}
+
+// IPv6 addresses do not fit ip_string_to_uint32 and come back as 0
+bool contains_event_ip(const Utils::IpPrefixSet &set, uint32_t ip_u32,
+                       std::string_view ip) {
+  return ip_u32 != 0 ? set.contains(ip_u32) : set.contains(ip);
+}
+
+} // namespace
 
 // =================================================================================
 // Public Interface & Constructor
 // =================================================================================
 
 RuleEngine::RuleEngine(AlertManager &manager, const Config::AppConfig &cfg,
-                       std::shared_ptr<ModelManager> model_manager)
-    : alert_mgr(manager), app_config(cfg), model_manager_(model_manager) {
+                       std::shared_ptr<ModelManager> model_manager,
+                       std::shared_ptr<IpAllowlist> ip_allowlist,
+                       std::shared_ptr<detection::RuleCounterSet> rule_counters)
+    : alert_mgr(manager), app_config(cfg),
+      ip_allowlist_(std::move(ip_allowlist)), model_manager_(model_manager),
+      rule_counter_set_(std::move(rule_counters)) {
   LOG(LogLevel::INFO, LogComponent::RULES_EVAL,
       "RuleEngine created and initialised.");
 
-  if (!app_config.allowlist_path.empty()) {
-    if (load_ip_allowlist(app_config.allowlist_path))
-      LOG(LogLevel::INFO, LogComponent::RULES_EVAL,
-          "IP Allowlist loaded successfully: " << cidr_allowlist_cache_.size()
-                                               << " entries.");
-    else
-      LOG(LogLevel::ERROR, LogComponent::RULES_EVAL,
-          "Failed to load IP allowlist from: " << app_config.allowlist_path);
+  if (!ip_allowlist_) {
+    owns_ip_allowlist_ = true;
+    ip_allowlist_ = std::make_shared<IpAllowlist>();
+    if (!app_config.allowlist_path.empty())
+      ip_allowlist_->publish(load_ip_allowlist(app_config.allowlist_path));
   }
+  allowlist_reader_ = IpAllowlist::Reader(ip_allowlist_.get());
 
-  if (!app_config.tier1.suspicious_path_substrings.empty()) {
-    suspicious_path_matcher_ = std::make_unique<Utils::AhoCorasick>(
-        app_config.tier1.suspicious_path_substrings);
-    LOG(LogLevel::DEBUG, LogComponent::RULES_EVAL,
-        "Initialized suspicious path matcher with "
-            << app_config.tier1.suspicious_path_substrings.size()
-            << " patterns.");
-  }
-  if (!app_config.tier1.suspicious_ua_substrings.empty()) {
-    suspicious_ua_matcher_ = std::make_unique<Utils::AhoCorasick>(
-        app_config.tier1.suspicious_ua_substrings);
-    LOG(LogLevel::DEBUG, LogComponent::RULES_EVAL,
-        "Initialized suspicious UA matcher with "
-            << app_config.tier1.suspicious_ua_substrings.size()
-            << " patterns.");
-  }
+  if (!rule_counter_set_)
+    rule_counter_set_ = std::make_shared<detection::RuleCounterSet>();
+  rule_counter_set_->add(rule_counters_);
 
-  if (app_config.threat_intel.enabled)
-    intel_manager_ = std::make_shared<IntelManager>(
-        app_config.threat_intel.feed_urls,
-        app_config.threat_intel.update_interval_seconds);
+  program_ = std::make_shared<const detection::RuleProgram>(app_config);
+  LOG(LogLevel::DEBUG, LogComponent::RULES_EVAL,
+      "Compiled " << program_->rule_count() << " Tier 1/2 rules.");
 }
 
 RuleEngine::~RuleEngine() {}
@@ -94,57 +102,32 @@ void RuleEngine::evaluate_rules(const AnalyzedEvent &event_ref) {
                 "Latency of evaluating Tier 2 (Statistical) rules.")
           : nullptr;
 
-  static Histogram *tier3_timer =
-      app_config.monitoring.enable_deep_timing
-          ? MetricsManager::instance().register_histogram(
-                "ad_rules_tier3_duration_seconds",
-                "Latency of evaluating Tier 3 (ML) rules.")
-          : nullptr;
-
-  // Prometheus metrics for rule evaluation
-  // auto start_time = std::chrono::high_resolution_clock::now();
+  // Alerts share one owned snapshot per event, built on the first hit
+  alert_context_.reset();
 
   // --- Pre-checks: Threat Intel and Allowlist ---
-  uint32_t event_ip_u32 =
-      Utils::ip_string_to_uint32(event_ref.raw_log.ip_address);
-  if (event_ip_u32 != 0)
-    if (intel_manager_ && intel_manager_->is_blacklisted(event_ip_u32)) {
-      LOG(LogLevel::DEBUG, LogComponent::IO_THREATINTEL,
-          "IP " << event_ref.raw_log.ip_address
-                << " found on threat intelligence blacklist. Creating alert "
-                   "and stopping further evaluation.");
-      create_and_record_alert(
-          event_ref, "IP is on external threat intelligence blacklist",
-          AlertTier::TIER1_HEURISTIC, AlertAction::BLOCK,
-          "Block IP immediately; listed on external threat feed.", 100.0,
-          event_ref.raw_log.ip_address);
-      return;
-    }
-
-  for (const auto &block : cidr_allowlist_cache_) {
-    if (block.contains(event_ip_u32)) {
-      LOG(LogLevel::DEBUG, LogComponent::RULES_EVAL,
-          "IP " << event_ref.raw_log.ip_address
-                << " is on the allowlist. Skipping all rule evaluation.");
-      return;
-    }
+  switch (screen_ip(event_ref)) {
+  case IpScreening::BLACKLISTED:
+    raise_blacklist_alert(event_ref);
+    return;
+  case IpScreening::ALLOWLISTED:
+    return;
+  case IpScreening::EVALUATE:
+    break;
   }
 
-  const auto event = std::make_shared<const AnalyzedEvent>(event_ref);
+  // Both tiers read the same record, extracted once
+  detection::FeatureRecord features;
+  if (app_config.tier1.enabled || app_config.tier2.enabled)
+    program_->extract(event_ref, features);
 
   if (app_config.tier1.enabled) {
     std::optional<ScopedTimer> t =
         tier1_timer ? std::optional<ScopedTimer>(*tier1_timer) : std::nullopt;
 
     LOG(LogLevel::DEBUG, LogComponent::RULES_EVAL,
-        "Evaluating Tier 1 rules for IP: " << event->raw_log.ip_address);
-    check_requests_per_ip_rule(*event);
-    check_failed_logins_rule(*event);
-    check_user_agent_rules(*event);
-    check_suspicious_string_rules(*event);
-    check_asset_ratio_rule(*event);
-    check_new_seen_rules(*event);
-    check_session_rules(*event);
+        "Evaluating Tier 1 rules for IP: " << event_ref.raw_log.ip_address);
+    evaluate_program(detection::RuleTier::HEURISTIC, event_ref, features);
   } else
     LOG(LogLevel::TRACE, LogComponent::RULES_EVAL,
         "Tier 1 rules are disabled.");
@@ -154,21 +137,169 @@ void RuleEngine::evaluate_rules(const AnalyzedEvent &event_ref) {
         tier2_timer ? std::optional<ScopedTimer>(*tier2_timer) : std::nullopt;
 
     LOG(LogLevel::DEBUG, LogComponent::RULES_EVAL,
-        "Evaluating Tier 2 rules for IP: " << event->raw_log.ip_address);
-    check_ip_zscore_rules(*event);
-    check_path_zscore_rules(*event);
-    check_historical_comparison_rules(*event);
+        "Evaluating Tier 2 rules for IP: " << event_ref.raw_log.ip_address);
+    evaluate_program(detection::RuleTier::STATISTICAL, event_ref, features);
   } else
     LOG(LogLevel::TRACE, LogComponent::RULES_EVAL,
         "Tier 2 rules are disabled.");
 
+  evaluate_tier3_and_tier4(event_ref);
+
+  alert_context_.reset();
+
+  LOG(LogLevel::TRACE, LogComponent::RULES_EVAL,
+      "Exiting evaluate_rules for IP: " << event_ref.raw_log.ip_address);
+}
+
+void RuleEngine::evaluate_rules_batched(AnalyzedEvent &&event) {
+  const size_t batch_size = std::min<size_t>(
+      app_config.rule_batch_size, detection::FeatureBlock::kLanes);
+  if (batch_size <= 1) {
+    flush_rule_batch();
+    evaluate_rules(event);
+    return;
+  }
+
+  // The whole batch is evaluated by the program its inputs were extracted
+  // for, even if a reconfigure lands in between
+  if (pending_events_.empty())
+    pending_program_ = program_;
+  detection::FeatureRecord features;
+  pending_program_->extract(event, features);
+  pending_features_.append(features);
+
+  // The session handle is only valid until the analysis engine's next event,
+  // so the queued event carries a snapshot instead
+  if (event.raw_session_state) {
+    if (!event.session_snapshot)
+      event.session_snapshot.emplace(*event.raw_session_state);
+    event.raw_session_state = nullptr;
+  }
+  pending_events_.push_back(std::move(event));
+
+  if (pending_events_.size() >= batch_size)
+    flush_rule_batch();
+}
+
+void RuleEngine::flush_rule_batch() {
+  if (pending_events_.empty())
+    return;
+  static Histogram *batch_timer = MetricsManager::instance().register_histogram(
+      "ad_rule_engine_batch_evaluation_duration_seconds",
+      "Latency of evaluating one batch of events in "
+      "RuleEngine::flush_rule_batch.");
+  ScopedTimer timer(*batch_timer);
+
+  const detection::RuleProgram &program = *pending_program_;
+  const detection::FeatureBlock &block = pending_features_;
+  const size_t count = pending_events_.size();
+
+  // Screen every lane up front so the rule groups count the same
+  // evaluations as the per-event path
+  uint64_t blacklisted = 0;
+  uint64_t evaluated = 0;
+  for (size_t lane = 0; lane < count; ++lane) {
+    uint64_t bit = uint64_t{1} << lane;
+    switch (screen_ip(pending_events_[lane])) {
+    case IpScreening::BLACKLISTED:
+      blacklisted |= bit;
+      break;
+    case IpScreening::ALLOWLISTED:
+      break;
+    case IpScreening::EVALUATE:
+      evaluated |= bit;
+      break;
+    }
+  }
+
+  std::array<uint64_t, detection::kRuleCount> hits{};
+  uint64_t hit_lanes = 0;
+  if (evaluated) {
+    const uint64_t evaluations = __builtin_popcountll(evaluated);
+    for (detection::RuleTier tier :
+         {detection::RuleTier::HEURISTIC, detection::RuleTier::STATISTICAL}) {
+      for (detection::RuleGroup group : program.groups(tier))
+        track_rule_evaluation(group, evaluations);
+      hit_lanes |= program.evaluate(tier, block, hits);
+    }
+    hit_lanes &= evaluated;
+  }
+
+  // Alerts are raised event by event, in the order the per-event path would
+  // raise them
+  for (size_t lane = 0; lane < count; ++lane) {
+    const AnalyzedEvent &event = pending_events_[lane];
+    uint64_t bit = uint64_t{1} << lane;
+    alert_context_.reset();
+    if (blacklisted & bit) {
+      raise_blacklist_alert(event);
+      continue;
+    }
+    if (!(evaluated & bit))
+      continue;
+    if (hit_lanes & bit) {
+      detection::FeatureRecord features = block.record(lane);
+      for (size_t id = 0; id < detection::kRuleCount; ++id)
+        if (hits[id] & bit)
+          fire_rule(program, static_cast<detection::RuleId>(id), event,
+                    features);
+    }
+    evaluate_tier3_and_tier4(event);
+  }
+  alert_context_.reset();
+
+  pending_events_.clear();
+  pending_features_.clear();
+  pending_program_.reset();
+}
+
+RuleEngine::IpScreening RuleEngine::screen_ip(const AnalyzedEvent &event) {
+  uint32_t event_ip_u32 = Utils::ip_string_to_uint32(event.raw_log.ip_address);
+  const Utils::IpPrefixSet *blacklist = intel_blacklist_.get();
+  if (blacklist &&
+      contains_event_ip(*blacklist, event_ip_u32, event.raw_log.ip_address)) {
+    LOG(LogLevel::DEBUG, LogComponent::IO_THREATINTEL,
+        "IP " << event.raw_log.ip_address
+              << " found on threat intelligence blacklist. Creating alert "
+                 "and stopping further evaluation.");
+    return IpScreening::BLACKLISTED;
+  }
+
+  const Utils::IpPrefixSet *allowlist = allowlist_reader_.get();
+  if (allowlist &&
+      contains_event_ip(*allowlist, event_ip_u32, event.raw_log.ip_address)) {
+    LOG(LogLevel::DEBUG, LogComponent::RULES_EVAL,
+        "IP " << event.raw_log.ip_address
+              << " is on the allowlist. Skipping all rule evaluation.");
+    return IpScreening::ALLOWLISTED;
+  }
+  return IpScreening::EVALUATE;
+}
+
+void RuleEngine::raise_blacklist_alert(const AnalyzedEvent &event) {
+  create_and_record_alert(
+      event, "tier1_threat_intel",
+      "IP is on external threat intelligence blacklist",
+      AlertTier::TIER1_HEURISTIC, AlertAction::BLOCK,
+      "Block IP immediately; listed on external threat feed.", 100.0,
+      event.raw_log.ip_address);
+}
+
+void RuleEngine::evaluate_tier3_and_tier4(const AnalyzedEvent &event_ref) {
+  static Histogram *tier3_timer =
+      app_config.monitoring.enable_deep_timing
+          ? MetricsManager::instance().register_histogram(
+                "ad_rules_tier3_duration_seconds",
+                "Latency of evaluating Tier 3 (ML) rules.")
+          : nullptr;
+
   if (app_config.tier3.enabled) {
     std::optional<ScopedTimer> t =
         tier3_timer ? std::optional<ScopedTimer>(*tier3_timer) : std::nullopt;
 
     LOG(LogLevel::DEBUG, LogComponent::RULES_EVAL,
-        "Evaluating Tier 3 rules for IP: " << event->raw_log.ip_address);
-    check_ml_rules(*event);
+        "Evaluating Tier 3 rules for IP: " << event_ref.raw_log.ip_address);
+    check_ml_rules(event_ref);
   } else
     LOG(LogLevel::TRACE, LogComponent::RULES_EVAL,
         "Tier 3 rules are disabled.");
@@ -177,7 +308,7 @@ void RuleEngine::evaluate_rules(const AnalyzedEvent &event_ref) {
   if (app_config.tier4.enabled && tier4_detector_) {
     auto start_time = std::chrono::high_resolution_clock::now();
 
-    evaluate_tier4_rules(*event);
+    evaluate_tier4_rules(event_ref);
 
     // Track processing time
     if (metrics_exporter_) {
@@ -198,34 +329,34 @@ void RuleEngine::evaluate_rules(const AnalyzedEvent &event_ref) {
       warning_logged = true;
     }
   }
-
-  LOG(LogLevel::TRACE, LogComponent::RULES_EVAL,
-      "Exiting evaluate_rules for IP: " << event_ref.raw_log.ip_address);
 }
 
-bool RuleEngine::load_ip_allowlist(const std::string &filepath) {
+std::shared_ptr<const Utils::IpPrefixSet>
+RuleEngine::load_ip_allowlist(const std::string &filepath) {
   LOG(LogLevel::DEBUG, LogComponent::RULES_EVAL,
       "Loading IP allowlist from: " << filepath);
   std::ifstream allowlist_file(filepath);
   if (!allowlist_file.is_open()) {
     LOG(LogLevel::ERROR, LogComponent::RULES_EVAL,
         "Could not open allowlist file: " << filepath);
-    return false;
-  }
-  std::string ip_line;
-  while (std::getline(allowlist_file, ip_line)) {
-    std::string trimmed_line = Utils::trim_copy(ip_line);
-    if (!trimmed_line.empty() && trimmed_line[0] != '#') {
-      if (auto cidr_opt = Utils::parse_cidr(trimmed_line)) {
-        cidr_allowlist_cache_.push_back(*cidr_opt);
-        LOG(LogLevel::TRACE, LogComponent::RULES_EVAL,
-            "Added CIDR to allowlist: " << trimmed_line);
-      } else
-        LOG(LogLevel::WARN, LogComponent::RULES_EVAL,
-            "Could not parse allowlist entry: " << trimmed_line);
-    }
+    return nullptr;
   }
-  return true;
+  std::string contents((std::istreambuf_iterator<char>(allowlist_file)),
+                       std::istreambuf_iterator<char>());
+  std::vector<Utils::IpPrefix> prefixes;
+  size_t rejected = 0;
+  Utils::parse_ip_prefix_list(contents, prefixes, &rejected);
+  if (rejected > 0)
+    LOG(LogLevel::WARN, LogComponent::RULES_EVAL,
+        "Could not parse " << rejected << " allowlist entries in "
+                           << filepath);
+
+  auto allowlist =
+      std::make_shared<const Utils::IpPrefixSet>(std::move(prefixes));
+  LOG(LogLevel::INFO, LogComponent::RULES_EVAL,
+      "IP Allowlist loaded successfully: " << allowlist->prefix_count()
+                                           << " entries.");
+  return allowlist;
 }
 
 void RuleEngine::reconfigure(const Config::AppConfig &new_config) {
@@ -233,34 +364,16 @@ void RuleEngine::reconfigure(const Config::AppConfig &new_config) {
       "RuleEngine is being reconfigured.");
   app_config = new_config;
 
-  cidr_allowlist_cache_.clear();
-  if (!app_config.allowlist_path.empty())
-    load_ip_allowlist(app_config.allowlist_path);
-
-  // Re-build the Aho-Corasick matchers
-  if (!app_config.tier1.suspicious_path_substrings.empty()) {
-    suspicious_path_matcher_ = std::make_unique<Utils::AhoCorasick>(
-        app_config.tier1.suspicious_path_substrings);
-    LOG(LogLevel::DEBUG, LogComponent::RULES_EVAL,
-        "Re-initialized suspicious path matcher.");
-  } else {
-    suspicious_path_matcher_.reset();
-  }
-
-  if (!app_config.tier1.suspicious_ua_substrings.empty()) {
-    suspicious_ua_matcher_ = std::make_unique<Utils::AhoCorasick>(
-        app_config.tier1.suspicious_ua_substrings);
-    LOG(LogLevel::DEBUG, LogComponent::RULES_EVAL,
-        "Re-initialized suspicious UA matcher.");
-  } else
-    suspicious_ua_matcher_.reset();
+  if (owns_ip_allowlist_)
+    ip_allowlist_->publish(app_config.allowlist_path.empty()
+                               ? nullptr
+                               : load_ip_allowlist(app_config.allowlist_path));
 
-  if (new_config.threat_intel.enabled) {
-    intel_manager_ = std::make_shared<IntelManager>(
-        new_config.threat_intel.feed_urls,
-        new_config.threat_intel.update_interval_seconds);
-  } else
-    intel_manager_.reset();
+  // Thresholds and matchers are baked into the program; a batch already
+  // queued keeps the program it was extracted for
+  program_ = std::make_shared<const detection::RuleProgram>(app_config);
+  LOG(LogLevel::DEBUG, LogComponent::RULES_EVAL,
+      "Recompiled " << program_->rule_count() << " Tier 1/2 rules.");
 
   LOG(LogLevel::INFO, LogComponent::RULES_EVAL,
       "RuleEngine has been reconfigured successfully.");
@@ -270,12 +383,21 @@ void RuleEngine::reconfigure(const Config::AppConfig &new_config) {
 // Private Helper Functions
 // =================================================================================
 
-void RuleEngine::create_and_record_alert(const AnalyzedEvent &event,
+std::shared_ptr<const AnalyzedEvent>
+RuleEngine::get_alert_context(const AnalyzedEvent &event) {
+  if (!alert_context_)
+    alert_context_ = event.materialize();
+  return alert_context_;
+}
+
+bool RuleEngine::create_and_record_alert(const AnalyzedEvent &event,
+                                         std::string_view rule,
                                          std::string_view reason,
                                          AlertTier tier, AlertAction action,
                                          std::string_view action_str,
                                          double score,
-                                         std::string_view key_id) {
+                                         std::string_view key_id,
+                                         uint64_t rule_id) {
   static TimeWindowCounter *alerts_counter =
       MetricsManager::instance().register_time_window_counter(
           "ad_alerts_generated", "Timestamped counter for recorded alerts to "
@@ -286,59 +408,7 @@ void RuleEngine::create_and_record_alert(const AnalyzedEvent &event,
   if (score <= 0.0) {
     LOG(LogLevel::TRACE, LogComponent::RULES_EVAL,
         "Score is <= 0.0, not creating alert for reason: " << reason);
-    return;
-  }
-
-  // Extract rule name from reason for metrics tracking
-  std::string rule_name;
-  if (reason.find("High request rate") != std::string::npos) {
-    rule_name = "tier1_requests_per_ip";
-  } else if (reason.find("Multiple failed login attempts") !=
-             std::string::npos) {
-    rule_name = "tier1_failed_logins";
-  } else if (reason.find("Request path contains a suspicious pattern") !=
-             std::string::npos) {
-    rule_name = "tier1_suspicious_string";
-  } else if (reason.find("User-Agent contains a suspicious pattern") !=
-             std::string::npos) {
-    rule_name = "tier1_suspicious_string";
-  } else if (reason.find("missing User-Agent") != std::string::npos ||
-             reason.find("known malicious User-Agent") != std::string::npos ||
-             reason.find("headless browser") != std::string::npos ||
-             reason.find("outdated browser") != std::string::npos ||
-             reason.find("cycling through different User-Agents") !=
-                 std::string::npos) {
-    rule_name = "tier1_user_agent";
-  } else if (reason.find("Low Asset-to-HTML request ratio") !=
-             std::string::npos) {
-    rule_name = "tier1_asset_ratio";
-  } else if (reason.find("failed logins within a single session") !=
-                 std::string::npos ||
-             reason.find("high request rate within a single session") !=
-                 std::string::npos ||
-             reason.find("User-Agent changed") != std::string::npos) {
-    rule_name = "tier1_session";
-  } else if (reason.find("Anomalous IP") != std::string::npos) {
-    rule_name = "tier2_ip_zscore";
-  } else if (reason.find("Anomalous") != std::string::npos &&
-             reason.find("for path") != std::string::npos) {
-    rule_name = "tier2_path_zscore";
-  } else if (reason.find("Newly seen IP immediately accessed") !=
-                 std::string::npos ||
-             reason.find("high error rate") != std::string::npos) {
-    rule_name = "tier1_new_seen";
-  } else if (reason.find("Sudden performance degradation") !=
-             std::string::npos) {
-    rule_name = "tier2_historical_comparison";
-  } else if (reason.find("ML model") != std::string::npos) {
-    rule_name = "tier3_ml";
-  } else {
-    rule_name = "unknown_rule";
-  }
-
-  // Track rule hit for metrics
-  if (!rule_name.empty()) {
-    track_rule_hit(rule_name);
+    return false;
   }
 
   // Track alert metrics by tier
@@ -382,7 +452,7 @@ void RuleEngine::create_and_record_alert(const AnalyzedEvent &event,
     metrics_exporter_->increment_counter("ad_alerts_generated_total",
                                          {{"tier", tier_str},
                                           {"action", action_str_metric},
-                                          {"rule", rule_name}});
+                                          {"rule", std::string(rule)}});
 
     // Track alert score distribution
     metrics_exporter_->observe_histogram("ad_alert_score_distribution", score,
@@ -392,418 +462,309 @@ void RuleEngine::create_and_record_alert(const AnalyzedEvent &event,
   LOG(LogLevel::INFO, LogComponent::RULES_EVAL,
       "Creating alert for IP " << event.raw_log.ip_address << " with score "
                                << score << ". Reason: " << reason);
-  alert_mgr.record_alert(Alert(std::make_shared<const AnalyzedEvent>(event),
-                               reason, tier, action, action_str, score,
-                               key_id));
+  Alert alert(get_alert_context(event), reason, tier, action, action_str,
+              score, key_id);
+  alert.rule_id = rule_id != 0 ? rule_id : AlertThrottle::name_id(rule);
+  alert_mgr.record_alert(alert);
+  return true;
+}
+
+void RuleEngine::record_rule_alert(detection::RuleId id,
+                                   const AnalyzedEvent &event,
+                                   std::string_view reason, AlertTier tier,
+                                   AlertAction action,
+                                   std::string_view action_str, double score,
+                                   std::string_view key_id) {
+  detection::RuleGroup group = detection::rule_group(id);
+  if (create_and_record_alert(event, detection::rule_group_name(group), reason,
+                              tier, action, action_str, score, key_id,
+                              compiled_rule_id(id)))
+    track_rule_hit(group);
 }
 
 // =================================================================================
-// Tier 1: Heuristic Rules
+// Tier 1 & 2: Compiled Heuristic and Statistical Rules
 // =================================================================================
 
-void RuleEngine::check_requests_per_ip_rule(const AnalyzedEvent &event) {
-  LOG(LogLevel::TRACE, LogComponent::RULES_T1_HEURISTIC,
-      "Checking 'requests_per_ip' rule...");
-  track_rule_evaluation("tier1_requests_per_ip");
-  if (event.current_ip_request_count_in_window &&
-      *event.current_ip_request_count_in_window >
-          app_config.tier1.max_requests_per_ip_in_window) {
-    LOG(LogLevel::DEBUG, LogComponent::RULES_T1_HEURISTIC,
-        "'requests_per_ip' TRIGGERED for IP "
-            << event.raw_log.ip_address << ". Count: "
-            << *event.current_ip_request_count_in_window << " > Threshold: "
-            << app_config.tier1.max_requests_per_ip_in_window);
-    double current_val = *event.current_ip_request_count_in_window;
-    double threshold = app_config.tier1.max_requests_per_ip_in_window;
-    double dangerous_val = threshold * 10;
-    double score =
-        Scoring::from_threshold(current_val, threshold, dangerous_val, 60.0);
-
-    std::string reason =
-        "High request rate from IP. Count: " +
-        std::to_string(*event.current_ip_request_count_in_window) +
-        " in last " +
-        std::to_string(app_config.tier1.sliding_window_duration_seconds) + "s.";
-    std::string action_str = "Consider rate-limiting IP; traffic volume "
-                             "exceeds configured threshold.";
-
-    create_and_record_alert(event, reason, AlertTier::TIER1_HEURISTIC,
-                            AlertAction::RATE_LIMIT, action_str, score,
-                            event.raw_log.ip_address);
-  }
+void RuleEngine::evaluate_program(detection::RuleTier tier,
+                                  const AnalyzedEvent &event,
+                                  const detection::FeatureRecord &features) {
+  for (detection::RuleGroup group : program_->groups(tier))
+    track_rule_evaluation(group);
+  program_->for_each_hit(tier, features, [&](detection::RuleId id) {
+    fire_rule(*program_, id, event, features);
+  });
 }
 
-void RuleEngine::check_failed_logins_rule(const AnalyzedEvent &event) {
-  LOG(LogLevel::TRACE, LogComponent::RULES_T1_HEURISTIC,
-      "Checking 'failed_logins' rule...");
-  track_rule_evaluation("tier1_failed_logins");
-  if (event.current_ip_failed_login_count_in_window &&
-      *event.current_ip_failed_login_count_in_window >
-          app_config.tier1.max_failed_logins_per_ip) {
-    LOG(LogLevel::DEBUG, LogComponent::RULES_T1_HEURISTIC,
-        "'failed_logins' TRIGGERED for IP "
-            << event.raw_log.ip_address
-            << ". Count: " << *event.current_ip_failed_login_count_in_window
-            << " > Threshold: " << app_config.tier1.max_failed_logins_per_ip);
-    double current_val = *event.current_ip_failed_login_count_in_window;
-    double threshold = app_config.tier1.max_failed_logins_per_ip;
-    double dangerous_val = threshold * 5;
-    double score = Scoring::from_threshold(current_val, threshold,
-                                           dangerous_val, 70.0, 99.0);
-
-    std::string reason =
-        "Multiple failed login attempts from IP. Count: " +
-        std::to_string(*event.current_ip_failed_login_count_in_window) +
-        " in last " +
-        std::to_string(app_config.tier1.sliding_window_duration_seconds) + "s.";
-    std::string action_str = "Investigate IP for brute-force/credential "
-                             "stuffing; consider blocking.";
-
-    create_and_record_alert(event, reason, AlertTier::TIER1_HEURISTIC,
-                            AlertAction::BLOCK, action_str, score,
-                            event.raw_log.ip_address);
-  }
-}
+void RuleEngine::fire_rule(const detection::RuleProgram &program,
+                           detection::RuleId id, const AnalyzedEvent &event,
+                           const detection::FeatureRecord &features) {
+  using detection::Feature;
+  using detection::RuleId;
+  const auto &t1 = app_config.tier1;
+  const auto &t2 = app_config.tier2;
+  std::string_view ip = event.raw_log.ip_address;
+  auto window_str = [&] {
+    return std::to_string(t1.sliding_window_duration_seconds) + "s.";
+  };
 
-void RuleEngine::check_suspicious_string_rules(const AnalyzedEvent &event) {
-  LOG(LogLevel::TRACE, LogComponent::RULES_T1_HEURISTIC,
-      "Checking 'suspicious_string' rules...");
-  track_rule_evaluation("tier1_suspicious_string");
-  if (suspicious_path_matcher_) {
-    auto matches =
-        suspicious_path_matcher_->find_all(event.raw_log.request_path);
-    if (!matches.empty()) {
-      LOG(LogLevel::DEBUG, LogComponent::RULES_T1_HEURISTIC,
-          "'suspicious_path' TRIGGERED for IP "
-              << event.raw_log.ip_address
-              << ". Path: " << event.raw_log.request_path
-              << " matched pattern: " << matches[0]);
-      create_and_record_alert(
-          event, "Request path contains a suspicious pattern: " + matches[0],
-          AlertTier::TIER1_HEURISTIC, AlertAction::BLOCK,
-          "High Priority: Block IP and investigate for exploit attempts",
-          app_config.tier1.score_suspicious_path, event.raw_log.ip_address);
-    }
+  switch (id) {
+  case RuleId::REQUESTS_PER_IP: {
+    size_t count = *event.current_ip_request_count_in_window;
+    double threshold = t1.max_requests_per_ip_in_window;
+    double score =
+        Scoring::from_threshold(count, threshold, threshold * 10, 60.0);
+    record_rule_alert(id, event,
+                      "High request rate from IP. Count: " +
+                          std::to_string(count) + " in last " + window_str(),
+                      AlertTier::TIER1_HEURISTIC, AlertAction::RATE_LIMIT,
+                      "Consider rate-limiting IP; traffic volume exceeds "
+                      "configured threshold.",
+                      score, ip);
+    break;
   }
-
-  if (suspicious_ua_matcher_) {
-    auto matches = suspicious_ua_matcher_->find_all(event.raw_log.user_agent);
-    if (!matches.empty()) {
-      LOG(LogLevel::DEBUG, LogComponent::RULES_T1_HEURISTIC,
-          "'suspicious_ua' TRIGGERED for IP "
-              << event.raw_log.ip_address
-              << ". UA matched pattern: " << matches[0]);
-      create_and_record_alert(
-          event, "User-Agent contains a suspicious pattern: " + matches[0],
-          AlertTier::TIER1_HEURISTIC, AlertAction::BLOCK,
-          "Block IP; known scanner/bot UA pattern",
-          app_config.tier1.score_known_bad_ua, event.raw_log.ip_address);
-    }
+  case RuleId::FAILED_LOGINS: {
+    size_t count = *event.current_ip_failed_login_count_in_window;
+    double threshold = t1.max_failed_logins_per_ip;
+    double score =
+        Scoring::from_threshold(count, threshold, threshold * 5, 70.0, 99.0);
+    record_rule_alert(id, event,
+                      "Multiple failed login attempts from IP. Count: " +
+                          std::to_string(count) + " in last " + window_str(),
+                      AlertTier::TIER1_HEURISTIC, AlertAction::BLOCK,
+                      "Investigate IP for brute-force/credential "
+                      "stuffing; consider blocking.",
+                      score, ip);
+    break;
   }
-}
-
-void RuleEngine::check_user_agent_rules(const AnalyzedEvent &event) {
-  LOG(LogLevel::TRACE, LogComponent::RULES_T1_HEURISTIC,
-      "Checking 'user_agent' rules...");
-  track_rule_evaluation("tier1_user_agent");
-  if (!app_config.tier1.check_user_agent_anomalies)
-    return;
-
-  if (event.is_ua_missing) {
-    LOG(LogLevel::DEBUG, LogComponent::RULES_T1_HEURISTIC,
-        "'ua_missing' TRIGGERED for IP " << event.raw_log.ip_address);
-    create_and_record_alert(
-        event, "Request with missing User-Agent", AlertTier::TIER1_HEURISTIC,
-        AlertAction::LOG, "Investigate IP for scripted activity",
-        app_config.tier1.score_missing_ua, event.raw_log.ip_address);
+  case RuleId::SUBNET_NARROW_VOLUME:
+  case RuleId::SUBNET_WIDE_VOLUME: {
+    bool narrow = id == RuleId::SUBNET_NARROW_VOLUME;
+    const analysis::SubnetActivity &act =
+        narrow ? *event.subnet_narrow_activity : *event.subnet_wide_activity;
+    double threshold = narrow ? t1.max_requests_per_subnet_narrow_in_window
+                              : t1.max_requests_per_subnet_wide_in_window;
+    std::string subnet =
+        analysis::SubnetRollup::format_prefix(ip, act.prefix_length);
+    double score = Scoring::from_threshold(act.requests, threshold,
+                                           threshold * 10.0, 55.0);
+    record_rule_alert(id, event,
+                      "High request rate from subnet " + subnet +
+                          ". Count: " + std::to_string(act.requests) +
+                          " from ~" + std::to_string(act.distinct_ips) +
+                          " IPs in last " + window_str(),
+                      AlertTier::TIER1_HEURISTIC, AlertAction::RATE_LIMIT,
+                      "Consider rate-limiting the subnet; traffic is "
+                      "distributed across many addresses.",
+                      score, subnet);
+    break;
   }
-
-  if (event.is_ua_known_bad) {
-    LOG(LogLevel::DEBUG, LogComponent::RULES_T1_HEURISTIC,
-        "'ua_known_bad' TRIGGERED for IP " << event.raw_log.ip_address);
-    create_and_record_alert(
-        event, "Request from a known malicious User-Agent signature",
-        AlertTier::TIER1_HEURISTIC, AlertAction::BLOCK,
-        "Block IP; known scanner/bot", app_config.tier1.score_known_bad_ua,
-        event.raw_log.ip_address);
+  case RuleId::SUBNET_FAILED_LOGINS: {
+    const analysis::SubnetActivity &act = *event.subnet_narrow_activity;
+    double threshold = t1.max_failed_logins_per_subnet;
+    std::string subnet =
+        analysis::SubnetRollup::format_prefix(ip, act.prefix_length);
+    double score = Scoring::from_threshold(act.failed_logins, threshold,
+                                           threshold * 5, 75.0, 99.0);
+    record_rule_alert(id, event,
+                      "Distributed failed logins from subnet " + subnet +
+                          ". Count: " + std::to_string(act.failed_logins) +
+                          " from ~" + std::to_string(act.distinct_ips) +
+                          " IPs in last " + window_str(),
+                      AlertTier::TIER1_HEURISTIC, AlertAction::BLOCK,
+                      "Investigate subnet for distributed credential "
+                      "stuffing; consider blocking the range.",
+                      score, subnet);
+    break;
   }
-
-  if (event.is_ua_headless) {
-    LOG(LogLevel::DEBUG, LogComponent::RULES_T1_HEURISTIC,
-        "'ua_headless' TRIGGERED for IP " << event.raw_log.ip_address);
-    create_and_record_alert(
-        event, "Request from a known headless browser signature",
+  case RuleId::UA_MISSING:
+    record_rule_alert(id, event, "Request with missing User-Agent",
+                      AlertTier::TIER1_HEURISTIC, AlertAction::LOG,
+                      "Investigate IP for scripted activity",
+                      t1.score_missing_ua, ip);
+    break;
+  case RuleId::UA_KNOWN_BAD:
+    record_rule_alert(id, event,
+                      "Request from a known malicious User-Agent signature",
+                      AlertTier::TIER1_HEURISTIC, AlertAction::BLOCK,
+                      "Block IP; known scanner/bot", t1.score_known_bad_ua,
+                      ip);
+    break;
+  case RuleId::UA_HEADLESS:
+    record_rule_alert(
+        id, event, "Request from a known headless browser signature",
         AlertTier::TIER1_HEURISTIC, AlertAction::CHALLENGE,
         "High likelihood of automated activity; monitor or challenge",
-        app_config.tier1.score_headless_browser, event.raw_log.ip_address);
-  }
-
-  if (event.is_ua_outdated) {
-    LOG(LogLevel::DEBUG, LogComponent::RULES_T1_HEURISTIC,
-        "'ua_outdated' TRIGGERED for IP " << event.raw_log.ip_address);
-    create_and_record_alert(
-        event,
+        t1.score_headless_browser, ip);
+    break;
+  case RuleId::UA_OUTDATED:
+    record_rule_alert(
+        id, event,
         "Request from outdated browser: " + event.detected_browser_version,
         AlertTier::TIER1_HEURISTIC, AlertAction::LOG,
         "Investigate IP for vulnerable client or bot activity",
-        app_config.tier1.score_outdated_browser, event.raw_log.ip_address);
-  }
-
-  if (event.is_ua_cycling) {
-    LOG(LogLevel::DEBUG, LogComponent::RULES_T1_HEURISTIC,
-        "'ua_cycling' TRIGGERED for IP " << event.raw_log.ip_address);
-    create_and_record_alert(
-        event, "IP rapidly cycling through different User-Agents",
+        t1.score_outdated_browser, ip);
+    break;
+  case RuleId::UA_CYCLING:
+    record_rule_alert(id, event,
+                      "IP rapidly cycling through different User-Agents",
+                      AlertTier::TIER1_HEURISTIC, AlertAction::BLOCK,
+                      "Very high likelihood of bot; consider blocking",
+                      t1.score_ua_cycling, ip);
+    break;
+  case RuleId::SUSPICIOUS_PATH:
+    record_rule_alert(
+        id, event,
+        "Request path contains a suspicious pattern: " +
+            program.suspicious_path_pattern(
+                static_cast<int>(features[Feature::SUSPICIOUS_PATH])),
         AlertTier::TIER1_HEURISTIC, AlertAction::BLOCK,
-        "Very high likelihood of bot; consider blocking",
-        app_config.tier1.score_ua_cycling, event.raw_log.ip_address);
-  }
-}
-
-void RuleEngine::check_asset_ratio_rule(const AnalyzedEvent &event) {
-  LOG(LogLevel::TRACE, LogComponent::RULES_T1_HEURISTIC,
-      "Checking 'asset_ratio' rule...");
-  track_rule_evaluation("tier1_asset_ratio");
-  const auto &cfg = app_config.tier1;
-
-  if (static_cast<size_t>(event.ip_html_requests_in_window) <
-      cfg.min_html_requests_for_ratio_check) {
-    LOG(LogLevel::TRACE, LogComponent::RULES_T1_HEURISTIC,
-        "Skipping asset_ratio check, not enough HTML requests ("
-            << event.ip_html_requests_in_window << "/"
-            << cfg.min_assets_per_html_ratio << ").");
-    return;
-  }
-
-  if (event.ip_assets_per_html_ratio &&
-      *event.ip_assets_per_html_ratio < cfg.min_assets_per_html_ratio) {
-    LOG(LogLevel::DEBUG, LogComponent::RULES_T1_HEURISTIC,
-        "'asset_ratio' TRIGGERED for IP "
-            << event.raw_log.ip_address
-            << ". Ratio: " << *event.ip_assets_per_html_ratio
-            << " < Threshold: " << cfg.min_assets_per_html_ratio);
-    double score = Scoring::from_threshold(cfg.min_assets_per_html_ratio,
-                                           *event.ip_assets_per_html_ratio, 0.1,
-                                           50.0, 95.0);
-    std::string reason =
+        "High Priority: Block IP and investigate for exploit attempts",
+        t1.score_suspicious_path, ip);
+    break;
+  case RuleId::SUSPICIOUS_UA:
+    record_rule_alert(id, event,
+                      "User-Agent contains a suspicious pattern: " +
+                          program.suspicious_ua_pattern(static_cast<int>(
+                              features[Feature::SUSPICIOUS_UA])),
+                      AlertTier::TIER1_HEURISTIC, AlertAction::BLOCK,
+                      "Block IP; known scanner/bot UA pattern",
+                      t1.score_known_bad_ua, ip);
+    break;
+  case RuleId::ASSET_RATIO: {
+    double ratio = *event.ip_assets_per_html_ratio;
+    double score = Scoring::from_threshold(t1.min_assets_per_html_ratio,
+                                           ratio, 0.1, 50.0, 95.0);
+    record_rule_alert(
+        id, event,
         "Low Asset-to-HTML request ratio detected. Ratio: " +
-        std::to_string(*event.ip_assets_per_html_ratio) +
-        " (Expected minimum: >" +
-        std::to_string(cfg.min_assets_per_html_ratio) + "). " +
-        "HTML: " + std::to_string(event.ip_html_requests_in_window) +
-        ", Assets: " + std::to_string(event.ip_asset_requests_in_window) +
-        " in window.";
-    std::string action_str =
-        "High confidence of bot activity (content scraping). Investigate IP.";
-    create_and_record_alert(event, reason, AlertTier::TIER1_HEURISTIC,
-                            AlertAction::CHALLENGE, action_str, score,
-                            event.raw_log.ip_address);
+            std::to_string(ratio) + " (Expected minimum: >" +
+            std::to_string(t1.min_assets_per_html_ratio) + "). " +
+            "HTML: " + std::to_string(event.ip_html_requests_in_window) +
+            ", Assets: " + std::to_string(event.ip_asset_requests_in_window) +
+            " in window.",
+        AlertTier::TIER1_HEURISTIC, AlertAction::CHALLENGE,
+        "High confidence of bot activity (content scraping). Investigate IP.",
+        score, ip);
+    break;
   }
-}
-
-void RuleEngine::check_session_rules(const AnalyzedEvent &event) {
-  LOG(LogLevel::TRACE, LogComponent::RULES_T1_HEURISTIC,
-      "Checking 'session' rules...");
-  track_rule_evaluation("tier1_session");
-  if (!event.raw_session_state)
-    return;
-
-  const auto &session = *event.raw_session_state;
-
-  // Rule: High number of failed logins in a single session
-  if (session.failed_login_attempts >
-      app_config.tier1.max_failed_logins_per_session) {
-    LOG(LogLevel::DEBUG, LogComponent::RULES_T1_HEURISTIC,
-        "'session_failed_logins' TRIGGERED for session. Count: "
-            << session.failed_login_attempts << " > Threshold: "
-            << app_config.tier1.max_failed_logins_per_session);
-    create_and_record_alert(
-        event,
+  case RuleId::NEW_IP_SENSITIVE_PATH:
+    record_rule_alert(
+        id, event,
+        "Newly seen IP immediately accessed a sensitive path containing '" +
+            program.sensitive_path_substring(
+                static_cast<int>(features[Feature::SENSITIVE_PATH])) +
+            "'.",
+        AlertTier::TIER1_HEURISTIC, AlertAction::BLOCK,
+        "High Priority: Investigate IP for targeted probing.",
+        t1.score_sensitive_path_new_ip, ip);
+    break;
+  case RuleId::NEW_PATH_HIGH_ERROR: {
+    double z = *event.ip_error_event_zscore;
+    record_rule_alert(id, event,
+                      "IP began generating a high error rate (Z-score: " +
+                          std::to_string(z) +
+                          ") while accessing a new path for the first time",
+                      AlertTier::TIER2_STATISTICAL, AlertAction::CHALLENGE,
+                      "Investigate for vulnerability scanning or forced "
+                      "browsing.",
+                      Scoring::from_z_score(z, 2.5, 70.0), ip);
+    break;
+  }
+  case RuleId::SESSION_FAILED_LOGINS:
+    record_rule_alert(
+        id, event,
         "High number of failed logins within a single session: " +
-            std::to_string(session.failed_login_attempts),
+            std::to_string(static_cast<uint32_t>(
+                features[Feature::SESSION_FAILED_LOGINS])),
         AlertTier::TIER1_HEURISTIC, AlertAction::BLOCK,
         "Block session/IP; high confidence of credential stuffing.", 85.0,
-        event.raw_log.ip_address);
-  }
-
-  // Rule: Impossibly fast navigation within the sliding window
-  auto &temp_window =
-      const_cast<SlidingWindow<uint64_t> &>(session.request_timestamps_window);
-  temp_window.prune_old_events(session.last_seen_timestamp_ms);
-  if (temp_window.get_event_count() >
-      app_config.tier1.max_requests_per_session_in_window) {
-    LOG(LogLevel::DEBUG, LogComponent::RULES_T1_HEURISTIC,
-        "'session_request_rate' TRIGGERED for session. Count: "
-            << temp_window.get_event_count() << " > Threshold: "
-            << app_config.tier1.max_requests_per_session_in_window);
-    create_and_record_alert(
-        event,
+        ip);
+    break;
+  case RuleId::SESSION_REQUEST_RATE:
+    // The engine prunes the session window on every event, so the count is
+    // current
+    record_rule_alert(
+        id, event,
         "Anomalously high request rate within a single session: " +
-            std::to_string(temp_window.get_event_count()) + " reqs in window.",
+            std::to_string(
+                static_cast<size_t>(features[Feature::SESSION_REQUESTS])) +
+            " reqs in window.",
         AlertTier::TIER1_HEURISTIC, AlertAction::CHALLENGE,
-        "High confidence of bot activity (scraping/probing).", 70.0,
-        event.raw_log.ip_address);
-  }
-
-  // Rule: User-Agent cycling within a session
-  if (session.unique_user_agents.size() >
-      app_config.tier1.max_ua_changes_per_session) {
-    LOG(LogLevel::DEBUG, LogComponent::RULES_T1_HEURISTIC,
-        "'session_ua_cycling' TRIGGERED for session. Count: "
-            << session.unique_user_agents.size()
-            << " > Threshold: " << app_config.tier1.max_ua_changes_per_session);
-    create_and_record_alert(
-        event,
+        "High confidence of bot activity (scraping/probing).", 70.0, ip);
+    break;
+  case RuleId::SESSION_UA_CYCLING:
+    record_rule_alert(
+        id, event,
         "User-Agent changed " +
-            std::to_string(session.unique_user_agents.size()) +
+            std::to_string(
+                static_cast<size_t>(features[Feature::SESSION_USER_AGENTS])) +
             " times within a single session.",
         AlertTier::TIER1_HEURISTIC, AlertAction::BLOCK,
-        "Very high confidence of sophisticated bot or attacker.", 90.0,
-        event.raw_log.ip_address);
+        "Very high confidence of sophisticated bot or attacker.", 90.0, ip);
+    break;
+  case RuleId::IP_REQ_TIME_ZSCORE:
+  case RuleId::IP_BYTES_SENT_ZSCORE:
+  case RuleId::IP_ERROR_ZSCORE:
+  case RuleId::IP_REQ_VOLUME_ZSCORE: {
+    static constexpr std::array<std::pair<Feature, const char *>, 4> metrics =
+        {{{Feature::IP_REQ_TIME_Z, "request_time"},
+          {Feature::IP_BYTES_SENT_Z, "bytes_sent"},
+          {Feature::IP_ERROR_Z, "error_rate"},
+          {Feature::IP_REQ_VOLUME_Z, "request_volume"}}};
+    const auto &[feature, metric_name] =
+        metrics[static_cast<size_t>(id) -
+                static_cast<size_t>(RuleId::IP_REQ_TIME_ZSCORE)];
+    double z = features[feature];
+    record_rule_alert(
+        id, event,
+        std::string("Anomalous IP ") + metric_name +
+            " (Z-score: " + std::to_string(z) + ")",
+        AlertTier::TIER2_STATISTICAL, AlertAction::LOG,
+        "Investigate IP for anomalous statistical behavior.",
+        Scoring::from_z_score(z, t2.z_score_threshold), ip);
+    break;
   }
-}
-
-// =================================================================================
-// Tier 2: Statistical & Contextual Rules
-// =================================================================================
-
-void RuleEngine::check_ip_zscore_rules(const AnalyzedEvent &event) {
-  LOG(LogLevel::TRACE, LogComponent::RULES_T2_STATISTICAL,
-      "Checking 'ip_zscore' rules...");
-  track_rule_evaluation("tier2_ip_zscore");
-  const double threshold = app_config.tier2.z_score_threshold;
-  std::string action_str = "Investigate IP for anomalous statistical behavior.";
-
-  auto check = [&](const std::optional<double> &zscore_opt,
-                   const std::string &metric_name) {
-    if (zscore_opt && std::abs(*zscore_opt) > threshold) {
-      LOG(LogLevel::DEBUG, LogComponent::RULES_T2_STATISTICAL,
-          "'ip_zscore_" << metric_name << "' TRIGGERED for IP "
-                        << event.raw_log.ip_address << ". Z-Score: "
-                        << *zscore_opt << " > Threshold: " << threshold);
-      double score = Scoring::from_z_score(*zscore_opt, threshold);
-      std::string reason = "Anomalous IP " + metric_name +
-                           " (Z-score: " + std::to_string(*zscore_opt) + ")";
-      create_and_record_alert(event, reason, AlertTier::TIER2_STATISTICAL,
-                              AlertAction::LOG, action_str, score,
-                              event.raw_log.ip_address);
-    }
-  };
-  check(event.ip_req_time_zscore, "request_time");
-  check(event.ip_bytes_sent_zscore, "bytes_sent");
-  check(event.ip_error_event_zscore, "error_rate");
-  check(event.ip_req_vol_zscore, "request_volume");
-}
-
-void RuleEngine::check_path_zscore_rules(const AnalyzedEvent &event) {
-  LOG(LogLevel::TRACE, LogComponent::RULES_T2_STATISTICAL,
-      "Checking 'path_zscore' rules...");
-  track_rule_evaluation("tier2_path_zscore");
-  const double threshold = app_config.tier2.z_score_threshold;
-  std::string action_str = "Investigate path for anomalous statistical "
-                           "behaviour (e.g., performance issue, data exfil).";
-
-  auto check = [&](const std::optional<double> &zscore_opt,
-                   const std::string &metric_name) {
-    if (zscore_opt && std::abs(*zscore_opt) > threshold) {
-      LOG(LogLevel::DEBUG, LogComponent::RULES_T2_STATISTICAL,
-          "'path_zscore_" << metric_name << "' TRIGGERED for path "
-                          << event.raw_log.request_path << ". Z-Score: "
-                          << *zscore_opt << " > Threshold: " << threshold);
-      double score = Scoring::from_z_score(*zscore_opt, threshold);
-      std::string reason = "Anomalous " + metric_name + " for path '" +
-                           event.raw_log.request_path +
-                           "' (Z-score: " + std::to_string(*zscore_opt) + ")";
-      create_and_record_alert(event, reason, AlertTier::TIER2_STATISTICAL,
-                              AlertAction::LOG, action_str, score,
-                              event.raw_log.request_path);
-    }
-  };
-  check(event.path_req_time_zscore, "request_time");
-  check(event.path_bytes_sent_zscore, "bytes_sent");
-  check(event.path_error_event_zscore, "error_rate");
-}
-
-void RuleEngine::check_new_seen_rules(const AnalyzedEvent &event) {
-  LOG(LogLevel::TRACE, LogComponent::RULES_T1_HEURISTIC,
-      "Checking 'new_seen' rules...");
-  track_rule_evaluation("tier1_new_seen");
-  if (event.is_first_request_from_ip) {
-    for (const auto &sensitive : app_config.tier1.sensitive_path_substrings) {
-      if (event.raw_log.request_path.find(sensitive) != std::string::npos) {
-        LOG(LogLevel::DEBUG, LogComponent::RULES_T1_HEURISTIC,
-            "'new_ip_sensitive_path' TRIGGERED for IP "
-                << event.raw_log.ip_address << " accessing "
-                << event.raw_log.request_path);
-        std::string reason =
-            "Newly seen IP immediately accessed a sensitive path containing '" +
-            sensitive + "'.";
-        std::string alert_str =
-            "High Priority: Investigate IP for targeted probing.";
-        create_and_record_alert(event, reason, AlertTier::TIER1_HEURISTIC,
-                                AlertAction::BLOCK, alert_str,
-                                app_config.tier1.score_sensitive_path_new_ip,
-                                event.raw_log.ip_address);
-        break;
-      }
-    }
+  case RuleId::PATH_REQ_TIME_ZSCORE:
+  case RuleId::PATH_BYTES_SENT_ZSCORE:
+  case RuleId::PATH_ERROR_ZSCORE: {
+    static constexpr std::array<std::pair<Feature, const char *>, 3> metrics =
+        {{{Feature::PATH_REQ_TIME_Z, "request_time"},
+          {Feature::PATH_BYTES_SENT_Z, "bytes_sent"},
+          {Feature::PATH_ERROR_Z, "error_rate"}}};
+    const auto &[feature, metric_name] =
+        metrics[static_cast<size_t>(id) -
+                static_cast<size_t>(RuleId::PATH_REQ_TIME_ZSCORE)];
+    double z = features[feature];
+    record_rule_alert(
+        id, event,
+        std::string("Anomalous ") + metric_name + " for path '" +
+            event.raw_log.request_path + "' (Z-score: " + std::to_string(z) +
+            ")",
+        AlertTier::TIER2_STATISTICAL, AlertAction::LOG,
+        "Investigate path for anomalous statistical "
+        "behaviour (e.g., performance issue, data exfil).",
+        Scoring::from_z_score(z, t2.z_score_threshold),
+        event.raw_log.request_path);
+    break;
   }
-
-  if (event.is_path_new_for_ip && event.ip_error_event_zscore &&
-      *event.ip_error_event_zscore > 2.5) {
-    LOG(LogLevel::DEBUG, LogComponent::RULES_T2_STATISTICAL,
-        "'new_path_high_error' TRIGGERED for IP "
-            << event.raw_log.ip_address << " accessing "
-            << event.raw_log.request_path);
-    double score =
-        Scoring::from_z_score(*event.ip_error_event_zscore, 2.5, 70.0);
-    std::string reason = "IP began generating a high error rate (Z-score: " +
-                         std::to_string(*event.ip_error_event_zscore) +
-                         ") while accessing a new path for the first time";
-    std::string action_str =
-        "Investigate for vulnerability scanning or forced browsing.";
-    create_and_record_alert(event, reason, AlertTier::TIER2_STATISTICAL,
-                            AlertAction::CHALLENGE, action_str, score,
-                            event.raw_log.ip_address);
+  case RuleId::HISTORICAL_REQ_TIME: {
+    double request_time = *event.raw_log.request_time_s;
+    double mean = *event.ip_hist_req_time_mean;
+    double limit = mean * t2.historical_deviation_factor;
+    record_rule_alert(
+        id, event,
+        "Sudden performance degradation for IP. Request time " +
+            std::to_string(request_time) + "s is >" +
+            std::to_string(t2.historical_deviation_factor) +
+            "x the historical average of " + std::to_string(mean) + "s",
+        AlertTier::TIER2_STATISTICAL, AlertAction::LOG,
+        "Investigate IP for unusual load or targeted DoS.",
+        Scoring::from_threshold(request_time, limit, limit * 5, 50.0), ip);
+    break;
   }
-}
-
-void RuleEngine::check_historical_comparison_rules(const AnalyzedEvent &event) {
-  LOG(LogLevel::TRACE, LogComponent::RULES_T2_STATISTICAL,
-      "Checking 'historical_comparison' rules...");
-  track_rule_evaluation("tier2_historical_comparison");
-  const auto &cfg = app_config.tier2;
-  const size_t min_samples = cfg.min_samples_for_z_score;
-
-  if (event.raw_log.request_time_s && event.ip_hist_req_time_mean &&
-      event.ip_hist_req_time_samples &&
-      *event.ip_hist_req_time_samples >= min_samples &&
-      *event.ip_hist_req_time_mean > 0) {
-    if (*event.raw_log.request_time_s >
-        (*event.ip_hist_req_time_mean * cfg.historical_deviation_factor)) {
-      LOG(LogLevel::DEBUG, LogComponent::RULES_T2_STATISTICAL,
-          "'historical_deviation_req_time' TRIGGERED for IP "
-              << event.raw_log.ip_address
-              << ". Current: " << *event.raw_log.request_time_s << " > "
-              << cfg.historical_deviation_factor
-              << "x Mean: " << *event.ip_hist_req_time_mean);
-      double score = Scoring::from_threshold(
-          *event.raw_log.request_time_s,
-          *event.ip_hist_req_time_mean * cfg.historical_deviation_factor,
-          *event.ip_hist_req_time_mean * cfg.historical_deviation_factor * 5,
-          50.0);
-      std::string reason =
-          "Sudden performance degradation for IP. Request time " +
-          std::to_string(*event.raw_log.request_time_s) + "s is >" +
-          std::to_string(cfg.historical_deviation_factor) +
-          "x the historical average of " +
-          std::to_string(*event.ip_hist_req_time_mean) + "s";
-      std::string action_str =
-          "Investigate IP for unusual load or targeted DoS.";
-      create_and_record_alert(event, reason, AlertTier::TIER2_STATISTICAL,
-                              AlertAction::LOG, action_str, score,
-                              event.raw_log.ip_address);
-    }
+  case RuleId::COUNT:
+    break;
   }
 }
 
@@ -813,7 +774,7 @@ void RuleEngine::check_historical_comparison_rules(const AnalyzedEvent &event) {
 
 void RuleEngine::check_ml_rules(const AnalyzedEvent &event) {
   LOG(LogLevel::TRACE, LogComponent::RULES_T3_ML, "Checking 'ml' rules...");
-  track_rule_evaluation("tier3_ml");
+  track_rule_evaluation(detection::RuleGroup::ML);
   if (event.feature_vector.empty()) {
     LOG(LogLevel::TRACE, LogComponent::RULES_T3_ML,
         "Skipping ML check, feature vector is empty.");
@@ -842,7 +803,7 @@ void RuleEngine::check_ml_rules(const AnalyzedEvent &event) {
         "High ML Anomaly Score detected: " + std::to_string(score);
     std::string action_str = "Review event; flagged as anomalous by ML model.";
 
-    auto ml_alert = Alert(std::make_shared<const AnalyzedEvent>(event), reason,
+    auto ml_alert = Alert(get_alert_context(event), reason,
                           AlertTier::TIER3_ML, AlertAction::BLOCK, action_str,
                           score, event.raw_log.ip_address);
 
@@ -853,6 +814,8 @@ void RuleEngine::check_ml_rules(const AnalyzedEvent &event) {
         contrib_str += ", ";
     }
     ml_alert.ml_feature_contribution = contrib_str;
+    ml_alert.rule_id = AlertThrottle::name_id(
+        detection::rule_group_name(detection::RuleGroup::ML));
 
     alert_mgr.record_alert(ml_alert);
   }
@@ -862,6 +825,13 @@ void RuleEngine::set_metrics_exporter(
   metrics_exporter_ = exporter;
   if (metrics_exporter_) {
     register_rule_engine_metrics();
+    // Owns the counters, not the engine, so it may outlive either
+    if (rule_counter_set_->claim(metrics_exporter_.get()))
+      metrics_exporter_->add_collector(
+          [counters = rule_counter_set_](
+              prometheus::PrometheusMetricsExporter &target) {
+            counters->publish(target);
+          });
   }
 }
 
@@ -930,6 +900,15 @@ void RuleEngine::register_rule_engine_metrics() {
       {"event_type"}); // event_type: opened, closed, half_open
 }
 
+void RuleEngine::track_rule_evaluation(detection::RuleGroup group,
+                                       uint64_t count) {
+  rule_counters_->add_evaluations(group, count);
+}
+
+void RuleEngine::track_rule_hit(detection::RuleGroup group) {
+  rule_counters_->add_hit(group);
+}
+
 void RuleEngine::track_rule_evaluation(const std::string &rule_name) {
   if (!metrics_exporter_)
     return;
@@ -1032,14 +1011,15 @@ void RuleEngine::evaluate_tier4_rules(const AnalyzedEvent &event) {
       }
 
       // Track rule evaluation
-      track_rule_evaluation("tier4_" + res.rule_name);
+      const std::string rule = "tier4_" + res.rule_name;
+      track_rule_evaluation(rule);
 
       if (res.is_anomaly) {
         // Track rule hit
-        track_rule_hit("tier4_" + res.rule_name);
+        track_rule_hit(rule);
 
         // Create alert for anomaly
-        create_and_record_alert(event,
+        create_and_record_alert(event, rule,
                                 "Tier 4 PromQL anomaly: " + res.rule_name +
                                     " (value=" + std::to_string(res.value) +
                                     ", score=" + std::to_string(res.score) +
@@ -1072,4 +1052,13 @@ void RuleEngine::evaluate_tier4_rules(const AnalyzedEvent &event) {
 void RuleEngine::set_tier4_anomaly_detector(
     std::shared_ptr<analysis::PrometheusAnomalyDetector> detector) {
   tier4_detector_ = std::move(detector);
+}
+
+void RuleEngine::set_intel_manager(
+    std::shared_ptr<IntelManager> intel_manager) {
+  if (intel_manager == intel_manager_)
+    return;
+  intel_manager_ = std::move(intel_manager);
+  intel_blacklist_ = IntelManager::Blacklist::Reader(
+      intel_manager_ ? &intel_manager_->blacklist() : nullptr);
 }
\ No newline at end of file
@@ -6,23 +6,47 @@
 #include "core/alert_manager.hpp"
 #include "core/config.hpp"
 #include "core/prometheus_metrics_exporter.hpp"
+#include "detection/rule_counters.hpp"
+#include "detection/rule_program.hpp"
 #include "io/threat_intel/intel_manager.hpp"
 #include "models/model_manager.hpp"
-#include "utils/aho_corasick.hpp"
+#include "utils/ip_prefix_set.hpp"
+#include "utils/published_snapshot.hpp"
 #include "utils/utils.hpp"
 
+#include <map>
 #include <memory>
 #include <string>
 #include <string_view>
 #include <unordered_map>
+#include <vector>
 
 class RuleEngine {
 public:
+  // Built once per (re)load and shared by every engine
+  using IpAllowlist = Utils::PublishedSnapshot<Utils::IpPrefixSet>;
+
+  // Without a shared allowlist the engine loads allowlist_path itself.
+  // Engines sharing rule_counters publish one set of rule metrics; without
+  // it the engine publishes its own counts.
   RuleEngine(AlertManager &manager, const Config::AppConfig &cfg,
-             std::shared_ptr<ModelManager> model_manager);
+             std::shared_ptr<ModelManager> model_manager,
+             std::shared_ptr<IpAllowlist> ip_allowlist = nullptr,
+             std::shared_ptr<detection::RuleCounterSet> rule_counters =
+                 nullptr);
   ~RuleEngine();
   void evaluate_rules(const AnalyzedEvent &event);
-  bool load_ip_allowlist(const std::string &filepath);
+  // Queues the event and evaluates its Tier 1/2 rules together with up to
+  // rule_batch_size - 1 others over a columnar FeatureBlock. Alerts are
+  // raised when the batch is flushed, in arrival order, and are the same as
+  // evaluate_rules would raise. A rule_batch_size of 0 or 1 evaluates at once.
+  void evaluate_rules_batched(AnalyzedEvent &&event);
+  // Evaluates whatever is queued; call when the input goes idle
+  void flush_rule_batch();
+  size_t pending_rule_batch_size() const { return pending_events_.size(); }
+  // Null if the file cannot be read
+  static std::shared_ptr<const Utils::IpPrefixSet>
+  load_ip_allowlist(const std::string &filepath);
 
   void reconfigure(const Config::AppConfig &new_config);
   void set_metrics_exporter(
@@ -31,45 +55,82 @@ public:
       std::shared_ptr<prometheus::PrometheusMetricsExporter> exporter);
   void set_tier4_anomaly_detector(
       std::shared_ptr<analysis::PrometheusAnomalyDetector> detector);
+  // The process-wide threat intel service, or null when disabled
+  void set_intel_manager(std::shared_ptr<IntelManager> intel_manager);
 
 private:
   AlertManager &alert_mgr;
   Config::AppConfig app_config;
 
   std::shared_ptr<IntelManager> intel_manager_;
-  std::vector<Utils::CIDRBlock> cidr_allowlist_cache_;
+  IntelManager::Blacklist::Reader intel_blacklist_;
+  std::shared_ptr<IpAllowlist> ip_allowlist_;
+  IpAllowlist::Reader allowlist_reader_;
+  // False when the allowlist is shared and reloaded by its owner
+  bool owns_ip_allowlist_ = false;
   std::shared_ptr<ModelManager> model_manager_;
   std::shared_ptr<prometheus::PrometheusMetricsExporter> metrics_exporter_;
   std::shared_ptr<analysis::PrometheusAnomalyDetector> tier4_detector_;
 
-  std::unique_ptr<Utils::AhoCorasick> suspicious_path_matcher_;
-  std::unique_ptr<Utils::AhoCorasick> suspicious_ua_matcher_;
+  // Tier 1/2 heuristics compiled from app_config, rebuilt on reconfigure
+  std::shared_ptr<const detection::RuleProgram> program_;
+
+  // Events queued by evaluate_rules_batched, their features by lane and the
+  // program that extracted them
+  std::vector<AnalyzedEvent> pending_events_;
+  detection::FeatureBlock pending_features_;
+  std::shared_ptr<const detection::RuleProgram> pending_program_;
+
+  // Owned copy of the event under evaluation, materialized on the first alert
+  // and shared by every alert raised for that event
+  std::shared_ptr<const AnalyzedEvent> alert_context_;
 
-  // Metrics tracking
+  // Metrics tracking. Built-in rule groups are counted locally and
+  // published when the exporter is scraped; Tier 4 rules are named at
+  // runtime and go to the exporter directly.
+  std::shared_ptr<detection::RuleCounters> rule_counters_ =
+      std::make_shared<detection::RuleCounters>();
+  std::shared_ptr<detection::RuleCounterSet> rule_counter_set_;
   std::unordered_map<std::string, uint64_t> rule_evaluation_counts_;
   std::unordered_map<std::string, uint64_t> rule_hit_counts_;
 
 private:
-  void create_and_record_alert(const AnalyzedEvent &event,
-                               std::string_view reason, AlertTier tier,
-                               AlertAction action, std::string_view action_str,
-                               double score, std::string_view key_id = "");
-
-  void check_requests_per_ip_rule(const AnalyzedEvent &event);
-  void check_failed_logins_rule(const AnalyzedEvent &event);
-  void check_suspicious_string_rules(const AnalyzedEvent &event);
-  void check_user_agent_rules(const AnalyzedEvent &event);
-  void check_asset_ratio_rule(const AnalyzedEvent &event);
-  void check_session_rules(const AnalyzedEvent &event);
-  void check_ip_zscore_rules(const AnalyzedEvent &event);
-  void check_path_zscore_rules(const AnalyzedEvent &event);
-  void check_new_seen_rules(const AnalyzedEvent &event);
-  void check_historical_comparison_rules(const AnalyzedEvent &event);
+  enum class IpScreening { EVALUATE, BLACKLISTED, ALLOWLISTED };
+  IpScreening screen_ip(const AnalyzedEvent &event);
+  void raise_blacklist_alert(const AnalyzedEvent &event);
+  void evaluate_tier3_and_tier4(const AnalyzedEvent &event);
+
+  std::shared_ptr<const AnalyzedEvent>
+  get_alert_context(const AnalyzedEvent &event);
+  // rule is the "rule" label of ad_alerts_generated_total, and identifies
+  // the alert for throttling unless rule_id is given. Returns false if the
+  // score was too low to raise an alert.
+  bool create_and_record_alert(const AnalyzedEvent &event,
+                               std::string_view rule, std::string_view reason,
+                               AlertTier tier, AlertAction action,
+                               std::string_view action_str, double score,
+                               std::string_view key_id = "",
+                               uint64_t rule_id = 0);
+  // Raises the alert of a compiled rule and counts the hit for its group
+  void record_rule_alert(detection::RuleId id, const AnalyzedEvent &event,
+                         std::string_view reason, AlertTier tier,
+                         AlertAction action, std::string_view action_str,
+                         double score, std::string_view key_id);
+
+  void evaluate_program(detection::RuleTier tier, const AnalyzedEvent &event,
+                        const detection::FeatureRecord &features);
+  // Formats the reason, score and action of a rule that held; only called
+  // for hits
+  void fire_rule(const detection::RuleProgram &program, detection::RuleId id,
+                 const AnalyzedEvent &event,
+                 const detection::FeatureRecord &features);
 
   void check_ml_rules(const AnalyzedEvent &event);
   void evaluate_tier4_rules(const AnalyzedEvent &event);
 
   // Helper methods for metrics
+  void track_rule_evaluation(detection::RuleGroup group, uint64_t count = 1);
+  void track_rule_hit(detection::RuleGroup group);
   void track_rule_evaluation(const std::string &rule_name);
   void track_rule_hit(const std::string &rule_name);
   void register_rule_engine_metrics();
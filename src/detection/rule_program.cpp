@@ -0,0 +1,384 @@
+#include "rule_program.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace detection {
+
+namespace {
+
+struct GroupInfo {
+  const char *name;
+  const char *tier;
+};
+
+constexpr std::array<GroupInfo, kRuleGroupCount> kGroups = {{
+    {"tier1_requests_per_ip", "tier1"},
+    {"tier1_failed_logins", "tier1"},
+    {"tier1_subnet_rollup", "tier1"},
+    {"tier1_user_agent", "tier1"},
+    {"tier1_suspicious_string", "tier1"},
+    {"tier1_asset_ratio", "tier1"},
+    {"tier1_new_seen", "tier1"},
+    {"tier1_session", "tier1"},
+    {"tier2_ip_zscore", "tier2"},
+    {"tier2_path_zscore", "tier2"},
+    {"tier2_historical_comparison", "tier2"},
+    {"tier3_ml", "tier3"},
+}};
+
+constexpr std::array<RuleGroup, kRuleCount> kRuleGroups = {
+    RuleGroup::REQUESTS_PER_IP,   // REQUESTS_PER_IP
+    RuleGroup::FAILED_LOGINS,     // FAILED_LOGINS
+    RuleGroup::SUBNET_ROLLUP,     // SUBNET_NARROW_VOLUME
+    RuleGroup::SUBNET_ROLLUP,     // SUBNET_WIDE_VOLUME
+    RuleGroup::SUBNET_ROLLUP,     // SUBNET_FAILED_LOGINS
+    RuleGroup::USER_AGENT,        // UA_MISSING
+    RuleGroup::USER_AGENT,        // UA_KNOWN_BAD
+    RuleGroup::USER_AGENT,        // UA_HEADLESS
+    RuleGroup::USER_AGENT,        // UA_OUTDATED
+    RuleGroup::USER_AGENT,        // UA_CYCLING
+    RuleGroup::SUSPICIOUS_STRING, // SUSPICIOUS_PATH
+    RuleGroup::SUSPICIOUS_STRING, // SUSPICIOUS_UA
+    RuleGroup::ASSET_RATIO,       // ASSET_RATIO
+    RuleGroup::NEW_SEEN,          // NEW_IP_SENSITIVE_PATH
+    RuleGroup::NEW_SEEN,          // NEW_PATH_HIGH_ERROR
+    RuleGroup::SESSION,           // SESSION_FAILED_LOGINS
+    RuleGroup::SESSION,           // SESSION_REQUEST_RATE
+    RuleGroup::SESSION,           // SESSION_UA_CYCLING
+    RuleGroup::IP_ZSCORE,         // IP_REQ_TIME_ZSCORE
+    RuleGroup::IP_ZSCORE,         // IP_BYTES_SENT_ZSCORE
+    RuleGroup::IP_ZSCORE,         // IP_ERROR_ZSCORE
+    RuleGroup::IP_ZSCORE,         // IP_REQ_VOLUME_ZSCORE
+    RuleGroup::PATH_ZSCORE,       // PATH_REQ_TIME_ZSCORE
+    RuleGroup::PATH_ZSCORE,       // PATH_BYTES_SENT_ZSCORE
+    RuleGroup::PATH_ZSCORE,       // PATH_ERROR_ZSCORE
+    RuleGroup::HISTORICAL_COMPARISON, // HISTORICAL_REQ_TIME
+};
+
+// An error z-score this high on a path the IP has never requested before
+// suggests forced browsing
+constexpr double kNewPathErrorZScore = 2.5;
+
+void set_if(FeatureRecord &features, Feature feature,
+            const std::optional<double> &value) {
+  if (value)
+    features.set(feature, *value);
+}
+
+void set_flag(FeatureRecord &features, Feature feature, bool flag) {
+  if (flag)
+    features.set(feature, 1.0);
+}
+
+#if defined(__SSE2__)
+// Two lanes per compare, four compares per step, so every step fills one
+// byte of the mask
+template <typename Compare>
+uint64_t lane_mask(const FeatureBlock::Column &column, Compare compare) {
+  uint64_t mask = 0;
+  for (size_t i = 0; i < FeatureBlock::kLanes; i += 8) {
+    int bits = _mm_movemask_pd(compare(_mm_load_pd(&column[i]))) |
+               _mm_movemask_pd(compare(_mm_load_pd(&column[i + 2]))) << 2 |
+               _mm_movemask_pd(compare(_mm_load_pd(&column[i + 4]))) << 4 |
+               _mm_movemask_pd(compare(_mm_load_pd(&column[i + 6]))) << 6;
+    mask |= static_cast<uint64_t>(bits) << i;
+  }
+  return mask;
+}
+#endif
+
+} // namespace
+
+size_t FeatureBlock::append(const FeatureRecord &record) {
+  size_t lane = size++;
+  uint64_t bit = uint64_t{1} << lane;
+  // Absent features keep the lane's stale value; their presence bit is clear
+  for (size_t f = 0; f < kFeatureCount; ++f)
+    if (record.present & (uint64_t{1} << f)) {
+      columns[f][lane] = record.values[f];
+      present[f] |= bit;
+    }
+  return lane;
+}
+
+FeatureRecord FeatureBlock::record(size_t lane) const {
+  FeatureRecord record;
+  for (size_t f = 0; f < kFeatureCount; ++f)
+    if (present[f] >> lane & 1)
+      record.set(static_cast<Feature>(f), columns[f][lane]);
+  return record;
+}
+
+const char *rule_group_name(RuleGroup group) {
+  return kGroups[static_cast<size_t>(group)].name;
+}
+
+const char *rule_group_tier(RuleGroup group) {
+  return kGroups[static_cast<size_t>(group)].tier;
+}
+
+RuleGroup rule_group(RuleId id) { return kRuleGroups[static_cast<size_t>(id)]; }
+
+RuleProgram::RuleProgram(const Config::AppConfig &cfg) {
+  const auto &t1 = cfg.tier1;
+  const auto &t2 = cfg.tier2;
+  constexpr RuleTier heuristic = RuleTier::HEURISTIC;
+  constexpr RuleTier statistical = RuleTier::STATISTICAL;
+  auto &t1_groups = groups_[static_cast<size_t>(heuristic)];
+  auto &t2_groups = groups_[static_cast<size_t>(statistical)];
+
+  if (t1.enabled) {
+    t1_groups.push_back(RuleGroup::REQUESTS_PER_IP);
+    add(heuristic, RuleId::REQUESTS_PER_IP,
+        {Feature::IP_REQUESTS, Op::GT,
+         static_cast<double>(t1.max_requests_per_ip_in_window)});
+
+    t1_groups.push_back(RuleGroup::FAILED_LOGINS);
+    add(heuristic, RuleId::FAILED_LOGINS,
+        {Feature::IP_FAILED_LOGINS, Op::GT,
+         static_cast<double>(t1.max_failed_logins_per_ip)});
+
+    if (t1.subnet_rollup_enabled) {
+      // Volume spread over many addresses in one subnet; a single noisy IP
+      // is already covered by the per-IP rule
+      const double min_ips =
+          static_cast<double>(t1.min_distinct_ips_for_subnet_alert);
+      t1_groups.push_back(RuleGroup::SUBNET_ROLLUP);
+      add(heuristic, RuleId::SUBNET_NARROW_VOLUME,
+          {Feature::SUBNET_NARROW_REQUESTS, Op::GT,
+           static_cast<double>(t1.max_requests_per_subnet_narrow_in_window)},
+          {Feature::SUBNET_NARROW_DISTINCT_IPS, Op::GE, min_ips});
+      add(heuristic, RuleId::SUBNET_WIDE_VOLUME,
+          {Feature::SUBNET_WIDE_REQUESTS, Op::GT,
+           static_cast<double>(t1.max_requests_per_subnet_wide_in_window)},
+          {Feature::SUBNET_WIDE_DISTINCT_IPS, Op::GE, min_ips});
+      add(heuristic, RuleId::SUBNET_FAILED_LOGINS,
+          {Feature::SUBNET_NARROW_FAILED_LOGINS, Op::GT,
+           static_cast<double>(t1.max_failed_logins_per_subnet)},
+          {Feature::SUBNET_NARROW_DISTINCT_IPS, Op::GE, min_ips});
+    }
+
+    t1_groups.push_back(RuleGroup::USER_AGENT);
+    if (t1.check_user_agent_anomalies) {
+      add(heuristic, RuleId::UA_MISSING, {Feature::UA_MISSING, Op::IS_SET, 0});
+      add(heuristic, RuleId::UA_KNOWN_BAD,
+          {Feature::UA_KNOWN_BAD, Op::IS_SET, 0});
+      add(heuristic, RuleId::UA_HEADLESS,
+          {Feature::UA_HEADLESS, Op::IS_SET, 0});
+      add(heuristic, RuleId::UA_OUTDATED,
+          {Feature::UA_OUTDATED, Op::IS_SET, 0});
+      add(heuristic, RuleId::UA_CYCLING, {Feature::UA_CYCLING, Op::IS_SET, 0});
+    }
+
+    t1_groups.push_back(RuleGroup::SUSPICIOUS_STRING);
+    if (!t1.suspicious_path_substrings.empty()) {
+      suspicious_path_matcher_.emplace(t1.suspicious_path_substrings);
+      add(heuristic, RuleId::SUSPICIOUS_PATH,
+          {Feature::SUSPICIOUS_PATH, Op::IS_SET, 0});
+    }
+    if (!t1.suspicious_ua_substrings.empty()) {
+      suspicious_ua_matcher_.emplace(t1.suspicious_ua_substrings);
+      add(heuristic, RuleId::SUSPICIOUS_UA,
+          {Feature::SUSPICIOUS_UA, Op::IS_SET, 0});
+    }
+
+    t1_groups.push_back(RuleGroup::ASSET_RATIO);
+    add(heuristic, RuleId::ASSET_RATIO,
+        {Feature::HTML_REQUESTS, Op::GE,
+         static_cast<double>(t1.min_html_requests_for_ratio_check)},
+        {Feature::ASSET_HTML_RATIO, Op::LT, t1.min_assets_per_html_ratio});
+
+    t1_groups.push_back(RuleGroup::NEW_SEEN);
+    if (!t1.sensitive_path_substrings.empty()) {
+      sensitive_path_substrings_ = t1.sensitive_path_substrings;
+      add(heuristic, RuleId::NEW_IP_SENSITIVE_PATH,
+          {Feature::SENSITIVE_PATH, Op::IS_SET, 0});
+    }
+    add(heuristic, RuleId::NEW_PATH_HIGH_ERROR,
+        {Feature::PATH_NEW_FOR_IP, Op::IS_SET, 0},
+        {Feature::IP_ERROR_Z, Op::GT, kNewPathErrorZScore});
+
+    t1_groups.push_back(RuleGroup::SESSION);
+    add(heuristic, RuleId::SESSION_FAILED_LOGINS,
+        {Feature::SESSION_FAILED_LOGINS, Op::GT,
+         static_cast<double>(t1.max_failed_logins_per_session)});
+    add(heuristic, RuleId::SESSION_REQUEST_RATE,
+        {Feature::SESSION_REQUESTS, Op::GT,
+         static_cast<double>(t1.max_requests_per_session_in_window)});
+    add(heuristic, RuleId::SESSION_UA_CYCLING,
+        {Feature::SESSION_USER_AGENTS, Op::GT,
+         static_cast<double>(t1.max_ua_changes_per_session)});
+  }
+
+  if (t2.enabled) {
+    const double z = t2.z_score_threshold;
+    t2_groups.push_back(RuleGroup::IP_ZSCORE);
+    add(statistical, RuleId::IP_REQ_TIME_ZSCORE,
+        {Feature::IP_REQ_TIME_Z, Op::ABS_GT, z});
+    add(statistical, RuleId::IP_BYTES_SENT_ZSCORE,
+        {Feature::IP_BYTES_SENT_Z, Op::ABS_GT, z});
+    add(statistical, RuleId::IP_ERROR_ZSCORE,
+        {Feature::IP_ERROR_Z, Op::ABS_GT, z});
+    add(statistical, RuleId::IP_REQ_VOLUME_ZSCORE,
+        {Feature::IP_REQ_VOLUME_Z, Op::ABS_GT, z});
+
+    t2_groups.push_back(RuleGroup::PATH_ZSCORE);
+    add(statistical, RuleId::PATH_REQ_TIME_ZSCORE,
+        {Feature::PATH_REQ_TIME_Z, Op::ABS_GT, z});
+    add(statistical, RuleId::PATH_BYTES_SENT_ZSCORE,
+        {Feature::PATH_BYTES_SENT_Z, Op::ABS_GT, z});
+    add(statistical, RuleId::PATH_ERROR_ZSCORE,
+        {Feature::PATH_ERROR_Z, Op::ABS_GT, z});
+
+    t2_groups.push_back(RuleGroup::HISTORICAL_COMPARISON);
+    add(statistical, RuleId::HISTORICAL_REQ_TIME,
+        {Feature::REQ_TIME_OVER_HIST_MEAN, Op::GT,
+         t2.historical_deviation_factor});
+  }
+  min_hist_samples_ = t2.min_samples_for_z_score;
+}
+
+void RuleProgram::add(RuleTier tier, RuleId id, Condition first) {
+  rules_[static_cast<size_t>(tier)].push_back(
+      {id, 1, {first, first}, FeatureRecord::bit(first.feature)});
+}
+
+void RuleProgram::add(RuleTier tier, RuleId id, Condition first,
+                      Condition second) {
+  rules_[static_cast<size_t>(tier)].push_back(
+      {id, 2, {first, second},
+       FeatureRecord::bit(first.feature) | FeatureRecord::bit(second.feature)});
+}
+
+uint64_t RuleProgram::evaluate(RuleTier tier, const FeatureBlock &block,
+                               std::array<uint64_t, kRuleCount> &hits) const {
+  uint64_t any = 0;
+  for (const auto &rule : rules_[static_cast<size_t>(tier)]) {
+    uint64_t lanes = block.lanes();
+    for (uint8_t i = 0; i < rule.condition_count; ++i)
+      lanes &= block.present[static_cast<size_t>(rule.conditions[i].feature)];
+    for (uint8_t i = 0; i < rule.condition_count && lanes; ++i) {
+      const Condition &condition = rule.conditions[i];
+      lanes &= condition.holding_lanes(
+          block.columns[static_cast<size_t>(condition.feature)]);
+    }
+    hits[static_cast<size_t>(rule.id)] = lanes;
+    any |= lanes;
+  }
+  return any;
+}
+
+uint64_t RuleProgram::Condition::holding_lanes(
+    const FeatureBlock::Column &column) const {
+#if defined(__SSE2__)
+  const __m128d x = _mm_set1_pd(operand);
+  switch (op) {
+  case Op::IS_SET:
+    return ~uint64_t{0};
+  case Op::GT:
+    return lane_mask(column, [x](__m128d v) { return _mm_cmpgt_pd(v, x); });
+  case Op::GE:
+    return lane_mask(column, [x](__m128d v) { return _mm_cmpge_pd(v, x); });
+  case Op::LT:
+    return lane_mask(column, [x](__m128d v) { return _mm_cmplt_pd(v, x); });
+  case Op::ABS_GT: {
+    // |v| by clearing the sign bit
+    const __m128d sign = _mm_set1_pd(-0.0);
+    return lane_mask(column, [x, sign](__m128d v) {
+      return _mm_cmpgt_pd(_mm_andnot_pd(sign, v), x);
+    });
+  }
+  }
+  return 0;
+#else
+  uint64_t mask = 0;
+  for (size_t i = 0; i < FeatureBlock::kLanes; ++i)
+    mask |= static_cast<uint64_t>(holds(column[i])) << i;
+  return mask;
+#endif
+}
+
+void RuleProgram::extract(const AnalyzedEvent &event,
+                          FeatureRecord &features) const {
+  features.present = 0;
+
+  if (event.current_ip_request_count_in_window)
+    features.set(
+        Feature::IP_REQUESTS,
+        static_cast<double>(*event.current_ip_request_count_in_window));
+  if (event.current_ip_failed_login_count_in_window)
+    features.set(
+        Feature::IP_FAILED_LOGINS,
+        static_cast<double>(*event.current_ip_failed_login_count_in_window));
+
+  if (const auto &narrow = event.subnet_narrow_activity) {
+    features.set(Feature::SUBNET_NARROW_REQUESTS, narrow->requests);
+    features.set(Feature::SUBNET_NARROW_FAILED_LOGINS, narrow->failed_logins);
+    features.set(Feature::SUBNET_NARROW_DISTINCT_IPS, narrow->distinct_ips);
+  }
+  if (const auto &wide = event.subnet_wide_activity) {
+    features.set(Feature::SUBNET_WIDE_REQUESTS, wide->requests);
+    features.set(Feature::SUBNET_WIDE_DISTINCT_IPS, wide->distinct_ips);
+  }
+
+  set_flag(features, Feature::UA_MISSING, event.is_ua_missing);
+  set_flag(features, Feature::UA_KNOWN_BAD, event.is_ua_known_bad);
+  set_flag(features, Feature::UA_HEADLESS, event.is_ua_headless);
+  set_flag(features, Feature::UA_OUTDATED, event.is_ua_outdated);
+  set_flag(features, Feature::UA_CYCLING, event.is_ua_cycling);
+
+  if (suspicious_path_matcher_) {
+    int match =
+        suspicious_path_matcher_->find_first(event.raw_log.request_path);
+    if (match != Utils::AhoCorasick::kNoMatch)
+      features.set(Feature::SUSPICIOUS_PATH, match);
+  }
+  // The analysis engine flags the UA in its one marker scan; the matcher
+  // is only run on a hit, to name the pattern in the alert
+  if (suspicious_ua_matcher_ && event.found_suspicious_ua_str) {
+    int match = suspicious_ua_matcher_->find_first(event.raw_log.user_agent);
+    if (match != Utils::AhoCorasick::kNoMatch)
+      features.set(Feature::SUSPICIOUS_UA, match);
+  }
+  // Only a newly seen IP's first request is checked, so a linear scan in
+  // config order is cheap and picks the same substring as before
+  if (event.is_first_request_from_ip)
+    for (size_t i = 0; i < sensitive_path_substrings_.size(); ++i)
+      if (event.raw_log.request_path.find(sensitive_path_substrings_[i]) !=
+          std::string::npos) {
+        features.set(Feature::SENSITIVE_PATH, static_cast<double>(i));
+        break;
+      }
+
+  features.set(Feature::HTML_REQUESTS, event.ip_html_requests_in_window);
+  set_if(features, Feature::ASSET_HTML_RATIO, event.ip_assets_per_html_ratio);
+  set_flag(features, Feature::PATH_NEW_FOR_IP, event.is_path_new_for_ip);
+
+  if (const PerSessionState *session = event.raw_session_state) {
+    features.set(Feature::SESSION_FAILED_LOGINS,
+                 session->failed_login_attempts);
+    features.set(Feature::SESSION_REQUESTS,
+                 static_cast<double>(session->get_request_timestamps_count()));
+    features.set(Feature::SESSION_USER_AGENTS,
+                 static_cast<double>(session->unique_user_agents.size()));
+  }
+
+  set_if(features, Feature::IP_REQ_TIME_Z, event.ip_req_time_zscore);
+  set_if(features, Feature::IP_BYTES_SENT_Z, event.ip_bytes_sent_zscore);
+  set_if(features, Feature::IP_ERROR_Z, event.ip_error_event_zscore);
+  set_if(features, Feature::IP_REQ_VOLUME_Z, event.ip_req_vol_zscore);
+  set_if(features, Feature::PATH_REQ_TIME_Z, event.path_req_time_zscore);
+  set_if(features, Feature::PATH_BYTES_SENT_Z, event.path_bytes_sent_zscore);
+  set_if(features, Feature::PATH_ERROR_Z, event.path_error_event_zscore);
+
+  if (event.raw_log.request_time_s && event.ip_hist_req_time_mean &&
+      event.ip_hist_req_time_samples &&
+      *event.ip_hist_req_time_samples >= min_hist_samples_ &&
+      *event.ip_hist_req_time_mean > 0)
+    features.set(Feature::REQ_TIME_OVER_HIST_MEAN,
+                 *event.raw_log.request_time_s / *event.ip_hist_req_time_mean);
+}
+
+} // namespace detection
@@ -0,0 +1,274 @@
+#ifndef RULE_PROGRAM_HPP
+#define RULE_PROGRAM_HPP
+
+#include "analysis/analyzed_event.hpp"
+#include "core/config.hpp"
+#include "utils/aho_corasick.hpp"
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace detection {
+
+// Metric identity of a rule. Each group is one "rule" label of
+// ad_rule_evaluations_total / ad_rule_hits_total.
+enum class RuleGroup : uint8_t {
+  REQUESTS_PER_IP,
+  FAILED_LOGINS,
+  SUBNET_ROLLUP,
+  USER_AGENT,
+  SUSPICIOUS_STRING,
+  ASSET_RATIO,
+  NEW_SEEN,
+  SESSION,
+  IP_ZSCORE,
+  PATH_ZSCORE,
+  HISTORICAL_COMPARISON,
+  ML,
+  COUNT
+};
+constexpr size_t kRuleGroupCount = static_cast<size_t>(RuleGroup::COUNT);
+
+// "tier1_requests_per_ip" etc.
+const char *rule_group_name(RuleGroup group);
+// "tier1", "tier2" or "tier3"
+const char *rule_group_tier(RuleGroup group);
+
+// Numbered in evaluation order: Tier 1 before Tier 2, and in the order the
+// rules are compiled within each tier
+enum class RuleId : uint8_t {
+  REQUESTS_PER_IP,
+  FAILED_LOGINS,
+  SUBNET_NARROW_VOLUME,
+  SUBNET_WIDE_VOLUME,
+  SUBNET_FAILED_LOGINS,
+  UA_MISSING,
+  UA_KNOWN_BAD,
+  UA_HEADLESS,
+  UA_OUTDATED,
+  UA_CYCLING,
+  SUSPICIOUS_PATH,
+  SUSPICIOUS_UA,
+  ASSET_RATIO,
+  NEW_IP_SENSITIVE_PATH,
+  NEW_PATH_HIGH_ERROR,
+  SESSION_FAILED_LOGINS,
+  SESSION_REQUEST_RATE,
+  SESSION_UA_CYCLING,
+  IP_REQ_TIME_ZSCORE,
+  IP_BYTES_SENT_ZSCORE,
+  IP_ERROR_ZSCORE,
+  IP_REQ_VOLUME_ZSCORE,
+  PATH_REQ_TIME_ZSCORE,
+  PATH_BYTES_SENT_ZSCORE,
+  PATH_ERROR_ZSCORE,
+  HISTORICAL_REQ_TIME,
+  COUNT
+};
+constexpr size_t kRuleCount = static_cast<size_t>(RuleId::COUNT);
+
+RuleGroup rule_group(RuleId id);
+
+// Tier 1 heuristics and Tier 2 statistical rules are evaluated (and timed)
+// as separate passes over the same FeatureRecord
+enum class RuleTier : uint8_t { HEURISTIC, STATISTICAL };
+constexpr size_t kRuleTierCount = 2;
+
+// Rule inputs, extracted from an AnalyzedEvent once per event
+enum class Feature : uint8_t {
+  IP_REQUESTS,
+  IP_FAILED_LOGINS,
+  SUBNET_NARROW_REQUESTS,
+  SUBNET_NARROW_FAILED_LOGINS,
+  SUBNET_NARROW_DISTINCT_IPS,
+  SUBNET_WIDE_REQUESTS,
+  SUBNET_WIDE_DISTINCT_IPS,
+  UA_MISSING,
+  UA_KNOWN_BAD,
+  UA_HEADLESS,
+  UA_OUTDATED,
+  UA_CYCLING,
+  // Matched pattern id / sensitive substring index
+  SUSPICIOUS_PATH,
+  SUSPICIOUS_UA,
+  SENSITIVE_PATH,
+  HTML_REQUESTS,
+  ASSET_HTML_RATIO,
+  PATH_NEW_FOR_IP,
+  SESSION_FAILED_LOGINS,
+  SESSION_REQUESTS,
+  SESSION_USER_AGENTS,
+  IP_REQ_TIME_Z,
+  IP_BYTES_SENT_Z,
+  IP_ERROR_Z,
+  IP_REQ_VOLUME_Z,
+  PATH_REQ_TIME_Z,
+  PATH_BYTES_SENT_Z,
+  PATH_ERROR_Z,
+  // Request time over the IP's historical mean, once enough samples exist
+  REQ_TIME_OVER_HIST_MEAN,
+  COUNT
+};
+constexpr size_t kFeatureCount = static_cast<size_t>(Feature::COUNT);
+static_assert(kFeatureCount <= 64, "presence mask is one word");
+
+// Packed rule inputs of one event. An absent input (an unset optional, a
+// false flag, no session) has its presence bit clear, and every rule reading
+// it is skipped.
+struct FeatureRecord {
+  std::array<double, kFeatureCount> values;
+  uint64_t present = 0;
+
+  static constexpr uint64_t bit(Feature feature) {
+    return uint64_t{1} << static_cast<unsigned>(feature);
+  }
+  bool has(Feature feature) const { return present & bit(feature); }
+  double operator[](Feature feature) const {
+    return values[static_cast<size_t>(feature)];
+  }
+  void set(Feature feature, double value) {
+    values[static_cast<size_t>(feature)] = value;
+    present |= bit(feature);
+  }
+};
+
+// Up to kLanes FeatureRecords stored column by column, so that one rule
+// condition is a single pass of compares over a contiguous array of doubles
+// for a whole batch of events
+struct FeatureBlock {
+  static constexpr size_t kLanes = 64;
+  using Column = std::array<double, kLanes>;
+
+  // columns[feature][lane]; lanes at or past size hold stale values
+  alignas(16) std::array<Column, kFeatureCount> columns{};
+  // Bit `lane` of present[feature] is set if that lane has the feature
+  std::array<uint64_t, kFeatureCount> present{};
+  size_t size = 0;
+
+  bool empty() const { return size == 0; }
+  bool full() const { return size == kLanes; }
+  // Mask of the occupied lanes
+  uint64_t lanes() const {
+    return size == kLanes ? ~uint64_t{0} : (uint64_t{1} << size) - 1;
+  }
+  void clear() {
+    present.fill(0);
+    size = 0;
+  }
+  // Stores record in the next free lane and returns that lane
+  size_t append(const FeatureRecord &record);
+  FeatureRecord record(size_t lane) const;
+};
+
+// The Tier 1 and Tier 2 heuristics as a flat table compiled from the config:
+// each rule is up to two threshold comparisons over a FeatureRecord. Only
+// the tiers and checks enabled at compile time are present, and thresholds
+// are baked in, so evaluating an event never touches the config. Reason
+// strings are the caller's business and are only built for hits.
+class RuleProgram {
+public:
+  RuleProgram() = default;
+  explicit RuleProgram(const Config::AppConfig &cfg);
+
+  void extract(const AnalyzedEvent &event, FeatureRecord &features) const;
+
+  // Calls on_hit(RuleId) for every rule of the tier whose inputs are present
+  // and whose conditions hold, in evaluation order
+  template <typename Fn>
+  void for_each_hit(RuleTier tier, const FeatureRecord &features,
+                    Fn &&on_hit) const {
+    for (const auto &rule : rules_[static_cast<size_t>(tier)]) {
+      if ((features.present & rule.inputs) != rule.inputs)
+        continue;
+      bool hit = true;
+      for (uint8_t i = 0; i < rule.condition_count && hit; ++i)
+        hit = rule.conditions[i].holds(features);
+      if (hit)
+        on_hit(rule.id);
+    }
+  }
+
+  // Block counterpart of for_each_hit: sets hits[id] to the lanes on which
+  // rule id fires, evaluating each condition for all lanes at once. Returns
+  // the union of the hit lanes.
+  uint64_t evaluate(RuleTier tier, const FeatureBlock &block,
+                    std::array<uint64_t, kRuleCount> &hits) const;
+
+  // Groups evaluated for every event, in order; empty if the tier is
+  // disabled
+  const std::vector<RuleGroup> &groups(RuleTier tier) const {
+    return groups_[static_cast<size_t>(tier)];
+  }
+  size_t rule_count() const {
+    return rules_[0].size() + rules_[1].size();
+  }
+
+  const std::string &suspicious_path_pattern(int id) const {
+    return suspicious_path_matcher_->pattern(id);
+  }
+  const std::string &suspicious_ua_pattern(int id) const {
+    return suspicious_ua_matcher_->pattern(id);
+  }
+  const std::string &sensitive_path_substring(int index) const {
+    return sensitive_path_substrings_[index];
+  }
+
+private:
+  enum class Op : uint8_t { IS_SET, GT, GE, LT, ABS_GT };
+
+  struct Condition {
+    Feature feature;
+    Op op;
+    double operand;
+
+    // Mask of the lanes of column on which the condition holds
+    uint64_t holding_lanes(const FeatureBlock::Column &column) const;
+
+    bool holds(const FeatureRecord &features) const {
+      return holds(features[feature]);
+    }
+    bool holds(double value) const {
+      switch (op) {
+      case Op::IS_SET:
+        return true;
+      case Op::GT:
+        return value > operand;
+      case Op::GE:
+        return value >= operand;
+      case Op::LT:
+        return value < operand;
+      case Op::ABS_GT:
+        return std::abs(value) > operand;
+      }
+      return false;
+    }
+  };
+
+  struct CompiledRule {
+    RuleId id;
+    uint8_t condition_count;
+    std::array<Condition, 2> conditions;
+    // Presence mask of every feature the conditions read
+    uint64_t inputs;
+  };
+
+  void add(RuleTier tier, RuleId id, Condition first);
+  void add(RuleTier tier, RuleId id, Condition first, Condition second);
+
+  std::array<std::vector<CompiledRule>, kRuleTierCount> rules_;
+  std::array<std::vector<RuleGroup>, kRuleTierCount> groups_;
+  size_t min_hist_samples_ = 0;
+
+  std::optional<Utils::AhoCorasick> suspicious_path_matcher_;
+  std::optional<Utils::AhoCorasick> suspicious_ua_matcher_;
+  std::vector<std::string> sensitive_path_substrings_;
+};
+
+} // namespace detection
+
+#endif // RULE_PROGRAM_HPP
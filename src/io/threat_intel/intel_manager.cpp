@@ -6,17 +6,17 @@
 #include <chrono>
 #include <cstddef>
 #include <cstdint>
-#include <iostream>
+#include <fstream>
+#include <iterator>
 #include <memory>
 #include <mutex>
 #include <regex>
 #include <sstream>
-#include <unordered_set>
 
 IntelManager::IntelManager(const std::vector<std::string> &feed_urls,
                            uint32_t update_interval_seconds)
     : feed_urls_(feed_urls), update_interval_seconds_(update_interval_seconds),
-      ip_blacklist_(std::make_unique<std::unordered_set<uint32_t>>()) {
+      blacklist_(std::make_shared<const Utils::IpPrefixSet>()) {
   LOG(LogLevel::INFO, LogComponent::IO_THREATINTEL,
       "IntelManager created. Starting background thread for feed updates.");
   // Initial fetch on startup
@@ -29,7 +29,10 @@ IntelManager::IntelManager(const std::vector<std::string> &feed_urls,
 IntelManager::~IntelManager() {
   LOG(LogLevel::INFO, LogComponent::IO_THREATINTEL,
       "Shutting down IntelManager...");
-  shutdown_flag_ = true;
+  {
+    std::lock_guard<std::mutex> lock(cv_mutex_);
+    shutdown_flag_ = true;
+  }
   cv_.notify_one();
 
   if (background_thread_.joinable())
@@ -39,88 +42,121 @@ IntelManager::~IntelManager() {
 }
 
 bool IntelManager::is_blacklisted(uint32_t ip) const {
-  std::lock_guard<std::mutex> lock(list_mutex_);
-  if (!ip_blacklist_)
-    return false;
-  return ip_blacklist_->count(ip) > 0;
+  return blacklist_.load()->contains(ip);
+}
+
+bool IntelManager::is_blacklisted(std::string_view ip) const {
+  return blacklist_.load()->contains(ip);
+}
+
+void IntelManager::reconfigure(const std::vector<std::string> &feed_urls,
+                               uint32_t update_interval_seconds) {
+  {
+    std::lock_guard<std::mutex> lock(cv_mutex_);
+    feed_urls_ = feed_urls;
+    update_interval_seconds_ = update_interval_seconds;
+    refresh_requested_ = true;
+  }
+  cv_.notify_one();
 }
 
 void IntelManager::background_thread_func() {
+  std::unique_lock<std::mutex> lock(cv_mutex_);
   while (!shutdown_flag_) {
-    std::unique_lock<std::mutex> lock(cv_mutex_);
-    cv_.wait_for(lock, std::chrono::seconds(update_interval_seconds_),
-                 [this] { return shutdown_flag_.load(); });
+    cv_.wait_for(lock, std::chrono::seconds(update_interval_seconds_), [this] {
+      return shutdown_flag_.load() || refresh_requested_;
+    });
 
     if (shutdown_flag_)
       break;
+    refresh_requested_ = false;
 
     LOG(LogLevel::INFO, LogComponent::IO_THREATINTEL,
         "IntelManager: Running periodic threat feed update...");
+    lock.unlock();
     update_feeds();
+    lock.lock();
   }
 }
 
-void IntelManager::update_feeds() {
-  auto new_blacklist = std::make_unique<std::unordered_set<uint32_t>>();
-
-  for (const auto &url_str : feed_urls_) {
-    std::regex url_regex(R"(^(https?):\/\/([^\/]+)(\/.*)?$)");
-    std::smatch match;
-    if (!std::regex_match(url_str, match, url_regex)) {
-      LOG(LogLevel::WARN, LogComponent::IO_THREATINTEL,
-          "IntelManager: Skipping invalid feed URL: " + url_str);
-      continue;
+bool IntelManager::fetch_feed(const std::string &url_str,
+                              std::string &body) const {
+  static const std::regex url_regex(R"(^(https?):\/\/([^\/]+)(\/.*)?$)");
+  constexpr std::string_view file_scheme = "file://";
+
+  if (url_str.find("://") == std::string::npos ||
+      url_str.rfind(file_scheme, 0) == 0) {
+    std::string path = url_str.rfind(file_scheme, 0) == 0
+                           ? url_str.substr(file_scheme.size())
+                           : url_str;
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+      LOG(LogLevel::ERROR, LogComponent::IO_THREATINTEL,
+          "IntelManager: Failed to read feed file " << path);
+      return false;
     }
-    std::string host = match[2].str();
-    std::string path = match[3].matched ? match[3].str() : "/";
-    bool is_https = (match[1].str() == "https");
-
-    auto process_request = [&](auto &client) {
-      auto res = client.Get(path.c_str());
-      if (res && res->status == 200) {
-        std::istringstream iss(res->body);
-        std::string line;
-        size_t count_before = new_blacklist->size();
-        while (std::getline(iss, line)) {
-          std::string trimmed_line = Utils::trim_copy(line);
-          if (trimmed_line.empty() || trimmed_line[0] == '#') {
-            continue;
-          }
-          uint32_t ip = Utils::ip_string_to_uint32(trimmed_line);
-          if (ip != 0) {
-            new_blacklist->insert(ip);
-          }
-        }
-        LOG(LogLevel::INFO, LogComponent::IO_THREATINTEL,
-            "Fetched " << std::to_string(new_blacklist->size() - count_before)
-                       << " IPs from " << url_str);
-      } else {
-        LOG(LogLevel::ERROR, LogComponent::IO_THREATINTEL,
-            "IntelManager: Failed to fetch feed from "
-                << url_str
-                << (res ? " | Status: " + std::to_string(res->status) : ""));
-      }
-    };
-
-    // Create the appropriate client
-    if (is_https) {
-      httplib::SSLClient cli(host);
-      cli.enable_server_certificate_verification(false);
-      process_request(cli);
-    } else {
-      httplib::Client cli(host);
-      process_request(cli);
+    body.assign(std::istreambuf_iterator<char>(in),
+                std::istreambuf_iterator<char>());
+    return true;
+  }
+
+  std::smatch match;
+  if (!std::regex_match(url_str, match, url_regex)) {
+    LOG(LogLevel::WARN, LogComponent::IO_THREATINTEL,
+        "IntelManager: Skipping invalid feed URL: " + url_str);
+    return false;
+  }
+  std::string host = match[2].str();
+  std::string path = match[3].matched ? match[3].str() : "/";
+  bool is_https = (match[1].str() == "https");
+
+  auto process_request = [&](auto &client) {
+    auto res = client.Get(path.c_str());
+    if (res && res->status == 200) {
+      body = std::move(res->body);
+      return true;
     }
+    LOG(LogLevel::ERROR, LogComponent::IO_THREATINTEL,
+        "IntelManager: Failed to fetch feed from "
+            << url_str
+            << (res ? " | Status: " + std::to_string(res->status) : ""));
+    return false;
+  };
+
+  // Create the appropriate client
+  if (is_https) {
+    httplib::SSLClient cli(host);
+    cli.enable_server_certificate_verification(false);
+    return process_request(cli);
   }
+  httplib::Client cli(host);
+  return process_request(cli);
+}
 
-  size_t final_count = 0;
+void IntelManager::update_feeds() {
+  std::vector<std::string> feed_urls;
   {
-    std::lock_guard<std::mutex> lock(list_mutex_);
-    ip_blacklist_ = std::move(new_blacklist);
-    if (ip_blacklist_)
-      final_count = ip_blacklist_->size();
+    std::lock_guard<std::mutex> lock(cv_mutex_);
+    feed_urls = feed_urls_;
   }
+
+  std::vector<Utils::IpPrefix> prefixes;
+  for (const auto &url_str : feed_urls) {
+    std::string body;
+    if (!fetch_feed(url_str, body))
+      continue;
+    size_t count = Utils::parse_ip_prefix_list(body, prefixes);
+    LOG(LogLevel::INFO, LogComponent::IO_THREATINTEL,
+        "Fetched " << count << " entries from " << url_str);
+  }
+
+  // Built entirely off the hot path; workers pick it up on their next event
+  auto blacklist =
+      std::make_shared<const Utils::IpPrefixSet>(std::move(prefixes));
+  size_t final_count = blacklist->prefix_count();
+  blacklist_.publish(std::move(blacklist));
   LOG(LogLevel::INFO, LogComponent::IO_THREATINTEL,
-      "IntelManager: Threat intelligence feeds updated. Total blacklisted IPs: "
+      "IntelManager: Threat intelligence feeds updated. Total blacklisted "
+      "networks: "
           << final_count);
-}
\ No newline at end of file
+}
@@ -1,38 +1,57 @@
 #ifndef INTEL_MANAGER_HPP
 #define INTEL_MANAGER_HPP
 
+#include "utils/ip_prefix_set.hpp"
+#include "utils/published_snapshot.hpp"
+
 #include <atomic>
 #include <condition_variable>
 #include <cstdint>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <string_view>
 #include <thread>
-#include <unordered_set>
 #include <vector>
 
+// One per process. A background thread downloads the feeds, builds a new
+// blacklist and publishes it with an atomic pointer swap; readers never wait
+// on a refresh. Feeds are http(s) URLs or local files (file:// URLs or
+// plain paths).
 class IntelManager {
 public:
   IntelManager(const std::vector<std::string> &feed_urls,
                uint32_t update_interval_seconds);
   ~IntelManager();
+
   bool is_blacklisted(uint32_t ip) const;
+  bool is_blacklisted(std::string_view ip) const;
+
+  // Workers read through their own Blacklist::Reader
+  using Blacklist = Utils::PublishedSnapshot<Utils::IpPrefixSet>;
+  const Blacklist &blacklist() const { return blacklist_; }
+
+  // Swaps the feed list and interval and refreshes in the background
+  void reconfigure(const std::vector<std::string> &feed_urls,
+                   uint32_t update_interval_seconds);
 
 private:
   void update_feeds();
   void background_thread_func();
+  bool fetch_feed(const std::string &url, std::string &body) const;
 
   std::vector<std::string> feed_urls_;
   uint32_t update_interval_seconds_;
+  bool refresh_requested_ = false;
 
-  std::unique_ptr<std::unordered_set<uint32_t>> ip_blacklist_;
-  mutable std::mutex list_mutex_;
+  Blacklist blacklist_;
 
   std::thread background_thread_;
   std::atomic<bool> shutdown_flag_{false};
 
   std::condition_variable cv_;
+  // Guards the feed list, interval and refresh request
   std::mutex cv_mutex_;
 };
 
-#endif // INTEL_MANAGER_HPP
\ No newline at end of file
+#endif // INTEL_MANAGER_HPP
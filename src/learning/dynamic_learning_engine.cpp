@@ -1,16 +1,203 @@
 #include "dynamic_learning_engine.hpp"
 #include "../analysis/analyzed_event.hpp"
+#include "../core/compact_serialization.hpp"
 #include "../core/logger.hpp"
+#include "../utils/stream_sketches.hpp"
+#include "../utils/utils.hpp"
 
 #include <algorithm>
 #include <chrono>
 #include <cmath>
+#include <cstdio>
+#include <fstream>
 #include <limits>
 #include <mutex>
 #include <shared_mutex>
+#include <stdexcept>
+#include <vector>
 
 namespace learning {
 
+namespace {
+constexpr uint32_t BASELINE_FILE_MAGIC = 0x4C424441; // "ADBL"
+constexpr uint32_t BASELINE_FILE_VERSION = 1;
+// A larger chunk length is taken as corruption rather than allocated
+constexpr uint32_t MAX_BASELINE_CHUNK_BYTES = 256u << 20;
+
+uint64_t mix64(uint64_t x) {
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ULL;
+  x ^= x >> 33;
+  return x;
+}
+
+// Field tags of LearningBaseline records. Append new tags; never renumber or
+// reuse one.
+namespace baseline_field {
+enum : uint32_t {
+  ENTITY_TYPE = 1,
+  ENTITY_ID = 2,
+  CREATED_AT = 3,
+  LAST_UPDATED = 4,
+  IS_ESTABLISHED = 5,
+  ESTABLISHED_TIME = 6,
+  STATISTICS = 7,
+  SEASONAL_MODEL = 8,
+  OVERRIDE_THRESHOLD = 9,
+  OVERRIDE_ACTIVE = 10,
+  OVERRIDE_OPERATOR = 11,
+  OVERRIDE_TIMESTAMP = 12,
+  SECURITY_CRITICAL = 13,
+  MAX_CHANGE_PERCENT = 14,
+  AUDIT_LOG = 15,
+};
+} // namespace baseline_field
+
+// Frames are a little-endian u32 length followed by that many bytes
+void write_frame(std::ofstream &out, const core::BinarySerializer &body) {
+  core::BinarySerializer length;
+  length.write_uint32(static_cast<uint32_t>(body.size()));
+  out.write(reinterpret_cast<const char *>(length.data().data()),
+            length.size());
+  out.write(reinterpret_cast<const char *>(body.data().data()), body.size());
+}
+
+bool read_exact(std::ifstream &in, std::vector<uint8_t> &buffer, size_t size) {
+  buffer.resize(size);
+  in.read(reinterpret_cast<char *>(buffer.data()),
+          static_cast<std::streamsize>(size));
+  return static_cast<size_t>(in.gcount()) == size;
+}
+} // namespace
+
+void LearningBaseline::serialize(core::BinarySerializer &out) const {
+  using namespace baseline_field;
+  std::lock_guard<std::mutex> lock(mutex);
+  core::TaggedRecordWriter record;
+  record.write_string(ENTITY_TYPE, entity_type);
+  record.write_string(ENTITY_ID, entity_id);
+  record.write_varint(CREATED_AT, created_at);
+  record.write_varint(LAST_UPDATED, last_updated);
+  if (is_established) {
+    record.write_varint(IS_ESTABLISHED, 1);
+    record.write_varint(ESTABLISHED_TIME, established_time);
+  }
+
+  core::BinarySerializer nested;
+  statistics.serialize(nested);
+  record.write_bytes(STATISTICS, nested);
+  nested.clear();
+  seasonal_model.serialize(nested);
+  record.write_bytes(SEASONAL_MODEL, nested);
+
+  if (!std::isnan(manual_override_threshold))
+    record.write_double(OVERRIDE_THRESHOLD, manual_override_threshold);
+  if (manual_override_active)
+    record.write_varint(OVERRIDE_ACTIVE, 1);
+  if (!override_operator_id.empty())
+    record.write_string(OVERRIDE_OPERATOR, override_operator_id);
+  if (override_timestamp_ms)
+    record.write_varint(OVERRIDE_TIMESTAMP, override_timestamp_ms);
+  if (is_security_critical)
+    record.write_varint(SECURITY_CRITICAL, 1);
+  record.write_double(MAX_CHANGE_PERCENT, max_threshold_change_percent);
+
+  if (!threshold_audit_log.empty()) {
+    nested.clear();
+    nested.write_varint32(static_cast<uint32_t>(threshold_audit_log.size()));
+    threshold_audit_log.for_each([&](const ThresholdAuditEntry &entry) {
+      nested.write_varint64(entry.timestamp_ms);
+      nested.write_double(entry.old_threshold);
+      nested.write_double(entry.new_threshold);
+      nested.write_double(entry.percentile);
+      nested.write_string_raw(entry.reason);
+      nested.write_string_raw(entry.operator_id);
+    });
+    record.write_bytes(AUDIT_LOG, nested);
+  }
+  record.finish(out);
+}
+
+void LearningBaseline::deserialize(core::BinaryDeserializer &in) {
+  using namespace baseline_field;
+  core::TaggedRecordReader record(in);
+  std::lock_guard<std::mutex> lock(mutex);
+  while (record.next()) {
+    switch (record.tag()) {
+    case ENTITY_TYPE:
+      entity_type = record.read_string();
+      break;
+    case ENTITY_ID:
+      entity_id = record.read_string();
+      break;
+    case CREATED_AT:
+      created_at = record.read_varint();
+      break;
+    case LAST_UPDATED:
+      last_updated = record.read_varint();
+      break;
+    case IS_ESTABLISHED:
+      is_established = record.read_varint() != 0;
+      break;
+    case ESTABLISHED_TIME:
+      established_time = record.read_varint();
+      break;
+    case STATISTICS: {
+      auto [data, size] = record.read_bytes();
+      core::BinaryDeserializer nested(data, size);
+      statistics.deserialize(nested);
+      break;
+    }
+    case SEASONAL_MODEL: {
+      auto [data, size] = record.read_bytes();
+      core::BinaryDeserializer nested(data, size);
+      seasonal_model.deserialize(nested);
+      break;
+    }
+    case OVERRIDE_THRESHOLD:
+      manual_override_threshold = record.read_double();
+      break;
+    case OVERRIDE_ACTIVE:
+      manual_override_active = record.read_varint() != 0;
+      break;
+    case OVERRIDE_OPERATOR:
+      override_operator_id = record.read_string();
+      break;
+    case OVERRIDE_TIMESTAMP:
+      override_timestamp_ms = record.read_varint();
+      break;
+    case SECURITY_CRITICAL:
+      is_security_critical = record.read_varint() != 0;
+      break;
+    case MAX_CHANGE_PERCENT:
+      max_threshold_change_percent = record.read_double();
+      break;
+    case AUDIT_LOG: {
+      auto [data, size] = record.read_bytes();
+      core::BinaryDeserializer nested(data, size);
+      threshold_audit_log.clear();
+      uint32_t count = nested.read_varint32();
+      for (uint32_t i = 0; i < count; ++i) {
+        ThresholdAuditEntry entry;
+        entry.timestamp_ms = nested.read_varint64();
+        entry.old_threshold = nested.read_double();
+        entry.new_threshold = nested.read_double();
+        entry.percentile = nested.read_double();
+        entry.reason = nested.read_string_raw();
+        entry.operator_id = nested.read_string_raw();
+        // Saved logs were already trimmed to the limit in force then
+        threshold_audit_log.add(std::move(entry), count);
+      }
+      break;
+    }
+    default:
+      break; // written by a newer version
+    }
+  }
+}
+
 DynamicLearningEngine::DynamicLearningEngine() {
   // Initialize with default configuration
   config_ = Config::DynamicLearningConfig();
@@ -22,104 +209,179 @@ DynamicLearningEngine::DynamicLearningEngine(
   max_gradual_threshold_step_ = config.gradual_threshold_step;
 }
 
-std::string
-DynamicLearningEngine::make_key(const std::string &entity_type,
-                                const std::string &entity_id) const {
-  return entity_type + ":" + entity_id;
+EntityKey make_entity_key(std::string_view entity_type,
+                          std::string_view entity_id) {
+  return mix64(Utils::sketch_hash(entity_type) * 0x9e3779b97f4a7c15ULL ^
+               Utils::sketch_hash(entity_id));
+}
+
+EntityKey DynamicLearningEngine::contextual_key(EntityKey key,
+                                                TimeContext context,
+                                                int context_value) {
+  uint64_t tag = static_cast<uint64_t>(context) << 32 |
+                 static_cast<uint32_t>(context_value);
+  return mix64(key ^ (tag + 1) * 0x9e3779b97f4a7c15ULL);
 }
 
-void DynamicLearningEngine::process_event(const std::string &entity_type,
-                                          const std::string &entity_id,
+void DynamicLearningEngine::process_event(std::string_view entity_type,
+                                          std::string_view entity_id,
                                           double value, uint64_t timestamp_ms) {
-  update_baseline(entity_type, entity_id, value, timestamp_ms);
-  // Update contextual baselines
   int hour = 0;
   get_time_context(timestamp_ms, hour);
-  auto hourly_baseline = get_contextual_baseline(entity_type, entity_id,
-                                                 TimeContext::HOURLY, hour);
-  hourly_baseline->statistics.add_value(value, timestamp_ms);
-  hourly_baseline->seasonal_model.add_observation(value, timestamp_ms);
-  hourly_baseline->last_updated = timestamp_ms;
-  if (!hourly_baseline->is_established &&
-      hourly_baseline->statistics.is_established(
-          config_.min_samples_for_contextual_baseline)) {
-    hourly_baseline->is_established = true;
-    hourly_baseline->established_time = timestamp_ms;
-  }
-
   // Day-of-week context
   time_t t = timestamp_ms / 1000;
   struct tm tmval;
   localtime_r(&t, &tmval);
   int day = tmval.tm_wday;
-  auto daily_baseline =
-      get_contextual_baseline(entity_type, entity_id, TimeContext::DAILY, day);
-  daily_baseline->statistics.add_value(value, timestamp_ms);
-  daily_baseline->seasonal_model.add_observation(value, timestamp_ms);
-  daily_baseline->last_updated = timestamp_ms;
-  if (!daily_baseline->is_established &&
-      daily_baseline->statistics.is_established(
+
+  // The entity and its contextual baselines share a shard, so one shared
+  // lock covers all three updates
+  EntityKey key = make_entity_key(entity_type, entity_id);
+  Shard &shard = shard_for(key);
+  std::shared_lock<std::shared_mutex> lock(shard.mutex);
+  update_baseline_locked(*find_or_insert(shard, lock, key, entity_type,
+                                         entity_id, TimeContext::NONE, 0),
+                         value, timestamp_ms);
+  update_contextual_locked(
+      *find_or_insert(shard, lock,
+                      contextual_key(key, TimeContext::HOURLY, hour),
+                      entity_type, entity_id, TimeContext::HOURLY, hour),
+      value, timestamp_ms);
+  update_contextual_locked(
+      *find_or_insert(shard, lock, contextual_key(key, TimeContext::DAILY, day),
+                      entity_type, entity_id, TimeContext::DAILY, day),
+      value, timestamp_ms);
+}
+
+void DynamicLearningEngine::update_contextual_locked(
+    LearningBaseline &baseline, double value, uint64_t timestamp_ms) {
+  std::lock_guard<std::mutex> baseline_lock(baseline.mutex);
+  baseline.statistics.add_value(value, timestamp_ms);
+  baseline.last_updated = timestamp_ms;
+  if (!baseline.is_established &&
+      baseline.statistics.is_established(
           config_.min_samples_for_contextual_baseline)) {
-    daily_baseline->is_established = true;
-    daily_baseline->established_time = timestamp_ms;
+    baseline.is_established = true;
+    baseline.established_time = timestamp_ms;
+  }
+  if (baseline.has_full_model())
+    baseline.seasonal_model.add_observation(value, timestamp_ms);
+}
+
+std::shared_ptr<LearningBaseline> &DynamicLearningEngine::find_or_insert(
+    Shard &shard, std::shared_lock<std::shared_mutex> &lock, EntityKey key,
+    std::string_view entity_type, std::string_view entity_id,
+    TimeContext context, int context_value) {
+  BaselineMap &map =
+      context == TimeContext::NONE ? shard.baselines : shard.contextual;
+  auto it = map.find(key);
+  // Loops because cleanup may drop the new baseline while unlocked
+  while (it == map.end()) {
+    lock.unlock();
+    {
+      std::unique_lock<std::shared_mutex> ulock(shard.mutex);
+      if (map.find(key) == map.end())
+        map.emplace(key, new_baseline(entity_type, entity_id, context,
+                                      context_value));
+    }
+    lock.lock();
+    it = map.find(key);
   }
+  return it->second;
+}
+
+std::shared_ptr<LearningBaseline>
+DynamicLearningEngine::find_baseline(const std::string &entity_type,
+                                     const std::string &entity_id) const {
+  EntityKey key = make_entity_key(entity_type, entity_id);
+  const Shard &shard = shard_for(key);
+  std::shared_lock<std::shared_mutex> lock(shard.mutex);
+  auto it = shard.baselines.find(key);
+  return it == shard.baselines.end() ? nullptr : it->second;
 }
 
 std::shared_ptr<LearningBaseline>
 DynamicLearningEngine::get_baseline(const std::string &entity_type,
                                     const std::string &entity_id) {
-  std::shared_lock<std::shared_mutex> lock(baselines_mutex_);
-  auto key = make_key(entity_type, entity_id);
-  auto it = baselines_.find(key);
-  if (it != baselines_.end())
-    return it->second;
-  lock.unlock();
-  // Create new baseline if not found
-  std::unique_lock<std::shared_mutex> ulock(baselines_mutex_);
+  EntityKey key = make_entity_key(entity_type, entity_id);
+  Shard &shard = shard_for(key);
+  std::shared_lock<std::shared_mutex> lock(shard.mutex);
+  return find_or_insert(shard, lock, key, entity_type, entity_id,
+                        TimeContext::NONE, 0);
+}
+
+std::shared_ptr<LearningBaseline>
+DynamicLearningEngine::new_baseline(std::string_view entity_type,
+                                    std::string_view entity_id,
+                                    TimeContext context,
+                                    int context_value) const {
   auto baseline = std::make_shared<LearningBaseline>();
   baseline->entity_type = entity_type;
   baseline->entity_id = entity_id;
+  baseline->time_context = static_cast<uint8_t>(context);
+  baseline->context_value = context_value;
   baseline->created_at = baseline->last_updated = 0;
   baseline->is_established = false;
+  // The members are not assignable (they own mutexes), so they are rebuilt in
+  // place with the configured parameters
+  baseline->statistics.~RollingStatistics();
+  new (&baseline->statistics) RollingStatistics(
+      context != TimeContext::NONE ? config_.contextual_statistics_alpha : 0.1,
+      1000, config_.percentile_relative_accuracy);
+  baseline->seasonal_model.~SeasonalModel();
   new (&baseline->seasonal_model)
       SeasonalModel(config_.min_samples_for_seasonal_pattern);
-  baselines_[key] = baseline;
   return baseline;
 }
 
-void DynamicLearningEngine::update_baseline(const std::string &entity_type,
-                                            const std::string &entity_id,
-                                            double value,
-                                            uint64_t timestamp_ms) {
-  auto baseline = get_baseline(entity_type, entity_id);
+double DynamicLearningEngine::update_baseline(std::string_view entity_type,
+                                              std::string_view entity_id,
+                                              double value,
+                                              uint64_t timestamp_ms) {
+  EntityKey key = make_entity_key(entity_type, entity_id);
+  Shard &shard = shard_for(key);
+  std::shared_lock<std::shared_mutex> lock(shard.mutex);
+  return update_baseline_locked(*find_or_insert(shard, lock, key, entity_type,
+                                                entity_id, TimeContext::NONE,
+                                                0),
+                                value, timestamp_ms);
+}
+
+double DynamicLearningEngine::update_baseline_locked(LearningBaseline &baseline,
+                                                     double value,
+                                                     uint64_t timestamp_ms) {
+  std::lock_guard<std::mutex> baseline_lock(baseline.mutex);
+  const std::string &entity_type = baseline.entity_type;
+  const std::string &entity_id = baseline.entity_id;
   // Capture old threshold for audit
   double old_threshold = std::numeric_limits<double>::quiet_NaN();
-  if (baseline->is_established) {
-    old_threshold = baseline->statistics.get_percentile(0.95);
+  if (baseline.is_established) {
+    old_threshold = baseline.statistics.get_percentile(0.95);
   }
 
-  baseline->statistics.add_value(value, timestamp_ms);
-  baseline->seasonal_model.add_observation(value, timestamp_ms);
-  baseline->last_updated = timestamp_ms;
+  baseline.statistics.add_value(value, timestamp_ms);
+  baseline.last_updated = timestamp_ms;
 
-  if (!baseline->is_established && baseline->statistics.is_established()) {
-    baseline->is_established = true;
-    baseline->established_time = timestamp_ms;
+  if (!baseline.is_established && baseline.statistics.is_established()) {
+    baseline.is_established = true;
+    baseline.established_time = timestamp_ms;
     LOG(LogLevel::INFO, LogComponent::ANALYSIS_STATS,
         "Baseline established for [" << entity_type << ":" << entity_id << "]");
   }
+  // Promoted entities also get seasonal modelling
+  if (baseline.has_full_model())
+    baseline.seasonal_model.add_observation(value, timestamp_ms);
 
-  if (!baseline->is_established)
-    return;
+  if (!baseline.is_established)
+    return std::numeric_limits<double>::quiet_NaN();
 
   // Calculate new threshold
-  double new_threshold = baseline->statistics.get_percentile(0.95);
+  double new_threshold = baseline.statistics.get_percentile(0.95);
 
   // Check if threshold change is acceptable (especially for security-critical
   // entities)
   if (!std::isnan(old_threshold) &&
-      !is_threshold_change_acceptable(*baseline, old_threshold,
-                                      new_threshold)) {
+      !is_threshold_change_acceptable(baseline, old_threshold, new_threshold)) {
     LOG(LogLevel::WARN, LogComponent::ANALYSIS_STATS,
         "Large threshold change detected for ["
             << entity_type << ":" << entity_id << "] "
@@ -128,7 +390,7 @@ void DynamicLearningEngine::update_baseline(const std::string &entity_type,
             << std::abs(new_threshold - old_threshold) /
                    std::abs(old_threshold) * 100.0
             << "%, "
-            << "max allowed: " << baseline->max_threshold_change_percent
+            << "max allowed: " << baseline.max_threshold_change_percent
             << "%)");
   }
 
@@ -137,31 +399,29 @@ void DynamicLearningEngine::update_baseline(const std::string &entity_type,
       std::abs(new_threshold - old_threshold) >
           0.01 * std::max(std::abs(old_threshold), 1.0)) {
 
-    add_threshold_audit_entry(*baseline, old_threshold, new_threshold, 0.95,
+    add_threshold_audit_entry(baseline, old_threshold, new_threshold, 0.95,
                               timestamp_ms, "Baseline update", "");
 
     // Invalidate threshold cache
-    baseline->cached_thresholds.clear();
-    baseline->threshold_cache_timestamp = 0;
+    baseline.cached_thresholds.clear();
+    baseline.threshold_cache_timestamp = 0;
 
     LOG(LogLevel::INFO, LogComponent::ANALYSIS_STATS,
         "Threshold change for [" << entity_type << ":" << entity_id << "] "
                                  << "old: " << old_threshold << ", new: "
                                  << new_threshold << ", ts: " << timestamp_ms);
   }
+
+  return baseline.manual_override_active ? baseline.manual_override_threshold
+                                         : new_threshold;
 }
 
 bool DynamicLearningEngine::is_anomalous(const std::string &entity_type,
                                          const std::string &entity_id,
                                          double value,
                                          double &anomaly_score) const {
-  std::shared_lock<std::shared_mutex> lock(baselines_mutex_);
-  auto key = make_key(entity_type, entity_id);
-  auto it = baselines_.find(key);
-  if (it == baselines_.end())
-    return false;
-  const auto &baseline = it->second;
-  if (!baseline->is_established)
+  auto baseline = find_baseline(entity_type, entity_id);
+  if (!baseline || !baseline->is_established)
     return false;
   double mean = baseline->statistics.get_mean();
   double stddev = baseline->statistics.get_standard_deviation();
@@ -227,20 +487,182 @@ DynamicLearningEngine::get_entity_threshold(const std::string &entity_type,
 }
 
 size_t DynamicLearningEngine::get_baseline_count() const {
-  std::shared_lock<std::shared_mutex> lock(baselines_mutex_);
-  return baselines_.size();
+  size_t count = 0;
+  for (const auto &shard : shards_) {
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    count += shard.baselines.size();
+  }
+  return count;
+}
+
+size_t DynamicLearningEngine::cleanup_expired_baselines(
+    uint64_t now_ms, uint64_t ttl_ms, std::vector<EntityKey> *removed) {
+  size_t dropped = 0;
+  for (auto &shard : shards_) {
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    for (BaselineMap *map : {&shard.baselines, &shard.contextual}) {
+      for (auto it = map->begin(); it != map->end();) {
+        if (now_ms > it->second->last_updated + ttl_ms) {
+          if (removed && map == &shard.baselines)
+            removed->push_back(it->first);
+          it = map->erase(it);
+          ++dropped;
+        } else {
+          ++it;
+        }
+      }
+    }
+  }
+  return dropped;
+}
+
+bool DynamicLearningEngine::save_baselines(const std::string &path,
+                                           size_t chunk_size) const {
+  std::vector<std::shared_ptr<LearningBaseline>> entries;
+  for (const auto &shard : shards_) {
+    std::shared_lock<std::shared_mutex> lock(shard.mutex);
+    for (const auto &[key, baseline] : shard.baselines)
+      entries.push_back(baseline);
+    for (const auto &[key, baseline] : shard.contextual)
+      entries.push_back(baseline);
+  }
+
+  std::string temp_path = path + ".tmp";
+  Utils::create_directory_for_file(path);
+  {
+    std::ofstream out(temp_path, std::ios::binary);
+    if (!out) {
+      LOG(LogLevel::ERROR, LogComponent::STATE_PERSIST,
+          "Could not open baseline file for writing: " << temp_path);
+      return false;
+    }
+    core::BinarySerializer header;
+    header.write_uint32(BASELINE_FILE_MAGIC);
+    header.write_uint32(BASELINE_FILE_VERSION);
+    out.write(reinterpret_cast<const char *>(header.data().data()),
+              header.size());
+
+    core::BinarySerializer chunk;
+    for (size_t begin = 0; begin < entries.size(); begin += chunk_size) {
+      const size_t end = std::min(entries.size(), begin + chunk_size);
+      chunk.clear();
+      chunk.write_varint64(end - begin);
+      for (size_t i = begin; i < end; ++i) {
+        // The context is fixed at creation, so it is read without the lock
+        const LearningBaseline &baseline = *entries[i];
+        chunk.write_varint32(baseline.time_context);
+        chunk.write_varint32(static_cast<uint32_t>(baseline.context_value));
+        baseline.serialize(chunk);
+      }
+      write_frame(out, chunk);
+    }
+
+    // An empty frame and the total mark a complete file
+    chunk.clear();
+    write_frame(out, chunk);
+    core::BinarySerializer trailer;
+    trailer.write_uint64(entries.size());
+    out.write(reinterpret_cast<const char *>(trailer.data().data()),
+              trailer.size());
+    if (!out.flush()) {
+      LOG(LogLevel::ERROR, LogComponent::STATE_PERSIST,
+          "Failed writing baseline file: " << temp_path);
+      out.close();
+      std::remove(temp_path.c_str());
+      return false;
+    }
+  }
+
+  if (std::rename(temp_path.c_str(), path.c_str()) != 0) {
+    LOG(LogLevel::ERROR, LogComponent::STATE_PERSIST,
+        "Could not rename baseline file into place: " << path);
+    std::remove(temp_path.c_str());
+    return false;
+  }
+  LOG(LogLevel::INFO, LogComponent::STATE_PERSIST,
+      "Saved " << entries.size() << " learning baselines to " << path);
+  return true;
 }
 
-void DynamicLearningEngine::cleanup_expired_baselines(uint64_t now_ms,
-                                                      uint64_t ttl_ms) {
-  std::unique_lock<std::shared_mutex> lock(baselines_mutex_);
-  for (auto it = baselines_.begin(); it != baselines_.end();) {
-    if (now_ms - it->second->last_updated > ttl_ms) {
-      it = baselines_.erase(it);
-    } else {
-      ++it;
+bool DynamicLearningEngine::load_baselines(const std::string &path) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    LOG(LogLevel::INFO, LogComponent::STATE_PERSIST,
+        "No learning baselines found at " << path << ". Starting fresh.");
+    return false;
+  }
+
+  std::vector<std::shared_ptr<LearningBaseline>> loaded;
+  size_t contextual_count = 0;
+  std::vector<uint8_t> buffer;
+  try {
+    if (!read_exact(in, buffer, 8))
+      throw std::runtime_error("missing header");
+    core::BinaryDeserializer header(buffer.data(), buffer.size());
+    if (header.read_uint32() != BASELINE_FILE_MAGIC ||
+        header.read_uint32() != BASELINE_FILE_VERSION) {
+      LOG(LogLevel::WARN, LogComponent::STATE_PERSIST,
+          "Learning baseline file " << path
+                                    << " is incompatible. Starting fresh.");
+      return false;
     }
+
+    uint64_t total = 0;
+    while (true) {
+      if (!read_exact(in, buffer, 4))
+        throw std::runtime_error("truncated chunk header");
+      uint32_t length =
+          core::BinaryDeserializer(buffer.data(), buffer.size()).read_uint32();
+      if (length == 0)
+        break;
+      if (length > MAX_BASELINE_CHUNK_BYTES || !read_exact(in, buffer, length))
+        throw std::runtime_error("truncated chunk");
+
+      core::BinaryDeserializer chunk(buffer.data(), buffer.size());
+      uint64_t count = chunk.read_varint64();
+      for (uint64_t i = 0; i < count; ++i) {
+        uint32_t context_tag = chunk.read_varint32();
+        if (context_tag > static_cast<uint32_t>(TimeContext::WEEKLY))
+          throw std::runtime_error("unknown time context");
+        auto context = static_cast<TimeContext>(context_tag);
+        int context_value = static_cast<int>(chunk.read_varint32());
+        auto baseline = new_baseline("", "", context, context_value);
+        baseline->deserialize(chunk);
+        if (context != TimeContext::NONE)
+          ++contextual_count;
+        loaded.push_back(std::move(baseline));
+      }
+      total += count;
+    }
+
+    if (!read_exact(in, buffer, 8) ||
+        core::BinaryDeserializer(buffer.data(), buffer.size()).read_uint64() !=
+            total)
+      throw std::runtime_error("baseline count does not match");
+  } catch (const std::exception &e) {
+    LOG(LogLevel::ERROR, LogComponent::STATE_PERSIST,
+        "Learning baseline file " << path << " is corrupt: " << e.what());
+    return false;
   }
+
+  // Baselines created since startup are newer than the saved ones
+  for (auto &baseline : loaded) {
+    EntityKey key = make_entity_key(baseline->entity_type, baseline->entity_id);
+    auto context = static_cast<TimeContext>(baseline->time_context);
+    Shard &shard = shard_for(key);
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    if (context == TimeContext::NONE)
+      shard.baselines.emplace(key, std::move(baseline));
+    else
+      shard.contextual.emplace(
+          contextual_key(key, context, baseline->context_value),
+          std::move(baseline));
+  }
+  LOG(LogLevel::INFO, LogComponent::STATE_PERSIST,
+      "Restored " << loaded.size() - contextual_count
+                  << " learning baselines and " << contextual_count
+                  << " contextual baselines from " << path);
+  return true;
 }
 
 void DynamicLearningEngine::process_analyzed_event(const AnalyzedEvent &event) {
@@ -253,34 +675,34 @@ void DynamicLearningEngine::process_analyzed_event(const AnalyzedEvent &event) {
   if (!event.raw_log.ip_address.empty()) {
     // Request time processing
     if (event.raw_log.request_time_s.has_value()) {
-      update_baseline("ip_request_time", std::string(event.raw_log.ip_address),
+      update_baseline("ip_request_time", event.raw_log.ip_address,
                       event.raw_log.request_time_s.value(), ts);
     }
 
     // Bytes sent processing
     if (event.raw_log.bytes_sent.has_value()) {
-      update_baseline("ip_bytes", std::string(event.raw_log.ip_address),
+      update_baseline("ip_bytes", event.raw_log.ip_address,
                       static_cast<double>(event.raw_log.bytes_sent.value()),
                       ts);
     }
 
     // Error rate processing (from historical analysis)
     if (event.ip_hist_error_rate_mean.has_value()) {
-      update_baseline("ip_error_rate", std::string(event.raw_log.ip_address),
+      update_baseline("ip_error_rate", event.raw_log.ip_address,
                       event.ip_hist_error_rate_mean.value(), ts);
     }
 
     // Request volume processing
     if (event.ip_hist_req_vol_mean.has_value()) {
       update_baseline("ip_request_volume",
-                      std::string(event.raw_log.ip_address),
+                      event.raw_log.ip_address,
                       event.ip_hist_req_vol_mean.value(), ts);
     }
 
     // Request count in window
     if (event.current_ip_request_count_in_window.has_value()) {
       update_baseline(
-          "ip_request_count", std::string(event.raw_log.ip_address),
+          "ip_request_count", event.raw_log.ip_address,
           static_cast<double>(event.current_ip_request_count_in_window.value()),
           ts);
     }
@@ -288,7 +710,7 @@ void DynamicLearningEngine::process_analyzed_event(const AnalyzedEvent &event) {
     // Failed login count
     if (event.current_ip_failed_login_count_in_window.has_value()) {
       update_baseline(
-          "ip_failed_logins", std::string(event.raw_log.ip_address),
+          "ip_failed_logins", event.raw_log.ip_address,
           static_cast<double>(
               event.current_ip_failed_login_count_in_window.value()),
           ts);
@@ -317,11 +739,11 @@ void DynamicLearningEngine::process_analyzed_event(const AnalyzedEvent &event) {
   }
 
   // --- Per-Session baseline updates ---
-  if (event.raw_session_state.has_value()) {
-    const auto &session_state = event.raw_session_state.value();
+  if (event.raw_session_state) {
+    const auto &session_state = *event.raw_session_state;
 
     // Use IP address as session identifier since session_id is not available
-    std::string session_key = std::string(event.raw_log.ip_address);
+    std::string_view session_key = event.raw_log.ip_address;
 
     if (!session_key.empty()) {
       // Session request count
@@ -399,25 +821,28 @@ void DynamicLearningEngine::set_manual_override(const std::string &entity_type,
                                                 const std::string &entity_id,
                                                 double threshold) {
   auto baseline = get_baseline(entity_type, entity_id);
-  double old_threshold = std::numeric_limits<double>::quiet_NaN();
-  if (baseline->is_established) {
-    old_threshold = baseline->statistics.get_percentile(0.95);
-  }
+  {
+    std::lock_guard<std::mutex> baseline_lock(baseline->mutex);
+    double old_threshold = std::numeric_limits<double>::quiet_NaN();
+    if (baseline->is_established) {
+      old_threshold = baseline->statistics.get_percentile(0.95);
+    }
 
-  baseline->manual_override_threshold = threshold;
-  baseline->manual_override_active = true;
-  baseline->override_timestamp_ms =
-      std::chrono::duration_cast<std::chrono::milliseconds>(
-          std::chrono::system_clock::now().time_since_epoch())
-          .count();
+    baseline->manual_override_threshold = threshold;
+    baseline->manual_override_active = true;
+    baseline->override_timestamp_ms =
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch())
+            .count();
 
-  // Add audit entry
-  add_threshold_audit_entry(*baseline, old_threshold, threshold, 0.95,
-                            baseline->override_timestamp_ms, "Manual override",
-                            "system");
+    // Add audit entry
+    add_threshold_audit_entry(*baseline, old_threshold, threshold, 0.95,
+                              baseline->override_timestamp_ms,
+                              "Manual override", "system");
 
-  // Invalidate cache
-  invalidate_threshold_cache(entity_type, entity_id);
+    // Invalidate cache
+    clear_threshold_cache_locked(*baseline);
+  }
 
   LOG(LogLevel::INFO, LogComponent::ANALYSIS_STATS,
       "Manual override set for [" << entity_type << ":" << entity_id << "] to "
@@ -427,30 +852,33 @@ void DynamicLearningEngine::set_manual_override(const std::string &entity_type,
 void DynamicLearningEngine::clear_manual_override(
     const std::string &entity_type, const std::string &entity_id) {
   auto baseline = get_baseline(entity_type, entity_id);
-  double old_threshold = baseline->manual_override_threshold;
+  {
+    std::lock_guard<std::mutex> baseline_lock(baseline->mutex);
+    double old_threshold = baseline->manual_override_threshold;
+
+    baseline->manual_override_active = false;
+    baseline->manual_override_threshold =
+        std::numeric_limits<double>::quiet_NaN();
+    baseline->override_operator_id.clear();
+    baseline->override_timestamp_ms = 0;
+
+    // Add audit entry
+    double new_threshold = std::numeric_limits<double>::quiet_NaN();
+    if (baseline->is_established) {
+      new_threshold = baseline->statistics.get_percentile(0.95);
+    }
 
-  baseline->manual_override_active = false;
-  baseline->manual_override_threshold =
-      std::numeric_limits<double>::quiet_NaN();
-  baseline->override_operator_id.clear();
-  baseline->override_timestamp_ms = 0;
+    add_threshold_audit_entry(
+        *baseline, old_threshold, new_threshold, 0.95,
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch())
+            .count(),
+        "Manual override cleared", "system");
 
-  // Add audit entry
-  double new_threshold = std::numeric_limits<double>::quiet_NaN();
-  if (baseline->is_established) {
-    new_threshold = baseline->statistics.get_percentile(0.95);
+    // Invalidate cache
+    clear_threshold_cache_locked(*baseline);
   }
 
-  add_threshold_audit_entry(
-      *baseline, old_threshold, new_threshold, 0.95,
-      std::chrono::duration_cast<std::chrono::milliseconds>(
-          std::chrono::system_clock::now().time_since_epoch())
-          .count(),
-      "Manual override cleared", "system");
-
-  // Invalidate cache
-  invalidate_threshold_cache(entity_type, entity_id);
-
   LOG(LogLevel::INFO, LogComponent::ANALYSIS_STATS,
       "Manual override cleared for [" << entity_type << ":" << entity_id
                                       << "]");
@@ -465,6 +893,7 @@ bool DynamicLearningEngine::update_baseline_with_threshold_check(
   auto baseline = get_baseline(entity_type, entity_id);
   if (!baseline)
     return false;
+  std::lock_guard<std::mutex> baseline_lock(baseline->mutex);
 
   // Get old threshold for comparison
   double old_threshold = std::numeric_limits<double>::quiet_NaN();
@@ -512,8 +941,7 @@ bool DynamicLearningEngine::update_baseline_with_threshold_check(
                               timestamp_ms, "Baseline update", "");
 
     // Invalidate threshold cache
-    baseline->cached_thresholds.clear();
-    baseline->threshold_cache_timestamp = 0;
+    clear_threshold_cache_locked(*baseline);
 
     LOG(LogLevel::INFO, LogComponent::ANALYSIS_STATS,
         "Threshold change for [" << entity_type << ":" << entity_id << "] "
@@ -528,14 +956,14 @@ double DynamicLearningEngine::calculate_percentile_threshold(
     const std::string &entity_type, const std::string &entity_id,
     double percentile, bool use_cache) const {
 
-  std::shared_lock<std::shared_mutex> lock(baselines_mutex_);
-  auto key = make_key(entity_type, entity_id);
-  auto it = baselines_.find(key);
-  if (it == baselines_.end() || !it->second->is_established) {
+  auto entry = find_baseline(entity_type, entity_id);
+  if (!entry || !entry->is_established) {
     return std::numeric_limits<double>::quiet_NaN();
   }
 
-  auto &baseline = *it->second;
+  auto &baseline = *entry;
+  // The cache is written below, so this reader locks like a mutator
+  std::lock_guard<std::mutex> baseline_lock(baseline.mutex);
   uint64_t current_time =
       std::chrono::duration_cast<std::chrono::milliseconds>(
           std::chrono::system_clock::now().time_since_epoch())
@@ -583,8 +1011,11 @@ void DynamicLearningEngine::mark_entity_as_security_critical(
     double max_change_percent) {
 
   auto baseline = get_baseline(entity_type, entity_id);
-  baseline->is_security_critical = true;
-  baseline->max_threshold_change_percent = max_change_percent;
+  {
+    std::lock_guard<std::mutex> baseline_lock(baseline->mutex);
+    baseline->is_security_critical = true;
+    baseline->max_threshold_change_percent = max_change_percent;
+  }
 
   LOG(LogLevel::INFO, LogComponent::ANALYSIS_STATS,
       "Entity marked as security critical ["
@@ -596,8 +1027,11 @@ void DynamicLearningEngine::unmark_entity_as_security_critical(
     const std::string &entity_type, const std::string &entity_id) {
 
   auto baseline = get_baseline(entity_type, entity_id);
-  baseline->is_security_critical = false;
-  baseline->max_threshold_change_percent = 50.0; // Reset to default
+  {
+    std::lock_guard<std::mutex> baseline_lock(baseline->mutex);
+    baseline->is_security_critical = false;
+    baseline->max_threshold_change_percent = 50.0; // Reset to default
+  }
 
   LOG(LogLevel::INFO, LogComponent::ANALYSIS_STATS,
       "Entity unmarked as security critical [" << entity_type << ":"
@@ -607,10 +1041,11 @@ void DynamicLearningEngine::unmark_entity_as_security_critical(
 bool DynamicLearningEngine::is_entity_security_critical(
     const std::string &entity_type, const std::string &entity_id) const {
 
-  std::shared_lock<std::shared_mutex> lock(baselines_mutex_);
-  auto key = make_key(entity_type, entity_id);
-  auto it = baselines_.find(key);
-  return it != baselines_.end() && it->second->is_security_critical;
+  auto baseline = find_baseline(entity_type, entity_id);
+  if (!baseline)
+    return false;
+  std::lock_guard<std::mutex> baseline_lock(baseline->mutex);
+  return baseline->is_security_critical;
 }
 
 bool DynamicLearningEngine::set_manual_override_with_validation(
@@ -631,6 +1066,7 @@ bool DynamicLearningEngine::set_manual_override_with_validation(
   }
 
   auto baseline = get_baseline(entity_type, entity_id);
+  std::lock_guard<std::mutex> baseline_lock(baseline->mutex);
   double old_threshold = std::numeric_limits<double>::quiet_NaN();
   if (baseline->is_established) {
     old_threshold = baseline->statistics.get_percentile(0.95);
@@ -665,7 +1101,7 @@ bool DynamicLearningEngine::set_manual_override_with_validation(
                             operator_id);
 
   // Invalidate cache
-  invalidate_threshold_cache(entity_type, entity_id);
+  clear_threshold_cache_locked(*baseline);
 
   LOG(LogLevel::INFO, LogComponent::ANALYSIS_STATS,
       "Manual override set for [" << entity_type << ":" << entity_id << "] to "
@@ -679,19 +1115,19 @@ std::vector<ThresholdAuditEntry> DynamicLearningEngine::get_threshold_audit_log(
     const std::string &entity_type, const std::string &entity_id,
     uint64_t since_timestamp_ms) const {
 
-  std::shared_lock<std::shared_mutex> lock(baselines_mutex_);
-  auto key = make_key(entity_type, entity_id);
-  auto it = baselines_.find(key);
-  if (it == baselines_.end()) {
+  auto baseline = find_baseline(entity_type, entity_id);
+  if (!baseline) {
     return {};
   }
 
+  std::lock_guard<std::mutex> baseline_lock(baseline->mutex);
   std::vector<ThresholdAuditEntry> result;
-  for (const auto &entry : it->second->threshold_audit_log) {
-    if (entry.timestamp_ms >= since_timestamp_ms) {
-      result.push_back(entry);
-    }
-  }
+  baseline->threshold_audit_log.for_each(
+      [&](const ThresholdAuditEntry &entry) {
+        if (entry.timestamp_ms >= since_timestamp_ms) {
+          result.push_back(entry);
+        }
+      });
 
   return result;
 }
@@ -700,7 +1136,10 @@ void DynamicLearningEngine::clear_threshold_audit_log(
     const std::string &entity_type, const std::string &entity_id) {
 
   auto baseline = get_baseline(entity_type, entity_id);
-  baseline->threshold_audit_log.clear();
+  {
+    std::lock_guard<std::mutex> baseline_lock(baseline->mutex);
+    baseline->threshold_audit_log.clear();
+  }
 
   LOG(LogLevel::INFO, LogComponent::ANALYSIS_STATS,
       "Threshold audit log cleared for [" << entity_type << ":" << entity_id
@@ -711,15 +1150,23 @@ void DynamicLearningEngine::invalidate_threshold_cache(
     const std::string &entity_type, const std::string &entity_id) {
 
   auto baseline = get_baseline(entity_type, entity_id);
-  baseline->cached_thresholds.clear();
-  baseline->threshold_cache_timestamp = 0;
+  std::lock_guard<std::mutex> baseline_lock(baseline->mutex);
+  clear_threshold_cache_locked(*baseline);
+}
+
+void DynamicLearningEngine::clear_threshold_cache_locked(
+    LearningBaseline &baseline) {
+  baseline.cached_thresholds.clear();
+  baseline.threshold_cache_timestamp = 0;
 }
 
 void DynamicLearningEngine::invalidate_all_threshold_caches() {
-  std::unique_lock<std::shared_mutex> lock(baselines_mutex_);
-  for (auto &[key, baseline] : baselines_) {
-    baseline->cached_thresholds.clear();
-    baseline->threshold_cache_timestamp = 0;
+  for (auto &shard : shards_) {
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    for (auto &[key, baseline] : shard.baselines) {
+      std::lock_guard<std::mutex> baseline_lock(baseline->mutex);
+      clear_threshold_cache_locked(*baseline);
+    }
   }
 }
 
@@ -738,13 +1185,37 @@ void DynamicLearningEngine::add_threshold_audit_entry(
   entry.reason = reason;
   entry.operator_id = operator_id;
 
-  baseline.threshold_audit_log.push_back(entry);
-
   // Maintain maximum audit log size based on configuration
-  size_t max_entries = config_.max_audit_entries_per_entity;
-  while (baseline.threshold_audit_log.size() > max_entries) {
-    baseline.threshold_audit_log.pop_front();
+  baseline.threshold_audit_log.add(std::move(entry),
+                                   config_.max_audit_entries_per_entity);
+}
+
+void ThresholdAuditLog::add(ThresholdAuditEntry entry, size_t max_entries) {
+  if (max_entries == 0) {
+    clear();
+    return;
+  }
+  if (oldest_ != 0 && entries_.size() != max_entries) {
+    // The limit changed since the log filled; put it back in order first
+    std::rotate(entries_.begin(),
+                entries_.begin() + static_cast<std::ptrdiff_t>(oldest_),
+                entries_.end());
+    oldest_ = 0;
+  }
+  if (entries_.size() > max_entries)
+    entries_.erase(entries_.begin(),
+                   entries_.end() - static_cast<std::ptrdiff_t>(max_entries));
+  if (entries_.size() < max_entries) {
+    entries_.push_back(std::move(entry));
+    return;
   }
+  entries_[oldest_] = std::move(entry);
+  oldest_ = (oldest_ + 1) % entries_.size();
+}
+
+void ThresholdAuditLog::clear() {
+  entries_.clear();
+  oldest_ = 0;
 }
 
 bool DynamicLearningEngine::is_threshold_change_acceptable(
@@ -810,15 +1281,12 @@ double DynamicLearningEngine::calculate_adaptive_threshold(
     const std::string &entity_type, const std::string &entity_id,
     uint64_t timestamp_ms, double base_percentile) const {
 
-  std::shared_lock<std::shared_mutex> lock(baselines_mutex_);
-  auto key = make_key(entity_type, entity_id);
-  auto it = baselines_.find(key);
-  if (it == baselines_.end() || !it->second->is_established) {
+  auto entry = find_baseline(entity_type, entity_id);
+  if (!entry || !entry->is_established) {
     return std::numeric_limits<double>::quiet_NaN();
   }
 
-  const auto &baseline = *it->second;
-  lock.unlock();
+  const auto &baseline = *entry;
 
   // Apply manual override if active
   if (baseline.manual_override_active) {
@@ -980,13 +1448,16 @@ void DynamicLearningEngine::trigger_threshold_adaptation(
       std::abs(new_threshold - old_threshold) >
           0.01 * std::max(std::abs(old_threshold), 1.0)) {
 
-    // Log the adaptation
-    add_threshold_audit_entry(*baseline, old_threshold, new_threshold, 0.95,
-                              timestamp_ms, "Adaptive threshold update",
-                              "system");
+    {
+      std::lock_guard<std::mutex> baseline_lock(baseline->mutex);
+      // Log the adaptation
+      add_threshold_audit_entry(*baseline, old_threshold, new_threshold, 0.95,
+                                timestamp_ms, "Adaptive threshold update",
+                                "system");
 
-    // Invalidate cache to force recalculation
-    invalidate_threshold_cache(entity_type, entity_id);
+      // Invalidate cache to force recalculation
+      clear_threshold_cache_locked(*baseline);
+    }
 
     // Get confidence information for logging
     double seasonal_confidence =
@@ -1046,38 +1517,24 @@ DynamicLearningEngine::get_contextual_baseline(const std::string &entity_type,
                                                const std::string &entity_id,
                                                TimeContext context,
                                                int context_value) {
-  ContextualKey key{entity_type, entity_id, context, context_value};
-  std::shared_lock<std::shared_mutex> lock(baselines_mutex_);
-  auto it = contextual_baselines_.find(key);
-  if (it != contextual_baselines_.end())
-    return it->second;
-  lock.unlock();
-  std::unique_lock<std::shared_mutex> ulock(baselines_mutex_);
-  auto baseline = std::make_shared<LearningBaseline>();
-  baseline->entity_type = entity_type;
-  baseline->entity_id = entity_id;
-  baseline->created_at = baseline->last_updated = 0;
-  baseline->is_established = false;
-  new (&baseline->statistics)
-      RollingStatistics(config_.contextual_statistics_alpha, 1000);
-  new (&baseline->seasonal_model)
-      SeasonalModel(config_.min_samples_for_seasonal_pattern);
-  contextual_baselines_[key] = baseline;
-  return baseline;
+  EntityKey key = make_entity_key(entity_type, entity_id);
+  Shard &shard = shard_for(key);
+  std::shared_lock<std::shared_mutex> lock(shard.mutex);
+  return find_or_insert(shard, lock,
+                        contextual_key(key, context, context_value),
+                        entity_type, entity_id, context, context_value);
 }
 
 double DynamicLearningEngine::calculate_time_based_threshold(
     const std::string &entity_type, const std::string &entity_id,
     uint64_t timestamp_ms, double base_percentile) const {
 
-  std::shared_lock<std::shared_mutex> lock(baselines_mutex_);
-  auto key = make_key(entity_type, entity_id);
-  auto it = baselines_.find(key);
-  if (it == baselines_.end() || !it->second->is_established) {
+  auto entry = find_baseline(entity_type, entity_id);
+  if (!entry || !entry->is_established) {
     return std::numeric_limits<double>::quiet_NaN();
   }
 
-  const auto &baseline = *it->second;
+  const auto &baseline = *entry;
 
   // Get time context for the timestamp
   int context_value = 0;
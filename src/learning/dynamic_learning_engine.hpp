@@ -6,16 +6,28 @@
 #include "rolling_statistics.hpp"
 #include "seasonal_model.hpp"
 
+#include <array>
+#include <cstddef>
 #include <cstdint>
-#include <deque>
 #include <limits>
 #include <memory>
+#include <mutex>
 #include <shared_mutex>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <vector>
 
 namespace learning {
 
+// Baselines are keyed by a 64-bit hash of (entity type, entity id) instead of
+// a concatenated "type:id" string, so the hot path neither allocates nor
+// compares strings. Two distinct entities only collide with probability
+// ~n^2/2^65, and a collision merely merges their statistics.
+using EntityKey = uint64_t;
+EntityKey make_entity_key(std::string_view entity_type,
+                          std::string_view entity_id);
+
 struct ThresholdAuditEntry {
   uint64_t timestamp_ms;
   double old_threshold;
@@ -25,11 +37,41 @@ struct ThresholdAuditEntry {
   std::string operator_id; // For manual overrides
 };
 
+// Newest audit entries of one baseline, oldest first. Once the log holds
+// max_entries, each new entry overwrites the oldest one in place. Allocates
+// nothing until the first entry.
+class ThresholdAuditLog {
+public:
+  void add(ThresholdAuditEntry entry, size_t max_entries);
+  void clear();
+
+  size_t size() const { return entries_.size(); }
+  bool empty() const { return entries_.empty(); }
+
+  template <typename Fn> void for_each(Fn &&fn) const {
+    for (size_t i = 0; i < entries_.size(); ++i)
+      fn(entries_[(oldest_ + i) % entries_.size()]);
+  }
+
+private:
+  std::vector<ThresholdAuditEntry> entries_;
+  size_t oldest_ = 0;
+};
+
+// Every entity gets one. Its rolling summary is fixed-size: EWMA, variance
+// and two quantile sketches whose size follows the spread of the values,
+// not the number of samples. The seasonal model, threshold cache and audit
+// log allocate nothing until used; the seasonal model is only fed once the
+// baseline is established or the entity is marked security critical.
 struct LearningBaseline {
   RollingStatistics statistics;
   SeasonalModel seasonal_model;
   std::string entity_type;
   std::string entity_id;
+  // DynamicLearningEngine::TimeContext and its value for contextual
+  // baselines, NONE (0) for entity baselines
+  uint8_t time_context = 0;
+  int context_value = 0;
   uint64_t created_at;
   uint64_t last_updated;
   bool is_established;
@@ -46,12 +88,26 @@ struct LearningBaseline {
   uint64_t override_timestamp_ms = 0;
 
   // Audit trail for threshold changes
-  std::deque<ThresholdAuditEntry> threshold_audit_log;
+  ThresholdAuditLog threshold_audit_log;
 
   // Security-critical threshold flags
   bool is_security_critical = false;
   double max_threshold_change_percent =
       50.0; // Maximum allowed threshold change
+
+  bool has_full_model() const {
+    return is_established || is_security_critical;
+  }
+
+  // Serializes updates of the fields above with concurrent saves. Statistics
+  // and the seasonal model have their own locks.
+  mutable std::mutex mutex;
+
+  // Tagged record (see core::TaggedRecordWriter). Threshold caches are not
+  // encoded; statistics and the seasonal model are decoded into the
+  // instances already constructed with the current configuration.
+  void serialize(core::BinarySerializer &out) const;
+  void deserialize(core::BinaryDeserializer &in);
 };
 
 class DynamicLearningEngine {
@@ -59,24 +115,41 @@ public:
   explicit DynamicLearningEngine();
   explicit DynamicLearningEngine(
       const struct Config::DynamicLearningConfig &config);
-  void process_event(const std::string &entity_type,
-                     const std::string &entity_id, double value,
-                     uint64_t timestamp_ms);
+  void process_event(std::string_view entity_type, std::string_view entity_id,
+                     double value, uint64_t timestamp_ms);
   void process_analyzed_event(const struct AnalyzedEvent &event);
   bool is_anomalous(const std::string &entity_type,
                     const std::string &entity_id, double value,
                     double &anomaly_score) const;
   std::shared_ptr<LearningBaseline> get_baseline(const std::string &entity_type,
                                                  const std::string &entity_id);
-  void update_baseline(const std::string &entity_type,
-                       const std::string &entity_id, double value,
-                       uint64_t timestamp_ms);
+  // Returns the entity's effective 95th percentile threshold after the
+  // update (the manual override if one is active), NaN while the baseline
+  // is not yet established
+  double update_baseline(std::string_view entity_type,
+                         std::string_view entity_id, double value,
+                         uint64_t timestamp_ms);
   double calculate_dynamic_threshold(const LearningBaseline &baseline,
                                      uint64_t timestamp_ms,
                                      double percentile = 0.95) const;
   size_t get_baseline_count() const;
-  void cleanup_expired_baselines(uint64_t now_ms,
-                                 uint64_t ttl_ms = 72 * 3600 * 1000);
+  // Drops baselines, contextual ones included, not updated within ttl_ms of
+  // now_ms. Returns the number dropped; the keys of dropped entity
+  // baselines are appended to removed if given.
+  size_t cleanup_expired_baselines(uint64_t now_ms,
+                                   uint64_t ttl_ms = 72 * 3600 * 1000,
+                                   std::vector<EntityKey> *removed = nullptr);
+
+  // Streams every baseline, contextual ones included, to path in chunks of
+  // chunk_size records through a temporary file. Each shard lock is only
+  // held to collect its baselines and each baseline only while it is
+  // encoded, so update_baseline() keeps running during a save.
+  bool save_baselines(const std::string &path, size_t chunk_size = 1024) const;
+
+  // Reads the baselines saved at path one chunk at a time and adds those not
+  // already in memory. Nothing is added if the file is incompatible or
+  // corrupt.
+  bool load_baselines(const std::string &path);
   double get_entity_threshold(const std::string &entity_type,
                               const std::string &entity_id,
                               double percentile = 0.95) const;
@@ -165,42 +238,59 @@ public:
                           int context_value);
 
 private:
-  mutable std::shared_mutex baselines_mutex_;
-  std::unordered_map<std::string, std::shared_ptr<LearningBaseline>> baselines_;
-  Config::DynamicLearningConfig config_;
-
-  // Time-contextual baseline support
-  struct ContextualKey {
-    std::string entity_type;
-    std::string entity_id;
-    TimeContext context;
-    int context_value; // hour (0-23), day (0-6), week (0-3)
-    bool operator==(const ContextualKey &other) const {
-      return entity_type == other.entity_type && entity_id == other.entity_id &&
-             context == other.context && context_value == other.context_value;
-    }
-  };
-  struct ContextualKeyHash {
-    std::size_t operator()(const ContextualKey &k) const {
-      return std::hash<std::string>()(k.entity_type) ^
-             std::hash<std::string>()(k.entity_id) ^
-             std::hash<int>()(static_cast<int>(k.context)) ^
-             std::hash<int>()(k.context_value);
-    }
+  // Baselines are striped over kShardCount shards by entity key. Events are
+  // sharded by IP across workers, so IP and session baselines are in practice
+  // only updated by one worker and their shard locks are uncontended; path
+  // baselines are shared and take the shard lock in shared mode. An entity's
+  // contextual baselines live in the same shard as the entity itself.
+  static constexpr size_t kShardCount = 64;
+
+  using BaselineMap =
+      std::unordered_map<EntityKey, std::shared_ptr<LearningBaseline>>;
+  struct Shard {
+    mutable std::shared_mutex mutex;
+    BaselineMap baselines;
+    BaselineMap contextual;
   };
 
-  // Contextual baselines: key is ContextualKey
-  std::unordered_map<ContextualKey, std::shared_ptr<LearningBaseline>,
-                     ContextualKeyHash>
-      contextual_baselines_;
+  Shard &shard_for(EntityKey key) const {
+    return shards_[key % kShardCount];
+  }
+  static EntityKey contextual_key(EntityKey key, TimeContext context,
+                                  int context_value);
+
+  mutable std::array<Shard, kShardCount> shards_;
+  Config::DynamicLearningConfig config_;
 
   // Gradual threshold adjustment config
   double max_gradual_threshold_step_ = 0.1; // 10% per update
 
-  std::string make_key(const std::string &entity_type,
-                       const std::string &entity_id) const;
+  std::shared_ptr<LearningBaseline>
+  new_baseline(std::string_view entity_type, std::string_view entity_id,
+               TimeContext context, int context_value) const;
+
+  // Returns the baseline for key in shard, creating it if needed. lock must
+  // hold the shard in shared mode; it is briefly released to insert. The
+  // reference is valid for as long as lock is held.
+  std::shared_ptr<LearningBaseline> &
+  find_or_insert(Shard &shard, std::shared_lock<std::shared_mutex> &lock,
+                 EntityKey key, std::string_view entity_type,
+                 std::string_view entity_id, TimeContext context,
+                 int context_value);
+
+  // Existing baseline or nullptr, without creating one
+  std::shared_ptr<LearningBaseline>
+  find_baseline(const std::string &entity_type,
+                const std::string &entity_id) const;
+
+  double update_baseline_locked(LearningBaseline &baseline, double value,
+                                uint64_t timestamp_ms);
+  void update_contextual_locked(LearningBaseline &baseline, double value,
+                                uint64_t timestamp_ms);
 
-  // Private helper methods for threshold management
+  // Private helper methods for threshold management. Callers hold the
+  // baseline's mutex.
+  static void clear_threshold_cache_locked(LearningBaseline &baseline);
   void add_threshold_audit_entry(LearningBaseline &baseline,
                                  double old_threshold, double new_threshold,
                                  double percentile, uint64_t timestamp_ms,
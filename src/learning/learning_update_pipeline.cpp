@@ -0,0 +1,249 @@
+#include "learning_update_pipeline.hpp"
+#include "../core/logger.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+namespace learning {
+
+namespace {
+
+// 0 marks an empty slot, so the one entity key equal to it is stored as 1:
+// no likelier a collision than any other between two 64-bit keys
+EntityKey stored_key(EntityKey key) { return key == 0 ? 1 : key; }
+
+uint64_t to_bits(double value) {
+  uint64_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+double from_bits(uint64_t bits) {
+  double value;
+  std::memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+} // namespace
+
+ThresholdSnapshot::ThresholdSnapshot()
+    : table_(std::make_shared<Table>(64)) {}
+
+double ThresholdSnapshot::get(std::string_view entity_type,
+                              std::string_view entity_id) const {
+  return get(make_entity_key(entity_type, entity_id));
+}
+
+double ThresholdSnapshot::get(EntityKey key) const {
+  auto table = std::atomic_load(&table_);
+  const Slot &slot = probe(*table, stored_key(key));
+  if (slot.key.load(std::memory_order_acquire) == 0)
+    return std::numeric_limits<double>::quiet_NaN();
+  return from_bits(slot.threshold.load(std::memory_order_relaxed));
+}
+
+ThresholdSnapshot::Slot &ThresholdSnapshot::probe(const Table &table,
+                                                  EntityKey key) {
+  // Entity keys are already mixed, so their low bits are the home slot. The
+  // table is never more than half used, so the probe always ends.
+  for (size_t i = key & table.mask;; i = (i + 1) & table.mask) {
+    EntityKey found = table.slots[i].key.load(std::memory_order_acquire);
+    if (found == key || found == 0)
+      return table.slots[i];
+  }
+}
+
+void ThresholdSnapshot::publish(const std::vector<Update> &thresholds) {
+  if (thresholds.empty())
+    return;
+  std::lock_guard<std::mutex> lock(publish_mutex_);
+  for (const auto &[entity, threshold] : thresholds) {
+    const EntityKey key = stored_key(entity);
+    Slot *slot = &probe(*table_, key);
+    const bool removing = std::isnan(threshold);
+    if (slot->key.load(std::memory_order_relaxed) == 0) {
+      if (removing)
+        continue;
+      if ((table_->used + 1) * 2 > table_->mask + 1) {
+        rebuild(1);
+        slot = &probe(*table_, key);
+      }
+      // The threshold is in place before readers can find the key
+      slot->threshold.store(to_bits(threshold), std::memory_order_relaxed);
+      slot->key.store(key, std::memory_order_release);
+      ++table_->used;
+      size_.fetch_add(1, std::memory_order_relaxed);
+      continue;
+    }
+    const bool was_live =
+        !std::isnan(from_bits(slot->threshold.load(std::memory_order_relaxed)));
+    slot->threshold.store(to_bits(threshold), std::memory_order_relaxed);
+    if (was_live && removing)
+      size_.fetch_sub(1, std::memory_order_relaxed);
+    else if (!was_live && !removing)
+      size_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void ThresholdSnapshot::rebuild(size_t extra) {
+  // Sized for four times the live keys, so the next rebuild is at least as
+  // many inserts away as this one copies
+  const size_t live = size_.load(std::memory_order_relaxed);
+  size_t capacity = 64;
+  while (capacity < (live + extra) * 4)
+    capacity *= 2;
+  auto grown = std::make_shared<Table>(capacity);
+  for (size_t i = 0; i <= table_->mask; ++i) {
+    const Slot &slot = table_->slots[i];
+    EntityKey key = slot.key.load(std::memory_order_relaxed);
+    uint64_t bits = slot.threshold.load(std::memory_order_relaxed);
+    if (key == 0 || std::isnan(from_bits(bits)))
+      continue;
+    Slot &target = probe(*grown, key);
+    target.threshold.store(bits, std::memory_order_relaxed);
+    target.key.store(key, std::memory_order_relaxed);
+    ++grown->used;
+  }
+  // Readers still holding the old table see it as of this point
+  std::atomic_store(&table_, std::move(grown));
+}
+
+LearningUpdatePipeline::LearningUpdatePipeline(
+    DynamicLearningEngine &engine, size_t producer_count, size_t thread_count,
+    std::chrono::milliseconds flush_interval, size_t max_pending_per_producer)
+    : engine_(engine), flush_interval_(flush_interval),
+      max_pending_(max_pending_per_producer) {
+  thread_count = std::max<size_t>(1, std::min(thread_count, producer_count));
+  for (size_t i = 0; i < producer_count; ++i)
+    buffers_.push_back(std::make_unique<ProducerBuffer>());
+  for (size_t i = 0; i < thread_count; ++i)
+    folders_.push_back(std::make_unique<Folder>());
+  for (size_t i = 0; i < thread_count; ++i)
+    threads_.emplace_back(&LearningUpdatePipeline::run, this, i);
+}
+
+LearningUpdatePipeline::~LearningUpdatePipeline() { stop(); }
+
+void LearningUpdatePipeline::record(size_t producer,
+                                    std::string_view entity_type,
+                                    std::string_view entity_id, double value,
+                                    uint64_t timestamp_ms) {
+  ProducerBuffer &buffer = *buffers_[producer];
+  std::lock_guard<std::mutex> lock(buffer.mutex);
+  if (buffer.pending.size() >= max_pending_) {
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  buffer.pending.push_back(Update{entity_type, buffer.ids.size(),
+                                  entity_id.size(), value, timestamp_ms});
+  buffer.ids.append(entity_id);
+}
+
+void LearningUpdatePipeline::set_baseline_expiry(uint64_t ttl_ms,
+                                                 uint64_t interval_ms) {
+  baseline_ttl_ms_.store(ttl_ms, std::memory_order_relaxed);
+  expiry_interval_ms_.store(interval_ms, std::memory_order_relaxed);
+}
+
+void LearningUpdatePipeline::flush() {
+  for (size_t i = 0; i < folders_.size(); ++i)
+    fold(i);
+  expire_baselines();
+}
+
+void LearningUpdatePipeline::stop() {
+  {
+    std::lock_guard<std::mutex> lock(wake_mutex_);
+    if (stopping_)
+      return;
+    stopping_ = true;
+  }
+  wake_cv_.notify_all();
+  for (auto &thread : threads_)
+    if (thread.joinable())
+      thread.join();
+  // Catch updates recorded while the threads were finishing
+  flush();
+  if (dropped_updates() > 0)
+    LOG(LogLevel::WARN, LogComponent::ANALYSIS_STATS,
+        "Learning update buffers overflowed; " << dropped_updates()
+                                                << " updates were dropped");
+}
+
+void LearningUpdatePipeline::run(size_t thread_index) {
+  std::unique_lock<std::mutex> lock(wake_mutex_);
+  while (!stopping_) {
+    wake_cv_.wait_for(lock, flush_interval_, [this] { return stopping_; });
+    lock.unlock();
+    fold(thread_index);
+    if (thread_index == 0)
+      expire_baselines();
+    lock.lock();
+  }
+}
+
+void LearningUpdatePipeline::fold(size_t thread_index) {
+  Folder &folder = *folders_[thread_index];
+  std::lock_guard<std::mutex> fold_lock(folder.mutex);
+  for (size_t p = thread_index; p < buffers_.size(); p += folders_.size()) {
+    {
+      // The emptied batch goes back to the producer with its capacity
+      ProducerBuffer &buffer = *buffers_[p];
+      std::lock_guard<std::mutex> lock(buffer.mutex);
+      folder.batch.swap(buffer.pending);
+      folder.batch_ids.swap(buffer.ids);
+    }
+    const std::string_view ids = folder.batch_ids;
+    uint64_t latest = 0;
+    for (const Update &update : folder.batch) {
+      latest = std::max(latest, update.timestamp_ms);
+      std::string_view entity_id = ids.substr(update.id_offset, update.id_size);
+      // Later thresholds of an entity overwrite earlier ones on publish
+      folder.thresholds.emplace_back(
+          make_entity_key(update.entity_type, entity_id),
+          engine_.update_baseline(update.entity_type, entity_id, update.value,
+                                  update.timestamp_ms));
+    }
+    folder.batch.clear();
+    folder.batch_ids.clear();
+
+    uint64_t seen = latest_timestamp_ms_.load(std::memory_order_relaxed);
+    while (latest > seen && !latest_timestamp_ms_.compare_exchange_weak(
+                                seen, latest, std::memory_order_relaxed))
+      ;
+  }
+  thresholds_.publish(folder.thresholds);
+  folder.thresholds.clear();
+}
+
+void LearningUpdatePipeline::expire_baselines() {
+  uint64_t ttl = baseline_ttl_ms_.load(std::memory_order_relaxed);
+  uint64_t now = latest_timestamp_ms_.load(std::memory_order_relaxed);
+  std::lock_guard<std::mutex> lock(expiry_mutex_);
+  if (ttl == 0 ||
+      now < last_expiry_ms_ +
+                expiry_interval_ms_.load(std::memory_order_relaxed))
+    return;
+  if (last_expiry_ms_ == 0) {
+    // Start the interval at the first event rather than the epoch
+    last_expiry_ms_ = now;
+    return;
+  }
+  last_expiry_ms_ = now;
+
+  std::vector<EntityKey> removed;
+  size_t dropped = engine_.cleanup_expired_baselines(now, ttl, &removed);
+  std::vector<ThresholdSnapshot::Update> retired;
+  retired.reserve(removed.size());
+  for (EntityKey key : removed)
+    retired.emplace_back(key, std::numeric_limits<double>::quiet_NaN());
+  thresholds_.publish(retired);
+  if (dropped > 0)
+    LOG(LogLevel::DEBUG, LogComponent::ANALYSIS_STATS,
+        "Reclaimed " << dropped << " idle learning baselines");
+}
+
+} // namespace learning
@@ -0,0 +1,169 @@
+#ifndef LEARNING_UPDATE_PIPELINE_HPP
+#define LEARNING_UPDATE_PIPELINE_HPP
+
+#include "dynamic_learning_engine.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace learning {
+
+// Learned 95th percentile thresholds as last published by the learning
+// threads, held in an open-addressing table of atomic (key, threshold)
+// slots. publish() overwrites thresholds in their slots, so it costs the
+// number of pairs published rather than the number of entities. Only growing
+// the table copies it, and the copy is swapped in atomically. A lookup is a
+// pointer load and a short probe and never waits on the engine or on a
+// writer.
+class ThresholdSnapshot {
+public:
+  using Update = std::pair<EntityKey, double>;
+
+  ThresholdSnapshot();
+
+  // NaN if the entity has no established baseline as of the last publish
+  double get(std::string_view entity_type, std::string_view entity_id) const;
+  double get(EntityKey key) const;
+
+  // Applies (key, threshold) pairs in order; a NaN threshold removes the key
+  void publish(const std::vector<Update> &thresholds);
+
+  size_t size() const { return size_.load(std::memory_order_relaxed); }
+
+private:
+  struct Slot {
+    // 0 while the slot is empty. A key stays in its slot once written;
+    // removing it stores a NaN threshold.
+    std::atomic<EntityKey> key{0};
+    // Bits of the threshold
+    std::atomic<uint64_t> threshold{0};
+  };
+
+  struct Table {
+    explicit Table(size_t capacity)
+        : mask(capacity - 1), slots(new Slot[capacity]) {}
+    // Capacity - 1; capacity is a power of two at least twice used
+    size_t mask;
+    std::unique_ptr<Slot[]> slots;
+    // Slots with a key, live or removed. Only touched by publish().
+    size_t used = 0;
+  };
+
+  // Slot holding key, or the empty slot where it would go
+  static Slot &probe(const Table &table, EntityKey key);
+  // Copies the live thresholds into a table with room for extra more keys
+  void rebuild(size_t extra);
+
+  // Accessed through std::atomic_load/atomic_store
+  std::shared_ptr<Table> table_;
+  std::mutex publish_mutex_;
+  std::atomic<size_t> size_{0};
+};
+
+// Moves baseline maintenance off the worker threads. Workers append
+// (entity, value, timestamp) updates to their own buffer; a small pool of
+// learning threads swaps the buffers out every flush interval, folds them
+// into the DynamicLearningEngine and publishes the resulting thresholds to
+// a ThresholdSnapshot. Each worker's buffer is always folded by the same
+// learning thread, so updates of an entity owned by one worker are applied
+// in order.
+class LearningUpdatePipeline {
+public:
+  LearningUpdatePipeline(DynamicLearningEngine &engine, size_t producer_count,
+                         size_t thread_count = 1,
+                         std::chrono::milliseconds flush_interval =
+                             std::chrono::milliseconds(100),
+                         size_t max_pending_per_producer = 65536);
+  ~LearningUpdatePipeline();
+
+  LearningUpdatePipeline(const LearningUpdatePipeline &) = delete;
+  LearningUpdatePipeline &operator=(const LearningUpdatePipeline &) = delete;
+
+  // Only called by the producer itself. entity_type must outlive the
+  // pipeline (it is a string literal at every call site). Updates beyond
+  // max_pending_per_producer are dropped rather than blocking the worker.
+  void record(size_t producer, std::string_view entity_type,
+              std::string_view entity_id, double value, uint64_t timestamp_ms);
+
+  // Drops baselines idle for ttl_ms, checked every interval_ms of event
+  // time after each fold; their published thresholds go with them.
+  // Disabled while ttl_ms is 0.
+  void set_baseline_expiry(uint64_t ttl_ms, uint64_t interval_ms);
+
+  // Folds everything recorded before the call and runs a due expiry
+  void flush();
+
+  // Folds what is left and joins the learning threads
+  void stop();
+
+  const ThresholdSnapshot &thresholds() const { return thresholds_; }
+  uint64_t dropped_updates() const {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+private:
+  struct Update {
+    std::string_view entity_type;
+    // Where the entity id sits in the buffer's ids
+    size_t id_offset;
+    size_t id_size;
+    double value;
+    uint64_t timestamp_ms;
+  };
+
+  // Entity ids are appended to one string per buffer, so once the buffers
+  // have grown to their working size recording an update never allocates
+  struct alignas(64) ProducerBuffer {
+    std::mutex mutex;
+    std::vector<Update> pending;
+    std::string ids;
+  };
+
+  // Scratch space of one learning thread, reused across folds
+  struct Folder {
+    std::mutex mutex;
+    std::vector<Update> batch;
+    std::string batch_ids;
+    std::vector<ThresholdSnapshot::Update> thresholds;
+  };
+
+  void run(size_t thread_index);
+  void fold(size_t thread_index);
+  void expire_baselines();
+
+  DynamicLearningEngine &engine_;
+  const std::chrono::milliseconds flush_interval_;
+  const size_t max_pending_;
+
+  std::vector<std::unique_ptr<ProducerBuffer>> buffers_;
+  std::vector<std::unique_ptr<Folder>> folders_;
+  std::vector<std::thread> threads_;
+
+  std::mutex wake_mutex_;
+  std::condition_variable wake_cv_;
+  bool stopping_ = false;
+
+  std::atomic<uint64_t> dropped_{0};
+  ThresholdSnapshot thresholds_;
+
+  // Newest event time folded so far, the clock for baseline expiry
+  std::atomic<uint64_t> latest_timestamp_ms_{0};
+  std::atomic<uint64_t> baseline_ttl_ms_{0};
+  std::atomic<uint64_t> expiry_interval_ms_{0};
+  std::mutex expiry_mutex_;
+  uint64_t last_expiry_ms_ = 0;
+};
+
+} // namespace learning
+
+#endif // LEARNING_UPDATE_PIPELINE_HPP
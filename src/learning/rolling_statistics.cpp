@@ -1,4 +1,6 @@
 #include "rolling_statistics.hpp"
+#include "../core/compact_serialization.hpp"
+
 #include <algorithm>
 #include <cmath>
 #include <mutex>
@@ -6,9 +8,11 @@
 
 namespace learning {
 
-RollingStatistics::RollingStatistics(double alpha, size_t window_size)
+RollingStatistics::RollingStatistics(double alpha, size_t window_size,
+                                     double percentile_accuracy)
     : alpha_(alpha), ewma_mean_(0.0), ewma_variance_(0.0),
-      max_window_size_(window_size), last_update_time_(0),
+      half_window_((window_size + 1) / 2), current_(percentile_accuracy),
+      previous_(percentile_accuracy), last_update_time_(0),
       total_sample_count_(0) {
   if (alpha <= 0.0 || alpha > 1.0) {
     throw std::invalid_argument("Alpha must be between 0 and 1");
@@ -25,6 +29,7 @@ void RollingStatistics::add_value(double value, uint64_t timestamp_ms) {
     // Initialize with first value
     ewma_mean_ = value;
     ewma_variance_ = 0.0;
+    first_value_ = value;
   } else {
     // Update EWMA mean
     double delta = value - ewma_mean_;
@@ -34,11 +39,11 @@ void RollingStatistics::add_value(double value, uint64_t timestamp_ms) {
     ewma_variance_ = (1.0 - alpha_) * ewma_variance_ + alpha_ * delta * delta;
   }
 
-  // Add to sample buffer for percentile calculations
-  samples_.emplace_back(value, timestamp_ms);
-  if (samples_.size() > max_window_size_) {
-    samples_.pop_front();
+  if (current_.count() >= half_window_) {
+    std::swap(previous_, current_);
+    current_.clear();
   }
+  current_.add(value);
 
   last_update_time_ = timestamp_ms;
   total_sample_count_++;
@@ -66,27 +71,15 @@ double RollingStatistics::get_percentile(double percentile) const {
 
   std::shared_lock<std::shared_mutex> lock(mutex_);
 
-  if (samples_.empty()) {
+  if (total_sample_count_ == 0) {
     return ewma_mean_;
   }
 
-  auto sorted_values = get_sorted_values();
-  if (sorted_values.size() == 1) {
-    return sorted_values[0];
-  }
-
-  // Linear interpolation for percentile calculation
-  double index = percentile * (sorted_values.size() - 1);
-  size_t lower_index = static_cast<size_t>(std::floor(index));
-  size_t upper_index = static_cast<size_t>(std::ceil(index));
-
-  if (lower_index == upper_index) {
-    return sorted_values[lower_index];
+  if (total_sample_count_ == 1) {
+    return first_value_;
   }
 
-  double weight = index - lower_index;
-  return sorted_values[lower_index] * (1.0 - weight) +
-         sorted_values[upper_index] * weight;
+  return current_.quantile(percentile, previous_);
 }
 
 std::pair<double, double>
@@ -104,17 +97,18 @@ RollingStatistics::get_confidence_interval(double confidence) const {
   }
 
   // Calculate standard error
+  const size_t samples = window_count();
   double standard_error = get_standard_deviation() /
-                          std::sqrt(static_cast<double>(samples_.size()));
+                          std::sqrt(static_cast<double>(samples));
 
   // Choose critical value based on sample size
   double critical_value;
-  if (samples_.size() > 30) {
+  if (samples > 30) {
     // Use normal distribution for large samples
     critical_value = calculate_normal_critical(confidence);
   } else {
     // Use t-distribution for small samples
-    critical_value = calculate_t_critical(confidence, samples_.size() - 1);
+    critical_value = calculate_t_critical(confidence, samples - 1);
   }
 
   double margin = critical_value * standard_error;
@@ -135,14 +129,17 @@ void RollingStatistics::reset() {
   std::unique_lock<std::shared_mutex> lock(mutex_);
   ewma_mean_ = 0.0;
   ewma_variance_ = 0.0;
-  samples_.clear();
+  current_.clear();
+  previous_.clear();
+  first_value_ = 0.0;
   last_update_time_ = 0;
   total_sample_count_ = 0;
 }
 
 size_t RollingStatistics::get_memory_usage() const {
   std::shared_lock<std::shared_mutex> lock(mutex_);
-  return sizeof(*this) + samples_.size() * sizeof(std::pair<double, uint64_t>);
+  return sizeof(*this) + current_.memory_bytes() - sizeof(current_) +
+         previous_.memory_bytes() - sizeof(previous_);
 }
 
 bool RollingStatistics::is_established(size_t min_samples) const {
@@ -150,6 +147,59 @@ bool RollingStatistics::is_established(size_t min_samples) const {
   return total_sample_count_ >= min_samples;
 }
 
+namespace {
+
+void write_sketch(core::BinarySerializer &out,
+                  const Utils::QuantileSketch &sketch) {
+  uint32_t buckets = 0;
+  sketch.for_each_bucket([&](double, uint64_t) { ++buckets; });
+  out.write_varint32(buckets);
+  sketch.for_each_bucket([&](double value, uint64_t count) {
+    out.write_double(value);
+    out.write_varint64(count);
+  });
+}
+
+void read_sketch(core::BinaryDeserializer &in, Utils::QuantileSketch &sketch) {
+  sketch.clear();
+  uint32_t buckets = in.read_varint32();
+  for (uint32_t i = 0; i < buckets; ++i) {
+    double value = in.read_double();
+    sketch.add(value, static_cast<uint32_t>(in.read_varint64()));
+  }
+}
+
+} // namespace
+
+void RollingStatistics::serialize(core::BinarySerializer &out) const {
+  std::shared_lock<std::shared_mutex> lock(mutex_);
+  out.write_double(ewma_mean_);
+  out.write_double(ewma_variance_);
+  out.write_varint64(last_update_time_);
+  out.write_varint64(total_sample_count_);
+  out.write_double(first_value_);
+  write_sketch(out, previous_);
+  write_sketch(out, current_);
+}
+
+void RollingStatistics::deserialize(core::BinaryDeserializer &in) {
+  double mean = in.read_double();
+  double variance = in.read_double();
+  uint64_t last_update = in.read_varint64();
+  uint64_t total = in.read_varint64();
+  double first_value = in.read_double();
+
+  std::unique_lock<std::shared_mutex> lock(mutex_);
+  ewma_mean_ = mean;
+  ewma_variance_ = variance;
+  last_update_time_ = last_update;
+  total_sample_count_ = static_cast<size_t>(total);
+  first_value_ = first_value;
+  // Sketches saved with another accuracy are re-bucketed by add()
+  read_sketch(in, previous_);
+  read_sketch(in, current_);
+}
+
 double
 RollingStatistics::calculate_t_critical(double confidence,
                                         size_t degrees_of_freedom) const {
@@ -192,16 +242,4 @@ double RollingStatistics::calculate_normal_critical(double confidence) const {
   return 1.0; // Default to 68% confidence
 }
 
-std::vector<double> RollingStatistics::get_sorted_values() const {
-  std::vector<double> values;
-  values.reserve(samples_.size());
-
-  for (const auto &sample : samples_) {
-    values.push_back(sample.first);
-  }
-
-  std::sort(values.begin(), values.end());
-  return values;
-}
-
 } // namespace learning
@@ -1,10 +1,16 @@
 #ifndef ROLLING_STATISTICS_HPP
 #define ROLLING_STATISTICS_HPP
 
+#include "../utils/stream_sketches.hpp"
+
 #include <cstdint>
-#include <deque>
 #include <shared_mutex>
-#include <vector>
+#include <utility>
+
+namespace core {
+class BinarySerializer;
+class BinaryDeserializer;
+} // namespace core
 
 namespace learning {
 
@@ -12,15 +18,22 @@ namespace learning {
  * Thread-safe rolling statistics calculator using Exponentially Weighted Moving
  * Average (EWMA) Provides confidence intervals using Bayesian updating and
  * efficient percentile calculations
+ *
+ * No samples are kept: percentiles come from two quantile sketches that
+ * each take half the window, the older one dropped when the newer fills. Its
+ * size depends on the spread of the values, never on their number.
  */
 class RollingStatistics {
 public:
   /**
    * Constructor
    * @param alpha Decay factor for EWMA (0 < alpha <= 1, smaller = more stable)
-   * @param window_size Maximum number of samples to keep in memory
+   * @param window_size Percentiles cover between half and all of this many
+   * of the latest samples
+   * @param percentile_accuracy Relative error bound of get_percentile()
    */
-  explicit RollingStatistics(double alpha = 0.1, size_t window_size = 1000);
+  explicit RollingStatistics(double alpha = 0.1, size_t window_size = 1000,
+                             double percentile_accuracy = 0.01);
 
   /**
    * Add a new value to the rolling statistics
@@ -45,7 +58,8 @@ public:
   double get_standard_deviation() const;
 
   /**
-   * Get a specific percentile from recent samples
+   * Get a specific percentile from recent samples, within the configured
+   * relative accuracy of the exact value. Does not sort the samples.
    * @param percentile Value between 0.0 and 1.0
    */
   double get_percentile(double percentile) const;
@@ -83,6 +97,14 @@ public:
    */
   bool is_established(size_t min_samples = 30) const;
 
+  /**
+   * Encode the EWMA state and the sketch buckets. Alpha, window size and
+   * accuracy are configuration and are not encoded; construct with them
+   * first.
+   */
+  void serialize(core::BinarySerializer &out) const;
+  void deserialize(core::BinaryDeserializer &in);
+
 private:
   mutable std::shared_mutex mutex_;
 
@@ -91,19 +113,24 @@ private:
   double ewma_mean_;     // Current EWMA mean
   double ewma_variance_; // Current EWMA variance
 
-  // Sample storage for percentile calculations
-  std::deque<std::pair<double, uint64_t>> samples_;
-  size_t max_window_size_;
+  // Percentile window: current_ takes new samples until it holds half the
+  // window, then replaces previous_
+  size_t half_window_;
+  Utils::QuantileSketch current_;
+  Utils::QuantileSketch previous_;
+  // Returned exactly while it is the only sample
+  double first_value_ = 0.0;
 
   // Metadata
   uint64_t last_update_time_;
   size_t total_sample_count_;
 
+  size_t window_count() const { return current_.count() + previous_.count(); }
+
   // Helper methods
   double calculate_t_critical(double confidence,
                               size_t degrees_of_freedom) const;
   double calculate_normal_critical(double confidence) const;
-  std::vector<double> get_sorted_values() const;
 };
 
 } // namespace learning
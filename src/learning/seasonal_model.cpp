@@ -1,4 +1,6 @@
 #include "seasonal_model.hpp"
+#include "../core/compact_serialization.hpp"
+
 #include <algorithm>
 #include <cmath>
 #include <ctime>
@@ -10,46 +12,85 @@
 
 namespace learning {
 
-SeasonalModel::SeasonalModel(size_t min_samples)
-    : min_samples_for_pattern_(min_samples), last_pattern_update_(0) {
-  current_pattern_.hourly_pattern.resize(24, 1.0); // Initialize to neutral
-  current_pattern_.daily_pattern.resize(7, 1.0);
-  current_pattern_.weekly_pattern.resize(4, 1.0);
-  current_pattern_.confidence_score = 0.0;
-  current_pattern_.last_updated = 0;
-  current_pattern_.observation_count = 0;
+namespace {
+// cos and sin of -2*pi*m/N for m in [0, N). Term (k, n) of a length N DFT
+// uses entry (k * n) % N, so no trigonometry runs per transform.
+struct Twiddles {
+  size_t size;
+  std::vector<double> cos;
+  std::vector<double> sin;
+};
+
+Twiddles make_twiddles(size_t n) {
+  Twiddles twiddles{n, std::vector<double>(n), std::vector<double>(n)};
+  for (size_t m = 0; m < n; ++m) {
+    double angle = -2.0 * M_PI * static_cast<double>(m) / n;
+    twiddles.cos[m] = std::cos(angle);
+    twiddles.sin[m] = std::sin(angle);
+  }
+  return twiddles;
+}
+
+// Tables for the weekly, daily and hourly pattern lengths
+const Twiddles *find_twiddles(size_t n) {
+  static const Twiddles tables[] = {make_twiddles(4), make_twiddles(7),
+                                    make_twiddles(24)};
+  for (const auto &table : tables)
+    if (table.size == n)
+      return &table;
+  return nullptr;
+}
+
+// Neutral factors and zeroed analysis, sized for each cycle
+SeasonalModel::SeasonalPattern make_neutral_pattern() {
+  SeasonalModel::SeasonalPattern pattern;
+  pattern.hourly_pattern.resize(24, 1.0); // Initialize to neutral
+  pattern.daily_pattern.resize(7, 1.0);
+  pattern.weekly_pattern.resize(4, 1.0);
+  pattern.confidence_score = 0.0;
+  pattern.last_updated = 0;
+  pattern.observation_count = 0;
 
   // Initialize stability metrics
-  current_pattern_.hourly_stability = 0.0;
-  current_pattern_.daily_stability = 0.0;
-  current_pattern_.weekly_stability = 0.0;
+  pattern.hourly_stability = 0.0;
+  pattern.daily_stability = 0.0;
+  pattern.weekly_stability = 0.0;
 
   // Initialize per-context confidence scores
-  current_pattern_.hourly_confidence.resize(24, 0.0);
-  current_pattern_.daily_confidence.resize(7, 0.0);
+  pattern.hourly_confidence.resize(24, 0.0);
+  pattern.daily_confidence.resize(7, 0.0);
 
   // Initialize Fourier coefficient storage
-  current_pattern_.hourly_fourier.real.resize(24, 0.0);
-  current_pattern_.hourly_fourier.imaginary.resize(24, 0.0);
-  current_pattern_.hourly_fourier.magnitude.resize(24, 0.0);
-  current_pattern_.hourly_fourier.phase.resize(24, 0.0);
-
-  current_pattern_.daily_fourier.real.resize(7, 0.0);
-  current_pattern_.daily_fourier.imaginary.resize(7, 0.0);
-  current_pattern_.daily_fourier.magnitude.resize(7, 0.0);
-  current_pattern_.daily_fourier.phase.resize(7, 0.0);
-
-  current_pattern_.weekly_fourier.real.resize(4, 0.0);
-  current_pattern_.weekly_fourier.imaginary.resize(4, 0.0);
-  current_pattern_.weekly_fourier.magnitude.resize(4, 0.0);
-  current_pattern_.weekly_fourier.phase.resize(4, 0.0);
+  pattern.hourly_fourier.real.resize(24, 0.0);
+  pattern.hourly_fourier.imaginary.resize(24, 0.0);
+  pattern.hourly_fourier.magnitude.resize(24, 0.0);
+  pattern.hourly_fourier.phase.resize(24, 0.0);
+
+  pattern.daily_fourier.real.resize(7, 0.0);
+  pattern.daily_fourier.imaginary.resize(7, 0.0);
+  pattern.daily_fourier.magnitude.resize(7, 0.0);
+  pattern.daily_fourier.phase.resize(7, 0.0);
+
+  pattern.weekly_fourier.real.resize(4, 0.0);
+  pattern.weekly_fourier.imaginary.resize(4, 0.0);
+  pattern.weekly_fourier.magnitude.resize(4, 0.0);
+  pattern.weekly_fourier.phase.resize(4, 0.0);
+  return pattern;
 }
+} // namespace
+
+SeasonalModel::SeasonalModel(size_t min_samples)
+    : min_samples_for_pattern_(min_samples),
+      capacity_(std::max<size_t>(1, min_samples * 2)),
+      last_pattern_update_(0) {}
 
 void SeasonalModel::add_observation(double value, uint64_t timestamp_ms) {
   std::lock_guard<std::recursive_mutex> lock(mutex_);
-  observations_.emplace_back(value, timestamp_ms);
-  if (observations_.size() > min_samples_for_pattern_ * 2) {
-    observations_.erase(observations_.begin());
+  push_observation(value, timestamp_ms);
+  // The pattern is computed as soon as enough samples are in
+  if (!current_pattern_ && observations_.size() >= min_samples_for_pattern_) {
+    update_pattern();
+    last_pattern_update_ = timestamp_ms;
   }
   // Optionally update pattern periodically
   if (timestamp_ms - last_pattern_update_ > PATTERN_UPDATE_INTERVAL_MS) {
@@ -58,6 +99,44 @@ void SeasonalModel::add_observation(double value, uint64_t timestamp_ms) {
   }
 }
 
+void SeasonalModel::push_observation(double value, uint64_t timestamp_ms) {
+  Observation observation{value, timestamp_ms, time_buckets(timestamp_ms)};
+  if (!bins_)
+    bins_ = std::make_unique<Bins>();
+  if (observations_.size() < capacity_) {
+    observations_.push_back(observation);
+  } else {
+    update_bins(observations_[next_], -1.0);
+    observations_[next_] = observation;
+    next_ = (next_ + 1) % capacity_;
+  }
+  update_bins(observation, 1.0);
+}
+
+void SeasonalModel::update_bins(const Observation &observation, double sign) {
+  const double value = observation.value;
+  Bins &bins = *bins_;
+  for (BinStats *bin : {&bins.hourly[observation.buckets.hour],
+                        &bins.daily[observation.buckets.day],
+                        observation.buckets.week < bins.weekly.size()
+                            ? &bins.weekly[observation.buckets.week]
+                            : nullptr}) {
+    if (!bin)
+      continue;
+    bin->sum += sign * value;
+    bin->sum_squares += sign * value * value;
+    if (sign > 0)
+      ++bin->count;
+    else
+      --bin->count;
+  }
+}
+
+const SeasonalModel::Observation &SeasonalModel::newest_observation() const {
+  return observations_[(next_ + observations_.size() - 1) %
+                       observations_.size()];
+}
+
 double SeasonalModel::get_expected_value(uint64_t timestamp_ms) const {
   std::lock_guard<std::recursive_mutex> lock(mutex_);
   if (!is_pattern_established()) {
@@ -65,11 +144,11 @@ double SeasonalModel::get_expected_value(uint64_t timestamp_ms) const {
   }
 
   // Use Fourier reconstruction for more accurate prediction
-  int hour = get_hour_of_day(timestamp_ms);
+  int hour = time_buckets(timestamp_ms).hour;
   double normalized_hour = static_cast<double>(hour) / 24.0;
 
   // Reconstruct using dominant frequency components
-  return reconstruct_from_fourier(current_pattern_.hourly_fourier,
+  return reconstruct_from_fourier(current_pattern_->hourly_fourier,
                                   normalized_hour);
 }
 
@@ -79,65 +158,66 @@ double SeasonalModel::get_seasonal_factor(uint64_t timestamp_ms) const {
     return 1.0; // No adjustment when pattern not established
   }
 
-  int hour = get_hour_of_day(timestamp_ms);
-  int day = get_day_of_week(timestamp_ms);
-  int week = get_week_of_month(timestamp_ms);
+  TimeBuckets buckets = time_buckets(timestamp_ms);
+  int hour = buckets.hour;
+  int day = buckets.day;
+  int week = buckets.week;
 
   double hourly_factor = 1.0;
   double daily_factor = 1.0;
   double weekly_factor = 1.0;
 
   // Use direct hourly pattern values (already normalized)
-  if (hour >= 0 && hour < 24 && !current_pattern_.hourly_pattern.empty()) {
-    hourly_factor = current_pattern_.hourly_pattern[hour];
+  if (hour >= 0 && hour < 24 && !current_pattern_->hourly_pattern.empty()) {
+    hourly_factor = current_pattern_->hourly_pattern[hour];
 
     // Weight by confidence if available
-    if (!current_pattern_.hourly_confidence.empty()) {
-      double confidence = current_pattern_.hourly_confidence[hour];
+    if (!current_pattern_->hourly_confidence.empty()) {
+      double confidence = current_pattern_->hourly_confidence[hour];
       // Blend with neutral factor (1.0) based on confidence
       hourly_factor = confidence * hourly_factor + (1.0 - confidence) * 1.0;
     }
   }
 
   // Use direct daily pattern values (normalized)
-  if (day >= 0 && day < 7 && !current_pattern_.daily_pattern.empty()) {
+  if (day >= 0 && day < 7 && !current_pattern_->daily_pattern.empty()) {
     // Calculate global daily average for normalization
     double daily_sum = 0.0;
-    for (const auto &val : current_pattern_.daily_pattern) {
+    for (const auto &val : current_pattern_->daily_pattern) {
       daily_sum += val;
     }
-    double daily_mean = daily_sum / current_pattern_.daily_pattern.size();
+    double daily_mean = daily_sum / current_pattern_->daily_pattern.size();
 
     daily_factor = (daily_mean > 0)
-                       ? (current_pattern_.daily_pattern[day] / daily_mean)
+                       ? (current_pattern_->daily_pattern[day] / daily_mean)
                        : 1.0;
 
     // Weight by confidence if available
-    if (!current_pattern_.daily_confidence.empty()) {
-      double confidence = current_pattern_.daily_confidence[day];
+    if (!current_pattern_->daily_confidence.empty()) {
+      double confidence = current_pattern_->daily_confidence[day];
       // Blend with neutral factor (1.0) based on confidence
       daily_factor = confidence * daily_factor + (1.0 - confidence) * 1.0;
     }
   }
 
   // Use direct weekly pattern values (normalized)
-  if (week >= 0 && week < 4 && !current_pattern_.weekly_pattern.empty()) {
+  if (week >= 0 && week < 4 && !current_pattern_->weekly_pattern.empty()) {
     // Calculate global weekly average for normalization
     double weekly_sum = 0.0;
-    for (const auto &val : current_pattern_.weekly_pattern) {
+    for (const auto &val : current_pattern_->weekly_pattern) {
       weekly_sum += val;
     }
-    double weekly_mean = weekly_sum / current_pattern_.weekly_pattern.size();
+    double weekly_mean = weekly_sum / current_pattern_->weekly_pattern.size();
 
     weekly_factor = (weekly_mean > 0)
-                        ? (current_pattern_.weekly_pattern[week] / weekly_mean)
+                        ? (current_pattern_->weekly_pattern[week] / weekly_mean)
                         : 1.0;
   }
 
   // Weight factors by their stability metrics
-  double hourly_weight = current_pattern_.hourly_stability;
-  double daily_weight = current_pattern_.daily_stability;
-  double weekly_weight = current_pattern_.weekly_stability;
+  double hourly_weight = current_pattern_->hourly_stability;
+  double daily_weight = current_pattern_->daily_stability;
+  double weekly_weight = current_pattern_->weekly_stability;
 
   // Ensure weights sum to 1.0
   double total_weight = hourly_weight + daily_weight + weekly_weight;
@@ -160,36 +240,85 @@ double SeasonalModel::get_seasonal_factor(uint64_t timestamp_ms) const {
 learning::SeasonalModel::SeasonalPattern
 SeasonalModel::get_current_pattern() const {
   std::lock_guard<std::recursive_mutex> lock(mutex_);
-  return current_pattern_;
+  return current_pattern_ ? *current_pattern_ : make_neutral_pattern();
 }
 
 bool SeasonalModel::is_pattern_established() const {
   std::lock_guard<std::recursive_mutex> lock(mutex_);
-  return observations_.size() >= min_samples_for_pattern_;
+  return current_pattern_ != nullptr;
 }
 
 void SeasonalModel::update_pattern() {
   std::lock_guard<std::recursive_mutex> lock(mutex_);
-  if (observations_.size() < min_samples_for_pattern_)
+  if (observations_.empty() ||
+      observations_.size() < min_samples_for_pattern_)
     return;
+  if (!current_pattern_)
+    current_pattern_ =
+        std::make_unique<SeasonalPattern>(make_neutral_pattern());
   compute_hourly_pattern();
   compute_daily_pattern();
   compute_weekly_pattern();
-  current_pattern_.confidence_score = calculate_pattern_confidence();
-  current_pattern_.last_updated = observations_.back().second;
-  current_pattern_.observation_count = observations_.size();
+  current_pattern_->confidence_score = calculate_pattern_confidence();
+  current_pattern_->last_updated = newest_observation().timestamp_ms;
+  current_pattern_->observation_count = observations_.size();
 }
 
 void SeasonalModel::reset() {
   std::lock_guard<std::recursive_mutex> lock(mutex_);
   observations_.clear();
-  current_pattern_ = SeasonalPattern();
+  next_ = 0;
+  bins_.reset();
+  current_pattern_.reset();
 }
 
 size_t SeasonalModel::get_memory_usage() const {
   std::lock_guard<std::recursive_mutex> lock(mutex_);
-  return sizeof(*this) +
-         observations_.size() * sizeof(std::pair<double, uint64_t>);
+  size_t usage =
+      sizeof(*this) + observations_.capacity() * sizeof(Observation);
+  if (bins_)
+    usage += sizeof(Bins);
+  if (current_pattern_)
+    usage += sizeof(SeasonalPattern) + 160 * sizeof(double);
+  return usage;
+}
+
+void SeasonalModel::serialize(core::BinarySerializer &out) const {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  out.write_varint64(last_pattern_update_);
+  out.write_varint32(static_cast<uint32_t>(observations_.size()));
+  uint64_t prev = last_pattern_update_;
+  // Oldest first
+  for (size_t i = 0; i < observations_.size(); ++i) {
+    const Observation &observation =
+        observations_[(next_ + i) % observations_.size()];
+    out.write_double(observation.value);
+    out.write_varint64(core::varint::zigzag_encode(
+        static_cast<int64_t>(observation.timestamp_ms - prev)));
+    prev = observation.timestamp_ms;
+  }
+}
+
+void SeasonalModel::deserialize(core::BinaryDeserializer &in) {
+  uint64_t last_update = in.read_varint64();
+  std::vector<std::pair<double, uint64_t>> observations;
+  uint32_t count = in.read_varint32();
+  observations.reserve(count);
+  uint64_t prev = last_update;
+  for (uint32_t i = 0; i < count; ++i) {
+    double value = in.read_double();
+    prev += static_cast<uint64_t>(
+        core::varint::zigzag_decode(in.read_varint64()));
+    observations.emplace_back(value, prev);
+  }
+
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
+  reset();
+  // Replaying evicts all but the newest capacity_ observations
+  for (const auto &[value, timestamp_ms] : observations)
+    push_observation(value, timestamp_ms);
+  last_pattern_update_ = last_update;
+  update_pattern();
 }
 
 void SeasonalModel::compute_hourly_pattern() {
@@ -198,14 +327,11 @@ void SeasonalModel::compute_hourly_pattern() {
   std::vector<double> hourly_variance(24, 0.0);
   std::vector<double> hourly_values_squared_sum(24, 0.0);
 
-  // Aggregate values by hour
-  for (const auto &obs : observations_) {
-    int hour = get_hour_of_day(obs.second);
-    if (hour >= 0 && hour < 24) {
-      hourly_sum[hour] += obs.first;
-      hourly_values_squared_sum[hour] += obs.first * obs.first;
-      hourly_count[hour]++;
-    }
+  // Values aggregated by hour as observations arrive
+  for (int i = 0; i < 24; ++i) {
+    hourly_sum[i] = bins_->hourly[i].sum;
+    hourly_values_squared_sum[i] = bins_->hourly[i].sum_squares;
+    hourly_count[i] = bins_->hourly[i].count;
   }
 
   // Calculate global average for normalization
@@ -222,7 +348,7 @@ void SeasonalModel::compute_hourly_pattern() {
     if (hourly_count[i] > 0) {
       double mean = hourly_sum[i] / hourly_count[i];
       // Normalize pattern relative to global mean
-      current_pattern_.hourly_pattern[i] =
+      current_pattern_->hourly_pattern[i] =
           (global_mean > 0) ? (mean / global_mean) : 1.0;
 
       // Calculate variance if we have enough samples
@@ -232,7 +358,7 @@ void SeasonalModel::compute_hourly_pattern() {
         hourly_variance[i] = squared_mean - mean_squared;
       }
     } else {
-      current_pattern_.hourly_pattern[i] = 1.0; // Default value
+      current_pattern_->hourly_pattern[i] = 1.0; // Default value
     }
   }
 
@@ -255,14 +381,15 @@ void SeasonalModel::compute_hourly_pattern() {
     }
 
     // Combine factors
-    current_pattern_.hourly_confidence[i] = sample_confidence * variance_factor;
+    current_pattern_->hourly_confidence[i] =
+        sample_confidence * variance_factor;
   }
 
   // Perform Fourier analysis on the hourly pattern
-  compute_fourier_transform(current_pattern_.hourly_pattern,
-                            current_pattern_.hourly_fourier);
-  current_pattern_.dominant_hourly_frequencies =
-      find_dominant_frequencies(current_pattern_.hourly_fourier, 3);
+  compute_fourier_transform(current_pattern_->hourly_pattern,
+                            current_pattern_->hourly_fourier);
+  current_pattern_->dominant_hourly_frequencies =
+      find_dominant_frequencies(current_pattern_->hourly_fourier, 3);
 }
 
 void SeasonalModel::compute_daily_pattern() {
@@ -271,20 +398,17 @@ void SeasonalModel::compute_daily_pattern() {
   std::vector<double> daily_variance(7, 0.0);
   std::vector<double> daily_values_squared_sum(7, 0.0);
 
-  for (const auto &obs : observations_) {
-    int day = get_day_of_week(obs.second);
-    if (day >= 0 && day < 7) {
-      daily_sum[day] += obs.first;
-      daily_values_squared_sum[day] += obs.first * obs.first;
-      daily_count[day]++;
-    }
+  for (int i = 0; i < 7; ++i) {
+    daily_sum[i] = bins_->daily[i].sum;
+    daily_values_squared_sum[i] = bins_->daily[i].sum_squares;
+    daily_count[i] = bins_->daily[i].count;
   }
 
   // Calculate averages and variances
   for (int i = 0; i < 7; ++i) {
     if (daily_count[i] > 0) {
       double mean = daily_sum[i] / daily_count[i];
-      current_pattern_.daily_pattern[i] = mean;
+      current_pattern_->daily_pattern[i] = mean;
 
       // Calculate variance if we have enough samples
       if (daily_count[i] > 1) {
@@ -293,7 +417,7 @@ void SeasonalModel::compute_daily_pattern() {
         daily_variance[i] = squared_mean - mean_squared;
       }
     } else {
-      current_pattern_.daily_pattern[i] = 1.0; // Default value
+      current_pattern_->daily_pattern[i] = 1.0; // Default value
     }
   }
 
@@ -309,21 +433,21 @@ void SeasonalModel::compute_daily_pattern() {
     if (daily_count[i] > 1 && daily_variance[i] > 0) {
       // Calculate coefficient of variation (CV)
       double cv = std::sqrt(daily_variance[i]) /
-                  std::max(0.1, std::abs(current_pattern_.daily_pattern[i]));
+                  std::max(0.1, std::abs(current_pattern_->daily_pattern[i]));
       // Lower CV means more consistent values, which means higher confidence
       variance_factor =
           std::exp(-cv); // Range: (0,1], approaches 1 as cv approaches 0
     }
 
     // Combine factors
-    current_pattern_.daily_confidence[i] = sample_confidence * variance_factor;
+    current_pattern_->daily_confidence[i] = sample_confidence * variance_factor;
   }
 
   // Perform Fourier analysis on the daily pattern
-  compute_fourier_transform(current_pattern_.daily_pattern,
-                            current_pattern_.daily_fourier);
-  current_pattern_.dominant_daily_frequencies =
-      find_dominant_frequencies(current_pattern_.daily_fourier, 2);
+  compute_fourier_transform(current_pattern_->daily_pattern,
+                            current_pattern_->daily_fourier);
+  current_pattern_->dominant_daily_frequencies =
+      find_dominant_frequencies(current_pattern_->daily_fourier, 2);
 }
 
 void SeasonalModel::compute_weekly_pattern() {
@@ -332,20 +456,17 @@ void SeasonalModel::compute_weekly_pattern() {
   std::vector<double> weekly_variance(4, 0.0);
   std::vector<double> weekly_values_squared_sum(4, 0.0);
 
-  for (const auto &obs : observations_) {
-    int week = get_week_of_month(obs.second);
-    if (week >= 0 && week < 4) {
-      weekly_sum[week] += obs.first;
-      weekly_values_squared_sum[week] += obs.first * obs.first;
-      weekly_count[week]++;
-    }
+  for (int i = 0; i < 4; ++i) {
+    weekly_sum[i] = bins_->weekly[i].sum;
+    weekly_values_squared_sum[i] = bins_->weekly[i].sum_squares;
+    weekly_count[i] = bins_->weekly[i].count;
   }
 
   // Calculate averages and variances
   for (int i = 0; i < 4; ++i) {
     if (weekly_count[i] > 0) {
       double mean = weekly_sum[i] / weekly_count[i];
-      current_pattern_.weekly_pattern[i] = mean;
+      current_pattern_->weekly_pattern[i] = mean;
 
       // Calculate variance if we have enough samples
       if (weekly_count[i] > 1) {
@@ -354,15 +475,15 @@ void SeasonalModel::compute_weekly_pattern() {
         weekly_variance[i] = squared_mean - mean_squared;
       }
     } else {
-      current_pattern_.weekly_pattern[i] = 1.0; // Default value
+      current_pattern_->weekly_pattern[i] = 1.0; // Default value
     }
   }
 
   // Perform Fourier analysis on the weekly pattern
-  compute_fourier_transform(current_pattern_.weekly_pattern,
-                            current_pattern_.weekly_fourier);
-  current_pattern_.dominant_weekly_frequencies =
-      find_dominant_frequencies(current_pattern_.weekly_fourier, 2);
+  compute_fourier_transform(current_pattern_->weekly_pattern,
+                            current_pattern_->weekly_fourier);
+  current_pattern_->dominant_weekly_frequencies =
+      find_dominant_frequencies(current_pattern_->weekly_fourier, 2);
 }
 
 double SeasonalModel::calculate_pattern_confidence() const {
@@ -377,19 +498,19 @@ double SeasonalModel::calculate_pattern_confidence() const {
 
   // Calculate hourly pattern confidence
   double hourly_fourier_confidence = 0.0;
-  if (!current_pattern_.hourly_fourier.magnitude.empty()) {
+  if (!current_pattern_->hourly_fourier.magnitude.empty()) {
     double total_power = 0.0;
     double dominant_power = 0.0;
 
-    for (size_t i = 0; i < current_pattern_.hourly_fourier.magnitude.size();
+    for (size_t i = 0; i < current_pattern_->hourly_fourier.magnitude.size();
          ++i) {
-      total_power += current_pattern_.hourly_fourier.magnitude[i];
+      total_power += current_pattern_->hourly_fourier.magnitude[i];
     }
 
-    for (int freq : current_pattern_.dominant_hourly_frequencies) {
+    for (int freq : current_pattern_->dominant_hourly_frequencies) {
       if (freq <
-          static_cast<int>(current_pattern_.hourly_fourier.magnitude.size())) {
-        dominant_power += current_pattern_.hourly_fourier.magnitude[freq];
+          static_cast<int>(current_pattern_->hourly_fourier.magnitude.size())) {
+        dominant_power += current_pattern_->hourly_fourier.magnitude[freq];
       }
     }
 
@@ -399,19 +520,19 @@ double SeasonalModel::calculate_pattern_confidence() const {
 
   // Calculate daily pattern confidence
   double daily_fourier_confidence = 0.0;
-  if (!current_pattern_.daily_fourier.magnitude.empty()) {
+  if (!current_pattern_->daily_fourier.magnitude.empty()) {
     double total_power = 0.0;
     double dominant_power = 0.0;
 
-    for (size_t i = 0; i < current_pattern_.daily_fourier.magnitude.size();
+    for (size_t i = 0; i < current_pattern_->daily_fourier.magnitude.size();
          ++i) {
-      total_power += current_pattern_.daily_fourier.magnitude[i];
+      total_power += current_pattern_->daily_fourier.magnitude[i];
     }
 
-    for (int freq : current_pattern_.dominant_daily_frequencies) {
+    for (int freq : current_pattern_->dominant_daily_frequencies) {
       if (freq <
-          static_cast<int>(current_pattern_.daily_fourier.magnitude.size())) {
-        dominant_power += current_pattern_.daily_fourier.magnitude[freq];
+          static_cast<int>(current_pattern_->daily_fourier.magnitude.size())) {
+        dominant_power += current_pattern_->daily_fourier.magnitude[freq];
       }
     }
 
@@ -421,20 +542,20 @@ double SeasonalModel::calculate_pattern_confidence() const {
 
   // Calculate weekly pattern confidence
   double weekly_fourier_confidence = 0.0;
-  if (!current_pattern_.weekly_fourier.magnitude.empty() &&
-      !current_pattern_.dominant_weekly_frequencies.empty()) {
+  if (!current_pattern_->weekly_fourier.magnitude.empty() &&
+      !current_pattern_->dominant_weekly_frequencies.empty()) {
     double total_power = 0.0;
     double dominant_power = 0.0;
 
-    for (size_t i = 0; i < current_pattern_.weekly_fourier.magnitude.size();
+    for (size_t i = 0; i < current_pattern_->weekly_fourier.magnitude.size();
          ++i) {
-      total_power += current_pattern_.weekly_fourier.magnitude[i];
+      total_power += current_pattern_->weekly_fourier.magnitude[i];
     }
 
-    for (int freq : current_pattern_.dominant_weekly_frequencies) {
+    for (int freq : current_pattern_->dominant_weekly_frequencies) {
       if (freq <
-          static_cast<int>(current_pattern_.weekly_fourier.magnitude.size())) {
-        dominant_power += current_pattern_.weekly_fourier.magnitude[freq];
+          static_cast<int>(current_pattern_->weekly_fourier.magnitude.size())) {
+        dominant_power += current_pattern_->weekly_fourier.magnitude[freq];
       }
     }
 
@@ -443,11 +564,11 @@ double SeasonalModel::calculate_pattern_confidence() const {
   }
 
   // Update stability metrics
-  const_cast<SeasonalModel *>(this)->current_pattern_.hourly_stability =
+  const_cast<SeasonalModel *>(this)->current_pattern_->hourly_stability =
       hourly_fourier_confidence;
-  const_cast<SeasonalModel *>(this)->current_pattern_.daily_stability =
+  const_cast<SeasonalModel *>(this)->current_pattern_->daily_stability =
       daily_fourier_confidence;
-  const_cast<SeasonalModel *>(this)->current_pattern_.weekly_stability =
+  const_cast<SeasonalModel *>(this)->current_pattern_->weekly_stability =
       weekly_fourier_confidence;
 
   // Combine confidences with weights
@@ -459,25 +580,27 @@ double SeasonalModel::calculate_pattern_confidence() const {
   return base_confidence * (0.7 + 0.3 * fourier_confidence);
 }
 
-int SeasonalModel::get_hour_of_day(uint64_t timestamp_ms) const {
-  time_t t = timestamp_ms / 1000;
-  struct tm tmval;
-  localtime_r(&t, &tmval);
-  return tmval.tm_hour;
-}
+SeasonalModel::TimeBuckets
+SeasonalModel::time_buckets(uint64_t timestamp_ms) const {
+  // All three buckets only change on a local hour boundary, so localtime_r
+  // runs once per hour of traffic rather than once per lookup
+  if (timestamp_ms >= bucket_cache_start_ms_ &&
+      timestamp_ms < bucket_cache_end_ms_)
+    return cached_buckets_;
 
-int SeasonalModel::get_day_of_week(uint64_t timestamp_ms) const {
   time_t t = timestamp_ms / 1000;
   struct tm tmval;
   localtime_r(&t, &tmval);
-  return tmval.tm_wday;
-}
-
-int SeasonalModel::get_week_of_month(uint64_t timestamp_ms) const {
-  time_t t = timestamp_ms / 1000;
-  struct tm tmval;
-  localtime_r(&t, &tmval);
-  return tmval.tm_mday / 7;
+  cached_buckets_.hour = static_cast<uint8_t>(tmval.tm_hour);
+  cached_buckets_.day = static_cast<uint8_t>(tmval.tm_wday);
+  cached_buckets_.week = static_cast<uint8_t>(tmval.tm_mday / 7);
+  uint64_t into_hour_ms =
+      static_cast<uint64_t>(std::min(tmval.tm_min * 60 + tmval.tm_sec, 3599)) *
+          1000 +
+      timestamp_ms % 1000;
+  bucket_cache_start_ms_ = timestamp_ms - into_hour_ms;
+  bucket_cache_end_ms_ = bucket_cache_start_ms_ + 3600000;
+  return cached_buckets_;
 }
 
 void SeasonalModel::compute_fourier_transform(
@@ -488,15 +611,21 @@ void SeasonalModel::compute_fourier_transform(
   coeffs.magnitude.assign(N, 0.0);
   coeffs.phase.assign(N, 0.0);
 
+  Twiddles local;
+  const Twiddles *twiddles = find_twiddles(N);
+  if (!twiddles) {
+    local = make_twiddles(N);
+    twiddles = &local;
+  }
+
   // Discrete Fourier Transform
   for (size_t k = 0; k < N; ++k) {
     double real_sum = 0.0;
     double imag_sum = 0.0;
 
-    for (size_t n = 0; n < N; ++n) {
-      double angle = -2.0 * M_PI * k * n / N;
-      real_sum += data[n] * std::cos(angle);
-      imag_sum += data[n] * std::sin(angle);
+    for (size_t n = 0, m = 0; n < N; ++n, m = (m + k) % N) {
+      real_sum += data[n] * twiddles->cos[m];
+      imag_sum += data[n] * twiddles->sin[m];
     }
 
     coeffs.real[k] = real_sum / N;
@@ -560,26 +689,27 @@ double SeasonalModel::get_time_context_confidence(uint64_t timestamp_ms) const {
     return 0.0; // No confidence when pattern not established
   }
 
-  int hour = get_hour_of_day(timestamp_ms);
-  int day = get_day_of_week(timestamp_ms);
+  TimeBuckets buckets = time_buckets(timestamp_ms);
+  int hour = buckets.hour;
+  int day = buckets.day;
 
   // Get confidence for specific hour and day
   double hour_confidence = 0.0;
   double day_confidence = 0.0;
 
-  if (hour >= 0 && hour < 24 && !current_pattern_.hourly_confidence.empty()) {
-    hour_confidence = current_pattern_.hourly_confidence[hour];
+  if (hour >= 0 && hour < 24 && !current_pattern_->hourly_confidence.empty()) {
+    hour_confidence = current_pattern_->hourly_confidence[hour];
   }
 
-  if (day >= 0 && day < 7 && !current_pattern_.daily_confidence.empty()) {
-    day_confidence = current_pattern_.daily_confidence[day];
+  if (day >= 0 && day < 7 && !current_pattern_->daily_confidence.empty()) {
+    day_confidence = current_pattern_->daily_confidence[day];
   }
 
   // Combine confidences, giving more weight to hourly patterns
   double combined_confidence = 0.7 * hour_confidence + 0.3 * day_confidence;
 
   // Scale by overall pattern confidence
-  return combined_confidence * current_pattern_.confidence_score;
+  return combined_confidence * current_pattern_->confidence_score;
 }
 
 } // namespace learning
\ No newline at end of file
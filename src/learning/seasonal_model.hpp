@@ -1,15 +1,29 @@
 #ifndef SEASONAL_MODEL_HPP
 #define SEASONAL_MODEL_HPP
 
+#include <array>
 #include <cstdint>
+#include <memory>
 #include <mutex>
 #include <vector>
 
+namespace core {
+class BinarySerializer;
+class BinaryDeserializer;
+} // namespace core
+
 namespace learning {
 
 /**
  * Seasonal pattern detection and modeling using Fourier analysis
  * Detects patterns in hourly, daily, and weekly cycles using DFT coefficients
+ *
+ * Observations live in a ring buffer and are folded into per-hour, per-day
+ * and per-week sums as they arrive (and taken out again when evicted), so
+ * an update and a pattern recompute both cost O(1) in the window size.
+ * The bins and the pattern are allocated with the first observation and
+ * once the pattern is established respectively, so a model that is never
+ * fed costs a few words.
  */
 class SeasonalModel {
 public:
@@ -114,23 +128,68 @@ public:
    */
   size_t get_memory_usage() const;
 
+  /**
+   * Encode the retained observations. The pattern is derived from them and
+   * is recomputed on decode rather than stored.
+   */
+  void serialize(core::BinarySerializer &out) const;
+  void deserialize(core::BinaryDeserializer &in);
+
 private:
   mutable std::recursive_mutex mutex_;
 
   // Configuration
   size_t min_samples_for_pattern_;
 
-  // Observation storage
-  std::vector<std::pair<double, uint64_t>> observations_;
+  // Local time buckets of a timestamp; week is tm_mday / 7, so 4 (days
+  // 28-31) falls outside the weekly pattern
+  struct TimeBuckets {
+    uint8_t hour = 0;
+    uint8_t day = 0;
+    uint8_t week = 0;
+  };
+
+  struct Observation {
+    double value;
+    uint64_t timestamp_ms;
+    TimeBuckets buckets;
+  };
+
+  struct BinStats {
+    double sum = 0.0;
+    double sum_squares = 0.0;
+    size_t count = 0;
+  };
+
+  // Ring buffer of the newest observations; grows up to its capacity, then
+  // overwrites the oldest entry at next_
+  std::vector<Observation> observations_;
+  size_t capacity_;
+  size_t next_ = 0;
+
+  struct Bins {
+    std::array<BinStats, 24> hourly{};
+    std::array<BinStats, 7> daily{};
+    std::array<BinStats, 4> weekly{};
+  };
+  std::unique_ptr<Bins> bins_;
+
+  // The local hour containing the last timestamp looked up
+  mutable uint64_t bucket_cache_start_ms_ = 1;
+  mutable uint64_t bucket_cache_end_ms_ = 0;
+  mutable TimeBuckets cached_buckets_;
 
-  // Current pattern
-  SeasonalPattern current_pattern_;
+  // Current pattern; present exactly when the pattern is established
+  std::unique_ptr<SeasonalPattern> current_pattern_;
 
   // Pattern update tracking
   uint64_t last_pattern_update_;
   static const uint64_t PATTERN_UPDATE_INTERVAL_MS = 3600000; // 1 hour
 
   // Helper methods
+  void push_observation(double value, uint64_t timestamp_ms);
+  void update_bins(const Observation &observation, double sign);
+  const Observation &newest_observation() const;
   void compute_hourly_pattern();
   void compute_daily_pattern();
   void compute_weekly_pattern();
@@ -145,9 +204,7 @@ private:
                                              size_t max_components = 3) const;
 
   // Time utility methods
-  int get_hour_of_day(uint64_t timestamp_ms) const;
-  int get_day_of_week(uint64_t timestamp_ms) const;
-  int get_week_of_month(uint64_t timestamp_ms) const;
+  TimeBuckets time_buckets(uint64_t timestamp_ms) const;
 
   // Statistical helpers
   std::vector<double> compute_moving_average(const std::vector<double> &data,
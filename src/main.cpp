@@ -2,6 +2,7 @@
 #include "analysis/prometheus_anomaly_detector.hpp"
 #include "analysis/prometheus_client.hpp"
 #include "core/alert_manager.hpp"
+#include "core/compact_serialization.hpp"
 #include "core/config.hpp"
 #include "core/log_entry.hpp"
 #include "core/logger.hpp"
@@ -10,6 +11,7 @@
 #include "core/metrics_manager.hpp"
 #include "core/metrics_registry.hpp"
 #include "core/resource_pool_manager.hpp"
+#include "core/state_snapshotter.hpp"
 #include "detection/rule_engine.hpp"
 #include "io/db/mongo_manager.hpp"
 #include "io/log_readers/base_log_reader.hpp"
@@ -17,17 +19,20 @@
 #include "io/log_readers/mongo_log_reader.hpp"
 #include "io/web/web_server.hpp"
 #include "learning/dynamic_learning_engine.hpp"
+#include "learning/learning_update_pipeline.hpp"
 #include "models/model_manager.hpp"
 #include "utils/error_recovery_manager.hpp"
 #include "utils/graceful_degradation_manager.hpp"
 #include "utils/performance_monitor.hpp"
 #include "utils/thread_safe_queue.hpp"
+#include "utils/utils.hpp"
 
 #include <algorithm>
 #include <atomic>
 #include <cerrno>
 #include <chrono>
 #include <csignal>
+#include <future>
 #include <cstddef>
 #include <cstdint>
 #include <iostream>
@@ -125,24 +130,48 @@ void log_reader_thread(ILogReader &reader, ThreadSafeQueue<LogEntry> &queue,
 // --- Worker thread function ---
 void worker_thread(int worker_id, ThreadSafeQueue<LogEntry> &queue,
                    AnalysisEngine &analysis_engine, RuleEngine &rule_engine,
-                   learning::DynamicLearningEngine &learning_engine,
+                   learning::LearningUpdatePipeline &learning_updates,
+                   uint32_t prune_interval_seconds,
+                   core::StateSnapshotter *snapshotter,
                    const std::atomic<bool> &shutdown_flag) {
   LOG(LogLevel::INFO, LogComponent::CORE,
       "Worker thread " << worker_id << " started.");
 
+  // Snapshots are captured here, between events, so the engine needs no lock
+  uint64_t captured_generation =
+      snapshotter ? snapshotter->requested_generation() : 0;
+  auto serve_snapshot_request = [&]() {
+    if (!snapshotter)
+      return;
+    uint64_t requested = snapshotter->requested_generation();
+    if (requested <= captured_generation)
+      return;
+    captured_generation = requested;
+    bool full = snapshotter->full_snapshot_due(worker_id);
+    snapshotter->submit(worker_id, requested,
+                        analysis_engine.get_max_timestamp_seen(),
+                        full ? analysis_engine.capture_snapshot()
+                             : analysis_engine.capture_delta(),
+                        full);
+  };
+
   // Performance monitoring
   uint64_t processed_count = 0;
   auto last_report_time = std::chrono::steady_clock::now();
+  auto last_prune_time = last_report_time;
 
   while (!shutdown_flag) {
-    std::optional<LogEntry> log_entry_opt = queue.wait_and_pop();
+    std::optional<LogEntry> log_entry_opt =
+        queue.wait_and_pop_for(std::chrono::milliseconds(250));
 
     if (!log_entry_opt) {
-      if (shutdown_flag || queue.empty()) {
+      rule_engine.flush_rule_batch();
+      if (shutdown_flag || queue.is_shutdown()) {
         LOG(LogLevel::INFO, LogComponent::CORE,
             "Worker " << worker_id << " shutting down.");
         break;
       }
+      serve_snapshot_request(); // idle
       continue;
     }
 
@@ -150,9 +179,11 @@ void worker_thread(int worker_id, ThreadSafeQueue<LogEntry> &queue,
 
     if (log_entry.successfully_parsed_structure) {
       // Use resource pooling for analyzed events
-      auto analyzed_event = analysis_engine.process_and_analyze(log_entry);
+      auto analyzed_event =
+          analysis_engine.process_and_analyze(std::move(log_entry));
 
-      // Feed data to learning engine for adaptive threshold updates
+      // Queue data for the learning threads; baselines are folded in batches
+      // off this thread
       auto timestamp_ms =
           std::chrono::duration_cast<std::chrono::milliseconds>(
               std::chrono::system_clock::now().time_since_epoch())
@@ -160,34 +191,35 @@ void worker_thread(int worker_id, ThreadSafeQueue<LogEntry> &queue,
 
       // Update baselines for different entity types using available metrics
       if (analyzed_event.current_ip_request_count_in_window.has_value()) {
-        std::string ip_addr(analyzed_event.raw_log.ip_address);
-        learning_engine.update_baseline(
-            "ip", ip_addr,
+        learning_updates.record(
+            worker_id, "ip", analyzed_event.raw_log.ip_address,
             static_cast<double>(
                 analyzed_event.current_ip_request_count_in_window.value()),
             timestamp_ms);
       }
 
       if (!analyzed_event.raw_log.request_path.empty()) {
-        learning_engine.update_baseline(
-            "path", analyzed_event.raw_log.request_path,
+        learning_updates.record(
+            worker_id, "path", analyzed_event.raw_log.request_path,
             analyzed_event.path_error_event_zscore.value_or(0.0), timestamp_ms);
       }
 
       // Update session-based learning if session data is available
-      if (analyzed_event.raw_session_state.has_value()) {
-        std::string session_key =
-            std::string(analyzed_event.raw_log.ip_address) + "_session";
-        learning_engine.update_baseline(
-            "session", session_key,
+      if (analyzed_event.raw_session_state) {
+        learning_updates.record(
+            worker_id, "session", analyzed_event.raw_log.ip_address,
             analyzed_event.derived_session_features.has_value() ? 1.0 : 0.0,
             timestamp_ms);
       }
 
-      // Evaluate rules with updated baselines
-      rule_engine.evaluate_rules(analyzed_event);
+      // Evaluate rules in batches, without holding alerts back once the
+      // input runs dry
+      rule_engine.evaluate_rules_batched(std::move(analyzed_event));
+      if (queue.empty())
+        rule_engine.flush_rule_batch();
 
       processed_count++;
+      serve_snapshot_request();
 
       // Periodic performance reporting (every 10 seconds)
       auto now = std::chrono::steady_clock::now();
@@ -200,6 +232,14 @@ void worker_thread(int worker_id, ThreadSafeQueue<LogEntry> &queue,
         last_report_time = now;
       }
 
+      // Periodic state pruning (and cold tier demotion) on the owning thread
+      if (std::chrono::duration_cast<std::chrono::seconds>(now -
+                                                           last_prune_time)
+              .count() >= prune_interval_seconds) {
+        analysis_engine.run_pruning(analysis_engine.get_max_timestamp_seen());
+        last_prune_time = now;
+      }
+
       // Check for memory pressure periodically
       if (processed_count % 1000 == 0 && g_memory_manager) {
         if (g_memory_manager->is_memory_pressure()) {
@@ -213,6 +253,7 @@ void worker_thread(int worker_id, ThreadSafeQueue<LogEntry> &queue,
     }
   }
 
+  rule_engine.flush_rule_batch();
   LOG(LogLevel::INFO, LogComponent::CORE,
       "Worker " << worker_id << " finished. Processed " << processed_count
                 << " events total.");
@@ -477,7 +518,7 @@ struct ComponentManager {
     }
 
     if (learning_engine) {
-      // Learning engine will save state in destructor
+      // Baselines were saved by the caller if persistence is enabled
       learning_engine.reset();
     }
 
@@ -731,15 +772,92 @@ int main(int argc, char *argv[]) {
   std::vector<std::unique_ptr<RuleEngine>> rule_engines;
   std::vector<std::thread> worker_threads;
 
+  // The allowlist is loaded once and published to every rule engine
+  auto load_allowlist = [](const Config::AppConfig &config) {
+    return config.allowlist_path.empty()
+               ? nullptr
+               : RuleEngine::load_ip_allowlist(config.allowlist_path);
+  };
+  auto ip_allowlist = std::make_shared<RuleEngine::IpAllowlist>(
+      load_allowlist(*current_config));
+  // Rule hit counts of all workers are published as one set of series
+  auto rule_counters = std::make_shared<detection::RuleCounterSet>();
+
   for (unsigned int i = 0; i < num_workers; ++i) {
     worker_queues.push_back(std::make_unique<ThreadSafeQueue<LogEntry>>());
-    auto analysis_engine = std::make_unique<AnalysisEngine>(*current_config);
+    // Workers share the first engine's request classifier instead of each
+    // compiling the path lists again
+    auto analysis_engine = std::make_unique<AnalysisEngine>(
+        *current_config,
+        i == 0 ? nullptr : analysis_engines[0]->get_request_classifier());
     auto rule_engine = std::make_unique<RuleEngine>(
-        *alert_manager_instance, *current_config, model_manager);
+        *alert_manager_instance, *current_config, model_manager, ip_allowlist,
+        rule_counters);
     analysis_engines.push_back(std::move(analysis_engine));
     rule_engines.push_back(std::move(rule_engine));
   }
 
+  // Subnet rollups and path baselines must see traffic from every IP, but the
+  // dispatcher shards by IP, so all workers record into the first engine's
+  auto share_cross_shard_state = [&analysis_engines]() {
+    auto shared_rollup = analysis_engines[0]->get_subnet_rollup();
+    auto shared_path_stats = analysis_engines[0]->get_path_stats();
+    auto shared_ua_verdicts = analysis_engines[0]->get_ua_verdict_cache();
+    auto shared_classifier = analysis_engines[0]->get_request_classifier();
+    for (size_t i = 1; i < analysis_engines.size(); ++i) {
+      analysis_engines[i]->set_subnet_rollup(shared_rollup);
+      analysis_engines[i]->set_path_stats(shared_path_stats);
+      analysis_engines[i]->set_ua_verdict_cache(shared_ua_verdicts);
+      analysis_engines[i]->set_request_classifier(shared_classifier);
+    }
+  };
+  share_cross_shard_state();
+
+  // Top-N sketches are per worker and merged at query time
+  auto traffic_sketches = std::make_shared<analysis::TrafficSketchSet>(
+      num_workers, current_config->tier1.sliding_window_duration_seconds * 1000);
+  for (unsigned int i = 0; i < num_workers; ++i)
+    analysis_engines[i]->set_traffic_sketches(traffic_sketches, i);
+
+  // Threat intel feeds are fetched and held once for all workers
+  std::shared_ptr<IntelManager> intel_manager;
+  auto configure_threat_intel = [&](const Config::ThreatIntelConfig &intel) {
+    if (!intel.enabled)
+      intel_manager.reset();
+    else if (intel_manager)
+      intel_manager->reconfigure(intel.feed_urls,
+                                 intel.update_interval_seconds);
+    else
+      intel_manager = std::make_shared<IntelManager>(
+          intel.feed_urls, intel.update_interval_seconds);
+    for (auto &engine : rule_engines)
+      engine->set_intel_manager(intel_manager);
+  };
+  configure_threat_intel(current_config->threat_intel);
+
+  // --- Cold State Tier ---
+  // Engines report their state footprint to the MemoryManager and spill their
+  // least recently seen IPs to a per-worker mmap file under pressure. The
+  // registrations are non-owning; they are removed before the engines die.
+  std::vector<std::shared_ptr<memory::IMemoryManaged>> managed_engines;
+  if (current_config->memory_management.enable_cold_state_tier &&
+      component_manager.memory_manager) {
+    for (unsigned int i = 0; i < num_workers; ++i) {
+      std::string spill_path =
+          current_config->memory_management.cold_state_directory +
+          "/ip_state_worker_" + std::to_string(i) + ".bin";
+      Utils::create_directory_for_file(spill_path);
+      if (!analysis_engines[i]->enable_cold_state_tier(spill_path))
+        continue;
+
+      managed_engines.emplace_back(analysis_engines[i].get(),
+                                   [](memory::IMemoryManaged *) {});
+      component_manager.memory_manager->register_component(
+          managed_engines.back());
+    }
+    component_manager.memory_manager->start_monitoring();
+  }
+
   // --- Tier 4 (Prometheus Anomaly Detection) Initialization ---
   std::shared_ptr<analysis::PrometheusAnomalyDetector> tier4_detector;
   if (current_config->tier4.enabled) {
@@ -847,20 +965,100 @@ int main(int argc, char *argv[]) {
     }
     LOG(LogLevel::INFO, LogComponent::CORE,
         "Prometheus metrics exporter set for all worker components");
-  } // --- Launch Worker Threads ---
+  }
+
+  // --- State Snapshots ---
+  // state_file_path holds the manifest; every worker restores and saves its
+  // own shard file in parallel. Must run before the workers start.
+  std::unique_ptr<core::StateSnapshotter> snapshotter;
+  if (current_config->state_persistence_enabled) {
+    snapshotter = std::make_unique<core::StateSnapshotter>(
+        current_config->state_file_path, num_workers,
+        current_config->state_file_magic,
+        current_config->state_compaction_interval);
+    auto shared_path_stats = analysis_engines[0]->get_path_stats();
+    snapshotter->set_shared_state_encoder([shared_path_stats]() {
+      core::BinarySerializer out;
+      shared_path_stats->serialize(out);
+      return out.data();
+    });
+
+    auto manifest = snapshotter->load_manifest();
+    if (manifest && manifest->shard_files.size() != num_workers) {
+      // IPs are assigned to workers by hash, so shards cannot be reused
+      LOG(LogLevel::WARN, LogComponent::STATE_PERSIST,
+          "Snapshot was taken with " << manifest->shard_files.size()
+                                     << " workers, now running "
+                                     << num_workers << ". Starting fresh.");
+    } else if (manifest) {
+      std::vector<std::future<bool>> restores;
+      for (unsigned int i = 0; i < num_workers; ++i)
+        restores.push_back(std::async(std::launch::async, [&, i]() {
+          // IPs stay in the mapped base and load on first access
+          if (!analysis_engines[i]->restore_snapshot_file(
+                  manifest->shard_files[i]))
+            return false;
+          core::StateSnapshotter::replay_log(
+              manifest->shard_logs[i], manifest->shard_log_bytes[i],
+              [&, i](const uint8_t *data, size_t size) {
+                return analysis_engines[i]->apply_delta(data, size);
+              });
+          return true;
+        }));
+      if (!manifest->shared_file.empty())
+        if (auto blob =
+                core::StateSnapshotter::read_file(manifest->shared_file)) {
+          try {
+            core::BinaryDeserializer in(blob->data(), blob->size());
+            shared_path_stats->deserialize(in);
+          } catch (const std::exception &e) {
+            LOG(LogLevel::WARN, LogComponent::STATE_PERSIST,
+                "Shared path state is corrupt: " << e.what());
+            shared_path_stats->clear();
+          }
+        }
+      size_t restored = 0;
+      for (auto &restore : restores)
+        restored += restore.get() ? 1 : 0;
+      LOG(LogLevel::INFO, LogComponent::STATE_PERSIST,
+          "Restored " << restored << "/" << num_workers
+                      << " worker shards from snapshot generation "
+                      << manifest->generation << " (watermark ms: "
+                      << manifest->watermark_ms << ").");
+    }
+
+    // Learning baselines are shared by all workers and kept in their own
+    // chunked file, saved whenever a snapshot is requested
+    component_manager.learning_engine->load_baselines(
+        current_config->dynamic_learning.baseline_state_file);
+  }
+
+  const auto &learning_config = current_config->dynamic_learning;
+  learning::LearningUpdatePipeline learning_updates(
+      *component_manager.learning_engine, num_workers,
+      learning_config.update_threads,
+      std::chrono::milliseconds(learning_config.update_flush_interval_ms),
+      learning_config.max_pending_updates_per_worker);
+  learning_updates.set_baseline_expiry(
+      uint64_t{learning_config.baseline_ttl_hours} * 3600 * 1000,
+      uint64_t{learning_config.baseline_cleanup_interval_seconds} * 1000);
+
+  // --- Launch Worker Threads ---
   for (unsigned int i = 0; i < num_workers; ++i) {
     worker_threads.emplace_back(worker_thread, i, std::ref(*worker_queues[i]),
                                 std::ref(*analysis_engines[i]),
                                 std::ref(*rule_engines[i]),
-                                std::ref(*component_manager.learning_engine),
+                                std::ref(learning_updates),
+                                current_config->memory_management
+                                    .eviction_check_interval_seconds,
+                                snapshotter.get(),
                                 std::ref(g_shutdown_requested));
   }
 
-  // State loading must happen after engines are created but before workers
-  // (current_config->state_persistence_enabled) { ... }
-
   uint64_t total_processed_count = 0;
   auto time_start = std::chrono::high_resolution_clock::now();
+  auto last_snapshot_request = std::chrono::steady_clock::now();
+  std::future<bool> baseline_save;
   ServiceState current_state = ServiceState::RUNNING;
   bool first_pause_message = true;
 
@@ -872,11 +1070,12 @@ int main(int argc, char *argv[]) {
       for (auto &engine : analysis_engines)
         engine->reset_in_memory_state();
 
-      if (current_config->state_persistence_enabled)
-        if (std::remove(current_config->state_file_path.c_str()) == 0)
-          LOG(LogLevel::INFO, LogComponent::STATE_PERSIST,
-              "Deleted persisted state file: "
-                  << current_config->state_file_path);
+      if (snapshotter) {
+        snapshotter->discard();
+        LOG(LogLevel::INFO, LogComponent::STATE_PERSIST,
+            "Deleted persisted state snapshot: "
+                << current_config->state_file_path);
+      }
       first_pause_message = true;
     }
 
@@ -898,8 +1097,11 @@ int main(int argc, char *argv[]) {
         // Reconfigure all worker engines
         for (auto &engine : analysis_engines)
           engine->reconfigure(*current_config);
+        share_cross_shard_state();
         for (auto &engine : rule_engines)
           engine->reconfigure(*current_config);
+        configure_threat_intel(current_config->threat_intel);
+        ip_allowlist->publish(load_allowlist(*current_config));
         LOG(LogLevel::INFO, LogComponent::CONFIG,
             "All components reconfigured successfully.");
       } else
@@ -950,6 +1152,34 @@ int main(int argc, char *argv[]) {
 
       total_processed_count++;
 
+      if (snapshotter) {
+        auto now = std::chrono::steady_clock::now();
+        bool events_due =
+            current_config->state_save_interval_events > 0 &&
+            total_processed_count %
+                    current_config->state_save_interval_events ==
+                0;
+        bool time_due =
+            current_config->state_save_interval_seconds > 0 &&
+            now - last_snapshot_request >=
+                std::chrono::seconds(
+                    current_config->state_save_interval_seconds);
+        if (events_due || time_due) {
+          snapshotter->request_snapshot();
+          last_snapshot_request = now;
+          // Skipped while the previous baseline save is still running
+          if (!baseline_save.valid() ||
+              baseline_save.wait_for(std::chrono::seconds(0)) ==
+                  std::future_status::ready)
+            baseline_save = std::async(
+                std::launch::async,
+                [engine = component_manager.learning_engine,
+                 path = current_config->dynamic_learning.baseline_state_file] {
+                  return engine->save_baselines(path);
+                });
+        }
+      }
+
       // --- Periodic Tasks ---
       if (current_config->log_source_type != "stdin" &&
           total_processed_count % 10000 == 0) {
@@ -1007,6 +1237,11 @@ int main(int argc, char *argv[]) {
     if (t.joinable())
       t.join();
   LOG(LogLevel::INFO, LogComponent::CORE, "Worker threads joined.");
+  learning_updates.stop();
+
+  for (auto &managed : managed_engines)
+    component_manager.memory_manager->unregister_component(managed.get());
+  managed_engines.clear();
 
   if (keyboard_thread.joinable()) {
 #if defined(__unix__) || (defined(__APPLE__) && defined(__MACH__))
@@ -1021,14 +1256,38 @@ int main(int argc, char *argv[]) {
     LOG(LogLevel::INFO, LogComponent::CORE, "Web server stopped");
   }
 
+  // Save baselines while the learning engine still exists
+  if (snapshotter) {
+    if (baseline_save.valid())
+      baseline_save.wait();
+    component_manager.learning_engine->save_baselines(
+        current_config->dynamic_learning.baseline_state_file);
+  }
+
   // Shutdown core components
   component_manager.shutdown();
 
   LOG(LogLevel::INFO, LogComponent::CORE,
       "Processing finished or shutdown signal received.");
 
-  // State saving is disabled for now
-  // if (current_config->state_persistence_enabled) { ... }
+  // Final snapshot: the workers have exited, so every shard is captured
+  // directly and in parallel
+  if (snapshotter) {
+    uint64_t generation = snapshotter->request_snapshot();
+    std::vector<std::future<void>> captures;
+    for (unsigned int i = 0; i < num_workers; ++i)
+      captures.push_back(std::async(std::launch::async, [&, i]() {
+        bool full = snapshotter->full_snapshot_due(i);
+        snapshotter->submit(i, generation,
+                            analysis_engines[i]->get_max_timestamp_seen(),
+                            full ? analysis_engines[i]->capture_snapshot()
+                                 : analysis_engines[i]->capture_delta(),
+                            full);
+      }));
+    for (auto &capture : captures)
+      capture.get();
+    snapshotter->flush();
+  }
 
   alert_manager_instance->flush_all_alerts();
 
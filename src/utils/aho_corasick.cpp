@@ -1,82 +1,198 @@
 #include "aho_corasick.hpp"
 
 #include <cstddef>
+#include <limits>
 #include <queue>
 
 namespace Utils {
 
-AhoCorasick::AhoCorasick(const std::vector<std::string> &patterns)
-    : patterns_(patterns) {
-  trie_.emplace_back(); // Root node
-
-  // 1. Build the basic trie structure
-  for (size_t i = 0; i < patterns.size(); ++i) {
-    int node = 0;
-    for (char ch : patterns[i]) {
-      if (trie_[node].children.find(ch) == trie_[node].children.end()) {
-        trie_[node].children[ch] = trie_.size();
-        trie_.emplace_back();
-      }
-      node = trie_[node].children[ch];
+namespace {
+
+constexpr uint32_t kAbsent = std::numeric_limits<uint32_t>::max();
+
+unsigned char fold(unsigned char ch, bool case_insensitive) {
+  return case_insensitive && ch >= 'A' && ch <= 'Z' ? ch - 'A' + 'a' : ch;
+}
+
+} // namespace
+
+AhoCorasick::AhoCorasick(const std::vector<std::string> &patterns,
+                         bool case_insensitive)
+    : patterns_(patterns), pattern_set_(patterns.size(), 0),
+      set_offsets_{0} {
+  compile(case_insensitive);
+}
+
+AhoCorasick AhoCorasick::from_sets(
+    const std::vector<std::vector<std::string>> &pattern_sets,
+    bool case_insensitive) {
+  AhoCorasick matcher;
+  for (size_t set = 0; set < pattern_sets.size() && set < 32; ++set) {
+    matcher.set_offsets_.push_back(matcher.patterns_.size());
+    for (const auto &pattern : pattern_sets[set]) {
+      matcher.patterns_.push_back(pattern);
+      matcher.pattern_set_.push_back(static_cast<uint8_t>(set));
     }
-    trie_[node].pattern_indices.push_back(i);
   }
+  matcher.compile(case_insensitive);
+  return matcher;
+}
 
-  // 2. Build suffix and output links using BFS
-  std::queue<int> q;
-  for (auto const &[key, val] : trie_[0].children) {
-    q.push(val);
-  }
+void AhoCorasick::compile(bool case_insensitive) {
+  for (size_t set = 0; set < set_offsets_.size(); ++set)
+    all_sets_ |= 1u << set;
 
-  while (!q.empty()) {
-    int u = q.front();
-    q.pop();
+  // 1. Alphabet compression: one class per distinct (folded) pattern byte
+  std::array<bool, 256> seen{};
+  for (const auto &pattern : patterns_)
+    for (unsigned char ch : pattern)
+      seen[fold(ch, case_insensitive)] = true;
+  class_count_ = 1;
+  for (int ch = 0; ch < 256; ++ch)
+    if (seen[ch])
+      byte_class_[ch] = static_cast<uint16_t>(class_count_++);
+  if (case_insensitive)
+    for (int ch = 'A'; ch <= 'Z'; ++ch)
+      byte_class_[ch] = byte_class_[ch - 'A' + 'a'];
 
-    for (auto const &[ch, v] : trie_[u].children) {
-      int j = trie_[u].suffix_link;
-      while (j > 0 && trie_[j].children.find(ch) == trie_[j].children.end()) {
-        j = trie_[j].suffix_link;
-      }
-      if (trie_[j].children.count(ch)) {
-        trie_[v].suffix_link = trie_[j].children[ch];
+  // 2. The trie, as rows of the transition table
+  transitions_.assign(class_count_, kAbsent);
+  std::vector<std::vector<uint32_t>> own_outputs(1);
+  for (size_t id = 0; id < patterns_.size(); ++id) {
+    if (patterns_[id].empty())
+      continue;
+    uint32_t state = 0;
+    for (unsigned char ch : patterns_[id]) {
+      uint32_t &next = transitions_[state * class_count_ + byte_class_[ch]];
+      if (next == kAbsent) {
+        next = static_cast<uint32_t>(own_outputs.size());
+        own_outputs.emplace_back();
+        transitions_.resize(transitions_.size() + class_count_, kAbsent);
       }
-      q.push(v);
+      state = transitions_[state * class_count_ + byte_class_[ch]];
     }
+    own_outputs[state].push_back(static_cast<uint32_t>(id));
+  }
+  size_t state_total = own_outputs.size();
 
-    // Build output links
-    int suffix_node = trie_[u].suffix_link;
-    if (!trie_[suffix_node].pattern_indices.empty()) {
-      trie_[u].output_link = suffix_node;
+  // 3. Failure links in BFS order, folding each missing edge into the
+  // transition its failure state takes
+  std::vector<uint32_t> fail(state_total, 0);
+  std::vector<uint32_t> order;
+  order.reserve(state_total);
+  std::queue<uint32_t> queue;
+  for (uint32_t c = 0; c < class_count_; ++c) {
+    uint32_t &next = transitions_[c];
+    if (next == kAbsent) {
+      next = 0;
     } else {
-      trie_[u].output_link = trie_[suffix_node].output_link;
+      fail[next] = 0;
+      queue.push(next);
+    }
+  }
+  while (!queue.empty()) {
+    uint32_t state = queue.front();
+    queue.pop();
+    order.push_back(state);
+    const uint32_t *fail_row = &transitions_[fail[state] * class_count_];
+    for (uint32_t c = 0; c < class_count_; ++c) {
+      uint32_t &next = transitions_[state * class_count_ + c];
+      if (next == kAbsent) {
+        next = fail_row[c];
+      } else {
+        fail[next] = fail_row[c];
+        queue.push(next);
+      }
     }
   }
-}
 
-std::vector<std::string> AhoCorasick::find_all(std::string_view text) const {
-  std::vector<std::string> found_patterns;
-  int current_node = 0;
+  // 4. Outputs include every pattern that is a suffix of the state
+  std::vector<std::vector<uint32_t>> outputs(state_total);
+  std::vector<uint32_t> sets(state_total, 0);
+  for (uint32_t state : order) {
+    outputs[state] = own_outputs[state];
+    for (uint32_t id : own_outputs[state])
+      sets[state] |= 1u << pattern_set_[id];
+    const auto &inherited = outputs[fail[state]];
+    outputs[state].insert(outputs[state].end(), inherited.begin(),
+                          inherited.end());
+    sets[state] |= sets[fail[state]];
+  }
 
-  for (char ch : text) {
-    while (current_node > 0 && trie_[current_node].children.find(ch) ==
-                                   trie_[current_node].children.end()) {
-      current_node = trie_[current_node].suffix_link;
-    }
-    if (trie_[current_node].children.count(ch)) {
-      current_node = trie_[current_node].children.at(ch);
-    }
+  // 5. Renumber so that matching states come first, and store transitions
+  // as row offsets: the scan loop then needs no multiply, and "did this byte
+  // complete a match" is a compare against match_rows_
+  std::vector<uint32_t> renumbered(state_total);
+  uint32_t next_id = 0;
+  for (size_t state = 0; state < state_total; ++state)
+    if (!outputs[state].empty())
+      renumbered[state] = next_id++;
+  match_rows_ = next_id * class_count_;
+  for (size_t state = 0; state < state_total; ++state)
+    if (outputs[state].empty())
+      renumbered[state] = next_id++;
+  start_row_ = renumbered[0] * class_count_;
 
-    int temp_node = current_node;
-    while (temp_node > 0) {
-      if (!trie_[temp_node].pattern_indices.empty()) {
-        for (int pattern_idx : trie_[temp_node].pattern_indices) {
-          found_patterns.push_back(patterns_[pattern_idx]);
-        }
-      }
-      temp_node = trie_[temp_node].output_link;
+  std::vector<uint32_t> rows(transitions_.size());
+  for (size_t state = 0; state < state_total; ++state)
+    for (uint32_t c = 0; c < class_count_; ++c)
+      rows[renumbered[state] * class_count_ + c] =
+          renumbered[transitions_[state * class_count_ + c]] * class_count_;
+  transitions_ = std::move(rows);
+
+  std::vector<uint32_t> by_id(state_total);
+  for (size_t state = 0; state < state_total; ++state)
+    by_id[renumbered[state]] = static_cast<uint32_t>(state);
+  output_begin_.assign(state_total + 1, 0);
+  outputs_.clear();
+  state_sets_.assign(state_total, 0);
+  for (size_t id = 0; id < state_total; ++id) {
+    output_begin_[id] = static_cast<uint32_t>(outputs_.size());
+    outputs_.insert(outputs_.end(), outputs[by_id[id]].begin(),
+                    outputs[by_id[id]].end());
+    state_sets_[id] = sets[by_id[id]];
+  }
+  output_begin_[state_total] = static_cast<uint32_t>(outputs_.size());
+}
+
+uint32_t AhoCorasick::match_sets(std::string_view text) const {
+  uint32_t sets = 0;
+  uint32_t row = start_row_;
+  for (unsigned char ch : text) {
+    row = transitions_[row + byte_class_[ch]];
+    if (row < match_rows_) {
+      sets |= state_sets_[row / class_count_];
+      if (sets == all_sets_)
+        break;
     }
   }
+  return sets;
+}
+
+int AhoCorasick::find_first(std::string_view text) const {
+  uint32_t row = start_row_;
+  for (unsigned char ch : text) {
+    row = transitions_[row + byte_class_[ch]];
+    if (row < match_rows_)
+      return static_cast<int>(outputs_[output_begin_[row / class_count_]]);
+  }
+  return kNoMatch;
+}
+std::vector<std::string> AhoCorasick::find_all(std::string_view text) const {
+  std::vector<std::string> found_patterns;
+  for_each_match(text,
+                 [&](int id) { found_patterns.push_back(patterns_[id]); });
   return found_patterns;
 }
 
-} // namespace Utils
\ No newline at end of file
+size_t AhoCorasick::memory_usage() const {
+  size_t usage = sizeof(*this) + transitions_.capacity() * sizeof(uint32_t) +
+                 output_begin_.capacity() * sizeof(uint32_t) +
+                 outputs_.capacity() * sizeof(uint32_t) +
+                 state_sets_.capacity() * sizeof(uint32_t);
+  for (const auto &pattern : patterns_)
+    usage += sizeof(pattern) + pattern.capacity();
+  return usage;
+}
+
+} // namespace Utils
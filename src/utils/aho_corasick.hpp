@@ -1,30 +1,87 @@
 #ifndef AHO_CORASICK_HPP
 #define AHO_CORASICK_HPP
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <string_view>
-#include <unordered_map>
 #include <vector>
 
 namespace Utils {
 
+// Multi-pattern substring matcher compiled to a dense DFA. Bytes that occur
+// in no pattern share one input class, so the transition table has a row of
+// (distinct pattern bytes + 1) entries per state and scanning is one table
+// load per input byte. Matches are reported as pattern ids (indexes into the
+// flattened pattern list) without allocating.
 class AhoCorasick {
 public:
-  AhoCorasick(const std::vector<std::string> &patterns);
+  static constexpr int kNoMatch = -1;
+
+  explicit AhoCorasick(const std::vector<std::string> &patterns,
+                       bool case_insensitive = false);
+
+  // One automaton over several pattern sets. Set i owns the ids following
+  // those of set i - 1 and sets bit i of match_sets(); at most 32 sets.
+  static AhoCorasick
+  from_sets(const std::vector<std::vector<std::string>> &pattern_sets,
+            bool case_insensitive = false);
+
+  // Bit i is set if any pattern of set i occurs in text
+  uint32_t match_sets(std::string_view text) const;
+
+  // The pattern whose occurrence ends first in text, or kNoMatch. Among
+  // patterns ending at the same byte the longest wins.
+  int find_first(std::string_view text) const;
+
+  // Calls on_match(id) for every occurrence, in order of where it ends
+  template <typename Fn>
+  void for_each_match(std::string_view text, Fn &&on_match) const {
+    uint32_t row = start_row_;
+    for (unsigned char ch : text) {
+      row = transitions_[row + byte_class_[ch]];
+      if (row >= match_rows_)
+        continue;
+      uint32_t state = row / class_count_;
+      for (uint32_t i = output_begin_[state]; i < output_begin_[state + 1];
+           ++i)
+        on_match(static_cast<int>(outputs_[i]));
+    }
+  }
+
   std::vector<std::string> find_all(std::string_view text) const;
 
+  const std::string &pattern(int id) const { return patterns_[id]; }
+  size_t pattern_count() const { return patterns_.size(); }
+  // Offset of set i's first pattern id
+  size_t set_offset(size_t set) const { return set_offsets_[set]; }
+
+  size_t state_count() const { return output_begin_.size() - 1; }
+  size_t memory_usage() const;
+
 private:
-  struct TrieNode {
-    std::unordered_map<char, int> children;
-    int suffix_link = 0; // Default to root
-    int output_link = 0; // Default to root
-    std::vector<int> pattern_indices;
-  };
-
-  std::vector<TrieNode> trie_;
+  AhoCorasick() = default;
+  void compile(bool case_insensitive);
+
   std::vector<std::string> patterns_;
+  std::vector<uint8_t> pattern_set_;
+  std::vector<size_t> set_offsets_;
+
+  std::array<uint16_t, 256> byte_class_{};
+  uint32_t class_count_ = 1;
+  // transitions_[row + class] is the row (state * class_count_) to move to.
+  // States that complete a match are numbered first, below match_rows_.
+  std::vector<uint32_t> transitions_;
+  uint32_t start_row_ = 0;
+  uint32_t match_rows_ = 0;
+  // Pattern ids ending at each state, suffix matches included
+  std::vector<uint32_t> output_begin_;
+  std::vector<uint32_t> outputs_;
+  std::vector<uint32_t> state_sets_;
+  uint32_t all_sets_ = 0;
 };
 
 } // namespace Utils
 
-#endif // AHO_CORASICK_HPP
\ No newline at end of file
+#endif // AHO_CORASICK_HPP
@@ -1,12 +1,14 @@
 #ifndef BLOOM_FILTER_HPP
 #define BLOOM_FILTER_HPP
 
+#include <algorithm>
 #include <array>
 #include <cmath>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
 #include <string>
+#include <type_traits>
 #include <vector>
 
 namespace memory {
@@ -226,18 +228,25 @@ private:
   std::array<uint32_t, 8> hash_element(const T &element) const {
     std::array<uint32_t, 8> hashes;
 
-    // Convert element to bytes for hashing
+    // Integers are hashed in place rather than formatted into a string
+    const void *bytes;
+    size_t length;
     std::string element_bytes;
-    if constexpr (std::is_same_v<T, std::string>) {
-      element_bytes = element;
+    if constexpr (std::is_arithmetic_v<T>) {
+      bytes = &element;
+      length = sizeof(T);
     } else {
-      element_bytes = std::to_string(element);
+      if constexpr (std::is_same_v<T, std::string>)
+        element_bytes = element;
+      else
+        element_bytes = std::to_string(element);
+      bytes = element_bytes.data();
+      length = element_bytes.size();
     }
 
     // Generate primary and secondary hashes
-    uint32_t hash1 = murmur3_32(element_bytes.data(), element_bytes.size(), 0);
-    uint32_t hash2 =
-        murmur3_32(element_bytes.data(), element_bytes.size(), hash1);
+    uint32_t hash1 = murmur3_32(bytes, length, 0);
+    uint32_t hash2 = murmur3_32(bytes, length, hash1);
 
     // Use double hashing to generate multiple hash values
     for (size_t i = 0; i < std::min(num_hash_functions_, size_t(8)); ++i) {
@@ -250,9 +259,11 @@ private:
   // Calculate optimal bit array size
   static size_t calculate_optimal_size(size_t expected_elements,
                                        double false_positive_rate) {
-    return static_cast<size_t>(-expected_elements *
+    // Negating the size_t itself would wrap around
+    return std::max<size_t>(
+        8, static_cast<size_t>(-static_cast<double>(expected_elements) *
                                std::log(false_positive_rate) /
-                               (std::log(2) * std::log(2)));
+                               (std::log(2) * std::log(2))));
   }
 
   // Calculate optimal number of hash functions
@@ -260,9 +271,12 @@ private:
                                              size_t expected_elements) {
     if (expected_elements == 0)
       return 1;
-    return static_cast<size_t>(
-        std::round((static_cast<double>(bit_array_size) / expected_elements) *
-                   std::log(2)));
+    // hash_element() derives at most 8 hashes
+    return std::clamp<size_t>(
+        static_cast<size_t>(std::round(
+            (static_cast<double>(bit_array_size) / expected_elements) *
+            std::log(2))),
+        1, 8);
   }
 
   // Set bit at given index
@@ -0,0 +1,252 @@
+#include "ip_prefix_set.hpp"
+#include "utils.hpp"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cstring>
+#include <tuple>
+
+namespace Utils {
+
+namespace {
+
+constexpr uint64_t kV4MappedLo = 0x0000ffff00000000ULL;
+// Marks IPv4 bucket keys apart from the IPv6 ones, which are below 2^32
+constexpr uint64_t kV4BucketTag = 1ULL << 63;
+constexpr unsigned kV4BucketLength = 96 + 16;
+constexpr unsigned kV6BucketLength = 32;
+// Networks spanning more buckets than this bypass the filter
+constexpr unsigned kMaxBucketBits = 12;
+
+bool bit_at(uint64_t hi, uint64_t lo, unsigned i) {
+  return i < 64 ? (hi >> (63 - i)) & 1 : (lo >> (127 - i)) & 1;
+}
+
+unsigned common_length(uint64_t a_hi, uint64_t a_lo, uint64_t b_hi,
+                       uint64_t b_lo) {
+  if (a_hi != b_hi)
+    return __builtin_clzll(a_hi ^ b_hi);
+  if (a_lo != b_lo)
+    return 64 + __builtin_clzll(a_lo ^ b_lo);
+  return 128;
+}
+
+void clear_host_bits(IpPrefix &prefix) {
+  if (prefix.length <= 64) {
+    prefix.hi &= prefix.length == 0 ? 0 : ~0ULL << (64 - prefix.length);
+    prefix.lo = 0;
+  } else if (prefix.length < 128) {
+    prefix.lo &= ~0ULL << (128 - prefix.length);
+  }
+}
+
+bool is_v4_mapped(uint64_t hi, uint64_t lo) {
+  return hi == 0 && (lo >> 32) == 0xffff;
+}
+
+uint64_t bucket_key(uint64_t hi, uint64_t lo) {
+  if (is_v4_mapped(hi, lo))
+    return kV4BucketTag | ((lo & 0xffffffffULL) >> 16);
+  return hi >> 32;
+}
+
+uint64_t load_be64(const unsigned char *p) {
+  uint64_t v = 0;
+  for (int i = 0; i < 8; ++i)
+    v = (v << 8) | p[i];
+  return v;
+}
+
+} // namespace
+
+IpPrefix ipv4_prefix(uint32_t ip, uint8_t length) {
+  IpPrefix prefix{0, kV4MappedLo | ip, static_cast<uint8_t>(96 + length)};
+  clear_host_bits(prefix);
+  return prefix;
+}
+
+std::optional<IpPrefix> parse_ip_prefix(std::string_view text) {
+  std::string_view address = text;
+  std::optional<unsigned> length;
+  if (size_t slash = text.find('/'); slash != std::string_view::npos) {
+    address = text.substr(0, slash);
+    std::string_view bits = text.substr(slash + 1);
+    if (bits.empty())
+      return std::nullopt;
+    length = string_to_number<unsigned>(bits);
+    if (!length)
+      return std::nullopt;
+  }
+
+  char buf[INET6_ADDRSTRLEN];
+  if (address.empty() || address.size() >= sizeof(buf))
+    return std::nullopt;
+  std::memcpy(buf, address.data(), address.size());
+  buf[address.size()] = '\0';
+
+  in_addr v4{};
+  if (inet_pton(AF_INET, buf, &v4) == 1) {
+    if (length.value_or(32) > 32)
+      return std::nullopt;
+    return ipv4_prefix(ntohl(v4.s_addr), length.value_or(32));
+  }
+
+  in6_addr v6{};
+  if (inet_pton(AF_INET6, buf, &v6) != 1 || length.value_or(128) > 128)
+    return std::nullopt;
+  IpPrefix prefix{load_be64(v6.s6_addr), load_be64(v6.s6_addr + 8),
+                  static_cast<uint8_t>(length.value_or(128))};
+  clear_host_bits(prefix);
+  return prefix;
+}
+
+size_t parse_ip_prefix_list(std::string_view text, std::vector<IpPrefix> &out,
+                            size_t *rejected) {
+  size_t parsed = 0;
+  while (!text.empty()) {
+    size_t eol = text.find('\n');
+    std::string_view line = text.substr(0, eol);
+    text.remove_prefix(eol == std::string_view::npos ? text.size() : eol + 1);
+
+    size_t start = line.find_first_not_of(" \t\r");
+    if (start == std::string_view::npos)
+      continue;
+    line.remove_prefix(start);
+    std::string_view token = line.substr(0, line.find_first_of(" \t\r#;,"));
+    if (token.empty())
+      continue;
+    if (auto prefix = parse_ip_prefix(token)) {
+      out.push_back(*prefix);
+      ++parsed;
+    } else if (rejected) {
+      ++*rejected;
+    }
+  }
+  return parsed;
+}
+
+IpPrefixSet::IpPrefixSet(std::vector<IpPrefix> prefixes) {
+  for (auto &prefix : prefixes)
+    clear_host_bits(prefix);
+  std::sort(prefixes.begin(), prefixes.end(),
+            [](const IpPrefix &a, const IpPrefix &b) {
+              return std::tie(a.hi, a.lo, a.length) <
+                     std::tie(b.hi, b.lo, b.length);
+            });
+
+  // Sorted by address, a covering network comes right before what it covers
+  std::vector<IpPrefix> disjoint;
+  disjoint.reserve(prefixes.size());
+  for (const auto &prefix : prefixes) {
+    if (!disjoint.empty()) {
+      const IpPrefix &last = disjoint.back();
+      if (common_length(prefix.hi, prefix.lo, last.hi, last.lo) >= last.length)
+        continue;
+    }
+    disjoint.push_back(prefix);
+  }
+  prefix_count_ = disjoint.size();
+  if (disjoint.empty())
+    return;
+
+  nodes_.reserve(disjoint.size() * 2 - 1);
+  build(disjoint, 0, disjoint.size());
+
+  std::vector<uint64_t> buckets;
+  for (const auto &prefix : disjoint)
+    add_buckets(prefix, buckets);
+  std::sort(buckets.begin(), buckets.end());
+  buckets.erase(std::unique(buckets.begin(), buckets.end()), buckets.end());
+  bucket_filter_.emplace(std::max<size_t>(buckets.size(), 64), 0.01);
+  for (uint64_t bucket : buckets)
+    bucket_filter_->add(bucket);
+}
+
+uint32_t IpPrefixSet::build(const std::vector<IpPrefix> &prefixes,
+                              size_t begin, size_t end) {
+  uint32_t index = static_cast<uint32_t>(nodes_.size());
+  const IpPrefix &first = prefixes[begin];
+  if (end - begin == 1) {
+    nodes_.push_back(Node{first.hi, first.lo, first.length, true, {0, 0}});
+    return index;
+  }
+
+  // Disjoint prefixes all branch below the bits the range has in common
+  const IpPrefix &last = prefixes[end - 1];
+  IpPrefix branch = first;
+  branch.length = static_cast<uint8_t>(
+      common_length(first.hi, first.lo, last.hi, last.lo));
+  clear_host_bits(branch);
+  nodes_.push_back(Node{branch.hi, branch.lo, branch.length, false, {0, 0}});
+
+  auto split = std::partition_point(
+      prefixes.begin() + begin, prefixes.begin() + end,
+      [&](const IpPrefix &p) { return !bit_at(p.hi, p.lo, branch.length); });
+  size_t middle = static_cast<size_t>(split - prefixes.begin());
+  uint32_t zero = build(prefixes, begin, middle);
+  uint32_t one = build(prefixes, middle, end);
+  nodes_[index].child[0] = zero;
+  nodes_[index].child[1] = one;
+  return index;
+}
+
+void IpPrefixSet::add_buckets(const IpPrefix &prefix,
+                                std::vector<uint64_t> &buckets) {
+  unsigned bucket_length;
+  if (prefix.length >= 96 && is_v4_mapped(prefix.hi, prefix.lo)) {
+    bucket_length = kV4BucketLength;
+  } else if (prefix.length < 96 &&
+             common_length(prefix.hi, prefix.lo, 0, kV4MappedLo) >=
+                 prefix.length) {
+    // Also covers IPv4, whose buckets are keyed differently
+    filter_bypassed_ = true;
+    return;
+  } else {
+    bucket_length = kV6BucketLength;
+  }
+
+  if (prefix.length >= bucket_length) {
+    buckets.push_back(bucket_key(prefix.hi, prefix.lo));
+    return;
+  }
+  unsigned spread = bucket_length - prefix.length;
+  if (spread > kMaxBucketBits) {
+    filter_bypassed_ = true;
+    return;
+  }
+  uint64_t base = bucket_key(prefix.hi, prefix.lo);
+  for (uint64_t i = 0; i < (1ULL << spread); ++i)
+    buckets.push_back(base + i);
+}
+
+bool IpPrefixSet::lookup(uint64_t hi, uint64_t lo) const {
+  if (nodes_.empty())
+    return false;
+  if (!filter_bypassed_ && !bucket_filter_->contains(bucket_key(hi, lo)))
+    return false;
+  const Node *node = &nodes_[0];
+  while (true) {
+    if (common_length(hi, lo, node->hi, node->lo) < node->length)
+      return false;
+    if (node->leaf)
+      return true;
+    node = &nodes_[node->child[bit_at(hi, lo, node->length)]];
+  }
+}
+
+bool IpPrefixSet::contains(uint32_t ipv4) const {
+  return lookup(0, kV4MappedLo | ipv4);
+}
+
+bool IpPrefixSet::contains(std::string_view ip) const {
+  auto address = parse_ip_prefix(ip);
+  return address && address->length == 128 &&
+         lookup(address->hi, address->lo);
+}
+
+size_t IpPrefixSet::memory_usage() const {
+  return sizeof(*this) + nodes_.capacity() * sizeof(Node) +
+         (bucket_filter_ ? bucket_filter_->memory_usage() : 0);
+}
+
+} // namespace Utils
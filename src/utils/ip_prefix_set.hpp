@@ -0,0 +1,74 @@
+#ifndef IP_PREFIX_SET_HPP
+#define IP_PREFIX_SET_HPP
+
+#include "utils/bloom_filter.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace Utils {
+
+// An IPv4 or IPv6 network as a 128-bit address and prefix length. IPv4 is
+// kept IPv4-mapped (::ffff:a.b.c.d, length 96 + n) so both families live in
+// one trie.
+struct IpPrefix {
+  uint64_t hi = 0;
+  uint64_t lo = 0;
+  uint8_t length = 128;
+};
+
+IpPrefix ipv4_prefix(uint32_t ip, uint8_t length = 32);
+
+// Accepts "1.2.3.4", "10.0.0.0/8", "2001:db8::1" or "2001:db8::/32". Host
+// bits past the prefix length are cleared.
+std::optional<IpPrefix> parse_ip_prefix(std::string_view text);
+
+// Appends every address or network of a plain-text list to out: one entry
+// per line, the first token counts and '#' or ';' start a comment. Returns
+// the number of entries parsed; rejected, if given, counts the lines that
+// held something else.
+size_t parse_ip_prefix_list(std::string_view text, std::vector<IpPrefix> &out,
+                            size_t *rejected = nullptr);
+
+// Immutable set of IPv4 and IPv6 networks, built once and then shared by
+// every worker. Networks covered by a wider one are dropped, which leaves
+// disjoint prefixes as the leaves of a path-compressed binary trie, so any
+// match is also the longest one. A Bloom filter over /16 (IPv4) and /32
+// (IPv6) buckets turns away most addresses before the trie is walked.
+class IpPrefixSet {
+public:
+  explicit IpPrefixSet(std::vector<IpPrefix> prefixes = {});
+
+  bool contains(uint32_t ipv4) const;
+  bool contains(std::string_view ip) const;
+
+  size_t prefix_count() const { return prefix_count_; }
+  size_t memory_usage() const;
+
+private:
+  struct Node {
+    uint64_t hi;
+    uint64_t lo;
+    uint8_t length;
+    bool leaf;
+    uint32_t child[2];
+  };
+
+  uint32_t build(const std::vector<IpPrefix> &prefixes, size_t begin,
+                 size_t end);
+  void add_buckets(const IpPrefix &prefix, std::vector<uint64_t> &buckets);
+  bool lookup(uint64_t hi, uint64_t lo) const;
+
+  std::vector<Node> nodes_;
+  std::optional<memory::BloomFilter<uint64_t>> bucket_filter_;
+  // Set when a network spans too many buckets to enumerate
+  bool filter_bypassed_ = false;
+  size_t prefix_count_ = 0;
+};
+
+} // namespace Utils
+
+#endif // IP_PREFIX_SET_HPP
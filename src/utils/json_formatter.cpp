@@ -1,5 +1,6 @@
 #include "json_formatter.hpp"
 
+#include <optional>
 #include <sstream>
 #include <string_view>
 
@@ -122,16 +123,23 @@ nlohmann::json JsonFormatter::alert_to_json_object(const Alert &alert_data) {
        get_opt(analysis_context.path_error_event_zscore, 0.0)}};
 
   // Session Features (if they exist)
-  if (analysis_context.raw_session_state.has_value()) {
-    const auto &session = analysis_context.raw_session_state.value();
+  // Alert contexts carry an owned snapshot; fall back to the live handle for
+  // events formatted before materialization
+  std::optional<SessionSnapshot> session_opt =
+      analysis_context.session_snapshot;
+  if (!session_opt && analysis_context.raw_session_state)
+    session_opt.emplace(*analysis_context.raw_session_state);
+
+  if (session_opt) {
+    const auto &session = *session_opt;
     const auto &derived =
         analysis_context.derived_session_features.value_or(SessionFeatures{});
     j_analysis["session_context"] = {
         {"start_time_ms", session.session_start_timestamp_ms},
         {"last_seen_ms", session.last_seen_timestamp_ms},
         {"request_count", session.request_count},
-        {"unique_paths", session.unique_paths_visited.size()},
-        {"unique_uas", session.unique_user_agents.size()},
+        {"unique_paths", session.unique_paths_count},
+        {"unique_uas", session.unique_user_agents_count},
         {"failed_logins", session.failed_login_attempts},
         {"errors_4xx", session.error_4xx_count},
         {"errors_5xx", session.error_5xx_count},
@@ -146,6 +154,28 @@ nlohmann::json JsonFormatter::alert_to_json_object(const Alert &alert_data) {
   // Add the raw log line itself for full context
   j["raw_log_line"] = escape_json_value(log_context.raw_log_line);
 
+  // === Incident (only on incident notifications) ===
+  if (alert_data.incident) {
+    const auto &incident = *alert_data.incident;
+    nlohmann::json j_samples = nlohmann::json::array();
+    for (const auto &sample : incident.sample_events) {
+      const auto &sample_log = sample->raw_log;
+      j_samples.push_back(
+          {{"line_number", sample_log.original_line_number},
+           {"timestamp_str", escape_json_value(sample_log.timestamp_str)},
+           {"request_path", escape_json_value(sample_log.request_path)},
+           {"status_code", get_opt(sample_log.http_status_code, 0)},
+           {"raw_log_line", escape_json_value(sample_log.raw_log_line)}});
+    }
+    j["incident"] = {{"incident_id", incident.incident_id},
+                     {"state", incident_state_to_string(incident.state)},
+                     {"first_seen_ms", incident.first_seen_ms},
+                     {"last_seen_ms", incident.last_seen_ms},
+                     {"alert_count", incident.alert_count},
+                     {"max_score", incident.max_score},
+                     {"sample_events", j_samples}};
+  }
+
   return j;
 }
 
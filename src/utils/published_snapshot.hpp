@@ -0,0 +1,68 @@
+#ifndef PUBLISHED_SNAPSHOT_HPP
+#define PUBLISHED_SNAPSHOT_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+namespace Utils {
+
+// Immutable state handed from a writer (a refresh thread or a config
+// reload) to many worker threads. publish() swaps the pointer and then bumps
+// a generation. Each worker reads through its own Reader, which keeps its
+// reference until the generation moves, so a steady-state read is a single
+// atomic load and a superseded value is freed once every reader has let go.
+template <typename T> class PublishedSnapshot {
+public:
+  explicit PublishedSnapshot(std::shared_ptr<const T> initial = nullptr)
+      : value_(std::move(initial)) {}
+
+  PublishedSnapshot(const PublishedSnapshot &) = delete;
+  PublishedSnapshot &operator=(const PublishedSnapshot &) = delete;
+
+  void publish(std::shared_ptr<const T> value) {
+    std::atomic_store(&value_, std::move(value));
+    generation_.fetch_add(1, std::memory_order_release);
+  }
+
+  std::shared_ptr<const T> load() const { return std::atomic_load(&value_); }
+
+  uint64_t generation() const {
+    return generation_.load(std::memory_order_acquire);
+  }
+
+  // Owned by one thread
+  class Reader {
+  public:
+    explicit Reader(const PublishedSnapshot *source = nullptr)
+        : source_(source) {}
+
+    // Null when nothing has been published
+    const T *get() {
+      if (!source_)
+        return nullptr;
+      uint64_t generation = source_->generation();
+      if (generation != generation_ || !loaded_) {
+        value_ = source_->load();
+        generation_ = generation;
+        loaded_ = true;
+      }
+      return value_.get();
+    }
+
+  private:
+    const PublishedSnapshot *source_;
+    std::shared_ptr<const T> value_;
+    uint64_t generation_ = 0;
+    bool loaded_ = false;
+  };
+
+private:
+  // Accessed through std::atomic_load/atomic_store
+  std::shared_ptr<const T> value_;
+  std::atomic<uint64_t> generation_{0};
+};
+
+} // namespace Utils
+
+#endif // PUBLISHED_SNAPSHOT_HPP
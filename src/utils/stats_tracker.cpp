@@ -30,6 +30,12 @@ double StatsTracker::get_variance() const {
 
 double StatsTracker::get_stddev() const { return std::sqrt(get_variance()); }
 
+void StatsTracker::restore(int64_t count, double mean, double m2) {
+  count_ = count;
+  mean_ = mean;
+  m2_ = m2;
+}
+
 void StatsTracker::save(std::ofstream &out) const {
   out.write(reinterpret_cast<const char *>(&count_), sizeof(count_));
   out.write(reinterpret_cast<const char *>(&mean_), sizeof(mean_));
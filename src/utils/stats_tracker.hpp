@@ -17,6 +17,10 @@ public:
   double get_variance() const;
   double get_stddev() const;
 
+  // Raw Welford moments, for compact encoders that persist the tracker
+  double get_m2() const { return m2_; }
+  void restore(int64_t count, double mean, double m2);
+
   void save(std::ofstream &out) const;
   void load(std::ifstream &in);
 
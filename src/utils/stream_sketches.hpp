@@ -0,0 +1,468 @@
+#ifndef STREAM_SKETCHES_HPP
+#define STREAM_SKETCHES_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace Utils {
+
+inline uint64_t sketch_hash(std::string_view value) {
+  uint64_t x = std::hash<std::string_view>{}(value);
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  x *= 0xc4ceb9fe1a85ec53ULL;
+  x ^= x >> 33;
+  return x;
+}
+
+// HyperLogLog distinct counter. Two sketches of equal precision merge by
+// taking the register-wise maximum. Relative error is about 1.04/sqrt(2^p).
+class HyperLogLog {
+public:
+  explicit HyperLogLog(uint8_t precision = 12)
+      : precision_(std::clamp<uint8_t>(precision, 4, 16)),
+        registers_(size_t{1} << precision_, 0) {}
+
+  void add(std::string_view value) { add_hash(sketch_hash(value)); }
+
+  void add_hash(uint64_t hash) {
+    const size_t index = hash >> (64 - precision_);
+    // Rank of the first set bit in the remaining bits; the sentinel bit caps
+    // it when they are all zero
+    const uint64_t rest = (hash << precision_) | (uint64_t{1} << (precision_ - 1));
+    const uint8_t rank = static_cast<uint8_t>(__builtin_clzll(rest) + 1);
+    if (rank > registers_[index])
+      registers_[index] = rank;
+  }
+
+  void merge(const HyperLogLog &other) {
+    if (other.precision_ != precision_)
+      return;
+    for (size_t i = 0; i < registers_.size(); ++i)
+      registers_[i] = std::max(registers_[i], other.registers_[i]);
+  }
+
+  double estimate() const {
+    const double m = static_cast<double>(registers_.size());
+    double sum = 0.0;
+    size_t zeros = 0;
+    for (uint8_t r : registers_) {
+      sum += std::ldexp(1.0, -r);
+      zeros += r == 0;
+    }
+    const double alpha = m == 16   ? 0.673
+                         : m == 32 ? 0.697
+                         : m == 64 ? 0.709
+                                   : 0.7213 / (1.0 + 1.079 / m);
+    const double raw = alpha * m * m / sum;
+    if (raw <= 2.5 * m && zeros > 0)
+      return m * std::log(m / static_cast<double>(zeros));
+    return raw;
+  }
+
+  void clear() { std::fill(registers_.begin(), registers_.end(), 0); }
+  uint8_t precision() const { return precision_; }
+  size_t memory_bytes() const { return sizeof(*this) + registers_.size(); }
+
+private:
+  uint8_t precision_;
+  std::vector<uint8_t> registers_;
+};
+
+struct NoPayload {};
+
+// Space-Saving heavy-hitter summary over at most `capacity` keys.
+//
+// Any key whose true count exceeds total/capacity is guaranteed to be
+// tracked, and each tracked count overestimates the truth by at most the
+// entry's `error`. Entries stay in fixed slots and a min-heap of slot
+// indices orders them by count, so updates are O(log capacity). The index
+// is keyed by views of the slot keys, so counting a tracked key allocates
+// nothing; a key string is only written when a slot is taken or reassigned.
+// Each entry carries a Payload (e.g. a companion sketch) that is reset from
+// the prototype whenever its slot is reassigned. Movable but not copyable,
+// since the index points into the slots.
+template <typename Payload = NoPayload> class SpaceSaving {
+public:
+  struct Entry {
+    std::string key;
+    uint64_t count = 0;
+    uint64_t error = 0;
+    Payload payload;
+  };
+
+  explicit SpaceSaving(size_t capacity, Payload prototype = Payload{})
+      : capacity_(std::max<size_t>(1, capacity)),
+        prototype_(std::move(prototype)) {
+    // Never grown past capacity_, so slot keys do not move
+    slots_.reserve(capacity_);
+    heap_.reserve(capacity_);
+    heap_pos_.reserve(capacity_);
+    index_.reserve(capacity_);
+  }
+
+  SpaceSaving(const SpaceSaving &) = delete;
+  SpaceSaving &operator=(const SpaceSaving &) = delete;
+  SpaceSaving(SpaceSaving &&) = default;
+  SpaceSaving &operator=(SpaceSaving &&) = default;
+
+  // Counts weight occurrences of key and returns its entry's payload
+  Payload &offer(std::string_view key, uint64_t weight = 1) {
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+      const size_t slot = it->second;
+      slots_[slot].count += weight;
+      sift_down(heap_pos_[slot]);
+      return slots_[slot].payload;
+    }
+
+    if (slots_.size() < capacity_) {
+      const size_t slot = slots_.size();
+      slots_.push_back(Entry{std::string(key), weight, 0, prototype_});
+      index_.emplace(slots_[slot].key, slot);
+      heap_.push_back(slot);
+      heap_pos_.push_back(slot);
+      sift_up(slot);
+      return slots_[slot].payload;
+    }
+
+    // Evict the minimum; the newcomer inherits its count as error bound
+    const size_t slot = heap_.front();
+    Entry &victim = slots_[slot];
+    index_.erase(victim.key);
+    const uint64_t floor = victim.count;
+    victim.key.assign(key.data(), key.size());
+    victim.error = floor;
+    victim.count = floor + weight;
+    victim.payload = prototype_;
+    index_.emplace(victim.key, slot);
+    sift_down(0);
+    return victim.payload;
+  }
+
+  // Tracked entries in no particular order
+  const std::vector<Entry> &entries() const { return slots_; }
+
+  // The k largest entries, highest count first
+  std::vector<Entry> top(size_t k) const {
+    std::vector<Entry> out(slots_);
+    k = std::min(k, out.size());
+    std::partial_sort(
+        out.begin(), out.begin() + k, out.end(),
+        [](const Entry &a, const Entry &b) { return a.count > b.count; });
+    out.resize(k);
+    return out;
+  }
+
+  void clear() {
+    index_.clear();
+    slots_.clear();
+    heap_.clear();
+    heap_pos_.clear();
+  }
+
+  size_t size() const { return slots_.size(); }
+  size_t capacity() const { return capacity_; }
+
+private:
+  uint64_t count_at(size_t pos) const { return slots_[heap_[pos]].count; }
+
+  void swap_entries(size_t a, size_t b) {
+    std::swap(heap_[a], heap_[b]);
+    heap_pos_[heap_[a]] = a;
+    heap_pos_[heap_[b]] = b;
+  }
+
+  void sift_up(size_t pos) {
+    while (pos > 0) {
+      size_t parent = (pos - 1) / 2;
+      if (count_at(parent) <= count_at(pos))
+        break;
+      swap_entries(parent, pos);
+      pos = parent;
+    }
+  }
+
+  void sift_down(size_t pos) {
+    const size_t n = heap_.size();
+    for (;;) {
+      size_t smallest = pos;
+      size_t left = 2 * pos + 1;
+      size_t right = left + 1;
+      if (left < n && count_at(left) < count_at(smallest))
+        smallest = left;
+      if (right < n && count_at(right) < count_at(smallest))
+        smallest = right;
+      if (smallest == pos)
+        return;
+      swap_entries(pos, smallest);
+      pos = smallest;
+    }
+  }
+
+  size_t capacity_;
+  Payload prototype_;
+  std::vector<Entry> slots_;
+  // Min-heap on count of indices into slots_, and each slot's heap position
+  std::vector<size_t> heap_;
+  std::vector<size_t> heap_pos_;
+  std::unordered_map<std::string_view, size_t> index_;
+};
+
+// Relative-error quantile sketch (DDSketch). Values are counted in
+// logarithmic buckets of ratio gamma = (1 + a) / (1 - a), so a quantile is
+// returned within relative error a of the sample at that rank. Adding and
+// removing a value are amortized O(1): each end of the bucket range grows or
+// shrinks in place, and a bucket is only paid for when the range first
+// reaches it. That lets a sliding window evict samples, and sketches of
+// equal accuracy merge by adding counts. Query cost grows with the spread of
+// the values, not their number.
+class QuantileSketch {
+public:
+  explicit QuantileSketch(double relative_accuracy = 0.01)
+      : accuracy_(std::clamp(relative_accuracy, 1e-4, 0.5)),
+        gamma_((1.0 + accuracy_) / (1.0 - accuracy_)),
+        inv_log_gamma_(1.0 / std::log(gamma_)) {}
+
+  void add(double value, uint32_t count = 1) { update(value, count); }
+  // value must have been added before
+  void remove(double value) { update(value, 0); }
+
+  // q in [0, 1]; returns 0 when empty
+  double quantile(double q) const { return quantile_of(q, nullptr); }
+  // Quantile of the values of this sketch and other together, without
+  // merging them. other is ignored unless it has the same accuracy.
+  double quantile(double q, const QuantileSketch &other) const {
+    return quantile_of(q, other.accuracy_ == accuracy_ ? &other : nullptr);
+  }
+
+  // Calls fn(value, count) for every non-empty bucket, in increasing value
+  // order, with a value that add() puts back in the same bucket
+  template <typename Fn> void for_each_bucket(Fn &&fn) const {
+    for (size_t i = negative_.size; i-- > 0;)
+      if (negative_.at(i))
+        fn(-value_of(negative_.offset + static_cast<int32_t>(i)),
+           negative_.at(i));
+    if (zero_count_)
+      fn(0.0, zero_count_);
+    for (size_t i = 0; i < positive_.size; ++i)
+      if (positive_.at(i))
+        fn(value_of(positive_.offset + static_cast<int32_t>(i)),
+           positive_.at(i));
+  }
+
+  void merge(const QuantileSketch &other) {
+    if (other.accuracy_ != accuracy_)
+      return;
+    positive_.merge(other.positive_);
+    negative_.merge(other.negative_);
+    zero_count_ += other.zero_count_;
+    count_ += other.count_;
+  }
+
+  void clear() {
+    positive_ = Store();
+    negative_ = Store();
+    zero_count_ = 0;
+    count_ = 0;
+  }
+
+  uint64_t count() const { return count_; }
+  double relative_accuracy() const { return accuracy_; }
+  size_t memory_bytes() const {
+    return sizeof(*this) +
+           (positive_.ring.capacity() + negative_.ring.capacity()) *
+               sizeof(uint32_t);
+  }
+
+private:
+  // Magnitudes below this are counted as zero, which bounds the bucket range
+  static constexpr double kMinMagnitude = 1e-9;
+
+  // Dense counts for bucket indexes [offset, offset + size), held in a ring
+  // so either end of the range moves without shifting the buckets between.
+  // Ring slots outside the range are always zero.
+  struct Store {
+    int32_t offset = 0;
+    size_t size = 0;
+    // Ring slot of bucket `offset`
+    size_t head = 0;
+    // Length is zero or a power of two
+    std::vector<uint32_t> ring;
+
+    uint32_t &at(size_t i) { return ring[(head + i) & (ring.size() - 1)]; }
+    uint32_t at(size_t i) const {
+      return ring[(head + i) & (ring.size() - 1)];
+    }
+    // Count of bucket index, 0 outside the range
+    uint32_t count_of(int32_t index) const {
+      const int32_t slot = index - offset;
+      return slot < 0 || slot >= static_cast<int32_t>(size)
+                 ? 0
+                 : at(static_cast<size_t>(slot));
+    }
+    int32_t high() const { return offset + static_cast<int32_t>(size) - 1; }
+
+    // Doubles the ring until it holds needed buckets
+    void reserve(size_t needed) {
+      if (needed <= ring.size())
+        return;
+      size_t capacity = std::max<size_t>(8, ring.size());
+      while (capacity < needed)
+        capacity *= 2;
+      std::vector<uint32_t> grown(capacity, 0);
+      for (size_t i = 0; i < size; ++i)
+        grown[i] = at(i);
+      ring.swap(grown);
+      head = 0;
+    }
+
+    // Grows the range to cover [low, high]
+    void extend(int32_t low, int32_t high) {
+      if (size == 0) {
+        reserve(static_cast<size_t>(high - low) + 1);
+        offset = low;
+        size = static_cast<size_t>(high - low) + 1;
+        return;
+      }
+      if (low < offset) {
+        const size_t grow = static_cast<size_t>(offset - low);
+        reserve(size + grow);
+        head = (head - grow) & (ring.size() - 1);
+        size += grow;
+        offset = low;
+      }
+      if (high >= offset + static_cast<int32_t>(size)) {
+        const size_t needed = static_cast<size_t>(high - offset) + 1;
+        reserve(needed);
+        size = needed;
+      }
+    }
+
+    void add(int32_t index, uint32_t count) {
+      extend(index, index);
+      at(static_cast<size_t>(index - offset)) += count;
+    }
+
+    bool remove(int32_t index) {
+      const int32_t slot = index - offset;
+      if (slot < 0 || slot >= static_cast<int32_t>(size) ||
+          at(static_cast<size_t>(slot)) == 0)
+        return false;
+      --at(static_cast<size_t>(slot));
+      // Trim empty edge buckets so the range follows the current values.
+      // Each bucket is trimmed at most once per time the range reached it.
+      while (size > 0 && at(size - 1) == 0)
+        --size;
+      while (size > 0 && at(0) == 0) {
+        head = (head + 1) & (ring.size() - 1);
+        ++offset;
+        --size;
+      }
+      return true;
+    }
+
+    void merge(const Store &other) {
+      if (other.size == 0)
+        return;
+      extend(other.offset, other.offset + static_cast<int32_t>(other.size) - 1);
+      const size_t shift = static_cast<size_t>(other.offset - offset);
+      for (size_t i = 0; i < other.size; ++i)
+        at(shift + i) += other.at(i);
+    }
+  };
+
+  int32_t index_of(double magnitude) const {
+    return static_cast<int32_t>(
+        std::ceil(std::log(magnitude) * inv_log_gamma_));
+  }
+  // Bucket i holds (gamma^(i-1), gamma^i]; this point is within accuracy_ of
+  // both ends
+  double value_of(int32_t index) const {
+    return 2.0 * std::pow(gamma_, index) / (gamma_ + 1.0);
+  }
+
+  // Bucket range covering both stores; empty (low > high) if both are
+  static std::pair<int32_t, int32_t> span(const Store &a, const Store *b) {
+    if (!b || b->size == 0)
+      return {a.offset, a.high()};
+    if (a.size == 0)
+      return {b->offset, b->high()};
+    return {std::min(a.offset, b->offset), std::max(a.high(), b->high())};
+  }
+
+  double quantile_of(double q, const QuantileSketch *other) const {
+    const uint64_t total = count_ + (other ? other->count_ : 0);
+    if (total == 0)
+      return 0.0;
+    const double rank =
+        std::clamp(q, 0.0, 1.0) * static_cast<double>(total - 1);
+    uint64_t seen = 0;
+    // Negative values in increasing order are decreasing magnitudes
+    const Store *other_negative = other ? &other->negative_ : nullptr;
+    const auto [negative_low, negative_high] = span(negative_, other_negative);
+    for (int32_t i = negative_high; i >= negative_low; --i) {
+      seen += negative_.count_of(i) +
+              (other_negative ? other_negative->count_of(i) : 0);
+      if (static_cast<double>(seen) > rank)
+        return -value_of(i);
+    }
+    seen += zero_count_ + (other ? other->zero_count_ : 0);
+    if (static_cast<double>(seen) > rank)
+      return 0.0;
+    const Store *other_positive = other ? &other->positive_ : nullptr;
+    const auto [low, high] = span(positive_, other_positive);
+    for (int32_t i = low; i <= high; ++i) {
+      seen += positive_.count_of(i) +
+              (other_positive ? other_positive->count_of(i) : 0);
+      if (static_cast<double>(seen) > rank)
+        return value_of(i);
+    }
+    return value_of(high);
+  }
+
+  // Adds count copies of value, or removes one when count is 0
+  void update(double value, uint32_t count) {
+    const bool insert = count > 0;
+    const double magnitude = std::abs(value);
+    if (!(magnitude >= kMinMagnitude)) { // also catches NaN
+      if (insert) {
+        zero_count_ += count;
+        count_ += count;
+      } else if (zero_count_ > 0) {
+        --zero_count_;
+        --count_;
+      }
+      return;
+    }
+    Store &store = value > 0 ? positive_ : negative_;
+    const int32_t index = index_of(std::min(magnitude, 1e300));
+    if (insert) {
+      store.add(index, count);
+      count_ += count;
+    } else if (store.remove(index)) {
+      --count_;
+    }
+  }
+
+  double accuracy_;
+  double gamma_;
+  double inv_log_gamma_;
+  Store positive_;
+  Store negative_;
+  uint64_t zero_count_ = 0;
+  uint64_t count_ = 0;
+};
+
+} // namespace Utils
+
+#endif // STREAM_SKETCHES_HPP
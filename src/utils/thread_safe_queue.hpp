@@ -1,6 +1,7 @@
 #ifndef THREAD_SAFE_QUEUE_HPP
 #define THREAD_SAFE_QUEUE_HPP
 
+#include <chrono>
 #include <condition_variable>
 #include <mutex>
 #include <optional>
@@ -25,6 +26,27 @@ public:
     return value;
   }
 
+  // Like wait_and_pop, but also returns nullopt after timeout so an idle
+  // consumer can still do periodic work; use is_shutdown() to tell them apart
+  std::optional<T> wait_and_pop_for(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!cond_.wait_for(lock, timeout, [this] {
+          return !queue_.empty() || shutdown_requested_;
+        }))
+      return std::nullopt;
+    if (shutdown_requested_ && queue_.empty())
+      return std::nullopt;
+
+    T value = std::move(queue_.front());
+    queue_.pop();
+    return value;
+  }
+
+  bool is_shutdown() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return shutdown_requested_;
+  }
+
   // Notify all waiting threads to wake up for shutdown
   void shutdown() {
     {
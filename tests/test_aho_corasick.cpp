@@ -0,0 +1,97 @@
+#include "utils/aho_corasick.hpp"
+
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <random>
+#include <string>
+#include <vector>
+
+using Utils::AhoCorasick;
+
+TEST(AhoCorasickTest, ReportsOverlappingAndNestedMatches) {
+  AhoCorasick matcher({"he", "she", "his", "hers"});
+
+  std::vector<std::string> found = matcher.find_all("ushers");
+  std::vector<std::string> expected = {"she", "he", "hers"};
+  EXPECT_EQ(found, expected);
+
+  int first = matcher.find_first("ushers");
+  ASSERT_NE(first, AhoCorasick::kNoMatch);
+  EXPECT_EQ(matcher.pattern(first), "she");
+  EXPECT_EQ(matcher.find_first("nothing to see"), AhoCorasick::kNoMatch);
+  EXPECT_EQ(matcher.find_first(""), AhoCorasick::kNoMatch);
+}
+
+TEST(AhoCorasickTest, FoldsCaseOnlyWhenAsked) {
+  AhoCorasick exact({"/wp-admin", "sqlmap"});
+  AhoCorasick folded({"/wp-admin", "sqlmap"}, true);
+
+  EXPECT_EQ(exact.find_first("/WP-Admin/setup.php"), AhoCorasick::kNoMatch);
+  EXPECT_NE(folded.find_first("/WP-Admin/setup.php"), AhoCorasick::kNoMatch);
+  EXPECT_NE(folded.find_first("SQLMap/1.7"), AhoCorasick::kNoMatch);
+}
+
+TEST(AhoCorasickTest, MatchSetsReportsEverySetInOnePass) {
+  AhoCorasick matcher = AhoCorasick::from_sets(
+      {{"HeadlessChrome", "PhantomJS"},
+       {"sqlmap", "Nmap"},
+       {"Windows", "Macintosh", "Linux"},
+       {"iPhone", "Android"}});
+
+  EXPECT_EQ(matcher.pattern_count(), 9u);
+  EXPECT_EQ(matcher.set_offset(2), 4u);
+  EXPECT_EQ(matcher.match_sets("Mozilla/5.0 (X11; Linux x86_64) "
+                               "HeadlessChrome/120.0"),
+            0b0101u);
+  EXPECT_EQ(matcher.match_sets("Mozilla/5.0 (Linux; Android 14)"), 0b1100u);
+  EXPECT_EQ(matcher.match_sets("curl/8.4.0"), 0u);
+
+  int first = matcher.find_first("sqlmap/1.7 (Windows)");
+  ASSERT_NE(first, AhoCorasick::kNoMatch);
+  EXPECT_GE(static_cast<size_t>(first), matcher.set_offset(1));
+  EXPECT_LT(static_cast<size_t>(first), matcher.set_offset(2));
+}
+
+TEST(AhoCorasickTest, MatchesNaiveSearchOverRandomText) {
+  std::mt19937 rng(7);
+  std::uniform_int_distribution<int> letter('a', 'e');
+  auto random_string = [&](size_t length) {
+    std::string s;
+    for (size_t i = 0; i < length; ++i)
+      s.push_back(static_cast<char>(letter(rng)));
+    return s;
+  };
+
+  std::vector<std::string> patterns;
+  for (int i = 0; i < 40; ++i)
+    patterns.push_back(random_string(1 + i % 5));
+  AhoCorasick matcher(patterns);
+
+  for (int round = 0; round < 200; ++round) {
+    std::string text = random_string(64);
+
+    // Expected: for every end position, each pattern ending there
+    size_t expected_count = 0;
+    size_t first_end = std::string::npos;
+    for (const auto &pattern : patterns)
+      for (size_t pos = text.find(pattern); pos != std::string::npos;
+           pos = text.find(pattern, pos + 1)) {
+        ++expected_count;
+        first_end = std::min(first_end, pos + pattern.size());
+      }
+
+    size_t count = 0;
+    matcher.for_each_match(text, [&](int) { ++count; });
+    EXPECT_EQ(count, expected_count);
+
+    int first = matcher.find_first(text);
+    if (first_end == std::string::npos) {
+      EXPECT_EQ(first, AhoCorasick::kNoMatch);
+    } else {
+      ASSERT_NE(first, AhoCorasick::kNoMatch);
+      const std::string &found = matcher.pattern(first);
+      EXPECT_EQ(text.compare(first_end - found.size(), found.size(), found),
+                0);
+    }
+  }
+}
@@ -0,0 +1,87 @@
+#include "core/alert_throttle.hpp"
+
+#include <atomic>
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST(AlertThrottleTest, SuppressesRepeatsWithinWindow) {
+  AlertThrottle throttle;
+  throttle.configure(1000, 0, 1 << 16);
+  const uint64_t rule = AlertThrottle::name_id("tier1_requests_per_ip");
+  const uint64_t key = AlertThrottle::key("10.0.0.1", rule);
+
+  EXPECT_FALSE(throttle.throttle(key, 5000));
+  EXPECT_TRUE(throttle.throttle(key, 5999));
+  // Other rules and other sources are independent
+  EXPECT_FALSE(throttle.throttle(
+      AlertThrottle::key("10.0.0.1", AlertThrottle::name_id("other")), 5001));
+  EXPECT_FALSE(throttle.throttle(AlertThrottle::key("10.0.0.2", rule), 5001));
+
+  // The window runs from the last recorded alert, not the last throttled one
+  EXPECT_FALSE(throttle.throttle(key, 6000));
+  EXPECT_TRUE(throttle.throttle(key, 6500));
+
+  throttle.configure(0, 0, 1 << 16);
+  EXPECT_FALSE(throttle.throttle(key, 6501));
+}
+
+TEST(AlertThrottleTest, InterveningAlertsReleaseRepeat) {
+  AlertThrottle throttle;
+  throttle.configure(60000, 2, 1 << 16);
+  const uint64_t key = AlertThrottle::key("10.0.0.1", 1);
+
+  EXPECT_FALSE(throttle.throttle(key, 1000));
+  EXPECT_FALSE(throttle.throttle(AlertThrottle::key("10.0.0.2", 1), 1001));
+  EXPECT_TRUE(throttle.throttle(key, 1002));
+  EXPECT_FALSE(throttle.throttle(AlertThrottle::key("10.0.0.3", 1), 1003));
+  // Two alerts recorded since, so the repeat goes through and is recorded
+  EXPECT_FALSE(throttle.throttle(key, 1004));
+  EXPECT_TRUE(throttle.throttle(key, 1005));
+}
+
+TEST(AlertThrottleTest, StaysWithinMemoryCap) {
+  AlertThrottle throttle;
+  // One entry per shard
+  throttle.configure(1000, 0, 64);
+  for (int i = 0; i < 10000; ++i)
+    throttle.throttle(AlertThrottle::key("10.0.0." + std::to_string(i), 1),
+                      static_cast<uint64_t>(i));
+  EXPECT_LE(throttle.size(), 64u);
+
+  // The oldest entries are evicted first, so a recent one survives a flood
+  // of older alerts
+  throttle.clear();
+  throttle.configure(1000, 0, 64 * 8);
+  const uint64_t live = AlertThrottle::key("192.168.1.1", 1);
+  EXPECT_FALSE(throttle.throttle(live, 100000));
+  for (int i = 0; i < 5000; ++i)
+    throttle.throttle(AlertThrottle::key("10.0.1." + std::to_string(i), 1),
+                      50000);
+  EXPECT_LE(throttle.size(), 64u * 8);
+  EXPECT_TRUE(throttle.throttle(live, 100500));
+}
+
+TEST(AlertThrottleTest, ConcurrentRepeatsRecordedOnce) {
+  AlertThrottle throttle;
+  throttle.configure(60000, 0, 1 << 16);
+  constexpr int kThreads = 8;
+  constexpr int kKeys = 500;
+  std::atomic<int> recorded{0};
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t)
+    threads.emplace_back([&] {
+      for (int i = 0; i < kKeys; ++i)
+        if (!throttle.throttle(
+                AlertThrottle::key("10.1.0." + std::to_string(i), 7), 1000))
+          recorded.fetch_add(1);
+    });
+  for (auto &thread : threads)
+    thread.join();
+
+  // Every (source, rule) pair gets through exactly once
+  EXPECT_EQ(recorded.load(), kKeys);
+  EXPECT_EQ(throttle.size(), static_cast<size_t>(kKeys));
+}
@@ -0,0 +1,159 @@
+#include "analysis/analysis_engine.hpp"
+#include "analysis/per_ip_state.hpp"
+#include "core/cold_state_store.hpp"
+#include "core/compact_serialization.hpp"
+#include "core/config.hpp"
+#include "core/log_entry.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::string spill_path(const std::string &name) {
+  return (std::filesystem::temp_directory_path() / name).string();
+}
+
+std::vector<uint8_t> bytes_of(const std::string &s) {
+  return std::vector<uint8_t>(s.begin(), s.end());
+}
+
+LogEntry make_log(const std::string &ip, const std::string &path,
+                  uint64_t timestamp) {
+  LogEntry log;
+  log.ip_address = ip;
+  log.request_path = path;
+  log.parsed_timestamp_ms = timestamp;
+  return log;
+}
+
+} // namespace
+
+TEST(ColdStateStoreTest, PutAndTakeRoundTrip) {
+  memory::ColdStateStore store(spill_path("cold_store_roundtrip.bin"),
+                               1024 * 1024, 4096);
+  ASSERT_TRUE(store.is_open());
+
+  EXPECT_TRUE(store.put("10.0.0.1", bytes_of("alpha"), 100));
+  EXPECT_TRUE(store.put("10.0.0.2", bytes_of("beta"), 200));
+  EXPECT_EQ(store.entry_count(), 2u);
+  EXPECT_TRUE(store.contains("10.0.0.1"));
+
+  auto blob = store.take("10.0.0.1");
+  ASSERT_TRUE(blob.has_value());
+  EXPECT_EQ(std::string(blob->begin(), blob->end()), "alpha");
+  EXPECT_FALSE(store.contains("10.0.0.1"));
+  EXPECT_FALSE(store.take("10.0.0.1").has_value());
+  EXPECT_EQ(store.live_bytes(), 4u);
+}
+
+TEST(ColdStateStoreTest, GrowsAndCompactsAcrossRemaps) {
+  memory::ColdStateStore store(spill_path("cold_store_grow.bin"), 1024 * 1024,
+                               64);
+  for (int i = 0; i < 200; ++i)
+    ASSERT_TRUE(store.put("ip" + std::to_string(i),
+                          bytes_of("payload-" + std::to_string(i)), i));
+
+  // Expire the first half, then compact the dead space away
+  EXPECT_EQ(store.expire_older_than(100), 100u);
+  size_t before = store.file_bytes();
+  EXPECT_GT(store.compact(), 0u);
+  EXPECT_LT(store.file_bytes(), before);
+  EXPECT_EQ(store.file_bytes(), store.live_bytes());
+
+  auto blob = store.take("ip150");
+  ASSERT_TRUE(blob.has_value());
+  EXPECT_EQ(std::string(blob->begin(), blob->end()), "payload-150");
+}
+
+TEST(ColdStateStoreTest, RejectsWritesPastFileLimit) {
+  memory::ColdStateStore store(spill_path("cold_store_limit.bin"), 16, 16);
+  EXPECT_TRUE(store.put("a", bytes_of("0123456789"), 1));
+  EXPECT_FALSE(store.put("b", bytes_of("0123456789"), 2));
+  EXPECT_TRUE(store.contains("a"));
+}
+
+TEST(ColdStateStoreTest, PerIpStateCompactEncodingRoundTrip) {
+  PerIpState original(5000, 60000, 60000);
+  original.ip_first_seen_timestamp_ms = 1000;
+  original.request_timestamps_window.add_event(4000, 4000);
+  original.request_timestamps_window.add_event(3990, 3990); // out of order
+  original.failed_login_timestamps_window.add_event(4500, 401);
+  original.html_request_timestamps.add_event(4600, 1);
+  original.recent_unique_ua_window.add_event(4700, "curl/8.0");
+  original.paths_seen_by_ip.insert("/login");
+  original.historical_user_agents.insert("curl/8.0");
+  original.last_known_user_agent = "curl/8.0";
+  original.request_time_tracker.update(0.25);
+  original.request_time_tracker.update(0.75);
+
+  core::BinarySerializer out;
+  original.serialize(out);
+
+  PerIpState restored(0, 60000, 60000);
+  core::BinaryDeserializer in(out.data().data(), out.size());
+  restored.deserialize(in);
+
+  EXPECT_EQ(restored.last_seen_timestamp_ms, 5000u);
+  EXPECT_EQ(restored.ip_first_seen_timestamp_ms, 1000u);
+  EXPECT_EQ(restored.request_timestamps_window.get_raw_window_data(),
+            original.request_timestamps_window.get_raw_window_data());
+  EXPECT_EQ(restored.failed_login_timestamps_window.get_raw_window_data(),
+            original.failed_login_timestamps_window.get_raw_window_data());
+  EXPECT_EQ(restored.html_request_timestamps.get_raw_window_data(),
+            original.html_request_timestamps.get_raw_window_data());
+  EXPECT_EQ(restored.recent_unique_ua_window.get_raw_window_data(),
+            original.recent_unique_ua_window.get_raw_window_data());
+  EXPECT_EQ(restored.paths_seen_by_ip, original.paths_seen_by_ip);
+  EXPECT_EQ(restored.historical_user_agents, original.historical_user_agents);
+  EXPECT_EQ(restored.last_known_user_agent, "curl/8.0");
+  EXPECT_EQ(restored.request_time_tracker.get_count(), 2);
+  EXPECT_DOUBLE_EQ(restored.request_time_tracker.get_mean(), 0.5);
+  EXPECT_DOUBLE_EQ(restored.request_time_tracker.get_variance(),
+                   original.request_time_tracker.get_variance());
+}
+
+TEST(ColdStateStoreTest, EngineRehydratesSpilledIpState) {
+  Config::AppConfig config;
+  AnalysisEngine engine(config);
+  ASSERT_TRUE(
+      engine.enable_cold_state_tier(spill_path("cold_store_engine.bin")));
+
+  for (uint64_t i = 0; i < 5; ++i)
+    engine.process_and_analyze(make_log("3.3.3.3", "/a", 1000 + i));
+  engine.process_and_analyze(make_log("4.4.4.4", "/b", 2000));
+
+  // 3.3.3.3 is the least recently seen, so it is the one spilled
+  EXPECT_EQ(engine.spill_ip_states_to_cold(1), 1u);
+  EXPECT_EQ(engine.get_ip_state_count(), 1u);
+  EXPECT_EQ(engine.get_cold_ip_state_count(), 1u);
+
+  auto event = engine.process_and_analyze(make_log("3.3.3.3", "/a", 2001));
+  EXPECT_FALSE(event.is_first_request_from_ip);
+  EXPECT_FALSE(event.is_path_new_for_ip);
+  ASSERT_TRUE(event.current_ip_request_count_in_window.has_value());
+  EXPECT_EQ(*event.current_ip_request_count_in_window, 6u);
+  EXPECT_EQ(engine.get_cold_ip_state_count(), 0u);
+  EXPECT_EQ(engine.get_ip_state_count(), 2u);
+}
+
+TEST(ColdStateStoreTest, PressureRequestSpillsBeforeNextEvent) {
+  Config::AppConfig config;
+  AnalysisEngine engine(config);
+  ASSERT_TRUE(
+      engine.enable_cold_state_tier(spill_path("cold_store_pressure.bin")));
+
+  for (int i = 0; i < 10; ++i)
+    engine.process_and_analyze(
+        make_log("5.5.5." + std::to_string(i), "/", 1000 + i));
+
+  engine.on_memory_pressure(4);
+  EXPECT_EQ(engine.get_cold_ip_state_count(), 0u); // deferred to the worker
+
+  engine.process_and_analyze(make_log("6.6.6.6", "/", 2000));
+  EXPECT_EQ(engine.get_cold_ip_state_count(), 7u);
+  EXPECT_EQ(engine.get_ip_state_count(), 4u);
+}
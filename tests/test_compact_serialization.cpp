@@ -278,6 +278,84 @@ TEST_F(CompactSerializationTest, ErrorHandling) {
   EXPECT_THROW(deserializer.read_uint8(), std::runtime_error); // Should fail
 }
 
+// Test tagged records
+TEST_F(CompactSerializationTest, TaggedRecordRoundTrip) {
+  TaggedRecordWriter writer;
+  writer.write_varint(1, 300);
+  writer.write_signed(2, -5);
+  writer.write_double(3, 2.5);
+  writer.write_string(4, "hello");
+  BinarySerializer out;
+  writer.finish(out);
+  out.write_uint8(0x7F); // Next record starts right after
+
+  BinaryDeserializer in(out.data().data(), out.size());
+  TaggedRecordReader reader(in);
+  std::vector<uint32_t> tags;
+  while (reader.next()) {
+    tags.push_back(reader.tag());
+    switch (reader.tag()) {
+    case 1:
+      EXPECT_EQ(reader.read_varint(), 300u);
+      break;
+    case 2:
+      EXPECT_EQ(reader.read_signed(), -5);
+      break;
+    case 3:
+      EXPECT_DOUBLE_EQ(reader.read_double(), 2.5);
+      break;
+    case 4:
+      EXPECT_EQ(reader.read_string(), "hello");
+      break;
+    }
+  }
+  EXPECT_EQ(tags, (std::vector<uint32_t>{1, 2, 3, 4}));
+  EXPECT_EQ(in.read_uint8(), 0x7F);
+}
+
+TEST_F(CompactSerializationTest, TaggedRecordSkipsUnknownFields) {
+  // A newer writer adds tags 7 and 8 around a field an older reader knows
+  TaggedRecordWriter writer;
+  writer.write_string(7, "added later");
+  writer.write_varint(1, 42);
+  writer.write_double(8, 1.0);
+  BinarySerializer out;
+  writer.finish(out);
+
+  BinaryDeserializer in(out.data().data(), out.size());
+  TaggedRecordReader reader(in);
+  uint64_t known = 0;
+  while (reader.next()) {
+    if (reader.tag() == 1)
+      known = reader.read_varint();
+  }
+  EXPECT_EQ(known, 42u);
+
+  // Reading a field as the wrong type is an error, not a misparse
+  BinaryDeserializer again(out.data().data(), out.size());
+  TaggedRecordReader mismatched(again);
+  ASSERT_TRUE(mismatched.next());
+  EXPECT_THROW(mismatched.read_varint(), std::runtime_error);
+}
+
+TEST_F(CompactSerializationTest, TaggedRecordDetectsCorruption) {
+  TaggedRecordWriter writer;
+  writer.write_string(1, "payload");
+  BinarySerializer out;
+  writer.finish(out);
+
+  std::vector<uint8_t> corrupted = out.data();
+  corrupted[3] ^= 0x01;
+  BinaryDeserializer in(corrupted.data(), corrupted.size());
+  EXPECT_THROW(TaggedRecordReader reader(in), std::runtime_error);
+
+  BinaryDeserializer truncated(out.data().data(), out.size() - 1);
+  EXPECT_THROW(TaggedRecordReader reader(truncated), std::runtime_error);
+
+  EXPECT_EQ(crc32(reinterpret_cast<const uint8_t *>("123456789"), 9),
+            0xCBF43926u);
+}
+
 // Performance test
 TEST_F(CompactSerializationTest, CompressionEfficiency) {
   StringDictionary dict;
@@ -0,0 +1,216 @@
+#include "analysis/analyzed_event.hpp"
+#include "core/alert.hpp"
+#include "core/alert_throttle.hpp"
+#include "core/incident_aggregator.hpp"
+#include "core/log_entry.hpp"
+#include "utils/json_formatter.hpp"
+
+#include <algorithm>
+#include <gtest/gtest.h>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+Alert make_alert(const std::string &ip, uint64_t timestamp_ms, double score,
+                 uint64_t line = 1) {
+  LogEntry log_entry;
+  log_entry.ip_address = ip;
+  log_entry.request_path = "/login";
+  log_entry.request_method = "POST";
+  log_entry.http_status_code = 401;
+  log_entry.original_line_number = line;
+  log_entry.parsed_timestamp_ms = timestamp_ms;
+  auto event = std::make_shared<AnalyzedEvent>(log_entry);
+  return Alert(event, "Failed login burst", AlertTier::TIER1_HEURISTIC,
+               AlertAction::BLOCK, "Block IP", score);
+}
+
+uint64_t key_for(const std::string &ip) {
+  return AlertThrottle::key(ip, AlertThrottle::name_id("tier1_failed_logins"));
+}
+
+} // namespace
+
+TEST(IncidentAggregatorTest, CoalescesRepeatsIntoOneIncident) {
+  IncidentAggregator incidents;
+  incidents.configure(60000, 3, 1 << 16);
+
+  for (uint64_t i = 0; i < 1000; ++i)
+    incidents.record(key_for("10.0.0.1"),
+                     make_alert("10.0.0.1", 5000 + i, i == 400 ? 90.0 : 50.0,
+                                i + 1),
+                     100);
+  incidents.record(key_for("10.0.0.2"), make_alert("10.0.0.2", 7000, 20.0),
+                   100);
+  EXPECT_EQ(incidents.open_count(), 2u);
+
+  auto notifications = incidents.flush(200);
+  ASSERT_EQ(notifications.size(), 2u);
+  const Alert &alert = notifications[0].source_ip == "10.0.0.1"
+                           ? notifications[0]
+                           : notifications[1];
+  ASSERT_TRUE(alert.incident);
+  const IncidentSummary &incident = *alert.incident;
+  EXPECT_EQ(incident.state, IncidentState::OPENED);
+  EXPECT_EQ(incident.alert_count, 1000u);
+  EXPECT_EQ(incident.first_seen_ms, 5000u);
+  EXPECT_EQ(incident.last_seen_ms, 5999u);
+  EXPECT_DOUBLE_EQ(incident.max_score, 90.0);
+  // The notification carries the highest scoring alert
+  EXPECT_DOUBLE_EQ(alert.normalized_score, 90.0);
+  EXPECT_EQ(alert.associated_log_line, 401u);
+  // Only the first few events are retained
+  ASSERT_EQ(incident.sample_events.size(), 3u);
+  EXPECT_EQ(incident.sample_events[0]->raw_log.original_line_number, 1u);
+  EXPECT_EQ(incident.sample_events[2]->raw_log.original_line_number, 3u);
+}
+
+TEST(IncidentAggregatorTest, EmitsOpenUpdateAndClose) {
+  IncidentAggregator incidents;
+  incidents.configure(1000, 5, 1 << 16);
+  const uint64_t key = key_for("10.0.0.1");
+
+  incidents.record(key, make_alert("10.0.0.1", 5000, 50.0), 0);
+  auto notifications = incidents.flush(100);
+  ASSERT_EQ(notifications.size(), 1u);
+  EXPECT_EQ(notifications[0].incident->state, IncidentState::OPENED);
+  const uint64_t id = notifications[0].incident->incident_id;
+
+  // Nothing new since the last notification
+  EXPECT_TRUE(incidents.flush(200).empty());
+
+  incidents.record(key, make_alert("10.0.0.1", 5500, 50.0), 300);
+  incidents.record(key, make_alert("10.0.0.1", 5600, 50.0), 400);
+  notifications = incidents.flush(500);
+  ASSERT_EQ(notifications.size(), 1u);
+  EXPECT_EQ(notifications[0].incident->state, IncidentState::UPDATED);
+  EXPECT_EQ(notifications[0].incident->incident_id, id);
+  EXPECT_EQ(notifications[0].incident->alert_count, 3u);
+
+  // Idle for the timeout: closed and dropped
+  notifications = incidents.flush(1400);
+  ASSERT_EQ(notifications.size(), 1u);
+  EXPECT_EQ(notifications[0].incident->state, IncidentState::CLOSED);
+  EXPECT_EQ(notifications[0].incident->alert_count, 3u);
+  EXPECT_EQ(incidents.open_count(), 0u);
+
+  // A later alert opens a new incident
+  incidents.record(key, make_alert("10.0.0.1", 9000, 50.0), 2000);
+  notifications = incidents.flush(2100);
+  ASSERT_EQ(notifications.size(), 1u);
+  EXPECT_EQ(notifications[0].incident->state, IncidentState::OPENED);
+  EXPECT_NE(notifications[0].incident->incident_id, id);
+}
+
+TEST(IncidentAggregatorTest, StaysWithinOpenLimit) {
+  IncidentAggregator incidents;
+  // One incident per shard
+  incidents.configure(60000, 1, 64);
+  size_t accepted = 0;
+  for (int i = 0; i < 1000; ++i)
+    accepted +=
+        incidents.record(key_for("10.0.1." + std::to_string(i)),
+                         make_alert("10.0.1." + std::to_string(i), 1000, 10.0),
+                         static_cast<uint64_t>(i));
+  EXPECT_LE(incidents.open_count(), 64u);
+  // Each shard takes one more key by closing its incident, then turns the
+  // rest away until the next flush
+  EXPECT_GT(accepted, 64u);
+  EXPECT_LE(accepted, 128u);
+
+  // Incidents closed to make room are reported with a single CLOSED
+  auto notifications = incidents.flush(2000);
+  size_t closed = 0;
+  std::unordered_map<uint64_t, size_t> per_incident;
+  for (const Alert &alert : notifications) {
+    closed += alert.incident->state == IncidentState::CLOSED;
+    ++per_incident[alert.incident->incident_id];
+  }
+  EXPECT_EQ(notifications.size(), accepted);
+  EXPECT_EQ(per_incident.size(), accepted);
+  EXPECT_EQ(closed + incidents.open_count(), accepted);
+
+  auto remaining = incidents.close_all();
+  EXPECT_EQ(remaining.size() + closed, accepted);
+  for (const Alert &alert : remaining)
+    EXPECT_EQ(alert.incident->state, IncidentState::CLOSED);
+  EXPECT_EQ(incidents.open_count(), 0u);
+  EXPECT_TRUE(incidents.record(key_for("10.0.1.0"),
+                               make_alert("10.0.1.0", 3000, 10.0), 3000));
+}
+
+TEST(IncidentAggregatorTest, KeyFloodBetweenFlushesStaysBounded) {
+  IncidentAggregator incidents;
+  // Ten incidents per shard, three samples each
+  incidents.configure(60000, 3, 640);
+  std::vector<std::weak_ptr<const AnalyzedEvent>> events;
+  size_t turned_away = 0;
+  const size_t keys = 20000;
+  for (size_t i = 0; i < keys; ++i) {
+    const std::string ip =
+        "10." + std::to_string(i / 256) + "." + std::to_string(i % 256) + ".1";
+    bool recorded = false;
+    for (int repeat = 0; repeat < 5; ++repeat) {
+      Alert alert = make_alert(ip, 1000 + i, 10.0);
+      events.push_back(alert.event_context);
+      recorded = incidents.record(key_for(ip), alert, i);
+    }
+    turned_away += !recorded;
+  }
+  auto live_events = [&events] {
+    return std::count_if(events.begin(), events.end(),
+                         [](const auto &event) { return !event.expired(); });
+  };
+  // Open incidents keep their samples, closed ones only the peak's event
+  EXPECT_LE(incidents.open_count(), 640u);
+  EXPECT_LE(live_events(), 640 * 3 + 640);
+
+  // Every key is dispatched once: as an incident notification, or through
+  // the throttle when turned away, as with incidents off
+  auto notifications = incidents.flush(keys);
+  EXPECT_LE(notifications.size(), 2 * 640u);
+  EXPECT_EQ(notifications.size() + turned_away, keys);
+
+  notifications.clear();
+  EXPECT_LE(live_events(), 640 * 3);
+}
+
+TEST(IncidentAggregatorTest, ShutdownAnnouncesUnflushedIncidents) {
+  IncidentAggregator incidents;
+  incidents.configure(60000, 1, 1 << 16);
+  incidents.record(key_for("10.0.0.1"), make_alert("10.0.0.1", 5000, 50.0), 0);
+
+  auto notifications = incidents.close_all();
+  ASSERT_EQ(notifications.size(), 2u);
+  EXPECT_EQ(notifications[0].incident->state, IncidentState::OPENED);
+  EXPECT_EQ(notifications[1].incident->state, IncidentState::CLOSED);
+  EXPECT_EQ(notifications[0].incident->incident_id,
+            notifications[1].incident->incident_id);
+}
+
+TEST(IncidentAggregatorTest, NotificationJsonCarriesIncident) {
+  IncidentAggregator incidents;
+  incidents.configure(60000, 2, 1 << 16);
+  const uint64_t key = key_for("10.0.0.1");
+  incidents.record(key, make_alert("10.0.0.1", 5000, 50.0, 10), 0);
+  incidents.record(key, make_alert("10.0.0.1", 6000, 70.0, 11), 0);
+
+  auto notifications = incidents.flush(0);
+  ASSERT_EQ(notifications.size(), 1u);
+  auto json = JsonFormatter::alert_to_json_object(notifications[0]);
+  ASSERT_TRUE(json.contains("incident"));
+  EXPECT_EQ(json["incident"]["state"], "OPENED");
+  EXPECT_EQ(json["incident"]["alert_count"], 2);
+  EXPECT_EQ(json["incident"]["first_seen_ms"], 5000);
+  EXPECT_EQ(json["incident"]["last_seen_ms"], 6000);
+  ASSERT_EQ(json["incident"]["sample_events"].size(), 2u);
+  EXPECT_EQ(json["incident"]["sample_events"][1]["line_number"], 11);
+
+  // Plain alerts have no incident section
+  EXPECT_FALSE(JsonFormatter::alert_to_json_object(
+                   make_alert("10.0.0.1", 5000, 50.0))
+                   .contains("incident"));
+}
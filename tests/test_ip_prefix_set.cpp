@@ -0,0 +1,109 @@
+#include "utils/ip_prefix_set.hpp"
+#include "utils/published_snapshot.hpp"
+#include "utils/utils.hpp"
+
+#include <gtest/gtest.h>
+#include <memory>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+using Utils::IpPrefix;
+using Utils::IpPrefixSet;
+using Utils::ipv4_prefix;
+using Utils::parse_ip_prefix;
+using Utils::parse_ip_prefix_list;
+
+TEST(IpPrefixSetTest, ParsesFeedsWithCidrAndIpv6) {
+  std::vector<IpPrefix> prefixes;
+  size_t rejected = 0;
+  size_t parsed = parse_ip_prefix_list("# firehol style\n"
+                                   "203.0.113.7\n"
+                                   "  198.51.100.0/24 ; SBL123\n"
+                                   "2001:db8:bad::/48\n"
+                                   "\n"
+                                   "not-an-ip\n"
+                                   "10.0.0.0/33\n"
+                                   "192.0.2.1\r\n",
+                                   prefixes, &rejected);
+  EXPECT_EQ(parsed, 4u);
+  EXPECT_EQ(rejected, 2u);
+
+  IpPrefixSet snapshot(prefixes);
+  EXPECT_EQ(snapshot.prefix_count(), 4u);
+  EXPECT_TRUE(snapshot.contains(Utils::ip_string_to_uint32("203.0.113.7")));
+  EXPECT_FALSE(snapshot.contains(Utils::ip_string_to_uint32("203.0.113.8")));
+  EXPECT_TRUE(snapshot.contains(Utils::ip_string_to_uint32("198.51.100.42")));
+  EXPECT_FALSE(snapshot.contains(Utils::ip_string_to_uint32("198.51.101.1")));
+  EXPECT_TRUE(snapshot.contains(Utils::ip_string_to_uint32("192.0.2.1")));
+
+  EXPECT_TRUE(snapshot.contains(std::string_view("2001:db8:bad:1::5")));
+  EXPECT_FALSE(snapshot.contains(std::string_view("2001:db8:bae::5")));
+  // IPv4-mapped IPv6 is the same address as its IPv4 form
+  EXPECT_TRUE(snapshot.contains(std::string_view("::ffff:198.51.100.9")));
+  EXPECT_FALSE(snapshot.contains(std::string_view("garbage")));
+}
+
+TEST(IpPrefixSetTest, WideNetworksCoverNarrowerOnes) {
+  IpPrefixSet snapshot({*parse_ip_prefix("10.1.2.3"),
+                          *parse_ip_prefix("10.0.0.0/8"),
+                          *parse_ip_prefix("10.200.0.0/16"),
+                          *parse_ip_prefix("2001:db8::/32"),
+                          *parse_ip_prefix("2001:db8:1::1")});
+  EXPECT_EQ(snapshot.prefix_count(), 2u);
+  EXPECT_TRUE(snapshot.contains(Utils::ip_string_to_uint32("10.255.0.1")));
+  EXPECT_FALSE(snapshot.contains(Utils::ip_string_to_uint32("11.0.0.1")));
+  EXPECT_TRUE(snapshot.contains(std::string_view("2001:db8:ffff::1")));
+
+  // Too wide to enumerate its filter buckets, so the filter is bypassed
+  IpPrefixSet everything({*parse_ip_prefix("::/0")});
+  EXPECT_TRUE(everything.contains(Utils::ip_string_to_uint32("8.8.8.8")));
+  EXPECT_TRUE(everything.contains(std::string_view("fe80::1")));
+
+  IpPrefixSet empty;
+  EXPECT_FALSE(empty.contains(Utils::ip_string_to_uint32("8.8.8.8")));
+}
+
+TEST(IpPrefixSetTest, MatchesLinearScanOverRandomNetworks) {
+  std::mt19937 gen(11);
+  std::vector<Utils::CIDRBlock> blocks;
+  std::vector<IpPrefix> prefixes;
+  for (int i = 0; i < 2000; ++i) {
+    uint32_t length = 8 + gen() % 25;
+    uint32_t mask = length == 32 ? ~0u : ~(~0u >> length);
+    uint32_t network = gen() & mask & 0x3fffffff; // keep hits likely
+    blocks.push_back({network, mask});
+    prefixes.push_back(ipv4_prefix(network, static_cast<uint8_t>(length)));
+  }
+  IpPrefixSet snapshot(prefixes);
+
+  for (int i = 0; i < 20000; ++i) {
+    uint32_t ip = gen() & 0x3fffffff;
+    bool expected = false;
+    for (const auto &block : blocks)
+      expected = expected || block.contains(ip);
+    ASSERT_EQ(snapshot.contains(ip), expected) << ip;
+  }
+}
+
+TEST(IpPrefixSetTest, ReadersSeePublishedSetsOnTheirNextRead) {
+  Utils::PublishedSnapshot<IpPrefixSet> allowlist;
+  Utils::PublishedSnapshot<IpPrefixSet>::Reader reader(&allowlist);
+  EXPECT_EQ(reader.get(), nullptr);
+
+  allowlist.publish(std::make_shared<const IpPrefixSet>(
+      std::vector<IpPrefix>{*parse_ip_prefix("10.0.0.0/8")}));
+  const IpPrefixSet *first = reader.get();
+  ASSERT_NE(first, nullptr);
+  EXPECT_TRUE(first->contains(Utils::ip_string_to_uint32("10.1.1.1")));
+  EXPECT_EQ(reader.get(), first);
+
+  // The reader keeps the old set alive until it notices the new one
+  allowlist.publish(std::make_shared<const IpPrefixSet>(
+      std::vector<IpPrefix>{*parse_ip_prefix("192.168.0.0/16")}));
+  EXPECT_TRUE(first->contains(Utils::ip_string_to_uint32("10.1.1.1")));
+  const IpPrefixSet *second = reader.get();
+  EXPECT_FALSE(second->contains(Utils::ip_string_to_uint32("10.1.1.1")));
+  EXPECT_TRUE(second->contains(Utils::ip_string_to_uint32("192.168.3.4")));
+}
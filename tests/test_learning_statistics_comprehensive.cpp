@@ -1,11 +1,21 @@
 #include "core/config.hpp"
 #include "learning/dynamic_learning_engine.hpp"
+#include "learning/learning_update_pipeline.hpp"
 #include "learning/rolling_statistics.hpp"
 #include "learning/seasonal_model.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cmath>
+#include <deque>
+#include <filesystem>
 #include <gtest/gtest.h>
+#include <limits>
 #include <random>
+#include <string>
+#include <thread>
+#include <vector>
 
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
@@ -69,6 +79,52 @@ TEST_F(RollingStatisticsTest, PercentileAccuracy) {
   EXPECT_NEAR(stats.get_percentile(0.01), 10, 10.0);
 }
 
+TEST_F(RollingStatisticsTest, PercentilesTrackExactValuesOverWindow) {
+  RollingStatistics stats(0.1, 500, 0.01);
+  std::mt19937 gen(3);
+  std::gamma_distribution<> dist(2.0, 40.0);
+  std::deque<double> window;
+
+  for (int i = 0; i < 3000; ++i) {
+    double value = dist(gen);
+    stats.add_value(value, i * 1000);
+    window.push_back(value);
+    if (window.size() > 500)
+      window.pop_front();
+
+    // Checked when both half-window sketches are full, so they cover
+    // exactly the last 500 samples
+    if (i % 250 != 249)
+      continue;
+    std::vector<double> sorted(window.begin(), window.end());
+    std::sort(sorted.begin(), sorted.end());
+    for (double p : {0.5, 0.95, 0.99}) {
+      double exact = sorted[static_cast<size_t>(p * (sorted.size() - 1))];
+      EXPECT_NEAR(stats.get_percentile(p), exact, exact * 0.01)
+          << "p=" << p << " after " << i + 1 << " samples";
+    }
+  }
+}
+
+TEST_F(RollingStatisticsTest, MemoryDoesNotGrowWithSamples) {
+  RollingStatistics stats(0.1, 1000, 0.01);
+  std::uniform_real_distribution<> dist(10.0, 1000.0);
+  for (int i = 0; i < 2000; ++i)
+    stats.add_value(dist(gen), i * 1000);
+  const size_t warmed = stats.get_memory_usage();
+  for (int i = 2000; i < 50000; ++i)
+    stats.add_value(dist(gen), i * 1000);
+  EXPECT_EQ(stats.get_memory_usage(), warmed);
+  // Far below the 16 KB a 1000-sample window of (value, timestamp) took
+  EXPECT_LT(warmed, 4096u);
+  EXPECT_NEAR(stats.get_percentile(0.5), 505.0, 30.0);
+
+  // Older halves roll off: the percentiles follow a level shift
+  for (int i = 0; i < 1000; ++i)
+    stats.add_value(5000.0, (50000 + i) * 1000);
+  EXPECT_NEAR(stats.get_percentile(0.01), 5000.0, 50.0);
+}
+
 TEST_F(RollingStatisticsTest, BayesianConfidenceInterval) {
   RollingStatistics stats(0.1, 1000);
   std::normal_distribution<> dist(50.0, 10.0);
@@ -190,6 +246,59 @@ TEST_F(SeasonalModelTest, PatternEstablishment) {
   EXPECT_EQ(pattern.weekly_pattern.size(), 4);
 }
 
+TEST_F(SeasonalModelTest, EvictedObservationsLeaveThePattern) {
+  // Window of 48 observations
+  SeasonalModel windowed(24), fresh(24);
+  for (int i = 0; i < 500; ++i) {
+    double value = 10.0 + (i % 24) + (i < 452 ? 100.0 : 0.0);
+    uint64_t timestamp = base_time + i * 3600000ULL;
+    windowed.add_observation(value, timestamp);
+    if (i >= 452)
+      fresh.add_observation(value, timestamp);
+  }
+  windowed.update_pattern();
+  fresh.update_pattern();
+
+  auto a = windowed.get_current_pattern();
+  auto b = fresh.get_current_pattern();
+  EXPECT_EQ(a.observation_count, 48u);
+  for (size_t i = 0; i < 24; ++i) {
+    EXPECT_NEAR(a.hourly_pattern[i], b.hourly_pattern[i], 1e-9);
+    EXPECT_NEAR(a.hourly_fourier.magnitude[i], b.hourly_fourier.magnitude[i],
+                1e-9);
+  }
+  for (size_t i = 0; i < 7; ++i)
+    EXPECT_NEAR(a.daily_pattern[i], b.daily_pattern[i], 1e-9);
+}
+
+TEST_F(SeasonalModelTest, WindowIsAFixedRingWithRunningBins) {
+  // Window of 200 observations, cycled fifty times over
+  SeasonalModel windowed(100), fresh(100);
+  size_t full_window_bytes = 0;
+  for (int i = 0; i < 10000; ++i) {
+    double value = 10.0 + (i % 24) + (i < 9800 ? 100.0 : 0.0);
+    uint64_t timestamp = base_time + i * 3600000ULL;
+    windowed.add_observation(value, timestamp);
+    if (i >= 9800)
+      fresh.add_observation(value, timestamp);
+    if (i == 199)
+      full_window_bytes = windowed.get_memory_usage();
+  }
+  // Each push overwrites the oldest slot instead of growing the buffer
+  EXPECT_EQ(windowed.get_memory_usage(), full_window_bytes);
+
+  // Bins reversed on every eviction hold exactly the last window
+  windowed.update_pattern();
+  fresh.update_pattern();
+  auto a = windowed.get_current_pattern();
+  auto b = fresh.get_current_pattern();
+  EXPECT_EQ(a.observation_count, 200u);
+  for (size_t i = 0; i < 24; ++i)
+    EXPECT_NEAR(a.hourly_pattern[i], b.hourly_pattern[i], 1e-6);
+  for (size_t i = 0; i < 7; ++i)
+    EXPECT_NEAR(a.daily_pattern[i], b.daily_pattern[i], 1e-6);
+}
+
 class DynamicLearningEngineTest : public ::testing::Test {
 protected:
   void SetUp() override {
@@ -244,6 +353,88 @@ TEST_F(DynamicLearningEngineTest, AnomalyDetection) {
   EXPECT_GT(anomaly_score, 3.0);
 }
 
+TEST_F(DynamicLearningEngineTest, BaselinesSurviveSaveAndLoad) {
+  for (int i = 0; i < 200; ++i)
+    engine->process_event("ip", "10.0.0." + std::to_string(i % 5),
+                          100.0 + i % 7, base_time + i * 60000);
+  engine->set_manual_override("path", "/admin", 42.0);
+
+  std::string path =
+      (std::filesystem::temp_directory_path() / "learning_baselines.dat")
+          .string();
+  // A small chunk size spreads the baselines over several chunks
+  ASSERT_TRUE(engine->save_baselines(path, 2));
+
+  DynamicLearningEngine restored;
+  ASSERT_TRUE(restored.load_baselines(path));
+  EXPECT_EQ(restored.get_baseline_count(), engine->get_baseline_count());
+
+  auto original = engine->get_baseline("ip", "10.0.0.1");
+  auto loaded = restored.get_baseline("ip", "10.0.0.1");
+  EXPECT_TRUE(loaded->is_established);
+  EXPECT_EQ(loaded->last_updated, original->last_updated);
+  EXPECT_EQ(loaded->statistics.get_sample_count(),
+            original->statistics.get_sample_count());
+  EXPECT_DOUBLE_EQ(loaded->statistics.get_mean(),
+                   original->statistics.get_mean());
+  EXPECT_DOUBLE_EQ(loaded->statistics.get_percentile(0.95),
+                   original->statistics.get_percentile(0.95));
+
+  auto overridden = restored.get_baseline("path", "/admin");
+  EXPECT_TRUE(overridden->manual_override_active);
+  EXPECT_DOUBLE_EQ(overridden->manual_override_threshold, 42.0);
+  EXPECT_EQ(overridden->threshold_audit_log.size(), 1u);
+
+  // Contextual baselines come back under the same context
+  auto daily = engine->get_contextual_baseline(
+      "ip", "10.0.0.1", DynamicLearningEngine::TimeContext::DAILY, 0);
+  auto restored_daily = restored.get_contextual_baseline(
+      "ip", "10.0.0.1", DynamicLearningEngine::TimeContext::DAILY, 0);
+  EXPECT_EQ(restored_daily->statistics.get_sample_count(),
+            daily->statistics.get_sample_count());
+
+  // A truncated file is rejected as a whole
+  std::filesystem::resize_file(path, std::filesystem::file_size(path) - 3);
+  DynamicLearningEngine rejected;
+  EXPECT_FALSE(rejected.load_baselines(path));
+  EXPECT_EQ(rejected.get_baseline_count(), 0u);
+  std::filesystem::remove(path);
+}
+
+TEST_F(DynamicLearningEngineTest, OverridesRaceWithSavesSafely) {
+  for (int i = 0; i < 200; ++i)
+    engine->process_event("path", "/admin", 100.0 + i % 7,
+                          base_time + i * 1000);
+  std::string path =
+      (std::filesystem::temp_directory_path() / "learning_race.dat").string();
+
+  // Every mutator takes the baseline's mutex, which save_baselines holds
+  // while it encodes the baseline
+  std::atomic<bool> done{false};
+  std::thread saver([&] {
+    while (!done)
+      engine->save_baselines(path, 4);
+  });
+  for (int i = 0; i < 200; ++i) {
+    engine->set_manual_override("path", "/admin", 50.0 + i);
+    engine->mark_entity_as_security_critical("path", "/admin", 20.0);
+    engine->clear_manual_override("path", "/admin");
+    engine->unmark_entity_as_security_critical("path", "/admin");
+    if (i % 50 == 0)
+      engine->clear_threshold_audit_log("path", "/admin");
+  }
+  done = true;
+  saver.join();
+
+  ASSERT_TRUE(engine->save_baselines(path, 4));
+  DynamicLearningEngine restored;
+  ASSERT_TRUE(restored.load_baselines(path));
+  auto baseline = restored.get_baseline("path", "/admin");
+  EXPECT_FALSE(baseline->manual_override_active);
+  EXPECT_FALSE(baseline->is_security_critical);
+  std::filesystem::remove(path);
+}
+
 TEST_F(DynamicLearningEngineTest, DynamicThresholdCalculation) {
   std::string path = "/api/login";
 
@@ -302,6 +493,149 @@ TEST_F(DynamicLearningEngineTest, EntitySeparation) {
   EXPECT_NE(baseline2.get(), baseline3.get());
 }
 
+TEST_F(DynamicLearningEngineTest, ConcurrentUpdatesAcrossShards) {
+  // Same id under another type is a different entity
+  EXPECT_NE(make_entity_key("ip", "1.2.3.4"),
+            make_entity_key("session", "1.2.3.4"));
+  EXPECT_EQ(make_entity_key("ip", "1.2.3.4"), make_entity_key("ip", "1.2.3.4"));
+
+  // Each worker owns its IPs and all of them share one path
+  std::vector<std::thread> workers;
+  for (int w = 0; w < 4; ++w) {
+    workers.emplace_back([this, w] {
+      for (int i = 0; i < 500; ++i) {
+        std::string ip = "10.0." + std::to_string(w) + "." +
+                         std::to_string(i % 50);
+        engine->process_event("ip", ip, 1.0, base_time + i);
+        engine->update_baseline("path", "/shared", 1.0, base_time + i);
+      }
+    });
+  }
+  for (auto &worker : workers)
+    worker.join();
+
+  EXPECT_EQ(engine->get_baseline_count(), 4u * 50u + 1u);
+  EXPECT_EQ(engine->get_baseline("path", "/shared")
+                ->statistics.get_sample_count(),
+            2000u);
+  EXPECT_EQ(engine->get_baseline("ip", "10.0.3.7")->entity_id, "10.0.3.7");
+}
+
+TEST_F(DynamicLearningEngineTest, PipelineFoldsBatchesAndPublishesThresholds) {
+  LearningUpdatePipeline pipeline(*engine, 2, 2,
+                                  std::chrono::milliseconds(10000), 1024);
+  for (int i = 0; i < 100; ++i) {
+    pipeline.record(0, "ip", "10.0.0.1", 10.0 + i % 5, base_time + i);
+    pipeline.record(1, "path", "/api", 1.0, base_time + i);
+  }
+  // Nothing is folded or published before the flush
+  EXPECT_EQ(engine->get_baseline_count(), 0u);
+  EXPECT_TRUE(std::isnan(pipeline.thresholds().get("ip", "10.0.0.1")));
+
+  pipeline.flush();
+  EXPECT_EQ(engine->get_baseline("ip", "10.0.0.1")
+                ->statistics.get_sample_count(),
+            100u);
+  EXPECT_NEAR(pipeline.thresholds().get("ip", "10.0.0.1"), 14.0, 0.5);
+  EXPECT_NEAR(pipeline.thresholds().get("path", "/api"), 1.0, 0.02);
+  EXPECT_TRUE(std::isnan(pipeline.thresholds().get("ip", "10.0.0.2")));
+  EXPECT_EQ(pipeline.thresholds().size(), 2u);
+
+  // A full buffer drops instead of blocking the worker
+  for (int i = 0; i < 1100; ++i)
+    pipeline.record(0, "ip", "10.0.0.1", 10.0, base_time + 200 + i);
+  EXPECT_EQ(pipeline.dropped_updates(), 76u);
+  pipeline.stop();
+  EXPECT_EQ(engine->get_baseline("ip", "10.0.0.1")
+                ->statistics.get_sample_count(),
+            1124u);
+}
+
+TEST(ThresholdAuditLogTest, KeepsNewestEntriesInOrder) {
+  ThresholdAuditLog log;
+  auto timestamps = [&log] {
+    std::vector<uint64_t> seen;
+    log.for_each([&](const ThresholdAuditEntry &entry) {
+      seen.push_back(entry.timestamp_ms);
+    });
+    return seen;
+  };
+  for (uint64_t t = 1; t <= 7; ++t)
+    log.add(ThresholdAuditEntry{t, 0.0, 1.0, 0.95, "", ""}, 4);
+  EXPECT_EQ(timestamps(), (std::vector<uint64_t>{4, 5, 6, 7}));
+
+  // A lower limit drops the oldest, a higher one lets the log grow again
+  log.add(ThresholdAuditEntry{8, 0.0, 1.0, 0.95, "", ""}, 2);
+  EXPECT_EQ(timestamps(), (std::vector<uint64_t>{7, 8}));
+  log.add(ThresholdAuditEntry{9, 0.0, 1.0, 0.95, "", ""}, 4);
+  EXPECT_EQ(timestamps(), (std::vector<uint64_t>{7, 8, 9}));
+}
+
+TEST(ThresholdSnapshotTest, UpdatesInPlaceAndGrows) {
+  ThresholdSnapshot snapshot;
+  std::vector<ThresholdSnapshot::Update> batch;
+  for (EntityKey key = 0; key < 5000; ++key)
+    batch.emplace_back(key * 0x9e3779b97f4a7c15ULL, static_cast<double>(key));
+  // Later pairs win, and removing an unknown key is a no-op
+  batch.emplace_back(7 * 0x9e3779b97f4a7c15ULL, 70.0);
+  batch.emplace_back(12345, std::numeric_limits<double>::quiet_NaN());
+  snapshot.publish(batch);
+  EXPECT_EQ(snapshot.size(), 5000u);
+  EXPECT_EQ(snapshot.get(0), 0.0);
+  EXPECT_EQ(snapshot.get(7 * 0x9e3779b97f4a7c15ULL), 70.0);
+  EXPECT_EQ(snapshot.get(4999 * 0x9e3779b97f4a7c15ULL), 4999.0);
+  EXPECT_TRUE(std::isnan(snapshot.get(12345)));
+
+  // Removed keys read as absent and can come back
+  const double nan = std::numeric_limits<double>::quiet_NaN();
+  snapshot.publish({{0, nan}, {3 * 0x9e3779b97f4a7c15ULL, nan}});
+  EXPECT_EQ(snapshot.size(), 4998u);
+  EXPECT_TRUE(std::isnan(snapshot.get(0)));
+  snapshot.publish({{0, 1.5}});
+  EXPECT_EQ(snapshot.get(0), 1.5);
+  EXPECT_EQ(snapshot.size(), 4999u);
+}
+
+TEST_F(DynamicLearningEngineTest, OnlyPromotedBaselinesCarryASeasonalModel) {
+  Config::DynamicLearningConfig defaults;
+  size_t empty_model =
+      SeasonalModel(defaults.min_samples_for_seasonal_pattern)
+          .get_memory_usage();
+
+  // A transient entity keeps just its summary statistics
+  for (int i = 0; i < 10; ++i)
+    engine->update_baseline("ip", "10.0.0.1", 1.0, base_time + i * 1000);
+  auto transient = engine->get_baseline("ip", "10.0.0.1");
+  EXPECT_FALSE(transient->has_full_model());
+  EXPECT_EQ(transient->seasonal_model.get_memory_usage(), empty_model);
+
+  // Security-critical entities are promoted before they are established
+  engine->mark_entity_as_security_critical("path", "/admin");
+  engine->update_baseline("path", "/admin", 1.0, base_time);
+  auto critical = engine->get_baseline("path", "/admin");
+  EXPECT_TRUE(critical->has_full_model());
+  EXPECT_GT(critical->seasonal_model.get_memory_usage(), empty_model);
+}
+
+TEST_F(DynamicLearningEngineTest, PipelineExpiresIdleBaselines) {
+  LearningUpdatePipeline pipeline(*engine, 1, 1,
+                                  std::chrono::milliseconds(10000), 1024);
+  pipeline.set_baseline_expiry(60000, 10000);
+  for (int i = 0; i < 50; ++i) {
+    pipeline.record(0, "ip", "10.0.0.1", 1.0, base_time + i);
+    pipeline.record(0, "ip", "10.0.0.2", 1.0, base_time + i);
+  }
+  pipeline.flush();
+  EXPECT_EQ(pipeline.thresholds().size(), 2u);
+
+  // Only 10.0.0.2 stays active past the TTL
+  pipeline.record(0, "ip", "10.0.0.2", 1.0, base_time + 120000);
+  pipeline.flush();
+  EXPECT_EQ(engine->get_baseline_count(), 1u);
+  EXPECT_TRUE(std::isnan(pipeline.thresholds().get("ip", "10.0.0.1")));
+  EXPECT_EQ(pipeline.thresholds().size(), 1u);
+}
+
 TEST_F(DynamicLearningEngineTest, ThresholdChangeLoggingAndAudit) {
   std::string ip = "10.0.0.1";
 
@@ -600,7 +934,7 @@ TEST_F(DynamicLearningEngineTest, EnhancedProcessAnalyzedEventWithSessions) {
   session_state.failed_login_attempts = 2;
   session_state.error_4xx_count = 1;
   session_state.error_5xx_count = 0;
-  event.raw_session_state = session_state;
+  event.raw_session_state = &session_state;
 
   // Process the event
   engine->process_analyzed_event(event);
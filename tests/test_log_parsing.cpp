@@ -67,4 +67,27 @@ TEST(LogParsingTest, HandlesURLDecodingInPath) {
 
   ASSERT_TRUE(entry_opt.has_value());
   EXPECT_EQ(entry_opt->request_path, "/some/path with+spaces");
-}
\ No newline at end of file
+}
+
+TEST(LogParsingTest, CopiedEntryOwnsItsFieldViews) {
+  std::string line =
+      "192.168.0.1|-|01/Jan/2023:12:00:01 +0000|0.120|0.100|GET /index.html "
+      "HTTP/1.1|200|1024|-|Mozilla/5.0|example.com|US|-|-|-";
+  auto entry_opt = LogEntry::parse_from_string(std::move(line), 5);
+  ASSERT_TRUE(entry_opt.has_value());
+
+  LogEntry copy = *entry_opt;
+  entry_opt.reset(); // Free the original buffer
+
+  const char *begin = copy.raw_log_line.data();
+  const char *end = begin + copy.raw_log_line.size();
+  EXPECT_GE(copy.ip_address.data(), begin);
+  EXPECT_LE(copy.user_agent.data() + copy.user_agent.size(), end);
+  EXPECT_EQ(copy.ip_address, "192.168.0.1");
+  EXPECT_EQ(copy.request_method, "GET");
+  EXPECT_EQ(copy.user_agent, "Mozilla/5.0");
+
+  LogEntry moved = std::move(copy);
+  EXPECT_EQ(moved.ip_address.data(), moved.raw_log_line.data());
+  EXPECT_EQ(moved.host, "example.com");
+}
@@ -0,0 +1,125 @@
+#include "analysis/analysis_engine.hpp"
+#include "analysis/request_classifier.hpp"
+#include "core/config.hpp"
+
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+using analysis::RequestClassifier;
+using analysis::RequestType;
+
+namespace {
+
+Config::Tier1Config make_config() {
+  Config::Tier1Config cfg;
+  cfg.html_path_suffixes = {".html", ".htm", ".php", ".jsp"};
+  cfg.html_exact_paths = {"/", "/index"};
+  cfg.asset_path_prefixes = {"/static/", "/assets/", "/api/", "/a"};
+  cfg.asset_path_suffixes = {".css", ".js", ".png", ".php"};
+  return cfg;
+}
+
+// The linear scans the classifier replaced
+RequestType classify_linearly(std::string path,
+                              const Config::Tier1Config &cfg) {
+  path = path.substr(0, path.find('?'));
+  path = path.substr(0, path.find('#'));
+  for (const auto &exact : cfg.html_exact_paths)
+    if (path == exact)
+      return RequestType::HTML;
+  for (const auto &prefix : cfg.asset_path_prefixes)
+    if (path.rfind(prefix, 0) == 0)
+      return RequestType::ASSET;
+  size_t last_dot = path.rfind('.');
+  if (last_dot != std::string::npos) {
+    std::string suffix = path.substr(last_dot);
+    for (const auto &s : cfg.html_path_suffixes)
+      if (suffix == s)
+        return RequestType::HTML;
+    for (const auto &s : cfg.asset_path_suffixes)
+      if (suffix == s)
+        return RequestType::ASSET;
+  }
+  return RequestType::OTHER;
+}
+
+} // namespace
+
+TEST(RequestClassifierTest, AppliesRulesInConfigOrder) {
+  RequestClassifier classifier(make_config());
+
+  EXPECT_EQ(classifier.classify("/"), RequestType::HTML);
+  EXPECT_EQ(classifier.classify("/?utm=1"), RequestType::HTML);
+  EXPECT_EQ(classifier.classify("/index#top"), RequestType::HTML);
+  EXPECT_EQ(classifier.classify("/static/app.js"), RequestType::ASSET);
+  // Prefixes take precedence over suffixes
+  EXPECT_EQ(classifier.classify("/api/login.php"), RequestType::ASSET);
+  // A suffix in both lists counts as HTML
+  EXPECT_EQ(classifier.classify("/shop/cart.php?id=3"), RequestType::HTML);
+  EXPECT_EQ(classifier.classify("/css/site.css"), RequestType::ASSET);
+  EXPECT_EQ(classifier.classify("/download.tar.gz"), RequestType::OTHER);
+  EXPECT_EQ(classifier.classify("/v1.2/users"), RequestType::OTHER);
+  EXPECT_EQ(classifier.classify(""), RequestType::OTHER);
+
+  EXPECT_EQ(RequestClassifier::strip_query("/p?q=1#f"), "/p");
+  EXPECT_EQ(RequestClassifier::strip_query("/p#f?q=1"), "/p");
+}
+
+TEST(RequestClassifierTest, MatchesLinearScans) {
+  Config::Tier1Config cfg = make_config();
+  RequestClassifier classifier(cfg);
+
+  const std::vector<std::string> paths = {
+      "/",          "/index",      "/index.html", "/a",
+      "/about",     "/b/a.css",    "/static",     "/static/",
+      "/assets/x",  "/x.htm?y=.js", "/x.js#.html", "/.php",
+      "/x.PHP",     "/x.",         "?",           "#/static/",
+      "/api",       "/apiary.png", "/y/z.jsp",    "/img/logo.png?v=2"};
+  for (const auto &path : paths)
+    EXPECT_EQ(classifier.classify(path), classify_linearly(path, cfg))
+        << path;
+
+  // An empty config classifies nothing
+  RequestClassifier empty((Config::Tier1Config()));
+  EXPECT_EQ(empty.classify("/index.html"), RequestType::OTHER);
+}
+
+TEST(RequestClassifierTest, LargeListsBuildCompactTables) {
+  Config::Tier1Config cfg;
+  for (int i = 0; i < 3000; ++i)
+    cfg.html_exact_paths.push_back("/page/" + std::to_string(i));
+  // Duplicates keep their first entry
+  cfg.html_exact_paths.push_back("/page/7");
+  for (int i = 0; i < 200; ++i)
+    cfg.asset_path_suffixes.push_back(".x" + std::to_string(i));
+  RequestClassifier classifier(cfg);
+
+  for (int i = 0; i < 3000; ++i)
+    ASSERT_EQ(classifier.classify("/page/" + std::to_string(i)),
+              RequestType::HTML)
+        << i;
+  EXPECT_EQ(classifier.classify("/page/3000"), RequestType::OTHER);
+  EXPECT_EQ(classifier.classify("/f.x199"), RequestType::ASSET);
+  EXPECT_EQ(classifier.classify("/f.x200"), RequestType::OTHER);
+  // Linear in the number of keys: a few slots per path
+  EXPECT_LT(classifier.memory_footprint(), 3200u * 200u);
+}
+
+TEST(RequestClassifierTest, EnginesShareOneClassifier) {
+  Config::AppConfig cfg;
+  cfg.tier1 = make_config();
+  AnalysisEngine first(cfg);
+  AnalysisEngine second(cfg, first.get_request_classifier());
+  EXPECT_EQ(second.get_request_classifier(), first.get_request_classifier());
+
+  // Only the owner rebuilds; main then hands its classifier to the others
+  auto before = first.get_request_classifier();
+  first.reconfigure(cfg);
+  second.reconfigure(cfg);
+  EXPECT_NE(first.get_request_classifier(), before);
+  EXPECT_EQ(second.get_request_classifier(), before);
+  second.set_request_classifier(first.get_request_classifier());
+  second.reconfigure(cfg);
+  EXPECT_EQ(second.get_request_classifier(), first.get_request_classifier());
+}
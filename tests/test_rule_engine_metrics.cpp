@@ -269,6 +269,7 @@ TEST_F(RuleEngineMetricsTest, Tier1RuleEvaluationTracking) {
 
   // Process event to trigger tier 1 rule evaluations
   rule_engine->evaluate_rules(event);
+  mock_exporter->collect();
 
   // Verify rule evaluation counters are incremented
   EXPECT_TRUE(mock_exporter->has_counter(
@@ -312,6 +313,7 @@ TEST_F(RuleEngineMetricsTest, Tier1RuleHitTracking) {
 
   // Process event to trigger rule hit
   rule_engine->evaluate_rules(event);
+  mock_exporter->collect();
 
   // Verify rule hit counter is incremented
   EXPECT_TRUE(mock_exporter->has_counter(
@@ -350,6 +352,7 @@ TEST_F(RuleEngineMetricsTest, Tier2RuleEvaluationAndHitTracking) {
 
   // Process event
   rule_engine->evaluate_rules(event);
+  mock_exporter->collect();
 
   // Verify tier 2 rule evaluation tracking
   EXPECT_TRUE(mock_exporter->has_counter(
@@ -383,6 +386,7 @@ TEST_F(RuleEngineMetricsTest, Tier3MLRuleTracking) {
   // Process event (Note: ML model might not be available, but evaluation should
   // still be tracked)
   rule_engine->evaluate_rules(event);
+  mock_exporter->collect();
 
   // Verify tier 3 rule evaluation tracking
   EXPECT_TRUE(mock_exporter->has_counter(
@@ -400,6 +404,7 @@ TEST_F(RuleEngineMetricsTest, AlertScoreDistributionTracking) {
 
   // Process event
   rule_engine->evaluate_rules(event);
+  mock_exporter->collect();
 
   // Verify alert score distribution is tracked
   auto hist_observations = mock_exporter->get_histogram_observations(
@@ -429,6 +434,7 @@ TEST_F(RuleEngineMetricsTest, MultipleRuleHitRateCalculation) {
     }
     rule_engine->evaluate_rules(event);
   }
+  mock_exporter->collect();
 
   // Verify hit rate is calculated correctly (3 hits out of 5 evaluations = 0.6)
   double hit_rate = mock_exporter->get_gauge(
@@ -460,6 +466,7 @@ TEST_F(RuleEngineMetricsTest, ProcessingTimeMetrics) {
 
   // Process event
   rule_engine->evaluate_rules(event);
+  mock_exporter->collect();
 
   // The processing time metrics are handled by MetricsManager, not directly by
   // our mock exporter. Instead, let's verify that rule evaluation metrics are
@@ -498,11 +505,13 @@ TEST_F(RuleEngineMetricsTest, SuspiciousStringRuleTracking) {
   // Set up event to trigger suspicious string rules
   event.raw_log.request_path = "/admin/config"; // Contains "admin" from config
   event.raw_log.user_agent = "sqlmap/1.0";      // Contains "sqlmap" from config
+  event.found_suspicious_ua_str = true;
 
   mock_exporter->clear_metrics();
 
   // Process event
   rule_engine->evaluate_rules(event);
+  mock_exporter->collect();
 
   // Verify suspicious string rule evaluation and hits
   EXPECT_TRUE(mock_exporter->has_counter(
@@ -528,6 +537,7 @@ TEST_F(RuleEngineMetricsTest, UserAgentAnomalyRuleTracking) {
 
   mock_exporter->clear_metrics();
   rule_engine->evaluate_rules(event);
+  mock_exporter->collect();
 
   // Verify user agent rule tracking
   EXPECT_TRUE(mock_exporter->has_counter(
@@ -541,6 +551,7 @@ TEST_F(RuleEngineMetricsTest, UserAgentAnomalyRuleTracking) {
   event.is_ua_missing = false;
   event.is_ua_known_bad = true;
   rule_engine->evaluate_rules(event);
+  mock_exporter->collect();
 
   // Should have another hit
   EXPECT_TRUE(mock_exporter->has_counter(
@@ -560,6 +571,7 @@ TEST_F(RuleEngineMetricsTest, AssetRatioRuleTracking) {
 
   // Process event
   rule_engine->evaluate_rules(event);
+  mock_exporter->collect();
 
   // Verify asset ratio rule tracking
   EXPECT_TRUE(mock_exporter->has_counter(
@@ -581,6 +593,7 @@ TEST_F(RuleEngineMetricsTest, NewSeenRuleTracking) {
 
   // Process event
   rule_engine->evaluate_rules(event);
+  mock_exporter->collect();
 
   // Verify new seen rule tracking
   EXPECT_TRUE(mock_exporter->has_counter(
@@ -603,6 +616,7 @@ TEST_F(RuleEngineMetricsTest, HistoricalComparisonRuleTracking) {
 
   // Process event
   rule_engine->evaluate_rules(event);
+  mock_exporter->collect();
 
   // Verify historical comparison rule tracking
   EXPECT_TRUE(mock_exporter->has_counter(
@@ -630,6 +644,7 @@ TEST_F(RuleEngineMetricsTest, AllTierMetricsIntegration) {
 
   // Process event
   rule_engine->evaluate_rules(event);
+  mock_exporter->collect();
 
   // Verify all tiers have evaluation metrics
   EXPECT_TRUE(mock_exporter->has_counter(
@@ -651,6 +666,36 @@ TEST_F(RuleEngineMetricsTest, AllTierMetricsIntegration) {
       {{"tier", "tier2"}, {"action", "log"}, {"rule", "tier2_ip_zscore"}}));
 }
 
+TEST_F(RuleEngineMetricsTest, WorkersShareOneHitRate) {
+  auto counters = std::make_shared<detection::RuleCounterSet>();
+  auto make_worker = [&] {
+    auto engine = std::make_unique<RuleEngine>(
+        *mock_alert_manager, config, mock_model_manager, nullptr, counters);
+    engine->set_metrics_exporter(mock_exporter);
+    return engine;
+  };
+  auto hitting = make_worker();
+  auto quiet = make_worker();
+
+  auto event = create_test_event();
+  event.current_ip_request_count_in_window = std::make_optional<size_t>(150);
+  hitting->evaluate_rules(event);
+  event.current_ip_request_count_in_window = std::make_optional<size_t>(50);
+  for (int i = 0; i < 3; ++i)
+    quiet->evaluate_rules(event);
+
+  mock_exporter->clear_metrics();
+  mock_exporter->collect();
+  const std::map<std::string, std::string> labels = {
+      {"tier", "tier1"}, {"rule", "tier1_requests_per_ip"}};
+  // One hit in four evaluations over both workers, not either worker's own
+  EXPECT_DOUBLE_EQ(mock_exporter->get_gauge("ad_rule_hit_rate", labels),
+                   0.25);
+  EXPECT_EQ(mock_exporter->get_counter("ad_rule_evaluations_total", labels),
+            4);
+  EXPECT_EQ(mock_exporter->get_counter("ad_rule_hits_total", labels), 1);
+}
+
 TEST_F(RuleEngineMetricsTest, DisabledTiersNoMetrics) {
   // Disable tier 2 and tier 3
   config.tier2.enabled = false;
@@ -669,6 +714,7 @@ TEST_F(RuleEngineMetricsTest, DisabledTiersNoMetrics) {
 
   // Process event
   rule_engine->evaluate_rules(event);
+  mock_exporter->collect();
 
   // Verify only tier 1 metrics are recorded
   EXPECT_TRUE(mock_exporter->has_counter(
@@ -704,6 +750,7 @@ TEST_F(RuleEngineMetricsTest, FailedLoginRuleTracking) {
 
   // Process event
   rule_engine->evaluate_rules(event);
+  mock_exporter->collect();
 
   // Verify failed login rule tracking
   EXPECT_TRUE(mock_exporter->has_counter(
@@ -735,12 +782,13 @@ TEST_F(RuleEngineMetricsTest, SessionRuleTracking) {
   session_state.unique_user_agents.insert(
       "Firefox/88.0"); // 4 UAs, above threshold of 2
 
-  event.raw_session_state = session_state;
+  event.raw_session_state = &session_state;
 
   mock_exporter->clear_metrics();
 
   // Process event
   rule_engine->evaluate_rules(event);
+  mock_exporter->collect();
 
   // Verify session rule tracking
   EXPECT_TRUE(mock_exporter->has_counter(
@@ -768,6 +816,7 @@ TEST_F(RuleEngineMetricsTest, EmptyFeatureVectorNoMLMetrics) {
 
   // Process event
   rule_engine->evaluate_rules(event);
+  mock_exporter->collect();
 
   // ML rule should still be evaluated (to track attempts) but no hit should
   // occur
@@ -790,6 +839,7 @@ TEST_F(RuleEngineMetricsTest, ZeroScoreAlertsNotGenerated) {
 
   // Process event
   rule_engine->evaluate_rules(event);
+  mock_exporter->collect();
 
   // Rule evaluation should be tracked
   EXPECT_TRUE(mock_exporter->has_counter(
@@ -820,6 +870,7 @@ TEST_F(RuleEngineMetricsTest, AllowlistedIPSkipsRules) {
 
   // Process event
   rule_engine->evaluate_rules(event);
+  mock_exporter->collect();
 
   // No rule evaluations should occur for allowlisted IPs
   EXPECT_FALSE(mock_exporter->has_counter(
@@ -829,3 +880,82 @@ TEST_F(RuleEngineMetricsTest, AllowlistedIPSkipsRules) {
   // Clean up
   std::remove(allowlist_path.c_str());
 }
+
+TEST_F(RuleEngineMetricsTest, BatchedEvaluationMatchesPerEvent) {
+  PerSessionState session_state;
+  session_state.failed_login_attempts = 5;
+  session_state.unique_user_agents = {"a", "b", "c"};
+
+  std::vector<AnalyzedEvent> events;
+  events.push_back(create_test_event("10.0.1.1"));
+  events.push_back(create_test_event("10.0.1.2", "/static/../etc/passwd"));
+  events.back().current_ip_request_count_in_window = 150;
+  events.push_back(create_test_event("10.0.1.3"));
+  events.back().raw_session_state = &session_state;
+  events.push_back(create_test_event("10.0.1.4", "/", "sqlmap/1.0"));
+  events.back().found_suspicious_ua_str = true;
+  events.back().ip_req_time_zscore = -4.0;
+  events.back().is_ua_headless = true;
+  events.push_back(create_test_event("10.0.1.5"));
+  events.back().ip_assets_per_html_ratio = 0.5;
+
+  config.rule_batch_size = 4;
+  auto batched_exporter = std::make_shared<MockPrometheusMetricsExporter>();
+  RuleEngine batched(*mock_alert_manager, config, mock_model_manager);
+  batched.set_metrics_exporter(batched_exporter);
+  mock_exporter->clear_metrics();
+  batched_exporter->clear_metrics();
+
+  for (const auto &event : events) {
+    rule_engine->evaluate_rules(event);
+    batched.evaluate_rules_batched(AnalyzedEvent(event));
+  }
+  // The fifth event waits for more input or a flush
+  EXPECT_EQ(batched.pending_rule_batch_size(), 1u);
+  batched.flush_rule_batch();
+  EXPECT_EQ(batched.pending_rule_batch_size(), 0u);
+  mock_exporter->collect();
+  batched_exporter->collect();
+
+  EXPECT_EQ(batched_exporter->get_counter(
+                "ad_rule_evaluations_total",
+                {{"tier", "tier1"}, {"rule", "tier1_session"}}),
+            5);
+  EXPECT_EQ(batched_exporter->get_counter(
+                "ad_rule_hits_total",
+                {{"tier", "tier1"}, {"rule", "tier1_session"}}),
+            2);
+  EXPECT_EQ(batched_exporter->counter_increments,
+            mock_exporter->counter_increments);
+  EXPECT_EQ(batched_exporter->gauge_values, mock_exporter->gauge_values);
+}
+
+TEST_F(RuleEngineMetricsTest, WorkerCountersSummedAtScrape) {
+  RuleEngine second_worker(*mock_alert_manager, config, mock_model_manager);
+  second_worker.set_metrics_exporter(mock_exporter);
+  mock_exporter->clear_metrics();
+
+  auto event = create_test_event();
+  event.current_ip_request_count_in_window = std::make_optional<size_t>(150);
+  rule_engine->evaluate_rules(event);
+  second_worker.evaluate_rules(event);
+  second_worker.evaluate_rules(create_test_event());
+
+  // Nothing reaches the exporter until it is scraped
+  const std::map<std::string, std::string> labels{
+      {"tier", "tier1"}, {"rule", "tier1_requests_per_ip"}};
+  EXPECT_FALSE(mock_exporter->has_counter("ad_rule_evaluations_total", labels));
+
+  mock_exporter->collect();
+  EXPECT_EQ(mock_exporter->get_counter("ad_rule_evaluations_total", labels),
+            3);
+  EXPECT_EQ(mock_exporter->get_counter("ad_rule_hits_total", labels), 2);
+
+  // A second scrape only adds what was counted in between
+  rule_engine->evaluate_rules(event);
+  mock_exporter->collect();
+  mock_exporter->collect();
+  EXPECT_EQ(mock_exporter->get_counter("ad_rule_evaluations_total", labels),
+            4);
+  EXPECT_EQ(mock_exporter->get_counter("ad_rule_hits_total", labels), 3);
+}
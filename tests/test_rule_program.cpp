@@ -0,0 +1,162 @@
+#include "analysis/analyzed_event.hpp"
+#include "core/config.hpp"
+#include "detection/rule_program.hpp"
+
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+
+using detection::Feature;
+using detection::FeatureBlock;
+using detection::FeatureRecord;
+using detection::RuleGroup;
+using detection::RuleId;
+using detection::RuleProgram;
+using detection::RuleTier;
+
+namespace {
+
+Config::AppConfig make_config() {
+  Config::AppConfig cfg;
+  cfg.tier1.enabled = true;
+  cfg.tier2.enabled = true;
+  cfg.tier1.max_requests_per_ip_in_window = 100;
+  cfg.tier1.max_failed_logins_per_ip = 5;
+  cfg.tier1.subnet_rollup_enabled = true;
+  cfg.tier1.max_requests_per_subnet_narrow_in_window = 500;
+  cfg.tier1.min_distinct_ips_for_subnet_alert = 8;
+  cfg.tier1.suspicious_path_substrings = {"../", "/etc/passwd"};
+  cfg.tier1.sensitive_path_substrings = {"/admin", "/wp-login"};
+  cfg.tier2.z_score_threshold = 3.0;
+  cfg.tier2.min_samples_for_z_score = 10;
+  cfg.tier2.historical_deviation_factor = 3.0;
+  return cfg;
+}
+
+std::vector<RuleId> hits(const RuleProgram &program, RuleTier tier,
+                         const AnalyzedEvent &event) {
+  FeatureRecord features;
+  program.extract(event, features);
+  std::vector<RuleId> ids;
+  program.for_each_hit(tier, features,
+                       [&](RuleId id) { ids.push_back(id); });
+  return ids;
+}
+
+} // namespace
+
+TEST(RuleProgramTest, CompilesOnlyEnabledTiersAndChecks) {
+  Config::AppConfig cfg = make_config();
+  RuleProgram program(cfg);
+  EXPECT_EQ(program.groups(RuleTier::HEURISTIC).size(), 8u);
+  EXPECT_EQ(program.groups(RuleTier::STATISTICAL),
+            (std::vector<RuleGroup>{RuleGroup::IP_ZSCORE,
+                                    RuleGroup::PATH_ZSCORE,
+                                    RuleGroup::HISTORICAL_COMPARISON}));
+  EXPECT_STREQ(detection::rule_group_name(RuleGroup::SUBNET_ROLLUP),
+               "tier1_subnet_rollup");
+  EXPECT_STREQ(detection::rule_group_tier(RuleGroup::ML), "tier3");
+  EXPECT_EQ(detection::rule_group(RuleId::NEW_PATH_HIGH_ERROR),
+            RuleGroup::NEW_SEEN);
+
+  cfg.tier1.subnet_rollup_enabled = false;
+  cfg.tier1.check_user_agent_anomalies = false;
+  cfg.tier2.enabled = false;
+  RuleProgram reduced(cfg);
+  // The user-agent group is still evaluated, it just has no rules
+  EXPECT_EQ(reduced.groups(RuleTier::HEURISTIC).size(), 7u);
+  EXPECT_TRUE(reduced.groups(RuleTier::STATISTICAL).empty());
+  EXPECT_LT(reduced.rule_count(), program.rule_count());
+
+  AnalyzedEvent event{LogEntry{}};
+  event.is_ua_headless = true;
+  event.ip_req_time_zscore = 10.0;
+  event.subnet_narrow_activity = analysis::SubnetActivity{24, 900, 0, 20};
+  EXPECT_TRUE(hits(reduced, RuleTier::HEURISTIC, event).empty());
+  EXPECT_TRUE(hits(reduced, RuleTier::STATISTICAL, event).empty());
+}
+
+TEST(RuleProgramTest, MatchesThresholdsAndSkipsAbsentInputs) {
+  RuleProgram program(make_config());
+
+  // Nothing is known about a bare event, so nothing fires
+  AnalyzedEvent event{LogEntry{}};
+  EXPECT_TRUE(hits(program, RuleTier::HEURISTIC, event).empty());
+  EXPECT_TRUE(hits(program, RuleTier::STATISTICAL, event).empty());
+
+  event.current_ip_request_count_in_window = 100;
+  event.current_ip_failed_login_count_in_window = 6;
+  // Over the volume threshold but from too few addresses
+  event.subnet_narrow_activity = analysis::SubnetActivity{24, 900, 0, 3};
+  event.raw_log.request_path = "/static/../../etc/passwd";
+  EXPECT_EQ(hits(program, RuleTier::HEURISTIC, event),
+            (std::vector<RuleId>{RuleId::FAILED_LOGINS,
+                                 RuleId::SUSPICIOUS_PATH}));
+
+  FeatureRecord features;
+  program.extract(event, features);
+  EXPECT_EQ(program.suspicious_path_pattern(
+                static_cast<int>(features[Feature::SUSPICIOUS_PATH])),
+            "../");
+  EXPECT_FALSE(features.has(Feature::SENSITIVE_PATH));
+
+  event.raw_log.request_path = "/wp-login.php?next=/admin";
+  event.is_first_request_from_ip = true;
+  program.extract(event, features);
+  ASSERT_TRUE(features.has(Feature::SENSITIVE_PATH));
+  // The first substring in config order wins
+  EXPECT_EQ(program.sensitive_path_substring(
+                static_cast<int>(features[Feature::SENSITIVE_PATH])),
+            "/admin");
+
+  event.ip_req_time_zscore = -3.5;
+  event.path_error_event_zscore = 2.9;
+  event.raw_log.request_time_s = 4.0;
+  event.ip_hist_req_time_mean = 1.0;
+  event.ip_hist_req_time_samples = 9;
+  EXPECT_EQ(hits(program, RuleTier::STATISTICAL, event),
+            (std::vector<RuleId>{RuleId::IP_REQ_TIME_ZSCORE}));
+
+  event.ip_hist_req_time_samples = 10;
+  EXPECT_EQ(hits(program, RuleTier::STATISTICAL, event),
+            (std::vector<RuleId>{RuleId::IP_REQ_TIME_ZSCORE,
+                                 RuleId::HISTORICAL_REQ_TIME}));
+}
+
+TEST(RuleProgramTest, BlockEvaluationMatchesPerRecord) {
+  RuleProgram program(make_config());
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<double> value(-600.0, 600.0);
+
+  // Random inputs straddling every threshold, each present half the time;
+  // 37 lanes leaves the tail of the block unused
+  std::vector<FeatureRecord> records(37);
+  FeatureBlock block;
+  for (auto &record : records) {
+    for (size_t f = 0; f < detection::kFeatureCount; ++f)
+      if (rng() % 2)
+        record.set(static_cast<Feature>(f), value(rng));
+    block.append(record);
+  }
+  ASSERT_EQ(block.size, records.size());
+  EXPECT_EQ(block.record(3).present, records[3].present);
+
+  for (RuleTier tier : {RuleTier::HEURISTIC, RuleTier::STATISTICAL}) {
+    std::array<uint64_t, detection::kRuleCount> lanes{};
+    uint64_t any = program.evaluate(tier, block, lanes);
+
+    std::array<uint64_t, detection::kRuleCount> expected{};
+    for (size_t lane = 0; lane < records.size(); ++lane)
+      program.for_each_hit(tier, records[lane], [&](RuleId id) {
+        expected[static_cast<size_t>(id)] |= uint64_t{1} << lane;
+      });
+    EXPECT_EQ(lanes, expected);
+    EXPECT_NE(any, 0u);
+    EXPECT_EQ(any & ~block.lanes(), 0u);
+  }
+
+  block.clear();
+  EXPECT_TRUE(block.empty());
+  std::array<uint64_t, detection::kRuleCount> lanes{};
+  EXPECT_EQ(program.evaluate(RuleTier::HEURISTIC, block, lanes), 0u);
+}
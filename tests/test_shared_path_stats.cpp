@@ -0,0 +1,82 @@
+#include "analysis/analysis_engine.hpp"
+#include "analysis/shared_path_stats.hpp"
+#include "core/config.hpp"
+#include "core/log_entry.hpp"
+
+#include <gtest/gtest.h>
+#include <string>
+
+using analysis::SharedPathStats;
+
+namespace {
+
+SharedPathStats::Sample sample(double request_time_s, bool is_error) {
+  SharedPathStats::Sample s;
+  s.request_time_s = request_time_s;
+  s.is_error = is_error;
+  return s;
+}
+
+LogEntry make_log(const std::string &ip, const std::string &path,
+                  uint64_t timestamp, double request_time_s) {
+  LogEntry log;
+  log.ip_address = ip;
+  log.request_path = path;
+  log.parsed_timestamp_ms = timestamp;
+  log.request_time_s = request_time_s;
+  return log;
+}
+
+} // namespace
+
+TEST(SharedPathStatsTest, RecordReturnsUpdatedSnapshot) {
+  SharedPathStats stats;
+  stats.record("/login", 1000, sample(0.1, false));
+  stats.record("/login", 1001, sample(0.3, true));
+  PerPathState snapshot = stats.record("/login", 1002, sample(0.2, false));
+
+  EXPECT_EQ(snapshot.request_time_tracker.get_count(), 3);
+  EXPECT_NEAR(snapshot.request_time_tracker.get_mean(), 0.2, 1e-9);
+  EXPECT_NEAR(snapshot.error_rate_tracker.get_mean(), 1.0 / 3.0, 1e-9);
+  EXPECT_EQ(snapshot.bytes_sent_tracker.get_count(), 0);
+  EXPECT_EQ(snapshot.last_seen_timestamp_ms, 1002u);
+  EXPECT_EQ(stats.size(), 1u);
+}
+
+TEST(SharedPathStatsTest, PrunesIdlePaths) {
+  SharedPathStats stats;
+  stats.record("/old", 1000, sample(0.1, false));
+  stats.record("/new", 9000, sample(0.1, false));
+
+  EXPECT_EQ(stats.prune_idle(10000, 5000), 1u);
+  EXPECT_EQ(stats.size(), 1u);
+  EXPECT_EQ(stats.record("/new", 10001, sample(0.1, false))
+                .request_time_tracker.get_count(),
+            2);
+}
+
+TEST(SharedPathStatsTest, EnginesScoreAgainstGlobalPathBaseline) {
+  Config::AppConfig config;
+  config.tier2.min_samples_for_z_score = 4;
+  AnalysisEngine first(config);
+  AnalysisEngine second(config);
+  second.set_path_stats(first.get_path_stats());
+
+  // Each engine alone sees too few samples to score the path
+  first.process_and_analyze(make_log("1.1.1.1", "/api", 1000, 0.10));
+  first.process_and_analyze(make_log("1.1.1.1", "/api", 1001, 0.12));
+  second.process_and_analyze(make_log("2.2.2.2", "/api", 1002, 0.11));
+  auto event =
+      second.process_and_analyze(make_log("2.2.2.2", "/api", 1003, 0.90));
+
+  EXPECT_TRUE(event.path_req_time_zscore.has_value());
+  EXPECT_EQ(first.get_path_state_count(), 1u);
+  EXPECT_EQ(second.get_path_state_count(), 1u);
+
+  // Only the owner clears or prunes the shared store
+  second.reset_in_memory_state();
+  second.run_pruning(1000000000);
+  EXPECT_EQ(first.get_path_state_count(), 1u);
+  first.reset_in_memory_state();
+  EXPECT_EQ(second.get_path_state_count(), 0u);
+}
@@ -0,0 +1,338 @@
+#include "analysis/analysis_engine.hpp"
+#include "analysis/per_ip_state.hpp"
+#include "core/compact_serialization.hpp"
+#include "core/config.hpp"
+#include "core/log_entry.hpp"
+#include "core/state_snapshotter.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <gtest/gtest.h>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+std::string snapshot_dir(const std::string &name) {
+  auto dir = std::filesystem::temp_directory_path() / name;
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+  return dir.string();
+}
+
+LogEntry make_log(const std::string &ip, const std::string &path,
+                  uint64_t timestamp) {
+  LogEntry log;
+  log.ip_address = ip;
+  log.request_path = path;
+  log.user_agent = "test-agent";
+  log.parsed_timestamp_ms = timestamp;
+  log.http_status_code = 200;
+  return log;
+}
+
+std::vector<uint8_t> bytes_of(const std::string &s) {
+  return std::vector<uint8_t>(s.begin(), s.end());
+}
+
+} // namespace
+
+TEST(StateSnapshotTest, EngineSnapshotRestoresIpAndSessionState) {
+  Config::AppConfig config;
+  config.tier1.session_tracking_enabled = true;
+  AnalysisEngine original(config);
+  for (uint64_t i = 0; i < 4; ++i)
+    original.process_and_analyze(make_log("9.9.9.9", "/a", 1000 + i));
+  original.process_and_analyze(make_log("8.8.8.8", "/b", 2000));
+
+  std::vector<uint8_t> blob = original.capture_snapshot();
+
+  AnalysisEngine restored(config);
+  ASSERT_TRUE(restored.restore_snapshot(blob.data(), blob.size()));
+  EXPECT_EQ(restored.get_ip_state_count(), 2u);
+  EXPECT_EQ(restored.get_session_state_count(),
+            original.get_session_state_count());
+  EXPECT_EQ(restored.get_max_timestamp_seen(), 2000u);
+
+  // A restored IP is not "new" and keeps its window
+  auto event = restored.process_and_analyze(make_log("9.9.9.9", "/a", 2001));
+  EXPECT_FALSE(event.is_first_request_from_ip);
+  EXPECT_FALSE(event.is_path_new_for_ip);
+  ASSERT_TRUE(event.current_ip_request_count_in_window.has_value());
+  EXPECT_EQ(*event.current_ip_request_count_in_window, 5u);
+
+  // Truncated input is rejected without touching the engine
+  EXPECT_FALSE(restored.restore_snapshot(blob.data(), blob.size() / 2));
+  EXPECT_EQ(restored.get_ip_state_count(), 2u);
+}
+
+TEST(StateSnapshotTest, MappedRestoreLoadsIpsOnDemand) {
+  Config::AppConfig config;
+  AnalysisEngine original(config);
+  for (int i = 0; i < 50; ++i)
+    original.process_and_analyze(
+        make_log("10.0.0." + std::to_string(i), "/a", 1000 + i));
+  for (uint64_t i = 0; i < 3; ++i)
+    original.process_and_analyze(make_log("10.0.0.7", "/a", 2000 + i));
+
+  std::string path = snapshot_dir("snapshot_mapped") + "/shard.bin";
+  std::vector<uint8_t> blob = original.capture_snapshot();
+  std::ofstream(path, std::ios::binary)
+      .write(reinterpret_cast<const char *>(blob.data()), blob.size());
+
+  AnalysisEngine restored(config);
+  ASSERT_TRUE(restored.restore_snapshot_file(path));
+  EXPECT_EQ(restored.get_max_timestamp_seen(), 2002u);
+  EXPECT_EQ(restored.get_unloaded_ip_state_count(), 50u);
+
+  auto event = restored.process_and_analyze(make_log("10.0.0.7", "/a", 3000));
+  EXPECT_FALSE(event.is_first_request_from_ip);
+  ASSERT_TRUE(event.current_ip_request_count_in_window.has_value());
+  EXPECT_EQ(*event.current_ip_request_count_in_window, 5u);
+
+  // IPs that are still only in the mapping are carried into new snapshots
+  std::vector<uint8_t> again = restored.capture_snapshot();
+  AnalysisEngine copy(config);
+  ASSERT_TRUE(copy.restore_snapshot(again.data(), again.size()));
+  EXPECT_EQ(copy.get_ip_state_count(), 50u);
+
+  // The warmer eventually hands over everything else
+  for (int i = 0; i < 200 && restored.get_unloaded_ip_state_count() > 0; ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    restored.process_and_analyze(make_log("10.0.0.7", "/a", 3001 + i));
+  }
+  EXPECT_EQ(restored.get_unloaded_ip_state_count(), 0u);
+  EXPECT_EQ(restored.get_ip_state_count(), 50u);
+}
+
+TEST(StateSnapshotTest, IpStateRecordRoundTripsCompactly) {
+  const uint64_t window_ms = 60000;
+  PerIpState state(1000000, window_ms, window_ms);
+  state.ip_first_seen_timestamp_ms = 400000;
+  for (uint64_t i = 0; i < 20; ++i) {
+    uint64_t ts = 1000000 + i * 150;
+    state.request_timestamps_window.add_event(ts, ts);
+    state.recent_unique_ua_window.add_event(ts, i % 2 ? "agent-a" : "agent-b");
+    state.request_time_tracker.update(0.1 * i);
+  }
+  state.last_seen_timestamp_ms = 1000000 + 19 * 150;
+  state.paths_seen_by_ip.insert("/login");
+  state.last_known_user_agent = "agent-a";
+  state.historical_user_agents.insert("agent-a");
+  state.historical_user_agents.insert("agent-b");
+
+  core::BinarySerializer out;
+  state.serialize(out);
+  // 40 window entries plus the rest take less than half of the 16 bytes per
+  // entry a fixed-width layout needs for the windows alone
+  EXPECT_LT(out.size(), 40 * 8u);
+
+  PerIpState restored(0, window_ms, window_ms);
+  core::BinaryDeserializer in(out.data().data(), out.size());
+  restored.deserialize(in);
+  EXPECT_EQ(restored.last_seen_timestamp_ms, state.last_seen_timestamp_ms);
+  EXPECT_EQ(restored.ip_first_seen_timestamp_ms, 400000u);
+  EXPECT_EQ(restored.request_timestamps_window.get_raw_window_data(),
+            state.request_timestamps_window.get_raw_window_data());
+  EXPECT_EQ(restored.recent_unique_ua_window.get_raw_window_data(),
+            state.recent_unique_ua_window.get_raw_window_data());
+  EXPECT_EQ(restored.paths_seen_by_ip, state.paths_seen_by_ip);
+  EXPECT_EQ(restored.last_known_user_agent, "agent-a");
+  EXPECT_EQ(restored.historical_user_agents, state.historical_user_agents);
+  EXPECT_EQ(restored.request_time_tracker.get_count(), 20);
+  EXPECT_DOUBLE_EQ(restored.request_time_tracker.get_mean(),
+                   state.request_time_tracker.get_mean());
+  EXPECT_EQ(restored.bytes_sent_tracker.get_count(), 0);
+
+  // A flipped bit is caught by the record checksum
+  std::vector<uint8_t> corrupted = out.data();
+  corrupted[corrupted.size() / 2] ^= 0x10;
+  PerIpState rejected(0, window_ms, window_ms);
+  core::BinaryDeserializer bad(corrupted.data(), corrupted.size());
+  EXPECT_THROW(rejected.deserialize(bad), std::runtime_error);
+}
+
+TEST(StateSnapshotTest, SaveStateWritesLoadableSnapshot) {
+  Config::AppConfig config;
+  AnalysisEngine original(config);
+  original.process_and_analyze(make_log("4.4.4.4", "/a", 1000));
+  original.process_and_analyze(make_log("5.5.5.5", "/b", 1001));
+
+  std::string path = snapshot_dir("snapshot_save_state") + "/engine.dat";
+  ASSERT_TRUE(original.save_state(path));
+
+  AnalysisEngine restored(config);
+  ASSERT_TRUE(restored.load_state(path));
+  EXPECT_EQ(restored.get_max_timestamp_seen(), 1001u);
+  auto event = restored.process_and_analyze(make_log("4.4.4.4", "/a", 1002));
+  EXPECT_FALSE(event.is_first_request_from_ip);
+  EXPECT_FALSE(restored.load_state(path + ".missing"));
+}
+
+TEST(StateSnapshotTest, ManifestCommitsOnlyCompleteGenerations) {
+  std::string manifest = snapshot_dir("snapshot_manifest") + "/state.dat";
+  core::StateSnapshotter snapshotter(manifest, 2, 0xABCD);
+
+  uint64_t g1 = snapshotter.request_snapshot();
+  snapshotter.submit(0, g1, 100, bytes_of("shard-0"), true);
+  snapshotter.flush();
+  EXPECT_FALSE(snapshotter.load_manifest().has_value());
+
+  snapshotter.submit(1, g1, 90, bytes_of("shard-1"), true);
+  snapshotter.flush();
+  auto m1 = snapshotter.load_manifest();
+  ASSERT_TRUE(m1.has_value());
+  EXPECT_EQ(m1->generation, g1);
+  EXPECT_EQ(m1->watermark_ms, 90u);
+  ASSERT_EQ(m1->shard_files.size(), 2u);
+  auto shard1 = core::StateSnapshotter::read_file(m1->shard_files[1]);
+  ASSERT_TRUE(shard1.has_value());
+  EXPECT_EQ(std::string(shard1->begin(), shard1->end()), "shard-1");
+
+  // Committing the next generation removes the previous one's files
+  uint64_t g2 = snapshotter.request_snapshot();
+  snapshotter.submit(0, g2, 200, bytes_of("a"), true);
+  snapshotter.submit(1, g2, 210, bytes_of("b"), true);
+  snapshotter.flush();
+  EXPECT_EQ(snapshotter.load_manifest()->generation, g2);
+  EXPECT_FALSE(std::filesystem::exists(m1->shard_files[0]));
+
+  snapshotter.discard();
+  EXPECT_FALSE(snapshotter.load_manifest().has_value());
+}
+
+TEST(StateSnapshotTest, SubmitDoesNotWaitForCommit) {
+  std::string manifest = snapshot_dir("snapshot_commit") + "/state.dat";
+  core::StateSnapshotter snapshotter(manifest, 1, 0xABCD);
+  std::atomic<bool> encoding{false};
+  std::atomic<bool> release{false};
+  std::atomic<bool> encoded{false};
+  snapshotter.set_shared_state_encoder([&]() {
+    encoding = true;
+    // Bounded so a regression fails instead of hanging
+    for (int i = 0; i < 500 && !release; ++i)
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    encoded = true;
+    return bytes_of("shared");
+  });
+
+  uint64_t g1 = snapshotter.request_snapshot();
+  snapshotter.submit(0, g1, 100, bytes_of("base-with-enough-bytes"), true);
+  while (!encoding)
+    std::this_thread::yield();
+
+  // The commit of g1 is still encoding the shared state
+  uint64_t g2 = snapshotter.request_snapshot();
+  snapshotter.submit(0, g2, 200, bytes_of("d1"), false);
+  EXPECT_FALSE(encoded.load());
+  EXPECT_EQ(snapshotter.committed_generation(), 0u);
+
+  release = true;
+  snapshotter.flush();
+  auto committed = snapshotter.load_manifest();
+  ASSERT_TRUE(committed.has_value());
+  EXPECT_EQ(committed->generation, g2);
+  EXPECT_EQ(committed->watermark_ms, 200u);
+}
+
+TEST(StateSnapshotTest, DeltasReplayOnTopOfFullSnapshot) {
+  Config::AppConfig config;
+  config.tier1.session_tracking_enabled = true;
+  config.tier1.session_inactivity_ttl_seconds = 1;
+  AnalysisEngine original(config);
+  original.process_and_analyze(make_log("1.1.1.1", "/a", 1000));
+  original.process_and_analyze(make_log("2.2.2.2", "/a", 1000));
+  std::vector<uint8_t> base = original.capture_snapshot();
+
+  // Only the touched IP and its session are dirty
+  original.process_and_analyze(make_log("1.1.1.1", "/b", 1500));
+  EXPECT_EQ(original.get_dirty_state_count(), 2u);
+  std::vector<uint8_t> first = original.capture_delta();
+  EXPECT_LT(first.size(), base.size());
+
+  // A pruned IP is recorded as a removal
+  original.process_and_analyze(make_log("3.3.3.3", "/c", 900000000));
+  original.run_pruning(900000000);
+  std::vector<uint8_t> second = original.capture_delta();
+
+  AnalysisEngine restored(config);
+  ASSERT_TRUE(restored.restore_snapshot(base.data(), base.size()));
+  ASSERT_TRUE(restored.apply_delta(first.data(), first.size()));
+  auto event = restored.process_and_analyze(make_log("1.1.1.1", "/b", 1600));
+  EXPECT_FALSE(event.is_path_new_for_ip);
+
+  ASSERT_TRUE(restored.apply_delta(second.data(), second.size()));
+  EXPECT_EQ(restored.get_ip_state_count(), original.get_ip_state_count());
+  EXPECT_EQ(restored.get_session_state_count(),
+            original.get_session_state_count());
+  EXPECT_EQ(restored.get_max_timestamp_seen(), 900000000u);
+
+  EXPECT_FALSE(restored.apply_delta(second.data(), second.size() - 1));
+}
+
+TEST(StateSnapshotTest, DeltaLogsAreCommittedAndCompacted) {
+  std::string manifest = snapshot_dir("snapshot_delta_log") + "/state.dat";
+  core::StateSnapshotter snapshotter(manifest, 1, 0xABCD,
+                                     /*compaction_interval=*/2);
+
+  uint64_t g1 = snapshotter.request_snapshot();
+  ASSERT_TRUE(snapshotter.full_snapshot_due(0));
+  snapshotter.submit(0, g1, 10, bytes_of("base-with-enough-bytes"), true);
+
+  uint64_t g2 = snapshotter.request_snapshot();
+  EXPECT_FALSE(snapshotter.full_snapshot_due(0));
+  snapshotter.submit(0, g2, 20, bytes_of("d1"), false);
+  uint64_t g3 = snapshotter.request_snapshot();
+  snapshotter.submit(0, g3, 30, bytes_of("d2"), false);
+  snapshotter.flush();
+
+  auto m3 = snapshotter.load_manifest();
+  ASSERT_TRUE(m3.has_value());
+  EXPECT_EQ(m3->generation, g3);
+  EXPECT_EQ(m3->watermark_ms, 30u);
+  EXPECT_EQ(m3->shard_log_bytes[0], 2 * (4 + 2u));
+  std::vector<std::string> records;
+  EXPECT_EQ(core::StateSnapshotter::replay_log(
+                m3->shard_logs[0], m3->shard_log_bytes[0],
+                [&](const uint8_t *data, size_t size) {
+                  records.emplace_back(data, data + size);
+                  return true;
+                }),
+            2u);
+  EXPECT_EQ(records, (std::vector<std::string>{"d1", "d2"}));
+
+  // Two deltas since the base: the next generation is a compaction, which
+  // replaces the base and drops the old log
+  uint64_t g4 = snapshotter.request_snapshot();
+  EXPECT_TRUE(snapshotter.full_snapshot_due(0));
+  snapshotter.submit(0, g4, 40, bytes_of("new-base"), true);
+  snapshotter.flush();
+  auto m4 = snapshotter.load_manifest();
+  EXPECT_EQ(m4->shard_log_bytes[0], 0u);
+  EXPECT_TRUE(m4->shard_logs[0].empty());
+  EXPECT_FALSE(std::filesystem::exists(m3->shard_files[0]));
+  EXPECT_FALSE(std::filesystem::exists(m3->shard_logs[0]));
+}
+
+TEST(StateSnapshotTest, SharedPathStatsRoundTrip) {
+  analysis::SharedPathStats stats;
+  analysis::SharedPathStats::Sample sample;
+  sample.request_time_s = 0.5;
+  stats.record("/x", 1000, sample);
+  stats.record("/y", 1001, sample);
+
+  core::BinarySerializer out;
+  stats.serialize(out);
+
+  analysis::SharedPathStats restored;
+  core::BinaryDeserializer in(out.data().data(), out.size());
+  restored.deserialize(in);
+  EXPECT_EQ(restored.size(), 2u);
+  EXPECT_EQ(restored.record("/x", 1002, sample)
+                .request_time_tracker.get_count(),
+            2);
+}
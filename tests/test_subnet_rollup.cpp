@@ -0,0 +1,97 @@
+#include "analysis/analysis_engine.hpp"
+#include "analysis/subnet_rollup.hpp"
+#include "core/config.hpp"
+#include "core/log_entry.hpp"
+
+#include <gtest/gtest.h>
+#include <string>
+
+using analysis::SubnetRollup;
+
+TEST(SubnetRollupTest, AggregatesAcrossAddressesInNarrowSubnet) {
+  SubnetRollup rollup(60000);
+  for (int i = 1; i <= 10; ++i)
+    rollup.record("198.51.100." + std::to_string(i), 1000 + i, false);
+  rollup.record("198.51.100.3", 1100, true);
+
+  auto result = rollup.record("198.51.100.3", 1200, true);
+  ASSERT_TRUE(result.narrow.has_value());
+  EXPECT_EQ(result.narrow->prefix_length, 24);
+  EXPECT_EQ(result.narrow->requests, 12u);
+  EXPECT_EQ(result.narrow->failed_logins, 2u);
+  EXPECT_EQ(result.narrow->distinct_ips, 10u);
+
+  // A sibling /24 only shares the /16 counter
+  auto other = rollup.record("198.51.7.1", 1300, false);
+  EXPECT_EQ(other.narrow->requests, 1u);
+  ASSERT_TRUE(other.wide.has_value());
+  EXPECT_EQ(other.wide->prefix_length, 16);
+  EXPECT_EQ(other.wide->requests, 13u);
+  EXPECT_NEAR(other.wide->distinct_ips, 11.0, 2.0);
+}
+
+TEST(SubnetRollupTest, OldBucketsLeaveTheWindow) {
+  SubnetRollup rollup(60000);
+  for (int i = 0; i < 5; ++i)
+    rollup.record("192.0.2.1", 1000, false);
+
+  auto later = rollup.record("192.0.2.2", 1000 + 120000, false);
+  EXPECT_EQ(later.narrow->requests, 1u);
+  EXPECT_EQ(later.narrow->distinct_ips, 1u);
+
+  EXPECT_EQ(rollup.tracked_subnet_count(false, false), 1u);
+  EXPECT_EQ(rollup.prune(1000 + 300000), 2u);
+  EXPECT_EQ(rollup.tracked_subnet_count(false, false), 0u);
+}
+
+TEST(SubnetRollupTest, TracksIpv6PrefixesAndMappedIpv4) {
+  SubnetRollup rollup(60000);
+  rollup.record("2001:db8:1:2::1", 1000, false);
+  auto result = rollup.record("2001:db8:1:2::2", 1001, false);
+  EXPECT_EQ(result.narrow->prefix_length, 64);
+  EXPECT_EQ(result.narrow->requests, 2u);
+
+  auto sibling = rollup.record("2001:db8:1:3::1", 1002, false);
+  EXPECT_EQ(sibling.narrow->requests, 1u);
+  EXPECT_EQ(sibling.wide->prefix_length, 48);
+  EXPECT_EQ(sibling.wide->requests, 3u);
+
+  auto mapped = rollup.record("::ffff:192.0.2.9", 1003, false);
+  EXPECT_EQ(mapped.narrow->prefix_length, 24);
+  EXPECT_EQ(rollup.tracked_subnet_count(false, false), 1u);
+
+  EXPECT_FALSE(rollup.record("not-an-ip", 1004, false).narrow.has_value());
+}
+
+TEST(SubnetRollupTest, FormatsPrefixLabels) {
+  EXPECT_EQ(SubnetRollup::format_prefix("203.0.113.77", 24), "203.0.113.0/24");
+  EXPECT_EQ(SubnetRollup::format_prefix("203.0.113.77", 16), "203.0.0.0/16");
+  EXPECT_EQ(SubnetRollup::format_prefix("2001:db8:1:2::5", 64),
+            "2001:db8:1:2::/64");
+  EXPECT_EQ(SubnetRollup::format_prefix("2001:db8:1:2::5", 48),
+            "2001:db8:1::/48");
+}
+
+TEST(SubnetRollupTest, EnginesSharingARollupSeeEachOthersTraffic) {
+  Config::AppConfig config;
+  config.tier1.subnet_rollup_enabled = true;
+  AnalysisEngine first(config);
+  AnalysisEngine second(config);
+  second.set_subnet_rollup(first.get_subnet_rollup());
+
+  LogEntry a;
+  a.ip_address = "10.20.30.1";
+  a.request_path = "/";
+  a.parsed_timestamp_ms = 5000;
+  first.process_and_analyze(std::move(a));
+
+  LogEntry b;
+  b.ip_address = "10.20.30.2";
+  b.request_path = "/";
+  b.parsed_timestamp_ms = 5001;
+  auto event = second.process_and_analyze(std::move(b));
+
+  ASSERT_TRUE(event.subnet_narrow_activity.has_value());
+  EXPECT_EQ(event.subnet_narrow_activity->requests, 2u);
+  EXPECT_EQ(event.subnet_narrow_activity->distinct_ips, 2u);
+}
@@ -0,0 +1,223 @@
+#include "analysis/analysis_engine.hpp"
+#include "analysis/traffic_sketches.hpp"
+#include "core/config.hpp"
+#include "core/log_entry.hpp"
+#include "utils/stream_sketches.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <gtest/gtest.h>
+#include <random>
+#include <string>
+#include <vector>
+
+using analysis::TrafficSketchSet;
+
+TEST(StreamSketchesTest, HyperLogLogEstimatesAndMerges) {
+  Utils::HyperLogLog a(12), b(12);
+  for (int i = 0; i < 20000; ++i)
+    a.add("a-" + std::to_string(i));
+  for (int i = 0; i < 20000; ++i)
+    b.add("b-" + std::to_string(i));
+  EXPECT_NEAR(a.estimate(), 20000.0, 20000.0 * 0.05);
+
+  a.merge(b);
+  EXPECT_NEAR(a.estimate(), 40000.0, 40000.0 * 0.05);
+
+  Utils::HyperLogLog small(12);
+  for (int i = 0; i < 50; ++i)
+    small.add(std::to_string(i % 10));
+  EXPECT_NEAR(small.estimate(), 10.0, 1.0);
+}
+
+TEST(StreamSketchesTest, SpaceSavingKeepsHeavyHitters) {
+  Utils::SpaceSaving<> summary(16);
+  for (int round = 0; round < 100; ++round) {
+    summary.offer("heavy-1", 5);
+    summary.offer("heavy-2", 3);
+    for (int i = 0; i < 10; ++i)
+      summary.offer("noise-" + std::to_string(round * 10 + i));
+  }
+
+  auto top = summary.top(2);
+  ASSERT_EQ(top.size(), 2u);
+  EXPECT_EQ(top[0].key, "heavy-1");
+  EXPECT_EQ(top[1].key, "heavy-2");
+  // Counts never underestimate and overestimate by at most error
+  EXPECT_GE(top[0].count, 500u);
+  EXPECT_LE(top[0].count - top[0].error, 500u);
+  EXPECT_EQ(summary.size(), 16u);
+}
+
+TEST(StreamSketchesTest, SpaceSavingIndexSurvivesMoveAndEviction) {
+  Utils::SpaceSaving<> summary(2);
+  summary.offer("a", 3);
+  summary.offer("b", 2);
+  // Evicts "b"; the newcomer inherits its count as error
+  summary.offer("a-much-longer-key-than-fits-inline", 1);
+
+  Utils::SpaceSaving<> moved(1);
+  moved = std::move(summary);
+  moved.offer("a", 2);
+  moved.offer("a-much-longer-key-than-fits-inline");
+  EXPECT_EQ(moved.size(), 2u);
+
+  auto top = moved.top(2);
+  ASSERT_EQ(top.size(), 2u);
+  EXPECT_EQ(top[0].key, "a");
+  EXPECT_EQ(top[0].count, 5u);
+  EXPECT_EQ(top[1].key, "a-much-longer-key-than-fits-inline");
+  EXPECT_EQ(top[1].count, 4u);
+  EXPECT_EQ(top[1].error, 2u);
+}
+
+namespace {
+// Sample at rank q * (n - 1), the rank QuantileSketch answers for
+double exact_quantile(std::vector<double> values, double q) {
+  std::sort(values.begin(), values.end());
+  return values[static_cast<size_t>(q * (values.size() - 1))];
+}
+} // namespace
+
+TEST(StreamSketchesTest, QuantileSketchStaysWithinRelativeError) {
+  std::mt19937 gen(7);
+  std::lognormal_distribution<> latency(0.0, 1.5);
+  std::normal_distribution<> zscore(0.0, 2.0);
+
+  for (double accuracy : {0.01, 0.05}) {
+    Utils::QuantileSketch sketch(accuracy);
+    std::vector<double> values;
+    for (int i = 0; i < 5000; ++i) {
+      double v = i % 2 ? latency(gen) : zscore(gen);
+      if (i % 50 == 0)
+        v = 0.0;
+      values.push_back(v);
+      sketch.add(v);
+    }
+    for (double q : {0.01, 0.25, 0.5, 0.9, 0.95, 0.99}) {
+      double exact = exact_quantile(values, q);
+      EXPECT_NEAR(sketch.quantile(q), exact, std::abs(exact) * accuracy + 1e-9)
+          << "q=" << q << " accuracy=" << accuracy;
+    }
+  }
+}
+
+TEST(StreamSketchesTest, QuantileSketchRemovesAndMerges) {
+  Utils::QuantileSketch window(0.01), left(0.01), right(0.01);
+  std::vector<double> kept;
+  for (int i = 1; i <= 2000; ++i) {
+    window.add(i);
+    (i % 2 ? left : right).add(i);
+    if (i > 1000)
+      kept.push_back(i);
+  }
+  // Evicting the first half leaves the same answers as never adding it
+  for (int i = 1; i <= 1000; ++i)
+    window.remove(i);
+  EXPECT_EQ(window.count(), 1000u);
+  EXPECT_NEAR(window.quantile(0.5), exact_quantile(kept, 0.5),
+              exact_quantile(kept, 0.5) * 0.01);
+  EXPECT_NEAR(window.quantile(0.0), 1001.0, 1001.0 * 0.01);
+
+  left.merge(right);
+  EXPECT_EQ(left.count(), 2000u);
+  EXPECT_NEAR(left.quantile(0.95), 1900.0, 1900.0 * 0.01);
+
+  window.clear();
+  EXPECT_EQ(window.quantile(0.5), 0.0);
+}
+
+TEST(StreamSketchesTest, QuantileSketchWindowSlidesBothWays) {
+  Utils::QuantileSketch window(0.01);
+  std::deque<double> samples;
+  size_t peak_bytes = 0;
+  // A window of 200 samples drifting up by four decades, then back down
+  for (int step = 0; step < 8000; ++step) {
+    const double exponent =
+        (step < 4000 ? step : 8000 - step) / 1000.0;
+    samples.push_back(std::pow(10.0, exponent));
+    window.add(samples.back());
+    if (samples.size() > 200) {
+      window.remove(samples.front());
+      samples.pop_front();
+    }
+    if (step == 3999)
+      peak_bytes = window.memory_bytes();
+  }
+  std::vector<double> kept(samples.begin(), samples.end());
+  EXPECT_EQ(window.count(), 200u);
+  for (double q : {0.0, 0.5, 1.0})
+    EXPECT_NEAR(window.quantile(q), exact_quantile(kept, q),
+                exact_quantile(kept, q) * 0.01);
+  // Edges are trimmed as the window moves, so the range never spans the
+  // whole drift and the ring stops growing once it fits the window
+  EXPECT_EQ(window.memory_bytes(), peak_bytes);
+}
+
+TEST(TrafficSketchSetTest, MergesTopIpsAndPathsAcrossShards) {
+  TrafficSketchSet sketches(2, 60000);
+  for (int i = 0; i < 30; ++i)
+    sketches.record(0, "10.0.0.1", "/p" + std::to_string(i % 3), 1000, false);
+  for (int i = 0; i < 20; ++i)
+    sketches.record(1, "10.0.0.2", "/p0", 1000, i % 2 == 0);
+  sketches.record(1, "10.0.0.3", "/p1", 1000, false);
+
+  auto ips = sketches.top_ips(TrafficSketchSet::IpMetric::REQUESTS, 2);
+  ASSERT_EQ(ips.size(), 2u);
+  EXPECT_EQ(ips[0].key, "10.0.0.1");
+  EXPECT_EQ(ips[0].count, 30u);
+  EXPECT_NEAR(ips[0].distinct, 3.0, 0.5);
+  EXPECT_EQ(ips[1].key, "10.0.0.2");
+
+  auto errors = sketches.top_ips(TrafficSketchSet::IpMetric::ERRORS, 5);
+  ASSERT_EQ(errors.size(), 1u);
+  EXPECT_EQ(errors[0].count, 10u);
+
+  // /p0 gets traffic from both shards
+  auto paths = sketches.top_paths(1);
+  ASSERT_EQ(paths.size(), 1u);
+  EXPECT_EQ(paths[0].key, "/p0");
+  EXPECT_EQ(paths[0].count, 30u);
+  EXPECT_NEAR(paths[0].distinct, 2.0, 0.5);
+
+  EXPECT_NEAR(sketches.distinct_ips(), 3.0, 0.5);
+  EXPECT_NEAR(sketches.distinct_paths(), 3.0, 0.5);
+}
+
+TEST(TrafficSketchSetTest, OldGenerationsRollOff) {
+  TrafficSketchSet sketches(1, 60000); // 30s generations
+  sketches.record(0, "10.0.0.1", "/", 1000, false);
+  sketches.record(0, "10.0.0.2", "/", 31000, false);
+  EXPECT_EQ(sketches.top_ips(TrafficSketchSet::IpMetric::REQUESTS, 5).size(),
+            2u);
+
+  sketches.record(0, "10.0.0.3", "/", 61000, false);
+  auto ips = sketches.top_ips(TrafficSketchSet::IpMetric::REQUESTS, 5);
+  ASSERT_EQ(ips.size(), 2u);
+  for (const auto &ip : ips)
+    EXPECT_NE(ip.key, "10.0.0.1");
+}
+
+TEST(TrafficSketchSetTest, EngineTopNCoversAllWorkers) {
+  Config::AppConfig config;
+  AnalysisEngine first(config);
+  AnalysisEngine second(config);
+  auto sketches = std::make_shared<TrafficSketchSet>(2, 60000);
+  first.set_traffic_sketches(sketches, 0);
+  second.set_traffic_sketches(sketches, 1);
+
+  for (int i = 0; i < 3; ++i) {
+    LogEntry log;
+    log.ip_address = "7.7.7.7";
+    log.request_path = "/x";
+    log.parsed_timestamp_ms = 1000 + i;
+    second.process_and_analyze(std::move(log));
+  }
+
+  auto top = first.get_top_n_by_metric(5, "request_rate");
+  ASSERT_EQ(top.size(), 1u);
+  EXPECT_EQ(top[0].ip, "7.7.7.7");
+  EXPECT_DOUBLE_EQ(top[0].value, 3.0);
+  EXPECT_TRUE(first.get_top_n_by_metric(5, "unknown").empty());
+}
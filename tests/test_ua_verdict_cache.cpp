@@ -0,0 +1,124 @@
+#include "analysis/analysis_engine.hpp"
+#include "analysis/ua_verdict_cache.hpp"
+#include "core/config.hpp"
+#include "core/log_entry.hpp"
+
+#include <gtest/gtest.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+using analysis::UaVerdict;
+using analysis::UaVerdictCache;
+
+TEST(UaVerdictCacheTest, StoresVerdictsPerUaAndConfigSeed) {
+  UaVerdictCache cache(1000);
+  EXPECT_EQ(cache.capacity(), 1024u);
+
+  const std::string ua = "Mozilla/5.0 (X11; Linux x86_64) Chrome/80.0";
+  uint64_t key = UaVerdictCache::key_for(ua, 1);
+  EXPECT_FALSE(cache.find(key));
+
+  UaVerdict verdict;
+  verdict.flags = UaVerdict::OUTDATED | UaVerdict::CHROME;
+  verdict.browser_major = 80;
+  cache.insert(key, verdict);
+
+  auto found = cache.find(key);
+  ASSERT_TRUE(found);
+  EXPECT_TRUE(found->has(UaVerdict::OUTDATED));
+  EXPECT_TRUE(found->has(UaVerdict::CHROME));
+  EXPECT_FALSE(found->has(UaVerdict::HEADLESS));
+  EXPECT_EQ(found->browser_major, 80);
+
+  // A reload changes the seed, so the old verdict no longer applies
+  EXPECT_FALSE(cache.find(UaVerdictCache::key_for(ua, 2)));
+}
+
+TEST(UaVerdictCacheTest, ConcurrentReadersNeverSeeAnotherUasVerdict) {
+  // Two slots, so every writer keeps evicting the others
+  UaVerdictCache cache(2);
+  constexpr int kThreads = 4;
+  constexpr int kUas = 64;
+
+  std::vector<uint64_t> keys;
+  for (int i = 0; i < kUas; ++i)
+    keys.push_back(UaVerdictCache::key_for("ua-" + std::to_string(i), 0));
+
+  std::vector<int> mismatches(kThreads, 0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t)
+    threads.emplace_back([&, t] {
+      for (int round = 0; round < 20000; ++round) {
+        int i = (round * 7 + t) % kUas;
+        if (auto found = cache.find(keys[i])) {
+          if (found->browser_major != i)
+            ++mismatches[t];
+        } else {
+          UaVerdict verdict;
+          verdict.browser_major = static_cast<uint16_t>(i);
+          cache.insert(keys[i], verdict);
+        }
+      }
+    });
+  for (auto &thread : threads)
+    thread.join();
+
+  for (int count : mismatches)
+    EXPECT_EQ(count, 0);
+}
+
+TEST(UaVerdictCacheTest, SlotHoldsOnlyTheLatestUa) {
+  UaVerdictCache cache(1);
+  const uint64_t first = UaVerdictCache::key_for("ua-a", 0);
+  const uint64_t second = UaVerdictCache::key_for("ua-b", 0);
+  UaVerdict verdict;
+  verdict.browser_major = 1;
+  cache.insert(first, verdict);
+  EXPECT_FALSE(cache.find(second));
+
+  verdict.browser_major = 2;
+  cache.insert(second, verdict);
+  EXPECT_FALSE(cache.find(first));
+  ASSERT_TRUE(cache.find(second));
+  EXPECT_EQ(cache.find(second)->browser_major, 2);
+
+  // The first UA comes back with a new verdict, which is the one read
+  verdict.browser_major = 3;
+  cache.insert(first, verdict);
+  ASSERT_TRUE(cache.find(first));
+  EXPECT_EQ(cache.find(first)->browser_major, 3);
+  EXPECT_FALSE(cache.find(second));
+}
+
+TEST(UaVerdictCacheTest, EngineFlagsSuspiciousUasInTheMarkerScan) {
+  Config::AppConfig config;
+  config.tier1.check_user_agent_anomalies = false;
+  config.tier1.suspicious_ua_substrings = {"sqlmap"};
+  AnalysisEngine engine(config);
+  auto analyze = [&engine](const std::string &ua, uint64_t ts) {
+    LogEntry log;
+    log.ip_address = "10.0.0.1";
+    log.request_path = "/";
+    log.user_agent = ua;
+    log.parsed_timestamp_ms = ts;
+    return engine.process_and_analyze(std::move(log));
+  };
+
+  // The second event reads the cached verdict
+  for (uint64_t ts : {1000, 2000}) {
+    AnalyzedEvent event = analyze("sqlmap/1.7", ts);
+    EXPECT_TRUE(event.found_suspicious_ua_str);
+    EXPECT_FALSE(event.is_ua_known_bad);
+  }
+  EXPECT_FALSE(analyze("Mozilla/5.0", 3000).found_suspicious_ua_str);
+  EXPECT_FALSE(analyze("-", 4000).is_ua_missing);
+
+  // New settings change the cache seed, so old verdicts are not reused
+  config.tier1.check_user_agent_anomalies = true;
+  config.tier1.suspicious_ua_substrings.clear();
+  engine.reconfigure(config);
+  AnalyzedEvent event = analyze("sqlmap/1.7", 5000);
+  EXPECT_FALSE(event.found_suspicious_ua_str);
+  EXPECT_TRUE(event.is_ua_known_bad);
+}